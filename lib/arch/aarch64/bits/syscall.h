@@ -265,5 +265,7 @@
 #define NR_getrandom            278
 #define NR_memfd_create         279
 #define NR_bpf                  280
+#define NR_copy_file_range      285
+#define NR_statx                291
 
 #endif
@@ -381,5 +381,6 @@
 #define NR_pkey_mprotect      380
 #define NR_pkey_alloc         381
 #define NR_pkey_free          382
+#define NR_statx              383
 
 #endif
@@ -12,6 +12,7 @@
 #define MAP_FIXED       (1<<4)
 
 #define MAP_ANONYMOUS	(1<<11) /* MIPS-specific */
+#define MAP_NORESERVE	(1<<10) /* MIPS-specific */
 
 #define MREMAP_MAYMOVE  (1<<0)
 #define MREMAP_FIXED    (1<<1)
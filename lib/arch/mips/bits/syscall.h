@@ -364,5 +364,6 @@
 #define NR_copy_file_range            NR(360)
 #define NR_preadv2                    NR(361)
 #define NR_pwritev2                   NR(362)
+#define NR_statx                      NR(366)
 
 #endif
@@ -326,5 +326,6 @@
 #define NR_pkey_mprotect              5323
 #define NR_pkey_alloc                 5324
 #define NR_pkey_free                  5325
+#define NR_statx                      5326
 
 #endif
@@ -318,5 +318,7 @@
 #define NR_renameat2            316
 #define NR_seccomp              317
 #define NR_getrandom            318
+#define NR_copy_file_range      326
+#define NR_statx                332
 
 #endif
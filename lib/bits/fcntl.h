@@ -54,6 +54,7 @@
 #define S_ISSOCK(m) (((m) & S_IFMT) == S_IFSOCK)
 
 #define F_GETFD 1
+#define F_GETFL 3
 #define F_SETFL 4
 
 #define F_LINUX_SPECIFIC_BASE 1024
@@ -1,3 +1,5 @@
 #include <bits/ioctl.h>
 
 #define BLKGETSIZE64 _IOR(0x12, 114, size_t)
+#define BLKDISCARD   _IO(0x12, 119)
+#define BLKZEROOUT   _IO(0x12, 127)
@@ -0,0 +1,3 @@
+#include <bits/ioctl.h>
+
+#define FICLONE _IOW(0x94, 9, int)
@@ -13,6 +13,7 @@
 #define MAP_PRIVATE     (1<<1)
 #define MAP_FIXED       (1<<4)
 #define MAP_ANONYMOUS   (1<<5)
+#define MAP_NORESERVE   (1<<14)
 
 #define MREMAP_MAYMOVE  (1<<0)
 #define MREMAP_FIXED    (1<<1)
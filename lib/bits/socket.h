@@ -15,14 +15,32 @@
 
 #define SOL_SOCKET      1
 #define SO_REUSEADDR    2
+#define SO_ERROR        4
 #define SO_BROADCAST    6
+#define SO_RCVBUF       8
 #define SO_PASSCRED     16
 #define SO_PEERCRED     17
 #define SO_BINDTODEVICE 25
+#define SO_ATTACH_FILTER 26
+#define SO_RCVBUFFORCE  33
+#define SO_TIMESTAMPNS  35
+#define SO_TIMESTAMPING 37
+
+#define SCM_TIMESTAMPNS  SO_TIMESTAMPNS
+#define SCM_TIMESTAMPING SO_TIMESTAMPING
+
+#define SOF_TIMESTAMPING_TX_SOFTWARE (1<<1)
+#define SOF_TIMESTAMPING_RX_SOFTWARE (1<<3)
+#define SOF_TIMESTAMPING_SOFTWARE    (1<<4)
+#define SOF_TIMESTAMPING_OPT_TSONLY  (1<<11)
 
 #define MSG_OOB            (1<<0)
+#define MSG_PEEK           (1<<1)
+#define MSG_TRUNC          (1<<5)
 #define MSG_DONTWAIT       (1<<6)
+#define MSG_ERRQUEUE       (1<<13)
 #define MSG_NOSIGNAL       (1<<14)
+#define MSG_WAITFORONE     (1<<16)
 #define MSG_CMSG_CLOEXEC   (1<<30)
 
 #endif
@@ -0,0 +1,43 @@
+#ifndef __BITS_SOCKET_FILTER_H__
+#define __BITS_SOCKET_FILTER_H__
+
+#include <bits/types.h>
+
+/* Classic BPF, for SO_ATTACH_FILTER. See linux/filter.h and bpf_common.h */
+
+struct sock_filter {
+	uint16_t code;
+	uint8_t jt;
+	uint8_t jf;
+	uint32_t k;
+};
+
+struct sock_fprog {
+	uint16_t len;
+	struct sock_filter* filter;
+};
+
+#define BPF_LD    0x00
+#define BPF_LDX   0x01
+#define BPF_ALU   0x04
+#define BPF_JMP   0x05
+#define BPF_RET   0x06
+
+#define BPF_W     0x00
+#define BPF_H     0x08
+#define BPF_B     0x10
+
+#define BPF_IMM   0x00
+#define BPF_ABS   0x20
+#define BPF_IND   0x40
+#define BPF_MSH   0xa0
+
+#define BPF_AND   0x50
+#define BPF_JEQ   0x10
+#define BPF_JSET  0x40
+#define BPF_K     0x00
+
+#define BPF_STMT(code, k) { (uint16_t)(code), 0, 0, k }
+#define BPF_JUMP(code, k, jt, jf) { (uint16_t)(code), jt, jf, k }
+
+#endif
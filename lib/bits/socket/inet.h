@@ -3,6 +3,7 @@
 #define PF_INET 2
 #define AF_INET 2
 
+#define IPPROTO_TCP 6
 #define IPPROTO_UDP 17
 
 struct sockaddr_in {
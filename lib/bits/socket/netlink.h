@@ -7,6 +7,9 @@
 #define SOL_NETLINK 270
 #define NETLINK_ADD_MEMBERSHIP 1
 #define NETLINK_DROP_MEMBERSHIP 2
+#define NETLINK_NO_ENOBUFS 5
+#define NETLINK_EXT_ACK 11
+#define NETLINK_GET_STRICT_CHK 12
 
 /* protocols for socket() */
 #define NETLINK_ROUTE           0
@@ -0,0 +1,57 @@
+#ifndef __BITS_STATX_H__
+#define __BITS_STATX_H__
+
+#include <bits/types.h>
+
+/* See also: <linux/stat.h>. Unlike struct stat, the layout
+   is the same on all arches. */
+
+#define STATX_TYPE          (1<<0)
+#define STATX_MODE          (1<<1)
+#define STATX_NLINK         (1<<2)
+#define STATX_UID           (1<<3)
+#define STATX_GID           (1<<4)
+#define STATX_ATIME         (1<<5)
+#define STATX_MTIME         (1<<6)
+#define STATX_CTIME         (1<<7)
+#define STATX_INO           (1<<8)
+#define STATX_SIZE          (1<<9)
+#define STATX_BLOCKS        (1<<10)
+#define STATX_BTIME         (1<<11)
+#define STATX_BASIC_STATS   0x7FF
+
+#define AT_STATX_SYNC_AS_STAT  0x0000
+#define AT_STATX_FORCE_SYNC    0x2000
+#define AT_STATX_DONT_SYNC     0x4000
+
+struct statx_timestamp {
+	int64_t sec;
+	uint32_t nsec;
+	int32_t __0;
+};
+
+struct statx {
+	uint32_t mask;
+	uint32_t blksize;
+	uint64_t attributes;
+	uint32_t nlink;
+	uint32_t uid;
+	uint32_t gid;
+	uint16_t mode;
+	uint16_t __0;
+	uint64_t ino;
+	uint64_t size;
+	uint64_t blocks;
+	uint64_t attributes_mask;
+	struct statx_timestamp atime;
+	struct statx_timestamp btime;
+	struct statx_timestamp ctime;
+	struct statx_timestamp mtime;
+	uint32_t rdev_major;
+	uint32_t rdev_minor;
+	uint32_t dev_major;
+	uint32_t dev_minor;
+	uint64_t __1[14];
+};
+
+#endif
@@ -74,22 +74,17 @@ static uint32_t subword(uint32_t x, const uint8_t box[256])
 	return W(box[B0(x)], box[B1(x)], box[B2(x)], box[B3(x)]);
 }
 
-static uint8_t xtime(uint8_t x)
+/* Multiplication by x (that is, 2) in GF(2^8), for all four bytes
+   of a word at once. */
+
+static uint32_t xtime4(uint32_t x)
 {
-	return ((x<<1) ^ (((x>>7) & 1) * 0x1b)) & 0xFF;
+	return ((x & 0x7F7F7F7F) << 1) ^ (((x >> 7) & 0x01010101) * 0x1B);
 }
 
-static uint8_t xmul(uint8_t x, uint8_t y)
+static uint32_t rotl(uint32_t x, int n)
 {
-	int m = 0;
-
-	for(int i = 0; i <= 4; i++) {
-		if(y & 1) m ^= x;
-		y >>= 1;
-		x = xtime(x);
-	}
-
-	return m & 0xFF;
+	return (x << n) | (x >> (32 - n));
 }
 
 static void add_round_key(uint32_t S[4], uint32_t W[44], int r)
@@ -131,14 +126,6 @@ static void fwd_shift_rows(uint32_t S[4])
 	S[0] = P0; S[1] = P1; S[2] = P2; S[3] = P3;
 }
 
-static uint8_t colmul(uint32_t Si, int a, int b, int c, int d)
-{
-	return xmul(B0(Si), a)
-	     ^ xmul(B1(Si), b)
-	     ^ xmul(B2(Si), c)
-	     ^ xmul(B3(Si), d);
-}
-
 static void inv_sub_bytes(uint32_t S[4])
 {
 	for(int i = 0; i < 4; i++)
@@ -151,25 +138,33 @@ static void fwd_sub_bytes(uint32_t S[4])
 		S[i] = subword(S[i], sbox);
 }
 
-static void inv_mix_columns(uint32_t S[4])
+/* With {a0 a1 a2 a3} being the column and t = a0^a1^a2^a3, forward
+   mixing yields ai' = ai ^ t ^ 2*(ai ^ ai+1). The inverse matrix factors
+   into the forward one times a simple step adding 4*(a0^a2) to a0, a2
+   and 4*(a1^a3) to a1, a3. */
+
+static uint32_t mix_column(uint32_t a)
 {
-	for(int i = 0; i < 4; i++) {
-		uint32_t Si = S[i];
-		S[i] = W(colmul(Si, 0x0E, 0x0B, 0x0D, 0x09),
-		         colmul(Si, 0x09, 0x0E, 0x0B, 0x0D),
-		         colmul(Si, 0x0D, 0x09, 0x0E, 0x0B),
-		         colmul(Si, 0x0B, 0x0D, 0x09, 0x0E));
-	}
+	uint32_t r = rotl(a, 8);
+	uint32_t t = a ^ r;
+
+	t ^= rotl(t, 16);
+
+	return a ^ t ^ xtime4(a ^ r);
 }
 
 static void fwd_mix_columns(uint32_t S[4])
+{
+	for(int i = 0; i < 4; i++)
+		S[i] = mix_column(S[i]);
+}
+
+static void inv_mix_columns(uint32_t S[4])
 {
 	for(int i = 0; i < 4; i++) {
-		uint32_t Si = S[i];
-		S[i] = W(colmul(Si, 0x02, 0x03, 0x01, 0x01),
-		         colmul(Si, 0x01, 0x02, 0x03, 0x01),
-		         colmul(Si, 0x01, 0x01, 0x02, 0x03),
-		         colmul(Si, 0x03, 0x01, 0x01, 0x02));
+		uint32_t a = S[i];
+		uint32_t d = a ^ rotl(a, 16);
+		S[i] = mix_column(a ^ xtime4(xtime4(d)));
 	}
 }
 
@@ -12,3 +12,8 @@ void aes128_fini(struct aes128* ctx);
 
 void aes128_wrap(byte key[16], void* buf, ulong len);
 void aes128_unwrap(byte key[16], void* buf, ulong len);
+
+void aes128_xts_encrypt(struct aes128* K1, struct aes128* K2,
+                        void* rp, void* wp, ulong len, uint64_t S);
+void aes128_xts_decrypt(struct aes128* K1, struct aes128* K2,
+                        void* rp, void* wp, ulong len, uint64_t S);
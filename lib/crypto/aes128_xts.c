@@ -0,0 +1,132 @@
+/* Ref. IEEE Std 1619-2007 XTS-AES, as used by dm-crypt aes-xts-plain64.
+
+   Data unit (sector) size is fixed at 512 bytes, and sector numbers are
+   consecutive starting from S. The tweaks for a batch of blocks get
+   computed upfront, so that the AES calls for the whole batch run back
+   to back without the carry chain of the tweak update between them. */
+
+#include <string.h>
+#include "aes128.h"
+
+#define SECTOR 512
+#define BATCH 8
+
+typedef void (*aesfn)(struct aes128*, uint8_t*);
+
+/* The tweak is a little-endian 128-bit number regardless of the host
+   byte order. Doubling in GF(2^128) is a shift with the carry out of
+   the top bit folded back into the low byte as 0x87. */
+
+static uint64_t load_le64(const byte* p)
+{
+	uint64_t v = 0;
+
+	for(int i = 7; i >= 0; i--)
+		v = (v << 8) | p[i];
+
+	return v;
+}
+
+static void store_le64(byte* p, uint64_t v)
+{
+	for(int i = 0; i < 8; i++) {
+		p[i] = v & 0xFF;
+		v >>= 8;
+	}
+}
+
+static void prep_tweak(byte T[16], struct aes128* K2, uint64_t S)
+{
+	store_le64(T + 0, S);
+	store_le64(T + 8, 0);
+
+	aes128_encrypt(K2, T);
+}
+
+static void fill_tweaks(byte T[BATCH][16], uint64_t* lo, uint64_t* hi)
+{
+	uint64_t l = *lo;
+	uint64_t h = *hi;
+
+	for(int i = 0; i < BATCH; i++) {
+		store_le64(T[i] + 0, l);
+		store_le64(T[i] + 8, h);
+
+		uint64_t c = h >> 63;
+
+		h = (h << 1) | (l >> 63);
+		l = (l << 1) ^ (c * 0x87);
+	}
+
+	*lo = l;
+	*hi = h;
+}
+
+static inline uint64_t load64(const byte* p)
+{
+	uint64_t v;
+
+	__builtin_memcpy(&v, p, sizeof(v));
+
+	return v;
+}
+
+static inline void store64(byte* p, uint64_t v)
+{
+	__builtin_memcpy(p, &v, sizeof(v));
+}
+
+static void xor_batch(byte* w, const byte* r, byte T[BATCH][16])
+{
+	const byte* t = T[0];
+
+	for(int i = 0; i < 16*BATCH; i += 8)
+		store64(w + i, load64(r + i) ^ load64(t + i));
+}
+
+static void xts_sector(struct aes128* K1, struct aes128* K2,
+                       void* rp, void* wp, uint64_t S, aesfn op)
+{
+	byte T[BATCH][16];
+	uint64_t lo, hi;
+
+	prep_tweak(T[0], K2, S);
+
+	lo = load_le64(T[0] + 0);
+	hi = load_le64(T[0] + 8);
+
+	for(int i = 0; i < SECTOR; i += 16*BATCH) {
+		fill_tweaks(T, &lo, &hi);
+
+		xor_batch(wp + i, rp + i, T);
+
+		for(int j = 0; j < BATCH; j++)
+			op(K1, wp + i + 16*j);
+
+		xor_batch(wp + i, wp + i, T);
+	}
+}
+
+static void xts(struct aes128* K1, struct aes128* K2,
+                void* rp, void* wp, ulong len, uint64_t S, aesfn op)
+{
+	ulong off;
+
+	for(off = 0; off + SECTOR <= len; off += SECTOR)
+		xts_sector(K1, K2, rp + off, wp + off, S++, op);
+}
+
+/* rp == wp is allowed. Trailing partial sector, if any, is left
+   untouched. */
+
+void aes128_xts_encrypt(struct aes128* K1, struct aes128* K2,
+                        void* rp, void* wp, ulong len, uint64_t S)
+{
+	xts(K1, K2, rp, wp, len, S, aes128_encrypt);
+}
+
+void aes128_xts_decrypt(struct aes128* K1, struct aes128* K2,
+                        void* rp, void* wp, ulong len, uint64_t S)
+{
+	xts(K1, K2, rp, wp, len, S, aes128_decrypt);
+}
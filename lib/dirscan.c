@@ -0,0 +1,428 @@
+#include <sys/file.h>
+#include <sys/dents.h>
+#include <sys/mman.h>
+
+#include <dirscan.h>
+#include <format.h>
+#include <string.h>
+#include <util.h>
+
+/* See dirscan.h for the general description.
+
+   The point of splitting the scan into two passes is that stat calls are
+   the expensive part on slow (network-backed, or just cold) filesystems.
+   Reading the directories is one syscall per directory, stat is one per
+   entry, and the latter can be issued from several processes at once
+   without affecting the resulting tree in any way.
+
+   Memory comes from a chain of shared anonymous mappings. Entries never
+   move once allocated, the forked stat processes write directly into
+   the entries their parent allocated. */
+
+#define CHUNK (1<<20)
+#define DBUFLEN (8*PAGE)
+#define BATCH 256 /* min number of entries per process */
+
+struct dsblk {
+	struct dsblk* prev;
+	ulong size;
+};
+
+static int extend(struct dscan* ds, ulong size)
+{
+	ulong need = size + sizeof(struct dsblk);
+	ulong len = pagealign(need > CHUNK ? need : CHUNK);
+	int prot = PROT_READ | PROT_WRITE;
+	int flags = MAP_SHARED | MAP_ANONYMOUS;
+	struct dsblk* blk;
+	int ret;
+
+	blk = sys_mmap(NULL, len, prot, flags, -1, 0);
+
+	if((ret = mmap_error(blk)))
+		return ret;
+
+	blk->prev = ds->blk;
+	blk->size = len;
+
+	ds->blk = blk;
+	ds->ptr = (void*)(blk + 1);
+	ds->end = (void*)blk + len;
+
+	return 0;
+}
+
+static void* alloc(struct dscan* ds, ulong size)
+{
+	void* ptr;
+
+	size = (size + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+
+	if(ds->ptr + size > ds->end)
+		if(extend(ds, size) < 0)
+			return NULL;
+
+	ptr = ds->ptr;
+	ds->ptr += size;
+
+	return ptr;
+}
+
+void dsfree(struct dscan* ds)
+{
+	struct dsblk* blk = ds->blk;
+
+	while(blk) {
+		struct dsblk* prev = blk->prev;
+
+		sys_munmap(blk, blk->size);
+
+		blk = prev;
+	}
+
+	ds->blk = NULL;
+	ds->ptr = NULL;
+	ds->end = NULL;
+	ds->top = NULL;
+}
+
+int dspathlen(struct dsent* de)
+{
+	int len = 0;
+
+	for(; de && de->up; de = de->up)
+		len += strlen(de->name) + 1;
+
+	return len;
+}
+
+char* fmtdspath(char* p, char* e, struct dsent* de)
+{
+	if(!de || !de->up)
+		return p;
+
+	p = fmtdspath(p, e, de->up);
+
+	if(de->up->up)
+		p = fmtchar(p, e, '/');
+
+	return fmtstr(p, e, de->name);
+}
+
+static struct dsent* new_entry(struct dscan* ds, struct dsent* dir, char* name)
+{
+	int nlen = strlen(name);
+	struct dsent* de;
+
+	if(!(de = alloc(ds, sizeof(*de) + nlen + 1)))
+		return NULL;
+
+	memzero(de, sizeof(*de));
+	memcpy(de->name, name, nlen + 1);
+
+	de->up = dir;
+
+	return de;
+}
+
+static int isdir(struct dsent* de)
+{
+	return ((de->mode & S_IFMT) == S_IFDIR);
+}
+
+static int cmp_ent(void* pa, void* pb)
+{
+	struct dsent* a = pa;
+	struct dsent* b = pb;
+
+	int da = isdir(a);
+	int db = isdir(b);
+
+	if(!da && db)
+		return -1;
+	if(da && !db)
+		return 1;
+
+	return strcmp(a->name, b->name);
+}
+
+static void set_stat(struct dsent* de, struct stat* st)
+{
+	de->mode = st->mode;
+	de->size = isdir(de) ? 0 : st->size;
+}
+
+static int fail_at(struct dscan* ds, struct dsent* de, int ret)
+{
+	de->err = ret;
+	ds->bad = de;
+	return ret;
+}
+
+/* First pass. Directories are read fully before descending into any of
+   the subdirectories, so the getdents buffer can be shared, and only
+   the directories along the current path remain open. */
+
+static int add_entry(struct dscan* ds, struct dsent* dir, int fd, struct dirent* dd)
+{
+	int flags = AT_SYMLINK_NOFOLLOW;
+	char* name = dd->name;
+	int type = dd->type;
+	struct dsent* de;
+	struct stat st;
+	int ret;
+
+	if(!(de = new_entry(ds, dir, name)))
+		return fail_at(ds, dir, -ENOMEM);
+
+	if(type == DT_DIR) {
+		de->mode = S_IFDIR;
+	} else if(type == DT_UNKNOWN) {
+		if((ret = sys_fstatat(fd, name, &st, flags)) < 0)
+			return fail_at(ds, de, ret);
+
+		set_stat(de, &st);
+	}
+
+	de->next = dir->next;
+	dir->next = de;
+
+	return 1;
+}
+
+static int read_dir(struct dscan* ds, struct dsent* dir, int fd)
+{
+	void* buf = ds->dbuf;
+	int rd, ret, count = 0;
+
+	dir->next = NULL;
+
+	while((rd = sys_getdents(fd, buf, DBUFLEN)) > 0) {
+		void* ptr = buf;
+		void* end = buf + rd;
+
+		while(ptr < end) {
+			struct dirent* dd = ptr;
+
+			if(!dd->reclen)
+				break;
+
+			ptr += dd->reclen;
+
+			if(dotddot(dd->name))
+				continue;
+
+			if((ret = add_entry(ds, dir, fd, dd)) < 0)
+				return ret;
+
+			count++;
+		}
+	} if(rd < 0) {
+		return fail_at(ds, dir, rd);
+	}
+
+	return count;
+}
+
+static int index_dir(struct dscan* ds, struct dsent* dir, int count)
+{
+	struct dsent** sub;
+	struct dsent* de;
+	int i = count;
+
+	if(!(sub = alloc(ds, (count + 1)*sizeof(*sub))))
+		return fail_at(ds, dir, -ENOMEM);
+
+	sub[count] = NULL;
+
+	for(de = dir->next; de && i > 0; de = de->next)
+		sub[--i] = de;
+
+	dir->next = NULL;
+	dir->sub = sub;
+
+	qsortp(sub, count, cmp_ent);
+
+	return 0;
+}
+
+static int scan_dir(struct dscan* ds, struct dsent* dir, int fd, int depth)
+{
+	struct dsent **sp, *de;
+	int ret, sfd;
+
+	if((ret = read_dir(ds, dir, fd)) < 0)
+		return ret;
+	if((ret = index_dir(ds, dir, ret)) < 0)
+		return ret;
+
+	for(sp = dir->sub; (de = *sp); sp++) {
+		if(!isdir(de))
+			continue;
+		if(depth >= ds->maxdepth)
+			return fail_at(ds, de, -ELOOP);
+
+		if((sfd = sys_openat(fd, de->name, O_DIRECTORY)) < 0)
+			return fail_at(ds, de, sfd);
+
+		ret = scan_dir(ds, de, sfd, depth + 1);
+
+		sys_close(sfd);
+
+		if(ret < 0) return ret;
+	}
+
+	return 0;
+}
+
+/* Second pass. Entries to be stat'ed are collected into a flat array
+   in tree order, so that each process gets a contiguous slice and only
+   needs to re-open the directories its slice spans. */
+
+static uint count_pending(struct dsent* dir)
+{
+	struct dsent **sp, *de;
+	uint count = 0;
+
+	for(sp = dir->sub; (de = *sp); sp++)
+		if(isdir(de))
+			count += count_pending(de);
+		else if(!de->mode)
+			count++;
+
+	return count;
+}
+
+static struct dsent** fill_pending(struct dsent** list, struct dsent* dir)
+{
+	struct dsent **sp, *de;
+
+	for(sp = dir->sub; (de = *sp); sp++)
+		if(isdir(de))
+			list = fill_pending(list, de);
+		else if(!de->mode)
+			*list++ = de;
+
+	return list;
+}
+
+static int open_dir(struct dscan* ds, struct dsent* dir)
+{
+	int len = dspathlen(dir);
+
+	if(!dir->up)
+		return ds->at;
+	if(len >= 4096)
+		return -ENAMETOOLONG;
+
+	char* buf = alloca(len + 1);
+	char* p = fmtdspath(buf, buf + len, dir);
+
+	*p = '\0';
+
+	return sys_openat(ds->at, buf, O_DIRECTORY | O_PATH);
+}
+
+static void close_dir(struct dscan* ds, int fd)
+{
+	if(fd >= 0 && fd != ds->at)
+		sys_close(fd);
+}
+
+static void stat_range(struct dscan* ds, struct dsent** list, uint from, uint to)
+{
+	int flags = AT_SYMLINK_NOFOLLOW;
+	struct dsent* dir = NULL;
+	int fd = -1;
+	struct stat st;
+	uint i;
+	int ret;
+
+	for(i = from; i < to; i++) {
+		struct dsent* de = list[i];
+
+		if(de->up != dir) {
+			close_dir(ds, fd);
+			dir = de->up;
+			fd = open_dir(ds, dir);
+		}
+
+		if(fd < 0)
+			ret = fd;
+		else
+			ret = sys_fstatat(fd, de->name, &st, flags);
+
+		if(ret < 0) {
+			de->err = ret;
+		} else {
+			de->err = 0;
+			set_stat(de, &st);
+		}
+	}
+
+	close_dir(ds, fd);
+}
+
+struct stlist {
+	struct dscan* ds;
+	struct dsent** list;
+};
+
+static void stat_part(void* arg, int part, int from, int to)
+{
+	struct stlist* sl = arg;
+
+	stat_range(sl->ds, sl->list, from, to);
+}
+
+static int stat_pending(struct dscan* ds)
+{
+	uint i, count = count_pending(ds->top);
+	struct dsent** list;
+
+	if(!count)
+		return 0;
+	if(!(list = alloc(ds, count*sizeof(*list))))
+		return fail_at(ds, ds->top, -ENOMEM);
+
+	fill_pending(list, ds->top);
+
+	for(i = 0; i < count; i++)
+		list[i]->err = -ECHILD;
+
+	struct stlist sl = { ds, list };
+	int procs = rangeprocs(ds->procs, count, BATCH);
+
+	forkranges(procs, count, stat_part, &sl);
+
+	for(i = 0; i < count; i++)
+		if(list[i]->err)
+			return fail_at(ds, list[i], list[i]->err);
+
+	return 0;
+}
+
+int dirscan(struct dscan* ds, int at)
+{
+	struct dsent* top;
+	int ret;
+
+	ds->at = at;
+	ds->bad = NULL;
+
+	if(ds->maxdepth <= 0)
+		ds->maxdepth = 64;
+
+	if(!(ds->dbuf = alloc(ds, DBUFLEN)))
+		return -ENOMEM;
+	if(!(top = new_entry(ds, NULL, "")))
+		return -ENOMEM;
+
+	top->mode = S_IFDIR;
+	ds->top = top;
+
+	if((ret = scan_dir(ds, top, at, 0)) < 0)
+		return ret;
+
+	return stat_pending(ds);
+}
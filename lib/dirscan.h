@@ -0,0 +1,46 @@
+#include <bits/types.h>
+
+/* Directory tree scanner for tools that need to stat every entry in
+   a tree and then process the tree in a fixed, reproducible order
+   (mpac, cpio).
+
+   The scan is done in two passes. The first one reads the directories
+   with getdents and builds the tree; no stat calls are made there unless
+   the filesystem does not report entry types. The second pass stats
+   all non-directory entries, splitting them between several forked
+   processes when there are enough of them. The tree itself is kept
+   in shared anonymous memory so the results get back to the caller.
+
+   Entries within each directory are sorted: non-directories first,
+   then directories, byte order within each group. */
+
+struct dsent {
+	struct dsent* up;     /* parent directory, NULL for the top one */
+	struct dsent** sub;   /* directories: NULL-terminated entry list */
+	uint64_t size;        /* st.size; 0 for directories */
+	int mode;             /* st.mode; S_IFDIR only for directories */
+	int err;              /* non-zero if stat failed for this entry */
+	struct dsent* next;   /* private */
+	char name[];
+};
+
+struct dscan {
+	int procs;            /* max number of processes to stat with */
+	int maxdepth;         /* fail with -ELOOP if exceeded */
+
+	struct dsent* top;    /* top directory, name is empty */
+	struct dsent* bad;    /* entry that caused dirscan() to fail */
+
+	/* private */
+	int at;
+	void* blk;
+	void* ptr;
+	void* end;
+	void* dbuf;
+};
+
+int dirscan(struct dscan* ds, int at);
+void dsfree(struct dscan* ds);
+
+char* fmtdspath(char* p, char* e, struct dsent* de);
+int dspathlen(struct dsent* de);
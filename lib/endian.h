@@ -37,6 +37,7 @@ inline static uint64_t ntohx(uint64_t n) { return n; }
 
 inline static uint16_t itohs(uint16_t n) { return swabs(n); }
 inline static uint32_t itohl(uint32_t n) { return swabl(n); }
+inline static uint64_t itohx(uint64_t n) { return swabx(n); }
 
 inline static uint32_t htois(uint16_t n) { return swabs(n); }
 inline static uint32_t htoil(uint32_t n) { return swabl(n); }
@@ -53,6 +54,7 @@ inline static uint64_t ntohx(uint64_t n) { return swabx(n); }
 
 inline static uint16_t itohs(uint16_t n) { return n; }
 inline static uint32_t itohl(uint32_t n) { return n; }
+inline static uint64_t itohx(uint64_t n) { return n; }
 
 inline static uint32_t htois(uint16_t n) { return n; }
 inline static uint32_t htoil(uint32_t n) { return n; }
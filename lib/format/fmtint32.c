@@ -1,36 +1,90 @@
 #include <bits/types.h>
+#include <string.h>
 #include <format.h>
 
 /* Format 32-bit integers. Only matters for 32-bit arches where
    it's the native length and i64 requires additional code.
 
-   64-bit arches use 64-bit formatters for all integers. */
+   64-bit arches use 64-bit formatters for all integers.
+   See fmtint64.c for the description of the algorithm. */
 
 #if BITS == 32
 
+static const char pairs[200] =
+	"0001020304050607080910111213141516171819"
+	"2021222324252627282930313233343536373839"
+	"4041424344454647484950515253545556575859"
+	"6061626364656667686970717273747576777879"
+	"8081828384858687888990919293949596979899";
+
+static const uint32_t pow10[10] = {
+	1,
+	10,
+	100,
+	1000,
+	10000,
+	100000,
+	1000000,
+	10000000,
+	100000000,
+	1000000000
+};
+
+static int declen(uint32_t num)
+{
+	uint32_t n = num | 1;
+	int bits = 32 - __builtin_clz(n);
+	int t = (bits * 1233) >> 12;
+
+	return t + 1 - (n < pow10[t]);
+}
+
+static void putdigits(char* e, uint32_t num)
+{
+	char* p = e;
+
+	while(num >= 100) {
+		uint r = num % 100;
+		num /= 100;
+		p -= 2;
+		p[0] = pairs[2*r];
+		p[1] = pairs[2*r+1];
+	} if(num >= 10) {
+		p -= 2;
+		p[0] = pairs[2*num];
+		p[1] = pairs[2*num+1];
+	} else {
+		*(--p) = '0' + num;
+	}
+}
+
 static char* fmtint32(char* buf, char* end, int minus, uint32_t num)
 {
-	int len = 0;
-	uint32_t n;
+	int len = declen(num) + minus;
+	char* e = buf + len;
+
+	if(buf >= end)
+		return buf;
+
+	if(e <= end) {
+		putdigits(e, num);
+		if(minus) *buf = '-';
+		return e;
+	}
 
-	for(len = 1, n = num; n >= 10; len++)
-		n /= 10;
+	char tmp[16];
 
-	int i;
-	char* e = buf + len + minus;
-	char* p = e - 1; /* len >= 1 so e > buf */
+	putdigits(tmp + len, num);
+	if(minus) tmp[0] = '-';
 
-	for(i = 0; i < len; i++, p--, num /= 10)
-		if(p < end)
-			*p = '0' + num % 10;
-	if(minus) *p = '-';
+	memcpy(buf, tmp, end - buf);
 
-	return e > end ? end : e;
+	return end;
 }
 
 char* fmti32(char* buf, char* end, int32_t num)
 {
-	return fmtint32(buf, end, num < 0, num < 0 ? -num : num);
+	return fmtint32(buf, end, num < 0, num < 0 ? -(uint32_t)num : num);
 }
 
 char* fmtu32(char* buf, char* end, uint32_t num)
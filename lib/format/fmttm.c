@@ -1,8 +1,60 @@
 #include <bits/time.h>
 #include <format.h>
 
+/* The common case is a valid date going into a buffer with enough
+   space left, and that gets written directly, two digits at a time. */
+
+static char* put2(char* p, int n)
+{
+	p[0] = '0' + n / 10;
+	p[1] = '0' + n % 10;
+
+	return p + 2;
+}
+
+static int twodigit(int n)
+{
+	return ((unsigned)n < 100);
+}
+
+static int plain(const struct tm* tm)
+{
+	unsigned year = tm->year + 1900;
+
+	if(year > 9999)
+		return 0;
+
+	return twodigit(tm->mon + 1) && twodigit(tm->mday)
+	    && twodigit(tm->hour) && twodigit(tm->min)
+	    && twodigit(tm->sec);
+}
+
+static char* fmttm_fast(char* p, const struct tm* tm)
+{
+	unsigned year = tm->year + 1900;
+
+	p = put2(p, year / 100);
+	p = put2(p, year % 100);
+	*p++ = '-';
+	p = put2(p, tm->mon + 1);
+	*p++ = '-';
+	p = put2(p, tm->mday);
+	*p++ = ' ';
+
+	p = put2(p, tm->hour);
+	*p++ = ':';
+	p = put2(p, tm->min);
+	*p++ = ':';
+	p = put2(p, tm->sec);
+
+	return p;
+}
+
 char* fmttm(char* p, char* e, const struct tm* tm)
 {
+	if(e - p >= 19 && plain(tm))
+		return fmttm_fast(p, tm);
+
 	p = fmtulp(p, e, tm->year + 1900, 4);
 	p = fmtchar(p, e, '-');
 	p = fmtulp(p, e, tm->mon + 1, 2);
@@ -24,5 +24,8 @@ char* fmtulp(char* buf, char* end, unsigned long num, int pad)
 		if(p < end)
 			*p = '0' + num % 10;
 
-	return e;
+	if(e <= end)
+		return e;
+
+	return buf < end ? end : buf;
 }
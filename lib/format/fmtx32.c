@@ -1,28 +1,43 @@
+#include <bits/types.h>
+#include <endian.h>
 #include <format.h>
 
+/* See fmtx64.c */
+
+static uint64_t hex8(uint32_t v)
+{
+	uint64_t x = v;
+
+	x = (x | x << 16) & 0x0000FFFF0000FFFFULL;
+	x = (x | x <<  8) & 0x00FF00FF00FF00FFULL;
+	x = (x | x <<  4) & 0x0F0F0F0F0F0F0F0FULL;
+
+	uint64_t a = ((x + 0x0606060606060606ULL) >> 4) & 0x0101010101010101ULL;
+
+	return htonx(x + 0x3030303030303030ULL + 7*a);
+}
+
 char* fmtx32(char* buf, char* end, uint32_t num)
 {
-	static const char digits[] = "0123456789ABCDEF";
+	uint64_t digits;
+	ulong len, max = end - buf;
+
+	if(buf >= end)
+		return buf;
+
+	len = (32 - __builtin_clz(num | 1) + 3)/4;
 
-	ulong len = 1;
-	ulong n = num;
+	digits = hex8(num);
 
-	for(; n >= 0x10; n >>= 4)
-		len++;
+	char* src = (char*)&digits + 8 - len;
 
-	ulong i;
-	char* e = buf + len;
-	char* p = e - 1; /* len >= 1 so e > buf */
+	if(len > max)
+		len = max;
 
-	for(i = 0; i < len; i++) {
-		if(p < end)
-			*p = digits[num & 0x0F];
-		if(p >= buf)
-			p--;
-		num >>= 4;
-	}
+	for(ulong i = 0; i < len; i++)
+		buf[i] = src[i];
 
-	return e < end ? e : end;
+	return buf + len;
 }
 
 #if BITS == 32
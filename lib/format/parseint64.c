@@ -1,17 +1,31 @@
 #include <bits/types.h>
 #include <format.h>
 
+#if BITS == 64
+
 char* parseu64(char* buf, uint64_t* np)
 {
-	uint64_t n = 0;
-	int d;
+	ulong n;
 	char* p;
 
-	for(p = buf; *p; p++)
-		if(*p >= '0' && (d = *p - '0') < 10)
-			n = n*10 + d;
-		else
-			break;
+	if((p = parseulong(buf, &n)))
+		*np = n;
+
+	return p;
+}
+
+#else
+
+char* parseu64(char* buf, uint64_t* np)
+{
+	uint64_t n = 0;
+	char* p = buf;
+	uint d;
+
+	while((d = (uint)(*p - '0')) < 10) {
+		n = n*10 + d;
+		p++;
+	}
 
 	if(p == buf)
 		return NULL;
@@ -19,3 +33,5 @@ char* parseu64(char* buf, uint64_t* np)
 	*np = n;
 	return p;
 }
+
+#endif
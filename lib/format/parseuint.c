@@ -3,18 +3,11 @@
 
 char* parseuint(char* buf, uint* np)
 {
-	uint d, n = 0;
+	ulong n;
 	char* p;
 
-	for(p = buf; *p; p++)
-		if(*p >= '0' && (d = *p - '0') < 10)
-			n = n*10 + d;
-		else
-			break;
+	if((p = parseulong(buf, &n)))
+		*np = n;
 
-	if(p == buf)
-		return NULL;
-
-	*np = n;
 	return p;
 }
@@ -1,17 +1,82 @@
+#include <bits/types.h>
+#include <bits/mman.h>
+#include <endian.h>
 #include <format.h>
 
-char* parseulong(char* buf, unsigned long* np)
+/* On 64-bit arches, digits are checked and converted 8 at a time
+   whenever there are 8 bytes to read before the end of the page.
+   Reading past the terminating 0 is safe as long as it's the same
+   page, and any non-digit byte in the block sends the code down to
+   the plain loop which stops at the right position.
+
+   Overflow wraps around the same way it would with the plain loop,
+   so the other decimal parsers just call this one and truncate. */
+
+#if BITS == 64
+
+static int alldigits(uint64_t v)
+{
+	uint64_t hi = 0xF0F0F0F0F0F0F0F0ULL;
+	uint64_t zd = 0x3030303030303030ULL;
+
+	if((v & hi) != zd)
+		return 0;
+	if(((v + 0x0606060606060606ULL) & hi) != zd)
+		return 0;
+
+	return 1;
+}
+
+static uint64_t parse8(uint64_t v)
+{
+	uint64_t m = 0x000000FF000000FFULL;
+
+	v -= 0x3030303030303030ULL;
+	v = (v * 10) + (v >> 8);
+	v = ((v & m) * (100 + (1000000ULL << 32))
+	   + ((v >> 16) & m) * (1 + (10000ULL << 32))) >> 32;
+
+	return v;
+}
+
+static char* parseblocks(char* p, ulong* np)
 {
-	unsigned long n = 0;
-	int d;
-	char* p;
-
-	for(p = buf; *p; p++)
-		if(*p >= '0' && (d = *p - '0') < 10)
-			n = n*10 + d;
-		else
+	ulong n = *np;
+	uint64_t v;
+
+	while(((ulong)p & (PAGE - 1)) <= PAGE - 8) {
+		__builtin_memcpy(&v, p, 8);
+
+		v = itohx(v);
+
+		if(!alldigits(v))
 			break;
 
+		n = n*100000000 + parse8(v);
+		p += 8;
+	}
+
+	*np = n;
+
+	return p;
+}
+
+#endif
+
+char* parseulong(char* buf, ulong* np)
+{
+	ulong n = 0;
+	char* p = buf;
+	uint d;
+
+#if BITS == 64
+	p = parseblocks(p, &n);
+#endif
+	while((d = (uint)(*p - '0')) < 10) {
+		n = n*10 + d;
+		p++;
+	}
+
 	if(p == buf)
 		return NULL;
 
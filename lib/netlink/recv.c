@@ -13,6 +13,7 @@ void nr_buf_set(struct nrbuf* nr, void* buf, uint len)
 	nr->ptr = buf;
 	nr->msg = buf;
 	nr->end = buf + len;
+	nr->mapped = 0;
 }
 
 int nr_recv(int fd, struct nrbuf* nr)
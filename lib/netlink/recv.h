@@ -17,19 +17,33 @@ next:
 
    nr_recv does a single sys_recv() and therefore can be used both
    with blocking and non-blocking fds. The only difference is handling
-   EAGAIN return. */
+   EAGAIN return.
+
+   Netlink never splits messages between datagrams, but a datagram
+   that does not fit into the space left gets truncated, losing its
+   tail. nr_recv_whole checks the size first (MSG_PEEK | MSG_TRUNC)
+   and either makes room for it or fails with ENOBUFS, leaving the
+   datagram queued. Buffers set up with nr_buf_map get grown as needed.
+
+   Large dumps should use a mapped buffer of at least 32KB: the kernel
+   sizes dump datagrams after the largest recv() buffer it has seen
+   on the socket, up to that limit, so small buffers mean many more
+   round trips for the same data. */
 
 struct nrbuf {
 	void* buf;
 	void* msg;
 	void* ptr;
 	void* end;
+	int mapped;
 };
 
 int nl_recv(int fd, void* buf, int len);
 
 void nr_buf_set(struct nrbuf* nr, void* buf, unsigned len);
+int nr_buf_map(struct nrbuf* nr, unsigned len);
 int nr_recv(int fd, struct nrbuf* nr);
+int nr_recv_whole(int fd, struct nrbuf* nr);
 struct nlmsg* nr_next(struct nrbuf* nr);
 void nr_reset(struct nrbuf* nr);
 
@@ -38,3 +52,10 @@ void nr_reset(struct nrbuf* nr);
    running commands through the socket before subscribing. */
 
 int nl_subscribe(int fd, int id);
+
+/* Strict checking of dump requests (Linux 4.20+), which also makes
+   the kernel apply the filters given in request headers and attributes
+   instead of dumping everything. Fails with ENOPROTOOPT on older
+   kernels, in which case dumps are just unfiltered. */
+
+int nl_strict(int fd);
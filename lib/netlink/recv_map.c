@@ -0,0 +1,80 @@
+#include <sys/socket.h>
+#include <sys/mman.h>
+
+#include <netlink.h>
+#include <netlink/recv.h>
+
+#include <util.h>
+
+/* Self-allocated receive buffers for nr_recv_whole. See recv.h. */
+
+int nr_buf_map(struct nrbuf* nr, uint len)
+{
+	int prot = PROT_READ | PROT_WRITE;
+	int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+	ulong size = pagealign(len);
+	void* buf = sys_mmap(NULL, size, prot, flags, -1, 0);
+	int ret;
+
+	if((ret = mmap_error(buf)))
+		return ret;
+
+	nr_buf_set(nr, buf, size);
+	nr->mapped = 1;
+
+	return 0;
+}
+
+static int grow_buf(struct nrbuf* nr, ulong need)
+{
+	void* buf = nr->buf;
+	ulong size = nr->end - buf;
+	ulong msgoff = nr->msg - buf;
+	ulong ptroff = nr->ptr - buf;
+	ulong new = 2*size;
+	int ret;
+
+	if(new < ptroff + need)
+		new = pagealign(ptroff + need);
+
+	buf = sys_mremap(buf, size, new, MREMAP_MAYMOVE);
+
+	if((ret = mmap_error(buf)))
+		return ret;
+
+	nr->buf = buf;
+	nr->msg = buf + msgoff;
+	nr->ptr = buf + ptroff;
+	nr->end = buf + new;
+
+	return 0;
+}
+
+int nr_recv_whole(int fd, struct nrbuf* nr)
+{
+	void* buf = nr->buf;
+	void* ptr = nr->ptr;
+	void* end = nr->end;
+	long need, ret;
+
+	if(ptr < buf || ptr > end)
+		return -ENOBUFS;
+
+	if((need = sys_recv(fd, NULL, 0, MSG_PEEK | MSG_TRUNC)) <= 0)
+		return need;
+
+	if(need <= end - ptr)
+		;
+	else if(!nr->mapped)
+		return -ENOBUFS;
+	else if((ret = grow_buf(nr, need)) < 0)
+		return ret;
+
+	ptr = nr->ptr;
+	end = nr->end;
+
+	if((ret = sys_recv(fd, ptr, end - ptr, 0)) > 0)
+		nr->ptr = ptr + ret;
+
+	return ret;
+}
@@ -0,0 +1,12 @@
+#include <sys/socket.h>
+#include <netlink.h>
+#include <netlink/recv.h>
+
+int nl_strict(int fd)
+{
+	int lvl = SOL_NETLINK;
+	int opt = NETLINK_GET_STRICT_CHK;
+	int val = 1;
+
+	return sys_setsockopt(fd, lvl, opt, &val, sizeof(val));
+}
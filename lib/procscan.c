@@ -0,0 +1,450 @@
+#include <sys/file.h>
+#include <sys/dents.h>
+#include <sys/mman.h>
+
+#include <procscan.h>
+#include <format.h>
+#include <string.h>
+#include <util.h>
+
+/* See procscan.h for the general description.
+
+   Reading /proc is slow mostly because of the number of syscalls
+   involved, at least three (open, read, close) per file per process,
+   and the kernel generating file contents on each read. There is not
+   much to be done about the syscalls themselves, but they can be issued
+   from several processes at once. Paths are opened relative to /proc
+   directly, without opening the per-pid directories.
+
+   Command lines are of arbitrary size, so each reading process gets
+   its own large lazily-allocated chunk of the shared mapping to put
+   them into. */
+
+#define PROC "/proc"
+#define DBUFLEN (8*PAGE)
+#define ARENA (32*1024*1024)
+#define BATCH 256 /* min number of entries per process */
+
+struct arena {
+	char* ptr;
+	char* end;
+};
+
+static int isdigit(int c)
+{
+	return (c >= '0' && c <= '9');
+}
+
+static int isspace(int c)
+{
+	return (c == ' ' || c == '\t');
+}
+
+/* Pid list. This one is small enough (4 bytes per process) to be kept
+   in a private mapping grown with mremap as needed. */
+
+static int add_pid(struct pscan* ps, int** pids, ulong* size, int pid)
+{
+	int* ptr = *pids;
+	ulong need = (ps->count + 1)*sizeof(int);
+	int ret;
+
+	if(need > *size) {
+		ulong old = *size;
+		ulong new = old ? 2*old : 16*PAGE;
+
+		if(old)
+			ptr = sys_mremap(ptr, old, new, MREMAP_MAYMOVE);
+		else
+			ptr = sys_mmap(NULL, new, PROT_READ | PROT_WRITE,
+			                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+		if((ret = mmap_error(ptr)))
+			return ret;
+
+		*pids = ptr;
+		*size = new;
+	}
+
+	ptr[ps->count++] = pid;
+
+	return 0;
+}
+
+static int list_pids(struct pscan* ps, int at, int** pids, ulong* size)
+{
+	char buf[DBUFLEN];
+	int rd, ret, pid;
+	char* p;
+
+	while((rd = sys_getdents(at, buf, sizeof(buf))) > 0) {
+		void* ptr = buf;
+		void* end = buf + rd;
+
+		while(ptr < end) {
+			struct dirent* de = ptr;
+
+			if(!de->reclen)
+				break;
+
+			ptr += de->reclen;
+
+			if(de->type != DT_DIR)
+				continue;
+			if(!isdigit(de->name[0]))
+				continue;
+			if(!(p = parseint(de->name, &pid)) || *p)
+				continue;
+
+			if((ret = add_pid(ps, pids, size, pid)) < 0)
+				return ret;
+		}
+	}
+
+	return rd;
+}
+
+/* The kernel lists pids in ascending order, so this is linear
+   in all practical cases. User-supplied pid lists may need actual
+   sorting, but those are always short. */
+
+static void sort_pids(int* pids, int n)
+{
+	int i, j;
+
+	for(i = 1; i < n; i++) {
+		int pid = pids[i];
+
+		for(j = i; j > 0 && pids[j-1] > pid; j--)
+			pids[j] = pids[j-1];
+
+		pids[j] = pid;
+	}
+}
+
+/* Per-process files */
+
+static int read_file(int at, int pid, char* name, char* buf, int len)
+{
+	int fd, rd;
+
+	FMTBUF(p, e, path, 40);
+	p = fmtint(p, e, pid);
+	p = fmtchar(p, e, '/');
+	p = fmtstr(p, e, name);
+	FMTEND(p, e);
+
+	if((fd = sys_openat(at, path, O_RDONLY)) < 0)
+		return fd;
+
+	rd = sys_read(fd, buf, len);
+
+	sys_close(fd);
+
+	return rd;
+}
+
+static char* skipspace(char* p, char* e)
+{
+	for(; p < e; p++)
+		if(!isspace(*p))
+			break;
+
+	return p;
+}
+
+static void set_uids(char* p, int* uid, int* euid)
+{
+	if(!(p = parseint(p, uid)))
+		return;
+
+	while(*p && isspace(*p))
+		p++;
+
+	(void)parseint(p, euid);
+}
+
+static void set_name(struct psent* pe, char* val, char* end)
+{
+	ulong len = end - val;
+
+	if(len > sizeof(pe->name) - 1)
+		len = sizeof(pe->name) - 1;
+
+	memcpy(pe->name, val, len);
+	pe->name[len] = '\0';
+}
+
+/* All the fields we need are near the top of the file, way before
+   the long lists of capabilities and memory stats. */
+
+static int read_status(struct psent* pe, int at)
+{
+	char buf[1024];
+	int rd;
+
+	if((rd = read_file(at, pe->pid, "status", buf, sizeof(buf))) < 0)
+		return rd;
+
+	char* end = buf + rd;
+	char *ls, *le;
+
+	for(ls = buf; ls < end; ls = le + 1) {
+		if((le = strecbrk(ls, end, '\n')) >= end)
+			break;
+
+		char* key = ls;
+		char* val;
+
+		if((val = strecbrk(ls, le, ':')) >= le)
+			break;
+
+		*le = '\0'; *val++ = '\0';
+		val = skipspace(val, le);
+
+		if(!strcmp(key, "Name"))
+			set_name(pe, val, le);
+		else if(!strcmp(key, "State"))
+			pe->state = *val;
+		else if(!strcmp(key, "PPid"))
+			(void)parseint(val, &pe->ppid);
+		else if(!strcmp(key, "Uid"))
+			set_uids(val, &pe->uid, &pe->euid);
+		else if(!strcmp(key, "Gid"))
+			set_uids(val, &pe->gid, &pe->egid);
+	}
+
+	return 0;
+}
+
+/* The stat line is "pid (comm) state ppid ... utime stime ... starttime",
+   with comm possibly containing spaces and parens, so the fields are
+   counted from the last closing paren. */
+
+static char* skipfields(char* p, char* e, int n)
+{
+	while(n-- > 0) {
+		while(p < e && *p != ' ') p++;
+		while(p < e && *p == ' ') p++;
+	}
+
+	return p < e ? p : NULL;
+}
+
+static int read_stat(struct psent* pe, int at)
+{
+	char buf[1024];
+	uint64_t utime, stime;
+	int rd;
+
+	if((rd = read_file(at, pe->pid, "stat", buf, sizeof(buf) - 1)) < 0)
+		return rd;
+
+	char* e = buf + rd;
+	char* p = e;
+
+	*e = '\0';
+
+	while(p > buf && *(p-1) != ')')
+		p--;
+	if(p <= buf)
+		return -EINVAL;
+
+	/* p is at " state", utime is the 11th field after state */
+
+	if(!(p = skipfields(p, e, 12)))
+		return -EINVAL;
+	if(!(p = parseu64(p, &utime)))
+		return -EINVAL;
+	if(!(p = skipfields(p, e, 1)))
+		return -EINVAL;
+	if(!(p = parseu64(p, &stime)))
+		return -EINVAL;
+	if(!(p = skipfields(p, e, 7)))
+		return -EINVAL;
+	if(!(p = parseu64(p, &pe->start)))
+		return -EINVAL;
+
+	pe->ticks = utime + stime;
+
+	return 0;
+}
+
+static int read_cmdline(struct psent* pe, int at, struct arena* ar)
+{
+	char* buf = ar->ptr;
+	char* ptr = buf;
+	char* end = ar->end;
+	int fd, rd = 0;
+
+	FMTBUF(p, e, path, 40);
+	p = fmtint(p, e, pe->pid);
+	p = fmtstr(p, e, "/cmdline");
+	FMTEND(p, e);
+
+	if((fd = sys_openat(at, path, O_RDONLY)) < 0)
+		return fd;
+
+	while(ptr < end) {
+		if((rd = sys_read(fd, ptr, end - ptr)) <= 0)
+			break;
+		ptr += rd;
+	}
+
+	sys_close(fd);
+
+	if(rd < 0)
+		return rd;
+
+	pe->cmd = buf;
+	pe->cmdlen = ptr - buf;
+
+	ar->ptr = ptr;
+
+	return 0;
+}
+
+static void read_proc(struct pscan* ps, struct psent* pe, int at, struct arena* ar)
+{
+	int flags = ps->flags;
+	int ret;
+
+	if((ret = read_status(pe, at)) < 0)
+		goto out;
+	if((flags & PS_STAT) && (ret = read_stat(pe, at)) < 0)
+		goto out;
+	if((flags & PS_CMDLINE) && (ret = read_cmdline(pe, at, ar)) < 0)
+		goto out;
+out:
+	pe->err = ret;
+}
+
+static void read_range(struct pscan* ps, int at, int i, int from, int to)
+{
+	struct arena ar = { NULL, NULL };
+
+	if(ps->flags & PS_CMDLINE) {
+		char* base = (char*)ps->map + ps->size - (ulong)(i + 1)*ARENA;
+		ar.ptr = base;
+		ar.end = base + ARENA;
+	}
+
+	for(int k = from; k < to; k++)
+		read_proc(ps, &ps->ents[k], at, &ar);
+}
+
+struct rdlist {
+	struct pscan* ps;
+	int at;
+};
+
+static void read_part(void* arg, int part, int from, int to)
+{
+	struct rdlist* rl = arg;
+
+	read_range(rl->ps, rl->at, part, from, to);
+}
+
+static int prep_table(struct pscan* ps, int* pids, int procs)
+{
+	int prot = PROT_READ | PROT_WRITE;
+	int flags = MAP_SHARED | MAP_ANONYMOUS | MAP_NORESERVE;
+	int i, count = ps->count;
+	ulong size = pagealign(count*sizeof(struct psent) + 1);
+	struct psent* ents;
+	int ret;
+
+	if(ps->flags & PS_CMDLINE)
+		size += (ulong)procs*ARENA;
+
+	ents = sys_mmap(NULL, size, prot, flags, -1, 0);
+
+	if((ret = mmap_error(ents)))
+		return ret;
+
+	for(i = 0; i < count; i++) {
+		ents[i].pid = pids[i];
+		ents[i].err = -ECHILD;
+	}
+
+	ps->map = ents;
+	ps->size = size;
+	ps->ents = ents;
+
+	return 0;
+}
+
+/* With pids == NULL, the whole /proc gets scanned. Otherwise only
+   the listed pids get read, which is much cheaper if there are few. */
+
+int procscan(struct pscan* ps, int* pids, int npids)
+{
+	int* list = NULL;
+	ulong lsize = 0;
+	int at, ret, procs;
+	struct rdlist rl;
+
+	ps->count = 0;
+	ps->ents = NULL;
+	ps->map = NULL;
+
+	if((at = sys_open(PROC, O_DIRECTORY)) < 0)
+		return at;
+
+	if(pids) {
+		for(int i = 0; i < npids; i++)
+			if((ret = add_pid(ps, &list, &lsize, pids[i])) < 0)
+				goto out;
+	} else if((ret = list_pids(ps, at, &list, &lsize)) < 0) {
+		goto out;
+	}
+
+	sort_pids(list, ps->count);
+
+	procs = rangeprocs(ps->procs, ps->count, BATCH);
+
+	if((ret = prep_table(ps, list, procs)) < 0)
+		goto out;
+
+	rl.ps = ps;
+	rl.at = at;
+
+	forkranges(procs, ps->count, read_part, &rl);
+out:
+	if(list)
+		sys_munmap(list, lsize);
+
+	sys_close(at);
+
+	return ret;
+}
+
+void psfree(struct pscan* ps)
+{
+	if(ps->map)
+		sys_munmap(ps->map, ps->size);
+
+	ps->map = NULL;
+	ps->ents = NULL;
+	ps->count = 0;
+}
+
+struct psent* psfind(struct pscan* ps, int pid)
+{
+	struct psent* ents = ps->ents;
+	int lo = 0, hi = ps->count;
+
+	while(lo < hi) {
+		int mid = lo + (hi - lo)/2;
+		int mp = ents[mid].pid;
+
+		if(mp == pid)
+			return &ents[mid];
+		if(mp < pid)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return NULL;
+}
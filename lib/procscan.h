@@ -0,0 +1,50 @@
+#include <bits/types.h>
+
+/* /proc snapshot for the process listing tools (pslist, pstree, pskill,
+   sysinfo).
+
+   The list of pids is read first, then per-process files are read
+   and parsed into a flat table of fixed-size entries, sorted by pid.
+   With enough processes in the system, the pid list is split into
+   contiguous ranges read by several forked processes at once. The
+   table lives in shared anonymous memory so the results get back
+   to the caller.
+
+   Entries for processes that exited before they could be read have
+   non-zero err and should be skipped. */
+
+#define PS_CMDLINE (1<<0)   /* read /proc/$pid/cmdline */
+#define PS_STAT    (1<<1)   /* read /proc/$pid/stat for cpu time */
+
+struct psent {
+	int pid;
+	int ppid;
+	int uid, euid;
+	int gid, egid;
+	int err;
+	char state;
+	char name[64];      /* escaped, as in /proc/$pid/status */
+
+	uint cmdlen;        /* NUL-separated argv[], with PS_CMDLINE */
+	char* cmd;
+
+	uint64_t ticks;     /* utime + stime, with PS_STAT */
+	uint64_t start;     /* starttime, with PS_STAT */
+};
+
+struct pscan {
+	int procs;          /* max number of processes to read with */
+	int flags;          /* PS_* */
+
+	int count;
+	struct psent* ents;
+
+	/* private */
+	void* map;
+	ulong size;
+};
+
+int procscan(struct pscan* ps, int* pids, int npids);
+void psfree(struct pscan* ps);
+
+struct psent* psfind(struct pscan* ps, int pid);
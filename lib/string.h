@@ -7,6 +7,7 @@ int memxcmp(const void* av, const void* bv, size_t len);
 void memzero(void* a, size_t n);
 void* memmove(void* dst, const void* src, size_t n);
 int nonzero(void* a, size_t n);
+size_t memcount(const void* buf, size_t len, int c);
 
 char* strcbrk(char* str, char c);
 char* strecbrk(char* p, char* e, char k);
@@ -0,0 +1,69 @@
+#include <string.h>
+
+/* Number of bytes equal to c in the buffer, for counting lines
+   mostly. The bulk of the buffer gets processed a word at a time:
+   matching bytes are turned into 0x01 in their lanes, and the lanes
+   get added up in a word-sized accumulator which is folded into
+   the total before any of the byte-wide lane counters can overflow.
+   Folding goes through 16-bit lanes, since the sum of all byte lanes
+   may not fit into a byte. */
+
+#define ONES  (~0UL/255)
+#define HIGHS (ONES*0x80)
+#define LOWS  (ONES*0x7F)
+#define PAIRS (~0UL/0xFFFF)
+#define EVENS (PAIRS*0xFF)
+
+static inline ulong load(const char* p)
+{
+	ulong w;
+
+	__builtin_memcpy(&w, p, sizeof(w));
+
+	return w;
+}
+
+static inline ulong matches(ulong w, ulong pat)
+{
+	ulong x = w ^ pat;
+
+	return (~(((x & LOWS) + LOWS) | x) & HIGHS) >> 7;
+}
+
+static inline size_t fold(ulong acc)
+{
+	ulong sum = (acc & EVENS) + ((acc >> 8) & EVENS);
+
+	return (sum * PAIRS) >> (8*(sizeof(ulong) - 2));
+}
+
+size_t memcount(const void* buf, size_t len, int c)
+{
+	const char* p = buf;
+	const char* e = p + len;
+	const ulong W = sizeof(ulong);
+	ulong pat = ONES * (c & 0xFF);
+	size_t cnt = 0;
+
+	while(e - p >= 4*W) {
+		const char* q = p + 63*4*W;
+		ulong acc = 0;
+
+		if(q > e) q = e;
+
+		for(; q - p >= 4*W; p += 4*W) {
+			acc += matches(load(p + 0*W), pat);
+			acc += matches(load(p + 1*W), pat);
+			acc += matches(load(p + 2*W), pat);
+			acc += matches(load(p + 3*W), pat);
+		}
+
+		cnt += fold(acc);
+	}
+
+	for(; p < e; p++)
+		if(*p == (char)c)
+			cnt++;
+
+	return cnt;
+}
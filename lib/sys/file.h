@@ -1,5 +1,6 @@
 #include <syscall.h>
 #include <bits/stat.h>
+#include <bits/statx.h>
 #include <bits/types.h>
 #include <bits/fcntl.h>
 #include <bits/stdio.h>
@@ -151,6 +152,15 @@ inline static long sys_fstatat(int dirfd, const char *path,
 	return syscall4(NR_fstatat, dirfd, (long)path, (long)st, flags);
 }
 
+/* The mask tells which fields the caller needs; the kernel may
+   skip the rest, and reports what got filled in stx->mask. */
+
+inline static long sys_statx(int dirfd, const char* path, int flags,
+                             uint mask, struct statx* stx)
+{
+	return syscall5(NR_statx, dirfd, (long)path, flags, mask, (long)stx);
+}
+
 inline static long sys_lstat(const char *path, struct stat *st)
 {
 	return syscall4(NR_fstatat, AT_FDCWD, (long)path, (long)st,
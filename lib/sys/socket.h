@@ -1,6 +1,7 @@
 #include <bits/socket.h>
 #include <bits/types.h>
 #include <bits/iovec.h>
+#include <bits/time.h>
 #include <syscall.h>
 
 #define SHUT_RD   0
@@ -17,6 +18,11 @@ struct msghdr {
 	int flags;
 };
 
+struct mmsghdr {
+	struct msghdr hdr;
+	unsigned len;
+};
+
 inline static long sys_socket(int domain, int type, int proto)
 {
 	return syscall3(NR_socket, domain, type, proto);
@@ -89,6 +95,12 @@ inline static long sys_recvmsg(int fd, struct msghdr* msg, int flags)
 	return syscall3(NR_recvmsg, fd, (long)msg, flags);
 }
 
+inline static long sys_recvmmsg(int fd, struct mmsghdr* msgs, unsigned n,
+		int flags, struct timespec* ts)
+{
+	return syscall5(NR_recvmmsg, fd, (long)msgs, n, flags, (long)ts);
+}
+
 inline static long sys_send(int fd, const char* buf, int len, int flags)
 {
 	return syscall6(NR_sendto, fd, (long)buf, len, flags, 0, 0);
@@ -105,3 +117,8 @@ inline static long sys_sendmsg(int fd, const struct msghdr* msg, int flags)
 {
 	return syscall3(NR_sendmsg, fd, (long)msg, flags);
 }
+
+inline static long sys_sendmmsg(int fd, struct mmsghdr* msgs, unsigned n, int flags)
+{
+	return syscall4(NR_sendmmsg, fd, (long)msgs, n, flags);
+}
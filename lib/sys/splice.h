@@ -23,3 +23,10 @@ inline static long sys_sendfile(int ofd, int ifd, uint64_t* offset, size_t count
 {
 	return syscall4(NR_sendfile, ofd, ifd, (long)offset, count);
 }
+
+inline static long sys_copy_file_range(int ifd, uint64_t* ioff, int ofd,
+                                       uint64_t* ooff, size_t len, unsigned flags)
+{
+	return syscall6(NR_copy_file_range, ifd, (long)ioff, ofd, (long)ooff,
+                                                                   len, flags);
+}
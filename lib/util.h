@@ -20,6 +20,17 @@ long execvpe(char* file, char** argv, char** envp);
 
 int getifindex(int fd, char* ifname);
 
+int ncpus(void);
+
+typedef void (*rangefn)(void* arg, int part, int from, int to);
+
+int rangeprocs(int procs, int count, int batch);
+void forkranges(int n, int count, rangefn fn, void* arg);
+
+struct statx;
+
+int statxat(int at, const char* name, int flags, uint mask, struct statx* stx);
+
 void warn(const char* msg, const char* obj, int err);
 void fail(const char* msg, const char* obj, int err) noreturn;
 void _exit(int) noreturn;
@@ -0,0 +1,51 @@
+#include <sys/proc.h>
+#include <sys/prctl.h>
+
+#include <util.h>
+
+/* Splitting a list of independent items into contiguous ranges, each
+   processed by a forked process, with the caller taking the first one.
+   Results are expected to go into memory shared with the children, and
+   the caller should pre-fill them with an error, so that anything a
+   crashed process did not get to stays failed.
+
+   If fork fails, the range gets processed by the caller instead. */
+
+int rangeprocs(int procs, int count, int batch)
+{
+	int need = count / batch;
+
+	if(procs <= 0)
+		procs = ncpus();
+	if(need < procs)
+		procs = need;
+
+	return procs > 1 ? procs : 1;
+}
+
+void forkranges(int n, int count, rangefn fn, void* arg)
+{
+	int i, pid, status;
+	int pids[n];
+
+	for(i = 1; i < n; i++) {
+		int from = (long)count * i / n;
+		int to = (long)count * (i + 1) / n;
+
+		if((pid = sys_fork()) < 0) {
+			fn(arg, i, from, to);
+		} else if(pid == 0) {
+			sys_prctl(PR_SET_PDEATHSIG, SIGTERM, 0, 0, 0);
+			fn(arg, i, from, to);
+			_exit(0);
+		}
+
+		pids[i] = pid;
+	}
+
+	fn(arg, 0, 0, (long)count / n);
+
+	for(i = 1; i < n; i++)
+		if(pids[i] > 0)
+			sys_waitpid(pids[i], &status, 0);
+}
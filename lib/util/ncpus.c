@@ -0,0 +1,26 @@
+#include <sys/sched.h>
+#include <string.h>
+#include <util.h>
+
+/* Number of CPUs this process may run on. Tools that split the work
+   between several processes use this as the default process count. */
+
+int ncpus(void)
+{
+	struct cpuset cs;
+	int ret;
+
+	memzero(&cs, sizeof(cs));
+
+	if((ret = sys_sched_getaffinity(0, &cs)) < 0)
+		return 1;
+
+	uint w, b, cpus = 0;
+
+	for(w = 0; w < ARRAY_SIZE(cs.bits); w++)
+		for(b = 0; b < 8*sizeof(cs.bits[0]); b++)
+			if(cs.bits[w] & (1UL << b))
+				cpus++;
+
+	return cpus ? cpus : 1;
+}
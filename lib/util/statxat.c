@@ -0,0 +1,58 @@
+#include <sys/file.h>
+
+#include <string.h>
+#include <util.h>
+
+/* statx, with a fallback to fstatat for kernels older than 4.11.
+   In the latter case, struct statx gets the basic stats and the device
+   from struct stat, regardless of the mask. Once statx turns out to be
+   missing, it does not get tried again. */
+
+static int nostatx;
+
+static void from_stat(struct statx* stx, struct stat* st)
+{
+	uint64_t dev = st->dev;
+
+	stx->mask = STATX_BASIC_STATS;
+	stx->blksize = st->blksize;
+	stx->nlink = st->nlink;
+	stx->uid = st->uid;
+	stx->gid = st->gid;
+	stx->mode = st->mode;
+	stx->ino = st->ino;
+	stx->size = st->size;
+	stx->blocks = st->blocks;
+
+	stx->atime.sec = st->atime.sec;
+	stx->atime.nsec = st->atime.nsec;
+	stx->mtime.sec = st->mtime.sec;
+	stx->mtime.nsec = st->mtime.nsec;
+	stx->ctime.sec = st->ctime.sec;
+	stx->ctime.nsec = st->ctime.nsec;
+
+	stx->dev_major = ((dev >> 32) & 0xFFFFF000) | ((dev >> 8) & 0x00000FFF);
+	stx->dev_minor = ((dev >> 12) & 0xFFFFFF00) | (dev & 0x000000FF);
+}
+
+int statxat(int at, const char* name, int flags, uint mask, struct statx* stx)
+{
+	struct stat st;
+	int ret;
+
+	if(nostatx)
+		goto old;
+	if((ret = sys_statx(at, name, flags, mask, stx)) != -ENOSYS)
+		return ret;
+
+	nostatx = 1;
+old:
+	if((ret = sys_fstatat(at, name, &st, flags)) < 0)
+		return ret;
+
+	memzero(stx, sizeof(*stx));
+
+	from_stat(stx, &st);
+
+	return ret;
+}
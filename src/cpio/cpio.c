@@ -69,14 +69,14 @@ int main(int argc, char** argv)
 	ctx->argv = argv;
 	ctx->argi = 1;
 
+	if(argc > 1 && argv[1][0] == '-')
+		ctx->opts = argbits(OPTS, argv[ctx->argi++] + 1);
+
 	ctx->at = -1;
 	ctx->null = -1;
 	ctx->cpio.fd = -1;
 	ctx->list.fd = -1;
 
-	if(argc < 2)
-		fail("too few arguments", NULL, 0);
-
 	char* cmd = shift(ctx);
 
 	if(cmd[0] && !cmd[1])
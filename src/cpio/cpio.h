@@ -2,6 +2,9 @@
 
 #define MAXDEPTH 15
 
+#define OPTS "l"
+#define OPT_l (1<<0)
+
 struct bufout;
 
 struct header {
@@ -36,11 +39,6 @@ struct heap {
 	void* end;
 };
 
-struct dent {
-	void* buf;
-	int len;
-};
-
 /* archive entry being packed */
 struct entry {
 	char* name;
@@ -67,6 +65,19 @@ struct htmp {
 	uint size;
 };
 
+struct lz4 {
+	void* slots;
+	int nslots;
+	int cur;
+};
+
+struct links {
+	void* table;
+	uint cap;
+	uint count;
+	void* names;
+};
+
 struct list {
 	int fd;
 	char* name;
@@ -85,15 +96,17 @@ struct top {
 	int argc;
 	int argi;
 	char** argv;
+	int opts;
 
 	struct bufout* bo;
 	struct cpio cpio;
 	struct heap heap;
 	struct hwin hwin;
-	struct dent dent;
 	struct entry entry;
 	struct list list;
 	struct htmp htmp;
+	struct lz4 lz4;
+	struct links links;
 
 	int at;
 	char* dir;
@@ -142,3 +155,12 @@ void put_trailer(CTX);
 void put_immlink(CTX);
 
 void reset_entry(CTX);
+
+void lz4_init(CTX);
+void lz4_write(CTX, void* buf, uint len);
+void lz4_send(CTX, int fd, uint size);
+void lz4_fini(CTX);
+
+int link_content(CTX, void* buf, uint size, uint mode, uint* ino);
+char* find_extracted(CTX, uint ino);
+void note_extracted(CTX, uint ino, char* name);
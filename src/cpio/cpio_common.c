@@ -105,19 +105,35 @@ void open_cpio_file(CTX, char* name)
 	ctx->cpio.name = name;
 }
 
+static int has_extension(char* name, char* suff)
+{
+	int nlen = strlen(name);
+	int slen = strlen(suff);
+
+	if(nlen <= slen)
+		return 0;
+
+	return !strcmp(name + nlen - slen, suff);
+}
+
+/* Output files named *.cpio.lz4 get compressed on the fly. */
+
 void make_cpio_file(CTX, char* name)
 {
 	int fd;
 	int flags = O_WRONLY | O_CREAT | O_TRUNC;
 	int mode = 0644;
+	int lz4 = has_extension(name, ".cpio.lz4");
 
-	check_cpio_ext(name);
+	if(!lz4) check_cpio_ext(name);
 
 	if((fd = sys_open3(name, flags, mode)) < 0)
 		fail(NULL, name, fd);
 
 	ctx->cpio.fd = fd;
 	ctx->cpio.name = name;
+
+	if(lz4) lz4_init(ctx);
 }
 
 void open_base_dir(CTX, char* name)
@@ -242,12 +258,33 @@ static void header_size(struct header* hdr, uint size)
 	format_size(hdr->filesize, size);
 }
 
+static void header_link(struct header* hdr, uint ino)
+{
+	format_size(hdr->ino, ino);
+	format_size(hdr->nlink, 2);
+}
+
+static void output(CTX, void* buf, uint len)
+{
+	int ret, fd = ctx->cpio.fd;
+
+	if(ctx->lz4.slots)
+		return lz4_write(ctx, buf, len);
+
+	/* may be a whole mapped file with -l, see put_linked */
+	if((ret = writeall(fd, buf, len)) < 0)
+		fail("write", NULL, ret);
+}
+
 static void stream_body(CTX, int fd, uint size)
 {
 	int ifd = fd;
 	int ofd = ctx->cpio.fd;
 	int ret;
 
+	if(ctx->lz4.slots)
+		return lz4_send(ctx, fd, size);
+
 	while(size > 0) {
 		int sfb = (size < (1U<<30)) ? size : (1U<<30);
 
@@ -387,17 +424,13 @@ static struct header* named_header(CTX, char* name, uint nlen)
 
 static void write_header(CTX, uint skip)
 {
-	int ret, fd = ctx->cpio.fd;
 	void* buf = ctx->htmp.buf;
 	uint len = ctx->htmp.end - ctx->htmp.buf;
 
 	if(ctx->htmp.ptr < ctx->htmp.end)
 		warn("header underfilled", NULL, 0);
 
-	if((ret = sys_write(fd, buf, len)) < 0)
-		fail("write", NULL, ret);
-	if(ret != len)
-		fail("incomplete write", NULL, 0);
+	output(ctx, buf, len);
 
 	ctx->skip = skip;
 
@@ -421,24 +454,67 @@ void put_pref(CTX)
 	write_header(ctx, 0);
 }
 
-void put_file(CTX, uint mode)
-{
-	int fd, at = ctx->at;
+/* With -l, the content gets mmaped, hashed, and if it has been seen
+   before, only the header gets written. The body in this case comes
+   from the mapping rather than from sendfile. */
 
+static void put_linked(CTX, int fd, uint mode)
+{
 	uint size = ctx->entry.size;
 	char* path = ctx->entry.path;
+	int prot = PROT_READ;
+	int flags = MAP_PRIVATE;
+	uint ino;
+	int ret;
+
+	void* buf = sys_mmap(NULL, size, prot, flags, fd, 0);
+
+	if((ret = mmap_error(buf)))
+		fail("mmap", path, ret);
+
+	int dup = link_content(ctx, buf, size, mode, &ino);
 
 	struct header* hdr = entry_header(ctx, 0);
 
 	header_mode(hdr, S_IFREG | mode);
-	header_size(hdr, size);
+	header_link(hdr, ino);
+
+	if(dup) {
+		header_size(hdr, 0);
+		write_header(ctx, 0);
+	} else {
+		header_size(hdr, size);
+		write_header(ctx, align4(size) - size);
+		output(ctx, buf, size);
+	}
+
+	sys_munmap(buf, size);
+}
 
-	write_header(ctx, align4(size) - size);
+void put_file(CTX, uint mode)
+{
+	int fd, at = ctx->at;
+
+	uint size = ctx->entry.size;
+	char* path = ctx->entry.path;
 
 	if((fd = sys_openat(at, path, O_RDONLY)) < 0)
 		fail(NULL, path, fd);
 
-	stream_body(ctx, fd, size);
+	if((ctx->opts & OPT_l) && size > 0) {
+		put_linked(ctx, fd, mode & ~S_IFMT);
+	} else {
+		struct header* hdr = entry_header(ctx, 0);
+
+		header_mode(hdr, S_IFREG | mode);
+		header_size(hdr, size);
+
+		write_header(ctx, align4(size) - size);
+
+		stream_body(ctx, fd, size);
+	}
+
+	sys_close(fd);
 }
 
 void put_symlink(CTX)
@@ -490,4 +566,7 @@ void put_trailer(CTX)
 	(void)hdr;
 
 	write_header(ctx, 0);
+
+	if(ctx->lz4.slots)
+		lz4_fini(ctx);
 }
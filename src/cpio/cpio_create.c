@@ -2,9 +2,9 @@
 #include <sys/fpath.h>
 #include <sys/fprop.h>
 #include <sys/mman.h>
-#include <sys/dents.h>
 #include <sys/splice.h>
 
+#include <dirscan.h>
 #include <string.h>
 #include <printf.h>
 #include <format.h>
@@ -12,73 +12,40 @@
 
 #include "cpio.h"
 
-#define EN_DIR 0
-#define EN_FILE 1
-#define EN_EXEC 2
-#define EN_LINK 3
-
-struct ent {
-	short len;
-	short type;
-	uint size;
-	char name[];
-};
-
-static int cmp_ent(void* pa, void* pb)
+static void fail_dsent(CTX, struct dsent* de, int ret)
 {
-	struct ent* a = pa;
-	struct ent* b = pb;
-
-	int da = (a->type == EN_DIR);
-	int db = (b->type == EN_DIR);
-
-	if(!da && db)
-		return -1;
-	if(da && !db)
-		return 1;
-
-	return strcmp(a->name, b->name);
-}
+	int len = dspathlen(de) + 1;
+	char* buf = alloca(len);
+	char* p = fmtdspath(buf, buf + len - 1, de);
 
-static int count_entries(void* p0, void* p1)
-{
-	void* ptr = p0;
-	void* end = p1;
-	int count = 0;
-
-	while(ptr < end) {
-		struct ent* en = ptr;
-		ptr += en->len;
-		count++;
-	}
+	*p = '\0';
 
-	return count;
+	failx(ctx, buf, ret);
 }
 
-static void scan_directory(CTX);
+static void process_tree(CTX, struct dsent* dir);
 
-static void enter_directory(CTX, struct ent* en)
+static void enter_directory(CTX, struct dsent* de)
 {
 	int fd, at = ctx->at;
 	char* pref = ctx->pref;
+	int plen = ctx->plen;
 	int depth = ctx->depth;
+	int ret;
 
-	if(depth >= MAXDEPTH)
-		failx(ctx, en->name, -ELOOP);
-
-	if((fd = sys_openat(at, en->name, O_DIRECTORY)) < 0)
-		failx(ctx, en->name, fd);
+	if((fd = sys_openat(at, de->name, O_DIRECTORY | O_PATH)) < 0)
+		failx(ctx, de->name, fd);
 
-	int len = strlen(en->name) + 1;
+	int len = strlen(de->name) + 1;
 
-	len += strlen(pref) + 1;
+	len += plen + 1;
 
 	char* path = alloca(len + 1);
 	char* p = path;
 	char* e = path + len;
 
 	p = fmtstr(p, e, pref);
-	p = fmtstr(p, e, en->name);
+	p = fmtstr(p, e, de->name);
 	p = fmtstr(p, e, "/");
 	*p = '\0';
 
@@ -91,19 +58,23 @@ static void enter_directory(CTX, struct ent* en)
 
 	put_pref(ctx);
 
-	scan_directory(ctx);
+	process_tree(ctx, de);
+
+	if((ret = sys_close(fd)) < 0)
+		fail("close", NULL, ret);
 
 	ctx->pref = pref;
-	ctx->plen = strlen(path);
+	ctx->plen = plen;
 	ctx->at = at;
 	ctx->depth = depth;
 }
 
-static void process_entry(CTX, struct ent* en)
+static void process_entry(CTX, struct dsent* de)
 {
-	int type = en->type;
+	int mode = de->mode;
+	int type = mode & S_IFMT;
 
-	char* name = en->name;
+	char* name = de->name;
 	uint nlen = strlen(name);
 
 	ctx->entry.name = name;
@@ -112,13 +83,13 @@ static void process_entry(CTX, struct ent* en)
 	ctx->entry.path = name;
 	ctx->entry.plen = nlen;
 
-	ctx->entry.size = en->size;
+	ctx->entry.size = de->size;
 
-	if(type == EN_DIR)
-		enter_directory(ctx, en);
-	else if(type == EN_LINK)
+	if(type == S_IFDIR)
+		enter_directory(ctx, de);
+	else if(type == S_IFLNK)
 		put_symlink(ctx);
-	else if(type == EN_EXEC)
+	else if(mode & 0111)
 		put_file(ctx, 0755 | S_IFREG);
 	else
 		put_file(ctx, 0644 | S_IFREG);
@@ -126,136 +97,75 @@ static void process_entry(CTX, struct ent* en)
 	reset_entry(ctx);
 }
 
-static int index_entries(void* p0, void* p1, int count, struct ent** idx)
+/* Everything gets checked before anything gets written, so that
+   the archive does not end up half-done because of some special
+   file deep down the tree. */
+
+static void check_tree(CTX, struct dsent* dir)
 {
-	void* ptr = p0;
-	void* end = p1;
-	int i = 0;
-
-	while(ptr < end && i < count) {
-		struct ent* en = ptr;
-		idx[i++] = en;
-		ptr += en->len;
+	struct dsent **sp, *de;
+
+	for(sp = dir->sub; (de = *sp); sp++) {
+		int type = de->mode & S_IFMT;
+
+		if(type == S_IFDIR)
+			check_tree(ctx, de);
+		else if(type == S_IFLNK && de->size > 0xFFFF)
+			fail_dsent(ctx, de, -E2BIG);
+		else if(type == S_IFREG && de->size > 0xFFFFFFFF)
+			fail_dsent(ctx, de, -E2BIG);
+		else if(type != S_IFLNK && type != S_IFREG)
+			fail_dsent(ctx, de, -EINVAL);
 	}
-
-	return i;
 }
 
-static void process_dir(CTX, void* p0, void* p1)
+static void process_tree(CTX, struct dsent* dir)
 {
-	int count = count_entries(p0, p1);
-	struct ent** idx = heap_alloc(ctx, count*sizeof(void*));
-
-	count = index_entries(p0, p1, count, idx);
-
-	qsortp(idx, count, cmp_ent);
+	struct dsent **sp, *de;
 
-	for(int i = 0; i < count; i++) {
-		process_entry(ctx, idx[i]);
-	}
+	for(sp = dir->sub; (de = *sp); sp++)
+		process_entry(ctx, de);
 }
 
-static void check_dent(CTX, int at, char* name)
+static void scan_directory(CTX, struct dscan* ds)
 {
-	struct stat st;
-	int flags = AT_SYMLINK_NOFOLLOW;
 	int ret;
 
-	if((ret = sys_fstatat(at, name, &st, flags)) < 0)
-		failx(ctx, name, ret);
-
-	struct ent* ep;
-	int nlen = strlen(name);
-	int mode = st.mode;
-	int need = sizeof(*ep) + nlen + 1;
-	int type = mode & S_IFMT;
-	uint size;
-
-	if(type == S_IFDIR) {
-		size = 0;
-		type = EN_DIR;
-	} else if(type == S_IFLNK) {
-		if(st.size > 0xFFFF)
-			fail(NULL, name, -E2BIG);
-		size = st.size;
-		type = EN_LINK;
-	} else if(type == S_IFREG) {
-		if(st.size > 0xFFFFFFFF)
-			fail(NULL, name, -E2BIG);
-		size = st.size;
-		type = (mode & 0111) ? EN_EXEC : EN_FILE;
-	} else {
-		failx(ctx, name, -EINVAL);
-	}
-
-	need = (need + 3) & ~3;
-
-	ep = heap_alloc(ctx, need);
-
-	ep->len = need;
-	ep->type = type;
-	ep->size = size;
-
-	memcpy(ep->name, name, nlen + 1);
-};
-
-static void scan_directory(CTX)
-{
-	int ret, fd = ctx->at;
-	void* buf = ctx->dent.buf;
-	int len = ctx->dent.len;
-
-	void* p0 = heap_point(ctx);
-
-	while((ret = sys_getdents(fd, buf, len)) > 0) {
-		void* ptr = buf;
-		void* end = buf + ret;
+	memzero(ds, sizeof(*ds));
 
-		while(ptr < end) {
-			struct dirent* de = ptr;
+	ds->maxdepth = MAXDEPTH;
 
-			char* name = de->name;
-			int reclen = de->reclen;
+	if((ret = dirscan(ds, ctx->at)) >= 0)
+		return;
+	if(ds->bad)
+		fail_dsent(ctx, ds->bad, ret);
 
-			if(reclen <= 0)
-				break;
-
-			ptr += reclen;
-
-			if(dotddot(name))
-				continue;
-
-			check_dent(ctx, fd, name);
-		}
-	} if(ret < 0) {
-		failx(ctx, "", ret);
-	}
-
-	void* p1 = heap_point(ctx);
-
-	process_dir(ctx, p0, p1);
-
-	heap_reset(ctx, p0);
+	failx(ctx, "", ret);
 }
 
 void cmd_create(CTX)
 {
 	char* name = shift(ctx);
 	char* dir = shift(ctx);
+	struct dscan ds;
 
 	no_more_arguments(ctx);
 
 	heap_init(ctx, 4*PAGE);
 
-	ctx->dent.len = 2*PAGE;
-	ctx->dent.buf = heap_alloc(ctx, ctx->dent.len);
 	ctx->pref = "";
 	ctx->plen = 0;
 
 	open_base_dir(ctx, dir);
+
+	scan_directory(ctx, &ds);
+	check_tree(ctx, ds.top);
+
 	make_cpio_file(ctx, name);
 
-	scan_directory(ctx);
+	process_tree(ctx, ds.top);
 
 	put_trailer(ctx);
+
+	dsfree(&ds);
 }
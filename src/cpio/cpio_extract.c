@@ -366,15 +366,53 @@ static uint write_cached(CTX, int fd, uint filesize)
 	return ret;
 }
 
+static void extract_data(CTX, int fd, uint filesize)
+{
+	uint got = write_cached(ctx, fd, filesize);
+
+	if(got < filesize)
+		stream_rest(ctx, fd, filesize - got);
+
+	sys_close(fd);
+}
+
 static void extract_file(CTX, uint filesize, char* name, uint mode)
 {
 	int fd = open_output(ctx, name, mode);
-	uint got = write_cached(ctx, fd, filesize);
 
-	if(got >= filesize)
+	extract_data(ctx, fd, filesize);
+}
+
+/* Hardlinked entries, see cpio_links.c. The content may come with any
+   entry in a group, not necessarily the first one: GNU cpio for instance
+   puts it into the last one, and the kernel accepts either. Later entries
+   get linked to the first one, and if they carry any data, it gets written
+   through the new link, replacing whatever the file had. */
+
+static void extract_linked(CTX, uint filesize, char* name, uint mode, uint ino)
+{
+	int fd, ret, at = ctx->at;
+	int flags = O_WRONLY | O_TRUNC;
+	char* old;
+
+	if(!(old = find_extracted(ctx, ino))) {
+		extract_file(ctx, filesize, name, mode);
+		note_extracted(ctx, ino, name);
 		return;
+	}
+
+	remove_existing(ctx, name);
+
+	if((ret = sys_linkat(at, old, at, name, 0)) < 0)
+		failx(ctx, name, ret);
+
+	if(!filesize)
+		return;
+
+	if((fd = sys_openat(at, name, flags)) < 0)
+		failx(ctx, name, fd);
 
-	stream_rest(ctx, fd, filesize - got);
+	extract_data(ctx, fd, filesize);
 }
 
 static int copy_cached(CTX, void* buf, int len)
@@ -439,11 +477,15 @@ static int extract_single_entry(CTX, struct header* hdr)
 	uint namesize;
 	uint filesize;
 	uint mode;
+	uint nlink;
+	uint ino;
 
 	check_magic(ctx, hdr->magic);
 	parse_size(ctx, hdr->filesize, &filesize);
 	parse_size(ctx, hdr->namesize, &namesize);
 	parse_size(ctx, hdr->mode, &mode);
+	parse_size(ctx, hdr->nlink, &nlink);
+	parse_size(ctx, hdr->ino, &ino);
 
 	read_name(ctx, namesize);
 
@@ -459,7 +501,9 @@ static int extract_single_entry(CTX, struct header* hdr)
 
 	int type = mode & S_IFMT;
 
-	if(type == S_IFREG)
+	if(type == S_IFREG && nlink >= 2)
+		extract_linked(ctx, filesize, name, mode, ino);
+	else if(type == S_IFREG)
 		extract_file(ctx, filesize, name, mode);
 	else if(type == S_IFLNK)
 		extract_link(ctx, filesize, name);
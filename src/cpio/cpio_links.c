@@ -0,0 +1,165 @@
+#include <sys/file.h>
+#include <sys/mman.h>
+
+#include <crypto/sha256.h>
+#include <string.h>
+#include <util.h>
+
+#include "cpio.h"
+
+/* Hardlinks in newc archives are entries sharing the same ino value
+   with nlink >= 2. The kernel (init/initramfs.c) remembers every such
+   entry by ino and links later ones to the first, so the content only
+   needs to be stored once, with the remaining entries having size 0.
+
+   When packing with -l, files get hashed and looked up in the table
+   below. Since there is no way to tell whether a file will have any
+   duplicates at the time its header gets written, all files packed
+   this way get unique ino-s and nlink = 2.
+
+   The extract side keeps a list of names for the ino-s seen so far. */
+
+struct link {
+	byte hash[32];
+	uint size;
+	uint mode;
+	uint ino;
+};
+
+static struct link* alloc_table(uint cap)
+{
+	ulong size = pagealign(cap*sizeof(struct link));
+	int prot = PROT_READ | PROT_WRITE;
+	int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+	void* ptr;
+	int ret;
+
+	ptr = sys_mmap(NULL, size, prot, flags, -1, 0);
+
+	if((ret = mmap_error(ptr)))
+		fail("mmap", NULL, ret);
+
+	return ptr;
+}
+
+static uint hash_index(byte hash[32], uint cap)
+{
+	uint idx = hash[0] | (hash[1] << 8) | (hash[2] << 16) | (hash[3] << 24);
+
+	return idx & (cap - 1);
+}
+
+static struct link* locate(struct link* table, uint cap, byte hash[32], uint size, uint mode)
+{
+	uint i = hash_index(hash, cap);
+
+	while(1) {
+		struct link* ln = &table[i];
+
+		if(!ln->ino)
+			return ln;
+		if(ln->size == size && ln->mode == mode)
+			if(!memcmp(ln->hash, hash, 32))
+				return ln;
+
+		i = (i + 1) & (cap - 1);
+	}
+}
+
+static void grow_table(CTX)
+{
+	struct link* old = ctx->links.table;
+	uint oldcap = ctx->links.cap;
+	uint cap = oldcap ? 2*oldcap : 1024;
+	struct link* new = alloc_table(cap);
+
+	for(uint i = 0; i < oldcap; i++) {
+		struct link* ln = &old[i];
+
+		if(!ln->ino) continue;
+
+		struct link* ls = locate(new, cap, ln->hash, ln->size, ln->mode);
+
+		memcpy(ls, ln, sizeof(*ln));
+	}
+
+	if(old)
+		sys_munmap(old, pagealign(oldcap*sizeof(struct link)));
+
+	ctx->links.table = new;
+	ctx->links.cap = cap;
+}
+
+/* Returns ino for the content, and whether it has been seen before. */
+
+int link_content(CTX, void* buf, uint size, uint mode, uint* ino)
+{
+	byte hash[32];
+
+	if(2*(ctx->links.count + 1) > ctx->links.cap)
+		grow_table(ctx);
+
+	sha256(hash, buf, size);
+
+	struct link* ln = locate(ctx->links.table, ctx->links.cap, hash, size, mode);
+
+	if(ln->ino) {
+		*ino = ln->ino;
+		return 1;
+	}
+
+	memcpy(ln->hash, hash, 32);
+	ln->size = size;
+	ln->mode = mode;
+	ln->ino = ++ctx->links.count;
+
+	*ino = ln->ino;
+
+	return 0;
+}
+
+struct xlink {
+	struct xlink* next;
+	uint ino;
+	char name[];
+};
+
+#define NXLINKS 256
+
+char* find_extracted(CTX, uint ino)
+{
+	struct xlink** xl = ctx->links.names;
+	struct xlink* p;
+
+	if(!xl) return NULL;
+
+	for(p = xl[ino % NXLINKS]; p; p = p->next)
+		if(p->ino == ino)
+			return p->name;
+
+	return NULL;
+}
+
+void note_extracted(CTX, uint ino, char* name)
+{
+	struct xlink** xl = ctx->links.names;
+	struct xlink* p;
+	int nlen = strlen(name);
+
+	if(!xl) {
+		int size = NXLINKS*sizeof(*xl);
+
+		xl = heap_alloc(ctx, size);
+		memzero(xl, size);
+
+		ctx->links.names = xl;
+	}
+
+	p = heap_alloc(ctx, (sizeof(*p) + nlen + 1 + 7) & ~7);
+
+	p->ino = ino;
+	memcpy(p->name, name, nlen + 1);
+
+	p->next = xl[ino % NXLINKS];
+	xl[ino % NXLINKS] = p;
+}
@@ -0,0 +1,346 @@
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/proc.h>
+#include <sys/prctl.h>
+#include <sys/signal.h>
+
+#include <string.h>
+#include <util.h>
+
+#include "cpio.h"
+
+/* Built-in LZ4 compression for the output. The kernel can unpack
+   initramfs images in LZ4 legacy format (CONFIG_RD_LZ4), which is
+   simply a magic word followed by independently compressed blocks
+   of up to 8MB, each prefixed with its compressed size.
+
+   Independent blocks mean they can be compressed in parallel.
+   The input gets buffered into a ring of slots in shared memory,
+   each full slot is handed over to a forked process, and the parent
+   moves on to the next slot. Once the ring wraps around, the parent
+   waits for the oldest slot and writes it out, so the blocks end up
+   in the file in the same order they were filled.
+
+   The compressor itself is a plain greedy single-probe hash matcher.
+   The ratio is a bit worse than that of the reference lz4 tool,
+   but the output is valid LZ4 and the decoder does not care. */
+
+#define MAGIC 0x184C2102
+#define BLOCK (8<<20)
+#define BOUND (BLOCK + BLOCK/255 + 16)
+#define HASHLOG 16
+#define MAXSLOTS 8
+
+struct slot {
+	int pid;
+	int state;
+	uint ilen;
+	uint olen;
+	uint32_t hash[1<<HASHLOG];
+	byte out[BOUND];
+	byte in[BLOCK];
+};
+
+#define SLOT_FREE 0
+#define SLOT_BUSY 1
+#define SLOT_DONE 2
+
+static struct slot* get_slot(CTX, int i)
+{
+	return ctx->lz4.slots + i*sizeof(struct slot);
+}
+
+static uint32_t load32(byte* p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | (p[3] << 24);
+}
+
+static uint hash(uint32_t seq)
+{
+	return (seq * 2654435761U) >> (32 - HASHLOG);
+}
+
+static byte* put_length(byte* op, uint len)
+{
+	for(; len >= 255; len -= 255)
+		*op++ = 255;
+
+	*op++ = len;
+
+	return op;
+}
+
+/* Token, literals, offset, match length. The last sequence in a block
+   has literals only, which is indicated here with mlen = 0. */
+
+static byte* put_sequence(byte* op, byte* lit, uint llen, uint off, uint mlen)
+{
+	byte* token = op++;
+	uint ml = mlen - 4;
+
+	*token = (llen >= 15 ? 15 : llen) << 4;
+
+	if(llen >= 15)
+		op = put_length(op, llen - 15);
+
+	memcpy(op, lit, llen);
+	op += llen;
+
+	if(!mlen) return op;
+
+	*op++ = off;
+	*op++ = off >> 8;
+
+	*token |= (ml >= 15 ? 15 : ml);
+
+	if(ml >= 15)
+		op = put_length(op, ml - 15);
+
+	return op;
+}
+
+/* The format requires the last match to start at least 12 bytes before
+   the end of the block, and the last 5 bytes to be literals. */
+
+static uint compress(byte* dst, byte* src, uint len, uint32_t* tab)
+{
+	byte* ip = src;
+	byte* end = src + len;
+	byte* anchor = src;
+	byte* op = dst;
+
+	memzero(tab, sizeof(uint32_t) << HASHLOG);
+
+	if(len < 13)
+		goto last;
+
+	byte* limit = end - 12;
+	byte* mend = end - 5;
+	uint skip = 1 << 6;
+
+	while(ip < limit) {
+		uint32_t seq = load32(ip);
+		uint h = hash(seq);
+		byte* ref = src + tab[h];
+
+		tab[h] = ip - src;
+
+		if(ref >= ip || ip - ref > 0xFFFF || load32(ref) != seq) {
+			ip += (skip++ >> 6);
+			continue;
+		}
+
+		skip = 1 << 6;
+
+		while(ip > anchor && ref > src && ip[-1] == ref[-1]) {
+			ip--;
+			ref--;
+		}
+
+		byte* mp = ip + 4;
+		byte* rp = ref + 4;
+
+		while(mp < mend && *mp == *rp) {
+			mp++;
+			rp++;
+		}
+
+		op = put_sequence(op, anchor, ip - anchor, ip - ref, mp - ip);
+
+		ip = anchor = mp;
+	}
+last:
+	op = put_sequence(op, anchor, end - anchor, 0, 0);
+
+	return op - dst;
+}
+
+static void compress_slot(struct slot* sl)
+{
+	uint olen = compress(sl->out + 4, sl->in, sl->ilen, sl->hash);
+
+	sl->out[0] = olen;
+	sl->out[1] = olen >> 8;
+	sl->out[2] = olen >> 16;
+	sl->out[3] = olen >> 24;
+
+	sl->olen = olen + 4;
+}
+
+static void write_out(CTX, void* buf, uint len)
+{
+	int ret, fd = ctx->cpio.fd;
+
+	if((ret = writeall(fd, buf, len)) < 0)
+		fail("write", ctx->cpio.name, ret);
+}
+
+/* Wait for the slot to get compressed if necessary, and write it out. */
+
+static void flush_slot(CTX, struct slot* sl)
+{
+	int ret, status;
+
+	if(sl->state == SLOT_FREE)
+		return;
+
+	if(sl->state == SLOT_BUSY) {
+		if((ret = sys_waitpid(sl->pid, &status, 0)) < 0)
+			fail("wait", NULL, ret);
+		if(status || !sl->olen)
+			fail("compression failed", NULL, 0);
+	}
+
+	write_out(ctx, sl->out, sl->olen);
+
+	sl->state = SLOT_FREE;
+	sl->pid = 0;
+	sl->ilen = 0;
+	sl->olen = 0;
+}
+
+static void spawn_slot(CTX, struct slot* sl)
+{
+	int pid;
+
+	sl->olen = 0;
+
+	if(ctx->lz4.nslots > 1 && (pid = sys_fork()) >= 0) {
+		if(pid == 0) {
+			sys_prctl(PR_SET_PDEATHSIG, SIGTERM, 0, 0, 0);
+			compress_slot(sl);
+			_exit(0);
+		}
+
+		sl->pid = pid;
+		sl->state = SLOT_BUSY;
+	} else {
+		compress_slot(sl);
+		sl->state = SLOT_DONE;
+	}
+}
+
+static void submit_slot(CTX)
+{
+	int i = ctx->lz4.cur;
+	int n = ctx->lz4.nslots;
+	struct slot* sl = get_slot(ctx, i);
+
+	if(!sl->ilen) return;
+
+	spawn_slot(ctx, sl);
+
+	i = (i + 1) % n;
+
+	flush_slot(ctx, get_slot(ctx, i));
+
+	ctx->lz4.cur = i;
+}
+
+void lz4_init(CTX)
+{
+	int n = ncpus();
+	ulong size;
+	void* ptr;
+	int ret;
+
+	if(n > MAXSLOTS)
+		n = MAXSLOTS;
+
+	size = pagealign(n*sizeof(struct slot));
+
+	int prot = PROT_READ | PROT_WRITE;
+	int flags = MAP_SHARED | MAP_ANONYMOUS;
+
+	ptr = sys_mmap(NULL, size, prot, flags, -1, 0);
+
+	if((ret = mmap_error(ptr)))
+		fail("mmap", NULL, ret);
+
+	ctx->lz4.slots = ptr;
+	ctx->lz4.nslots = n;
+	ctx->lz4.cur = 0;
+
+	byte magic[4] = { MAGIC & 0xFF, (MAGIC >> 8) & 0xFF,
+	                  (MAGIC >> 16) & 0xFF, (MAGIC >> 24) & 0xFF };
+
+	write_out(ctx, magic, 4);
+}
+
+/* Return a pointer to the free space in the current slot, and its size. */
+
+static byte* slot_space(CTX, uint* left)
+{
+	struct slot* sl = get_slot(ctx, ctx->lz4.cur);
+
+	if(sl->ilen >= BLOCK) {
+		submit_slot(ctx);
+		sl = get_slot(ctx, ctx->lz4.cur);
+	}
+
+	*left = BLOCK - sl->ilen;
+
+	return sl->in + sl->ilen;
+}
+
+static void slot_commit(CTX, uint len)
+{
+	struct slot* sl = get_slot(ctx, ctx->lz4.cur);
+
+	sl->ilen += len;
+}
+
+void lz4_write(CTX, void* buf, uint len)
+{
+	uint left;
+
+	while(len > 0) {
+		byte* dst = slot_space(ctx, &left);
+		uint cnt = (len < left) ? len : left;
+
+		memcpy(dst, buf, cnt);
+		slot_commit(ctx, cnt);
+
+		buf += cnt;
+		len -= cnt;
+	}
+}
+
+void lz4_send(CTX, int fd, uint size)
+{
+	uint left;
+	int ret;
+
+	while(size > 0) {
+		byte* dst = slot_space(ctx, &left);
+		uint cnt = (size < left) ? size : left;
+
+		if((ret = sys_read(fd, dst, cnt)) < 0)
+			fail("read", NULL, ret);
+		else if(ret == 0)
+			break;
+
+		slot_commit(ctx, ret);
+
+		size -= ret;
+	} if(size > 0) {
+		fail("incomplete read", NULL, 0);
+	}
+}
+
+void lz4_fini(CTX)
+{
+	int i, n = ctx->lz4.nslots;
+
+	submit_slot(ctx);
+
+	for(i = 0; i < n; i++) {
+		int k = (ctx->lz4.cur + i) % n;
+
+		flush_slot(ctx, get_slot(ctx, k));
+	}
+
+	sys_munmap(ctx->lz4.slots, pagealign(n*sizeof(struct slot)));
+
+	ctx->lz4.slots = NULL;
+}
@@ -2,7 +2,7 @@
 #include <sys/fprop.h>
 #include <sys/proc.h>
 #include <sys/prctl.h>
-#include <sys/sched.h>
+#include <sys/mman.h>
 
 #include <crypto/aes128.h>
 
@@ -38,120 +38,133 @@ struct top {
 	uint64_t size;
 };
 
-char ibuf[512];
-char obuf[512];
+/* Data gets processed in large chunks, each worker handling a contiguous
+   range of the image, so that the syscall count does not depend on the
+   number of sectors and no two processes touch the same pages. */
+
+#define CHUNK (1<<20)
+#define SECTOR 512
 
 #define CTX struct top* ctx
 
-typedef void (*cryptf)(CTX, void* rp, void* wp, uint64_t S);
+typedef void (*cryptf)(CTX, void* buf, ulong len, uint64_t S);
 
-static void prep_tweak(uint8_t T[16], struct aes128* A, uint64_t S)
+static void aesxts_encrypt(CTX, void* buf, ulong len, uint64_t S)
 {
-	for(int i = 0; i < 16; i++) {
-		T[i] = S & 0xFF;
-		S >>= 8;
-	}
-
-	aes128_encrypt(A, T);
+	aes128_xts_encrypt(&ctx->K1, &ctx->K2, buf, buf, len, S);
 }
 
-static void next_tweak(uint8_t T[16])
+static void aesxts_decrypt(CTX, void* buf, ulong len, uint64_t S)
 {
-	int i, c = 0;
-
-	for(i = 0; i < 16; i++) {
-		uint8_t ti = T[i];
-		T[i] = ((ti << 1) + c);
-		c = (ti >> 7) & 1;
-	} if(c) {
-		T[0] ^= 0x87;
-	}
+	aes128_xts_decrypt(&ctx->K1, &ctx->K2, buf, buf, len, S);
 }
 
-static void blk_xor(uint8_t x[16], uint8_t a[16], uint8_t b[16])
+static void* map_buffer(void)
 {
-	uint32_t* xp = (uint32_t*) x;
-	uint32_t* ap = (uint32_t*) a;
-	uint32_t* bp = (uint32_t*) b;
-
-	xp[0] = ap[0] ^ bp[0];
-	xp[1] = ap[1] ^ bp[1];
-	xp[2] = ap[2] ^ bp[2];
-	xp[3] = ap[3] ^ bp[3];
+	int prot = PROT_READ | PROT_WRITE;
+	int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+	void* buf = sys_mmap(NULL, CHUNK, prot, flags, -1, 0);
+	int ret;
+
+	if((ret = mmap_error(buf)))
+		fail("mmap", NULL, ret);
+
+	return buf;
 }
 
-typedef void (*aesfn)(struct aes128*, uint8_t*);
+/* XTS works on whole sectors, a trailing partial one cannot be processed.
+   Images of known size get checked before any work starts, the rest when
+   the last chunk comes in. Both end up with the same error. */
 
-static void aesxts(CTX, void* rp, void* wp, uint64_t S, aesfn op)
+static void check_sectors(CTX, uint64_t size)
 {
-	uint8_t T[16];
-	uint8_t x[16];
+	if(size % SECTOR)
+		fail("incomplete read", ctx->iname, 0);
+}
 
-	prep_tweak(T, &ctx->K2, S);
+static long read_chunk(CTX, void* buf)
+{
+	long rd, done = 0;
 
-	for(int i = 0; i < 512; i += 16) {
-		blk_xor(x, rp + i, T);
-		op(&ctx->K1, x);
-		blk_xor(wp + i, x, T);
+	while(done < CHUNK) {
+		if((rd = sys_read(ctx->ifd, buf + done, CHUNK - done)) < 0)
+			fail("read", ctx->iname, rd);
+		if(!rd)
+			break;
 
-		next_tweak(T);
+		done += rd;
 	}
-}
 
-static void aesxts_encrypt(CTX, void* rp, void* wp, uint64_t S)
-{
-	aesxts(ctx, rp, wp, S, aes128_encrypt);
-}
+	check_sectors(ctx, done);
 
-static void aesxts_decrypt(CTX, void* rp, void* wp, uint64_t S)
-{
-	aesxts(ctx, rp, wp, S, aes128_decrypt);
+	return done;
 }
 
 static void pipe_data_single(CTX, cryptf fn)
 {
-	int rd, wr;
-	int ifd = ctx->ifd;
-	int ofd = ctx->ofd;
+	void* buf = map_buffer();
 	uint64_t S = 0;
+	long rd, wr;
+
+	while((rd = read_chunk(ctx, buf)) > 0) {
+		fn(ctx, buf, rd, S);
+
+		if((wr = writeall(ctx->ofd, buf, rd)) < 0)
+			fail("write", ctx->oname, wr);
+
+		S += rd / SECTOR;
+	}
+}
+
+static void pread_chunk(CTX, void* buf, ulong len, uint64_t off)
+{
+	long rd;
+
+	while(len > 0) {
+		if((rd = sys_pread(ctx->ifd, buf, len, off)) < 0)
+			fail("read", ctx->iname, rd);
+		if(!rd)
+			fail("incomplete read", ctx->iname, 0);
 
-	while((rd = sys_read(ifd, ibuf, 512)) > 0) {
-		if(rd < 512)
-			fail("incomplete read", NULL, 0);
+		buf += rd;
+		len -= rd;
+		off += rd;
+	}
+}
 
-		fn(ctx, ibuf, obuf, S);
+static void pwrite_chunk(CTX, void* buf, ulong len, uint64_t off)
+{
+	long wr;
 
-		if((wr = writeall(ofd, obuf, 512)) < 0)
+	while(len > 0) {
+		if((wr = sys_pwrite(ctx->ofd, buf, len, off)) < 0)
 			fail("write", ctx->oname, wr);
 
-		S += 1;
+		buf += wr;
+		len -= wr;
+		off += wr;
 	}
 }
 
 static void pipe_data_child(CTX, cryptf fn, int n, int i)
 {
-	int ifd = ctx->ifd;
-	int ofd = ctx->ofd;
+	uint64_t total = ctx->size / SECTOR;
+	uint64_t S = total * i / n;
+	uint64_t E = total * (i + 1) / n;
+	void* buf = map_buffer();
 
-	uint64_t off = i*512;
-	uint64_t end = ctx->size;
-	uint64_t S = i;
+	while(S < E) {
+		uint64_t left = (E - S) * SECTOR;
+		ulong len = left < CHUNK ? left : CHUNK;
+		uint64_t off = S * SECTOR;
 
-	int rd, wr;
+		pread_chunk(ctx, buf, len, off);
 
-	while(off < end) {
-		if((rd = sys_pread(ifd, ibuf, 512, off)) < 0)
-			fail("read", ctx->iname, rd);
-		if(rd < 512)
-			fail("incomplete read", NULL, 0);
-
-		fn(ctx, ibuf, obuf, S);
+		fn(ctx, buf, len, S);
 
-		if((wr = sys_pwrite(ofd, obuf, 512, off)) < 0)
-			fail("write", ctx->oname, wr);
+		pwrite_chunk(ctx, buf, len, off);
 
-		S += n;
-		off += n*512;
+		S += len / SECTOR;
 	}
 }
 
@@ -202,26 +215,6 @@ static void load_keyfile(struct keyfile* kf, char* name)
 	unwrap_keyfile(kf, phrase, phrlen);
 }
 
-static int guess_num_cpus(void)
-{
-	struct cpuset cs;
-	int ret;
-
-	memzero(&cs, sizeof(cs));
-
-	if((ret = sys_sched_getaffinity(0, &cs)) < 0)
-		return 1;
-
-	uint w, b, cpus = 0;
-
-	for(w = 0; w < ARRAY_SIZE(cs.bits); w++)
-		for(b = 0; b < 8*sizeof(cs.bits[0]); b++)
-			if(cs.bits[w] & (1UL << b))
-				cpus++;
-
-	return cpus;
-}
-
 static void init_context(CTX, int argc, char** argv)
 {
 	int i = 1, opts = 0;
@@ -239,7 +232,7 @@ static void init_context(CTX, int argc, char** argv)
 	if(opts & OPT_s)
 		ctx->ncpus = 1;
 	else
-		ctx->ncpus = guess_num_cpus();
+		ctx->ncpus = ncpus();
 }
 
 static void set_files(CTX, char* iname, char* oname, char* keyf, int kidx)
@@ -251,13 +244,16 @@ static void set_files(CTX, char* iname, char* oname, char* keyf, int kidx)
 		fail(NULL, iname, fd);
 	if((ret = sys_fstat(fd, &st)) < 0)
 		fail("stat", iname, ret);
-	if(st.size % 512)
-		fail(iname, "size is not in 512-blocks", 0);
-
 	ctx->ifd = fd;
 	ctx->iname = iname;
 	ctx->size = st.size;
 
+	check_sectors(ctx, st.size);
+
+	/* Small images are not worth forking for */
+	if(ctx->ncpus > st.size / CHUNK)
+		ctx->ncpus = st.size / CHUNK;
+
 	load_keyfile(&kf, keyf);
 
 	if((fd = sys_open3(oname, O_WRONLY | O_CREAT | O_TRUNC, 0666)) < 0)
@@ -13,6 +13,8 @@
 #include "common.h"
 #include "passblk.h"
 
+#define OPTS "w"
+
 ERRTAG("passblk");
 ERRLIST(NEINVAL NENOENT NENOTTY NEFAULT NENODEV NENOMEM NEPERM NEACCES);
 
@@ -60,7 +62,7 @@ static void parse_part_labels(CTX, int argc, char** argv)
 	int i, n = 0;
 	int itemp;
 
-	for(i = 2; i < argc; i++) {
+	for(i = 0; i < argc; i++) {
 		char* arg = argv[i];
 
 		if(arg[0] == '-' && !arg[1]) {
@@ -76,9 +78,9 @@ static void parse_part_labels(CTX, int argc, char** argv)
 			arg = sep + 1;
 			ki = itemp - 1;
 		}
-		if(ki > NUMKEYS)
+		if(ki >= NUMKEYS)
 			fail("key index out of range:", arg, 0);
-		if(n > NUMKEYS)
+		if(n >= NUMKEYS)
 			fail("too many partitions", NULL, 0);
 
 		struct part* pt = &ctx->parts[n++];
@@ -126,12 +128,16 @@ static void validate_parts(CTX)
 
 static void setup_args(CTX, int argc, char** argv)
 {
-	if(argc < 3)
+	int i = 1;
+
+	if(i < argc && argv[i][0] == '-')
+		ctx->opts = argbits(OPTS, argv[i++] + 1);
+	if(i + 1 >= argc)
 		fail("too few arguments", NULL, 0);
 
-	parse_part_labels(ctx, argc, argv);
+	parse_part_labels(ctx, argc - i - 1, argv + i + 1);
 
-	load_key_data(ctx, argv[1]);
+	load_key_data(ctx, argv[i]);
 
 	validate_parts(ctx);
 }
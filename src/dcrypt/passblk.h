@@ -18,6 +18,8 @@
 #define ST_INVALID   1
 #define ST_HASHING   2
 
+#define OPT_w (1<<0)	/* bypass dm-crypt workqueues */
+
 #define IS_REG  0
 #define IS_ESC  1
 #define IS_CSI  2
@@ -28,11 +30,15 @@ struct part {
 	uint64_t size;
 	uint64_t rdev;
 	uint dmidx;
+	int pid;
+	int linked;
 };
 
 struct top {
+	int opts;
 	int sigfd;
 	int mapfd;
+	int udev;
 
 	int rows;
 	int cols;
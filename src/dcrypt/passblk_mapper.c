@@ -1,11 +1,17 @@
 #include <bits/ioctl/mapper.h>
 #include <bits/ioctl/block.h>
 #include <bits/major.h>
+#include <bits/socket/netlink.h>
 
 #include <sys/fpath.h>
 #include <sys/ioctl.h>
 #include <sys/file.h>
 #include <sys/mman.h>
+#include <sys/proc.h>
+#include <sys/prctl.h>
+#include <sys/ppoll.h>
+#include <sys/signal.h>
+#include <sys/socket.h>
 
 #include <string.h>
 #include <format.h>
@@ -26,7 +32,12 @@
    DM ioctls are run on /dev/mapper/control, and we attemp to open that file
    very early, before starting the input code. This allows us to fail early,
    without asking for passphrase, in case DM itself is missing or badly
-   misconfigured. */
+   misconfigured.
+
+   With several partitions, devices are created in order but the rest
+   of the setup runs concurrently, see decrypt_parts() below. */
+
+#define UDEV_MGRP_KERNEL   (1<<0)
 
 void init_mapper(CTX)
 {
@@ -56,7 +67,7 @@ static void putstr(char* buf, char* src, int len)
 	buf[len] = '\0';
 }
 
-static void dm_create(CTX, struct part* pt)
+static int dm_create(CTX, struct part* pt)
 {
 	char* label = pt->label;
 	uint nlen = strlen(label);
@@ -69,18 +80,54 @@ static void dm_create(CTX, struct part* pt)
 		.data_size = sizeof(dmi)
 	};
 
-	if(nlen > sizeof(dmi.name) - 1)
-		fail(NULL, label, ENAMETOOLONG);
+	if(nlen > sizeof(dmi.name) - 1) {
+		warn(NULL, label, -ENAMETOOLONG);
+		return -ENAMETOOLONG;
+	}
 
 	putstr(dmi.name, label, nlen);
 
-	if((ret = sys_ioctl(fd, DM_DEV_CREATE, &dmi)) < 0)
-		fail("ioctl", "DM_DEV_CREATE", ret);
+	if((ret = sys_ioctl(fd, DM_DEV_CREATE, &dmi)) < 0) {
+		warn("ioctl DM_DEV_CREATE", label, ret);
+		return ret;
+	}
 
 	pt->dmidx = minor(dmi.dev);
+
+	return 0;
+}
+
+/* Devices that have been created but could not be set up get removed,
+   so that a failed attempt does not leave half-configured devices behind
+   and the next one can create them again. */
+
+static void dm_remove(CTX, struct part* pt)
+{
+	char* label = pt->label;
+	uint nlen = strlen(label);
+	int ret;
+
+	struct dm_ioctl dmi = {
+		.version = { DM_VERSION_MAJOR, 0, 0 },
+		.flags = 0,
+		.data_size = sizeof(dmi)
+	};
+
+	putstr(dmi.name, label, nlen);
+
+	if((ret = sys_ioctl(ctx->mapfd, DM_DEV_REMOVE, &dmi)) < 0)
+		warn("ioctl DM_DEV_REMOVE", label, ret);
 }
 
-static void dm_single(CTX, struct part* pt, char* targ, char* opts)
+static void remove_parts(CTX, int count)
+{
+	int i;
+
+	for(i = 0; i < count; i++)
+		dm_remove(ctx, &ctx->parts[i]);
+}
+
+static int dm_single(CTX, struct part* pt, char* targ, char* opts)
 {
 	struct dm_ioctl* dmi;
 	struct dm_target_spec* dts;
@@ -124,18 +171,23 @@ static void dm_single(CTX, struct part* pt, char* targ, char* opts)
 	putstr(dts->type, targ, tlen);
 	putstr(optstring, opts, olen);
 
-	int ret;
-
-	if((ret = sys_ioctl(ctx->mapfd, DM_TABLE_LOAD, req)) < 0)
-		fail("ioctl DM_TABLE_LOAD", name, ret);
+	return sys_ioctl(ctx->mapfd, DM_TABLE_LOAD, req);
 }
 
-static void dm_crypt(CTX, struct part* pt)
+/* Optional tuning. Bypassing the workqueues lets dm-crypt do the work
+   in the context of the submitting process, which helps throughput on
+   fast storage (and was added in Linux 5.9, older kernels reject it). */
+
+static int dm_crypt_table(CTX, struct part* pt, int opts)
 {
 	int keyidx = pt->keyidx;
 	int keyoffset = HDRSIZE + KEYSIZE*keyidx;
 	void* key = ctx->keydata + keyoffset;
 	int keylen = KEYSIZE;
+	int nopts = 1;
+
+	if(opts & OPT_w)
+		nopts += 2;
 
 	FMTBUF(p, e, buf, 256);
 	p = fmtstr(p, e, "aes-xts-plain64");
@@ -145,10 +197,31 @@ static void dm_crypt(CTX, struct part* pt)
 	p = fmtlong(p, e, major(pt->rdev));
 	p = fmtstr(p, e, ":");
 	p = fmtlong(p, e, minor(pt->rdev));
-	p = fmtstr(p, e, " 0 1 allow_discards");
+	p = fmtstr(p, e, " 0 ");
+	p = fmtint(p, e, nopts);
+	p = fmtstr(p, e, " allow_discards");
+	if(opts & OPT_w)
+		p = fmtstr(p, e, " no_read_workqueue no_write_workqueue");
 	FMTEND(p, e);
 
-	dm_single(ctx, pt, "crypt", buf);
+	return dm_single(ctx, pt, "crypt", buf);
+}
+
+static void dm_crypt(CTX, struct part* pt)
+{
+	int opts = ctx->opts;
+	int ret;
+
+	if((ret = dm_crypt_table(ctx, pt, opts)) >= 0)
+		return;
+
+	if((ret == -EINVAL) && (opts & OPT_w)) {
+		warn("workqueue bypass not supported for", pt->label, 0);
+		ret = dm_crypt_table(ctx, pt, opts & ~OPT_w);
+	}
+
+	if(ret < 0)
+		fail("ioctl DM_TABLE_LOAD", pt->label, ret);
 }
 
 static void dm_resume(CTX, struct part* pt)
@@ -192,17 +265,200 @@ static void redo_symlink(CTX, struct part* pt)
 		fail(NULL, link, ret);
 }
 
-void decrypt_parts(CTX)
+/* The device nodes for dm-N appear as soon as the devices get created,
+   but the kernel only announces them as usable with a change uevent once
+   resumed. The socket gets opened before any of the devices are created,
+   so none of the events can be missed, and the symlinks get switched over
+   as the events arrive. Failure to set up the socket is not fatal, the
+   links just get done without waiting. */
+
+static void open_udev(CTX)
+{
+	int fd, ret;
+
+	int domain = PF_NETLINK;
+	int type = SOCK_DGRAM;
+	int proto = NETLINK_KOBJECT_UEVENT;
+
+	ctx->udev = -1;
+
+	if((fd = sys_socket(domain, type, proto)) < 0) {
+		warn("socket", "udev", fd);
+		return;
+	}
+
+	struct sockaddr_nl addr = {
+		.family = AF_NETLINK,
+		.pid = 0,
+		.groups = UDEV_MGRP_KERNEL
+	};
+
+	if((ret = sys_bind(fd, &addr, sizeof(addr))) < 0) {
+		warn("bind", "udev", ret);
+		sys_close(fd);
+		return;
+	}
+
+	ctx->udev = fd;
+}
+
+static struct part* find_dm_part(CTX, char* name)
 {
 	int i, n = ctx->nparts;
+	int idx;
+	char* p;
+
+	if(strncmp(name, "dm-", 3))
+		return NULL;
+	if(!(p = parseint(name + 3, &idx)) || *p)
+		return NULL;
 
 	for(i = 0; i < n; i++) {
 		struct part* pt = &ctx->parts[i];
 
-		dm_create(ctx, pt);
-		dm_crypt(ctx, pt);
-		dm_resume(ctx, pt);
+		if(pt->dmidx == (uint)idx)
+			return pt;
+	}
+
+	return NULL;
+}
+
+static struct part* recv_udev_event(CTX)
+{
+	int max = 1024;
+	char buf[max+2];
+	int rd, fd = ctx->udev;
+
+	if((rd = sys_recv(fd, buf, max, 0)) < 0)
+		return NULL; /* ENOBUFS is possible here */
+
+	buf[rd] = '\0';
+
+	char* p = buf;
+	char* e = buf + rd;
+
+	if(strncmp(p, "change@", 7))
+		return NULL;
+
+	for(; p < e; p += strlen(p) + 1)
+		if(!strncmp(p, "DEVNAME=", 8))
+			return find_dm_part(ctx, p + 8);
+
+	return NULL;
+}
+
+static void link_part(CTX, struct part* pt)
+{
+	if(pt->linked)
+		return;
+
+	redo_symlink(ctx, pt);
+
+	pt->linked = 1;
+}
 
-		redo_symlink(ctx, pt);
+static void link_parts(CTX)
+{
+	int i, n = ctx->nparts;
+	int left = n;
+	struct timespec ts = { 2, 0 };
+	struct pollfd pfd = {
+		.fd = ctx->udev,
+		.events = POLLIN
+	};
+	struct part* pt;
+
+	while(left > 0 && pfd.fd >= 0) {
+		if(sys_ppoll(&pfd, 1, &ts, NULL) <= 0)
+			break;
+		if(!(pt = recv_udev_event(ctx)))
+			continue;
+		if(pt->linked)
+			continue;
+
+		link_part(ctx, pt);
+		left--;
 	}
+
+	for(i = 0; i < n; i++)
+		link_part(ctx, &ctx->parts[i]);
+
+	if(pfd.fd >= 0)
+		sys_close(pfd.fd);
+}
+
+/* Loading crypt tables and resuming the devices is where most of the time
+   goes, with the kernel setting up per-cpu crypto state and waiting for
+   RCU grace periods. None of that depends on other partitions, so each
+   one gets a child process of its own. The control fd is shared, which
+   is fine for DM ioctls. A single partition goes through a child as well,
+   so that its failure can be cleaned up the same way. */
+
+static void setup_part(CTX, struct part* pt)
+{
+	sys_prctl(PR_SET_PDEATHSIG, SIGTERM, 0, 0, 0);
+
+	dm_crypt(ctx, pt);
+	dm_resume(ctx, pt);
+
+	_exit(0x00);
+}
+
+static int spawn_setup(CTX, struct part* pt)
+{
+	int pid;
+
+	if((pid = sys_fork()) < 0) {
+		warn("fork", NULL, pid);
+		pt->pid = 0;
+		return pid;
+	}
+	if(pid == 0)
+		setup_part(ctx, pt);
+
+	pt->pid = pid;
+
+	return 0;
+}
+
+static int reap_setup(CTX, struct part* pt)
+{
+	int ret, status;
+
+	if(!pt->pid)
+		return -1;
+	if((ret = sys_waitpid(pt->pid, &status, 0)) < 0)
+		fail("waitpid", NULL, ret);
+
+	return status;
+}
+
+void decrypt_parts(CTX)
+{
+	int i, n = ctx->nparts;
+	int failed = 0;
+
+	open_udev(ctx);
+
+	for(i = 0; i < n; i++) {
+		if(dm_create(ctx, &ctx->parts[i]) >= 0)
+			continue;
+
+		remove_parts(ctx, i);
+		fail("cannot create DM devices", NULL, 0);
+	}
+
+	for(i = 0; i < n; i++)
+		if(spawn_setup(ctx, &ctx->parts[i]) < 0)
+			break;
+	for(i = 0; i < n; i++)
+		if(reap_setup(ctx, &ctx->parts[i]))
+			failed++;
+
+	if(failed) {
+		remove_parts(ctx, n);
+		fail("failed to set up some of the partitions", NULL, 0);
+	}
+
+	link_parts(ctx);
 }
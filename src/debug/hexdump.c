@@ -5,10 +5,11 @@
 #include <util.h>
 #include <main.h>
 
-#define RDBUF (1<<12)
-#define WRBUF (1<<14)
+#define RDBUF (1<<20)
+#define WRBUF (1<<16)
 #define HEXLINE 16
 #define OUTLINE 160
+#define FULLINE 79
 
 ERRTAG("hexdump");
 ERRLIST(NENOENT NEACCES NENOTDIR NELOOP NEISDIR NEFAULT NEINVAL NENOMEM
@@ -25,6 +26,54 @@ static int isprintable(int c)
 	return (cc >= 0x20 && cc < 0x7F);
 }
 
+static char rdbuf[RDBUF];
+static char wrbuf[WRBUF];
+
+/* Complete 16-byte lines make up almost all of the output, and those
+   get formatted by filling a fixed template from lookup tables, with
+   no per-byte function calls and no bounds checks. */
+
+static char hexpair[256][2];
+static char visible[256];
+
+static const char template[FULLINE+1] =
+	"00000000   00 00 00 00 00 00 00 00  00 00 00 00 00 00 00 00   "
+	"................\n";
+
+static void init_tables(void)
+{
+	static const char digits[] = "0123456789ABCDEF";
+
+	for(int i = 0; i < 256; i++) {
+		hexpair[i][0] = digits[(i >> 4) & 0x0F];
+		hexpair[i][1] = digits[(i >> 0) & 0x0F];
+		visible[i] = isprintable(i) ? i : '.';
+	}
+}
+
+static char* fullline(char* p, unsigned long addr, char* data)
+{
+	byte* d = (byte*)data;
+	char* h = p + 11;
+	char* a = p + 62;
+	int i;
+
+	__builtin_memcpy(p, template, FULLINE);
+
+	for(i = 0; i < 4; i++)
+		__builtin_memcpy(p + 2*i, hexpair[(addr >> 8*(3-i)) & 0xFF], 2);
+
+	for(i = 0; i < 8; i++)
+		__builtin_memcpy(h + 3*i, hexpair[d[i]], 2);
+	for(i = 8; i < 16; i++)
+		__builtin_memcpy(h + 3*i + 1, hexpair[d[i]], 2);
+
+	for(i = 0; i < 16; i++)
+		a[i] = visible[d[i]];
+
+	return p + FULLINE;
+}
+
 /* The address (offset within the file) is always shown as a 4-byte value.
    Hexdumping something over 4GB is a bad idea.
    Using less than 4 bytes would make sense, but traditionally it has been
@@ -86,9 +135,9 @@ static char* makeline(char* p, char* e, unsigned long addr, char* data, int size
 
 static void dumpbuf(unsigned long addr, char* data, long size)
 {
-	char buf[WRBUF];
-	char* hwm = buf + sizeof(buf) - OUTLINE;
-	char* end = buf + sizeof(buf);
+	char* buf = wrbuf;
+	char* hwm = buf + WRBUF - OUTLINE;
+	char* end = buf + WRBUF;
 	char* p = buf;
 
 	char* dptr = data;
@@ -96,7 +145,10 @@ static void dumpbuf(unsigned long addr, char* data, long size)
 
 	while(dptr < dend) {
 		int linesize = (dptr + 16 < dend ? 16 : dend - dptr);
-		p = makeline(p, end, addr, dptr, linesize);
+		if(linesize == 16)
+			p = fullline(p, addr, dptr);
+		else
+			p = makeline(p, end, addr, dptr, linesize);
 		dptr += linesize;
 		addr += linesize;
 
@@ -116,17 +168,17 @@ static void dumpbuf(unsigned long addr, char* data, long size)
    The way it is written it may do one sys_write() more than necessary,
    but it should do a reasonably good job at handling slowly-piped data.
 
-   Not sure if that's important, but then again, hexdump is not something
-   that should be well-optimized anyway. */
+   The buffers are large so that dumping disk images does not turn into
+   a syscall benchmark. */
 
 static void hexdump(long fd)
 {
-	char buf[RDBUF];
+	char* buf = rdbuf;
 	unsigned long addr = 0;
 	long ptr = 0;
 	long rd;
 
-	while((rd = sys_read(fd, buf + ptr, sizeof(buf) - ptr)) > 0) {
+	while((rd = sys_read(fd, buf + ptr, RDBUF - ptr)) > 0) {
 		if((ptr += rd) < HEXLINE)
 			continue;
 
@@ -161,6 +213,8 @@ static void dumpfile(const char* name)
 
 int main(int argc, char** argv)
 {
+	init_tables();
+
 	if(argc == 1)
 		hexdump(0);
 	else if(argc == 2)
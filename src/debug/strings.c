@@ -1,5 +1,6 @@
 #include <sys/file.h>
 
+#include <endian.h>
 #include <output.h>
 #include <string.h>
 #include <util.h>
@@ -11,10 +12,11 @@
 
 ERRTAG("strings");
 
-#define PAGE 4096
+#define RDBUF (1<<20)
+#define WRBUF (1<<16)
 
-char inbuf[2*PAGE];
-char outbuf[PAGE];
+char inbuf[RDBUF];
+char outbuf[WRBUF];
 
 struct top {
 	int addr;
@@ -23,7 +25,6 @@ struct top {
 	int min;
 	long seq;	/* current uninterrupted sequence length */
 	long pos;	/* position within the file, for -x */
-	long off;	/* offset of current sequence in file */
 	char* buf;	/* string buffer */
 
 	struct bufout bo;
@@ -66,42 +67,127 @@ static void write_addr(CTX, long off)
 	output(ctx, addr, 10);
 }
 
-/* This is basically innards of a state machine, pulled out of
-   strings() where it belongs. Not pretty, but keeps nesting levels sane. */
+/* Printable runs are located 8 bytes at a time. The mask has the high
+   bit set in each byte position holding a printable character; all
+   comparisons are done on the low 7 bits so there are no carries
+   between bytes, and the result is exact for every byte.
 
-void scan_block(CTX, char* data, int len)
+   This is plain C rather than SSE2/NEON. Intrinsics would need the
+   compiler headers, which the -nostdinc build does not see, while the
+   64-bit mask works on every arch minibase builds for. */
+
+#define LOBITS 0x7F7F7F7F7F7F7F7FULL
+#define HIBITS 0x8080808080808080ULL
+#define BYTES(c) (0x0101010101010101ULL * (c))
+
+static uint64_t load8(char* p)
 {
-	char* p = data;
-	char* end = data + len;
+	uint64_t v;
+
+	__builtin_memcpy(&v, p, 8);
+
+	return itohx(v);
+}
+
+static uint64_t zerobytes(uint64_t x)
+{
+	return ~(((x & LOBITS) + LOBITS) | x) & HIBITS;
+}
+
+static uint64_t printmask(uint64_t x)
+{
+	uint64_t y = x & LOBITS;
+	uint64_t ge20 = (y + BYTES(0x60)) & HIBITS;
+	uint64_t eq7F = (y + BYTES(0x01)) & HIBITS;
+	uint64_t tabs = zerobytes(x ^ BYTES(0x09));
+
+	return (ge20 & ~eq7F & ~x & HIBITS) | tabs;
+}
+
+static char* skip_printable(char* p, char* e)
+{
+	uint64_t m;
+
+	for(; p + 8 <= e; p += 8)
+		if((m = ~printmask(load8(p)) & HIBITS))
+			return p + __builtin_ctzll(m)/8;
+
+	for(; p < e; p++)
+		if(!printable(*p))
+			break;
+
+	return p;
+}
+
+static char* skip_garbage(char* p, char* e)
+{
+	uint64_t m;
 
+	for(; p + 8 <= e; p += 8)
+		if((m = printmask(load8(p))))
+			return p + __builtin_ctzll(m)/8;
+
+	for(; p < e; p++)
+		if(printable(*p))
+			break;
+
+	return p;
+}
+
+/* A run may span several blocks. Until it reaches the minimum length,
+   it gets stashed in ctx->buf; after that, it's written out as is. */
+
+static void add_run(CTX, char* p, long len)
+{
 	int min = ctx->min;
 	long seq = ctx->seq;
-	long off = ctx->off;
-	long pos = ctx->pos;
-	char* buf = ctx->buf;
-
-	for(; p < end; p++, pos++) {
-		if(printable(*p)) {
-			off = pos;
-			if(seq == min && ctx->addr)
-				write_addr(ctx, off);
-			if(seq < min)
-				buf[seq] = *p;
-			else if(seq == min)
-				output(ctx, buf, seq);
-			if(seq >= min)
-				output(ctx, p, 1);
-			seq++;
+
+	if(seq >= min) {
+		output(ctx, p, len);
+	} else if(seq + len < min) {
+		memcpy(ctx->buf + seq, p, len);
+	} else {
+		if(ctx->addr)
+			write_addr(ctx, ctx->pos - seq);
+		output(ctx, ctx->buf, seq);
+		output(ctx, p, len);
+	}
+
+	ctx->seq = seq + len;
+	ctx->pos += len;
+}
+
+static void end_run(CTX)
+{
+	if(ctx->seq >= ctx->min)
+		output(ctx, "\n", 1);
+
+	ctx->seq = 0;
+}
+
+static void scan_block(CTX, char* data, int len)
+{
+	char* p = data;
+	char* e = data + len;
+	char* q;
+
+	while(p < e) {
+		q = skip_printable(p, e);
+
+		if(q >= e) {
+			add_run(ctx, p, q - p);
+			break;
+		} else if(ctx->seq || q - p >= ctx->min) {
+			add_run(ctx, p, q - p);
+			end_run(ctx);
 		} else {
-			if(seq > min)
-				output(ctx, "\n", 1);
-			seq = 0;
+			ctx->pos += q - p; /* short run, most common case */
 		}
-	}
 
-	ctx->off = off;
-	ctx->pos = pos;
-	ctx->seq = seq;
+		p = skip_garbage(q, e);
+
+		ctx->pos += p - q;
+	}
 }
 
 static void scan_strings(CTX, int fd, int minlen, int opts)
@@ -110,7 +196,7 @@ static void scan_strings(CTX, int fd, int minlen, int opts)
 	int rd;
 
 	ctx->buf = strbuf;
-	ctx->min = minlen - 1;
+	ctx->min = minlen;
 	ctx->opts = opts;
 
 	ctx->addr = !(opts & OPT_x);
@@ -119,6 +205,8 @@ static void scan_strings(CTX, int fd, int minlen, int opts)
 		scan_block(ctx, inbuf, rd);
 	if(rd < 0)
 		fail("read", NULL, rd);
+
+	end_run(ctx);
 }
 
 static unsigned int xatou(const char* p)
@@ -176,12 +264,10 @@ int main(int argc, char** argv)
 		minlen = xatou(argv[i++]);
 	if(minlen <= 0 || minlen > 128)
 		fail("bad min length value", NULL, 0);
-	if(i >= argc)
-		fail("too few arguments", NULL, 0);
 	if(i < argc - 1)
 		fail("too many arguments", NULL, 0);
 
-	int fd = open_check(argv[i]);
+	int fd = i < argc ? open_check(argv[i]) : STDIN;
 
 	init_output(ctx);
 	scan_strings(ctx, fd, minlen, opts);
@@ -2,6 +2,8 @@
 #include <bits/auxvec.h>
 #include <bits/ioctl/socket.h>
 #include <bits/socket.h>
+#include <bits/socket/filter.h>
+#include <bits/socket/inet.h>
 #include <bits/socket/packet.h>
 #include <sys/ioctl.h>
 #include <sys/file.h>
@@ -62,6 +64,7 @@ void set_timer(CTX, int sec)
 	if(sec < 10) return;
 
 	close_raw_socket(ctx);
+	close_udp_socket(ctx);
 }
 
 static void create_timer(CTX)
@@ -140,6 +143,39 @@ static void setup_signals(CTX)
 	ctx->sigfd = fd;
 }
 
+/* The raw socket gets all IP packets arriving on the interface, which
+   on a busy link is a lot of packets to wake up for and copy only to
+   throw them away in handle_packet(). The filter below lets the kernel
+   drop everything but the UDP packets to port 68 carrying our xid.
+
+   Packets arrive with the IP header at offset 0 (SOCK_DGRAM),
+   IP options are possible so the UDP header is found with ldxb. */
+
+static void attach_filter(CTX, int fd)
+{
+	struct sock_filter code[] = {
+		BPF_STMT(BPF_LD  | BPF_B   | BPF_ABS, 9),            /* protocol */
+		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_UDP, 0, 8),
+		BPF_STMT(BPF_LD  | BPF_H   | BPF_ABS, 6),            /* frag_off */
+		BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K, 0x1FFF, 6, 0),
+		BPF_STMT(BPF_LDX | BPF_B   | BPF_MSH, 0),            /* x = ihl*4 */
+		BPF_STMT(BPF_LD  | BPF_H   | BPF_IND, 2),            /* udp dest */
+		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, BOOT_CLIENT_PORT, 0, 3),
+		BPF_STMT(BPF_LD  | BPF_W   | BPF_IND, 8 + 4),        /* dhcp xid */
+		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ctx->xid, 0, 1),
+		BPF_STMT(BPF_RET | BPF_K, 0xFFFF),
+		BPF_STMT(BPF_RET | BPF_K, 0)
+	};
+	struct sock_fprog prog = {
+		.len = ARRAY_SIZE(code),
+		.filter = code
+	};
+	int ret;
+
+	if((ret = sys_setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog))) < 0)
+		quit(ctx, "SO_ATTACH_FILTER", ret);
+}
+
 static void bind_raw_socket(CTX, int fd)
 {
 	struct sockaddr_ll addr = {
@@ -153,6 +189,8 @@ static void bind_raw_socket(CTX, int fd)
 	};
 	int ret;
 
+	attach_filter(ctx, fd);
+
 	if((ret = sys_bind(fd, &addr, sizeof(addr))) < 0)
 		quit(ctx, "bind", fd);
 
@@ -187,6 +225,51 @@ int reopen_raw_socket(CTX)
 	return fd;
 }
 
+/* Once the lease is obtained, the interface has an address and DHCP
+   traffic can go through a regular UDP socket, unicast to the server.
+   The raw socket is only needed for broadcasts before that. */
+
+void close_udp_socket(CTX)
+{
+	int ret, fd = ctx->udpfd;
+
+	if(fd < 0)
+		return;
+
+	if((ret = sys_close(fd)) < 0)
+		quit(ctx, "close", ret);
+
+	ctx->udpfd = -1;
+}
+
+int reopen_udp_socket(CTX)
+{
+	struct sockaddr_in addr = {
+		.family = AF_INET,
+		.port = htons(BOOT_CLIENT_PORT),
+		.addr = { 0, 0, 0, 0 }
+	};
+	char* ifname = ctx->ifname;
+	int fd = ctx->udpfd;
+	int ret;
+
+	if(fd >= 0)
+		return fd;
+
+	if((fd = sys_socket(PF_INET, SOCK_DGRAM, 0)) < 0)
+		quit(ctx, "udp socket", fd);
+	if((ret = sys_setsockopti(fd, SOL_SOCKET, SO_REUSEADDR, 1)) < 0)
+		quit(ctx, "SO_REUSEADDR", ret);
+	if((ret = sys_setsockopt(fd, SOL_SOCKET, SO_BINDTODEVICE, ifname, strlen(ifname))) < 0)
+		quit(ctx, "SO_BINDTODEVICE", ret);
+	if((ret = sys_bind(fd, &addr, sizeof(addr))) < 0)
+		quit(ctx, "bind", ret);
+
+	ctx->udpfd = fd;
+
+	return fd;
+}
+
 static void resolve_device(CTX, char* device)
 {
 	struct ifreq ifreq;
@@ -219,7 +302,7 @@ static void resolve_device(CTX, char* device)
 
 	memcpy(ctx->ourmac, ifreq.addr.data, 6);
 
-	bind_raw_socket(ctx, fd);
+	sys_close(fd); /* the filter needs xid, see reopen_raw_socket */
 }
 
 static void handle_signal(CTX, int sig)
@@ -265,14 +348,14 @@ static void check_signals(CTX, int revents)
 	handle_signal(ctx, si.signo);
 }
 
-static void check_incoming(CTX, int revents)
+static void check_incoming(CTX, int revents, int udp)
 {
 	if(revents & ~POLLIN)
-		quit(ctx, "raw socket lost", 0);
+		quit(ctx, udp ? "udp socket lost" : "raw socket lost", 0);
 	if(!(revents & POLLIN))
 		return;
 
-	recv_incoming(ctx);
+	recv_incoming(ctx, udp);
 }
 
 static void poll(CTX)
@@ -280,7 +363,8 @@ static void poll(CTX)
 	int ret;
 	struct pollfd pfds[] = {
 		{ .fd = ctx->sigfd, .events = POLLIN },
-		{ .fd = ctx->rawfd, .events = POLLIN }
+		{ .fd = ctx->rawfd, .events = POLLIN },
+		{ .fd = ctx->udpfd, .events = POLLIN }
 	};
 	int npfds = ARRAY_SIZE(pfds);
 
@@ -288,7 +372,8 @@ static void poll(CTX)
 		quit(ctx, "ppoll", ret);
 
 	check_signals(ctx, pfds[0].revents);
-	check_incoming(ctx, pfds[1].revents);
+	check_incoming(ctx, pfds[1].revents, 0);
+	check_incoming(ctx, pfds[2].revents, 1);
 }
 
 static void setup_args(CTX, int argc, char** argv)
@@ -314,6 +399,9 @@ int main(int argc, char** argv)
 
 	memzero(ctx, sizeof(*ctx));
 
+	ctx->rawfd = -1;
+	ctx->udpfd = -1;
+
 	setup_args(ctx, argc, argv);
 	pick_random_xid(ctx);
 	setup_signals(ctx);
@@ -132,6 +132,7 @@ struct top {
 	char** environ;
 	int sigfd;
 	int rawfd;
+	int udpfd;
 	int nlfd;
 
 	char* ifname;
@@ -167,7 +168,7 @@ void quit(CTX, char* msg, int err) noreturn;
 
 void start_discover(CTX);
 void timeout_waiting(CTX);
-void recv_incoming(CTX);
+void recv_incoming(CTX, int udp);
 void config_iface(CTX);
 void deconf_iface(CTX);
 void update_iface(CTX);
@@ -186,6 +187,8 @@ void output_lease_info(CTX);
 
 void close_raw_socket(CTX);
 int reopen_raw_socket(CTX);
+void close_udp_socket(CTX);
+int reopen_udp_socket(CTX);
 
 void set_state(CTX, int state);
 void set_timer(CTX, int sec);
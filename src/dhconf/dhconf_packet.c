@@ -1,4 +1,5 @@
 #include <bits/socket/packet.h>
+#include <bits/socket/inet.h>
 #include <sys/socket.h>
 #include <sys/time.h>
 
@@ -172,6 +173,28 @@ static void send_raw_packet(CTX, DH, const byte dst[6])
 		quit(ctx, "send", ret);
 }
 
+/* Unicast to the server, only possible once we have an address. */
+
+static void send_udp_packet(CTX, DH)
+{
+	int fd = reopen_udp_socket(ctx);
+	int ret;
+	struct sockaddr_in addr = {
+		.family = AF_INET,
+		.port = htons(BOOT_SERVER_PORT)
+	};
+	int alen = sizeof(addr);
+	int skip = sizeof(struct iphdr) + sizeof(struct udphdr);
+
+	memcpy(addr.addr, ctx->srvip, 4);
+
+	void* buf = dh->buf + skip;
+	uint len = dh->ptr - skip;
+
+	if((ret = sys_sendto(fd, buf, len, 0, &addr, alen)) < 0)
+		quit(ctx, "send", ret);
+}
+
 static void send_discover(CTX)
 {
 	byte buf[CMDSIZE];
@@ -224,9 +247,8 @@ static void send_renew(CTX)
 	add_ip(&dh, DHCP_REQUESTED_IP, ctx->ourip);
 	add_mac(&dh, DHCP_CLIENT_ID, ctx->ourmac);
 	add_optend(&dh);
-	put_ip_udp(msg, ctx, &dh);
 
-	send_raw_packet(ctx, &dh, bcast);
+	send_udp_packet(ctx, &dh);
 
 	set_timer(ctx, 1);
 }
@@ -239,13 +261,13 @@ static void send_release(CTX)
 
 	memzero(msg, sizeof(*msg));
 	put_header(msg, ctx);
+	memcpy(msg->dhcp.ciaddr, ctx->ourip, 4);
 	add_byte(&dh, DHCP_MESSAGE_TYPE, DHCPRELEASE);
 	add_ip(&dh, DHCP_SERVER_ID, ctx->srvip);
 	add_mac(&dh, DHCP_CLIENT_ID, ctx->ourmac);
 	add_optend(&dh);
-	put_ip_udp(msg, ctx, &dh);
 
-	send_raw_packet(ctx, &dh, bcast);
+	send_udp_packet(ctx, &dh);
 }
 
 static uint64_t current_time(CTX)
@@ -336,7 +358,7 @@ static void check_newack(CTX, MSG, int optlen, byte mac[6])
 {
 	struct iphdr* ip = &msg->ip;
 
-	if(memcmp(ctx->srvmac, mac, 6))
+	if(mac && memcmp(ctx->srvmac, mac, 6))
 		return; /* somebody else replied */
 	if(memcmp(ctx->srvip, ip->saddr, 4))
 		return; /* same, not the server we want */
@@ -354,11 +376,12 @@ static void check_newack(CTX, MSG, int optlen, byte mac[6])
 		set_state(ctx, ST_DECONF);
 }
 
+static void handle_dhcp(CTX, struct dhcpmsg* msg, int optlen, byte mac[6]);
+
 static void handle_packet(CTX, struct dhcpmsg* msg, int optlen, byte mac[6])
 {
 	struct iphdr* ip = &msg->ip;
 	struct udphdr* udp = &msg->udp;
-	struct dhcphdr* dhcp = &msg->dhcp;
 
 	int totlen = ntohs(ip->tot_len);
 	int udplen = ntohs(udp->len);
@@ -374,6 +397,13 @@ static void handle_packet(CTX, struct dhcpmsg* msg, int optlen, byte mac[6])
 	if(udplen != totlen - iphdrlen)
 		return;
 
+	handle_dhcp(ctx, msg, optlen, mac);
+}
+
+static void handle_dhcp(CTX, struct dhcpmsg* msg, int optlen, byte mac[6])
+{
+	struct dhcphdr* dhcp = &msg->dhcp;
+
 	if(dhcp->cookie != htonl(DHCP_COOKIE))
 		return;
 	if(dhcp->xid != htonl(ctx->xid))
@@ -415,6 +445,43 @@ static void recv_packet(CTX)
 	handle_packet(ctx, msg, optlen, from.addr);
 }
 
+/* Replies to unicast renewals come through the UDP socket, with no
+   IP header and no source MAC. The source address is all the checks
+   need from the header, so it's put back there. */
+
+static void recv_udp_packet(CTX)
+{
+	byte buf[REPSIZE];
+	struct sockaddr_in from;
+	int fromlen = sizeof(from);
+	int skip = sizeof(struct iphdr) + sizeof(struct udphdr);
+	int len = sizeof(buf) - skip;
+	int fd = ctx->udpfd;
+	int ret;
+
+	memzero(buf, skip);
+
+	if((ret = sys_recvfrom(fd, buf + skip, len, 0, &from, &fromlen)) == -EAGAIN)
+		return;
+	else if(ret < 0)
+		quit(ctx, "recv", ret);
+
+	struct dhcpmsg* msg = (void*)buf;
+
+	if(ret < ssizeof(msg->dhcp))
+		return;
+	if(from.port != htons(BOOT_SERVER_PORT))
+		return;
+	if(ctx->state != ST_RENEWING)
+		return;
+
+	int optlen = ret - sizeof(msg->dhcp);
+
+	memcpy(msg->ip.saddr, from.addr, 4);
+
+	handle_dhcp(ctx, msg, optlen, NULL);
+}
+
 static void retry_discover(CTX)
 {
 	deconf_iface(ctx);
@@ -515,11 +582,14 @@ static void next_action(CTX, int state0, int state1)
 	quit(ctx, "invalid next, state", state1);
 }
 
-void recv_incoming(CTX)
+void recv_incoming(CTX, int udp)
 {
 	int state0 = ctx->state;
 
-	recv_packet(ctx);
+	if(udp)
+		recv_udp_packet(ctx);
+	else
+		recv_packet(ctx);
 
 	int state1 = ctx->state;
 
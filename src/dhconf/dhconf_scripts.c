@@ -116,7 +116,7 @@ static int run_dns_script(CTX)
 
 static int run_ntp_script(CTX)
 {
-	return spawn_ips(ctx, "dhcp-dns", DHCP_TIME_SERVERS);
+	return spawn_ips(ctx, "dhcp-ntp", DHCP_TIME_SERVERS);
 }
 
 typedef int (*fh)(CTX);
@@ -5,6 +5,7 @@
 #include <sys/creds.h>
 
 #include <netlink.h>
+#include <netlink/recv.h>
 #include <netlink/attr.h>
 #include <netlink/rtnl/link.h>
 #include <netlink/rtnl/addr.h>
@@ -17,7 +18,9 @@
 
 #include "ifmon.h"
 
-char rxbuf[4096];
+#define RXBUF (32*1024)
+
+struct nrbuf rtnl;
 
 static void enabled_rise(CTX, LS)
 {
@@ -243,46 +246,20 @@ static void dispatch(CTX, struct nlmsg* msg)
 
 void handle_rtnl(CTX)
 {
+	struct nrbuf* nr = &rtnl;
 	struct nlmsg* msg;
-	int fd = ctx->rtnlfd;
-	int rd;
-	int off = 0;
-	void* buf = rxbuf;
-	int max = sizeof(rxbuf);
-again:
-	if((rd = sys_recv(fd, buf + off, max - off, 0)) < 0) {
-		if(rd != -EAGAIN)
-			fail("recv", "NETLINK", rd);
-		else if(off)
-			fail("recv", "NETLINK", -ENOBUFS);
-		else
-			return;
-	} if(rd == 0) {
-		fail("EOF", "NETLINK", 0);
-	}
-
-	int len = off + rd;
-	void* p = buf;
-	void* e = buf + len;
-
-	while(p < e) {
-		if(!(msg = nl_msg(p, e - p)))
-			break;
-
-		dispatch(ctx, msg);
+	int ret, fd = ctx->rtnlfd;
 
-		p += nl_len(msg);
-	}
+	while((ret = nr_recv_whole(fd, nr)) > 0)
+		while((msg = nr_next(nr)))
+			dispatch(ctx, msg);
 
-	if(p >= e)
+	if(ret == -EAGAIN)
 		return;
-	if(p == buf)
-		fail("recv", "NETLINK", -ENOBUFS);
-
-	off = e - p;
-	memmove(buf, p, off);
-
-	goto again;
+	else if(ret < 0)
+		fail("recv", "NETLINK", ret);
+	else
+		fail("EOF", "NETLINK", 0);
 }
 
 static int connect_netlink(void)
@@ -329,6 +306,10 @@ static void trigger_link_dump(int fd)
 void setup_netlink(CTX)
 {
 	int fd = connect_netlink();
+	int ret;
+
+	if((ret = nr_buf_map(&rtnl, RXBUF)) < 0)
+		fail("mmap", NULL, ret);
 
 	trigger_link_dump(fd);
 
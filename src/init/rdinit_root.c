@@ -33,22 +33,29 @@ static void make_path(char* path, int plen, char* dir, char* name)
 	*p++ = '\0';
 }
 
-static void delete_ent(CTX, int at, char* dir, struct dirent* de)
+static void warn_at(char* dir, char* name, int ret)
+{
+	int plen = strlen(dir) + strlen(name) + 5;
+	char* path = alloca(plen);
+
+	make_path(path, plen, dir, name);
+
+	warn(NULL, path, ret);
+}
+
+/* Directories are the only entries that need any checks, everything
+   else is unlinked right away without building the path. */
+
+static void delete_dir(CTX, int at, char* dir, char* name)
 {
 	int fd, ret;
 	struct stat st;
-	char* name = de->name;
 
 	int plen = strlen(dir) + strlen(name) + 5;
 	char* path = alloca(plen);
 
 	make_path(path, plen, dir, name);
 
-	if(de->type != DT_DIR) {
-		ret = sys_unlinkat(at, name, 0);
-		goto err;
-	}
-
 	if((fd = sys_openat(at, name, O_DIRECTORY)) < 0) {
 		ret = fd;
 		goto err;
@@ -72,30 +79,65 @@ err:
 	if(ret) warn(NULL, path, ret);
 }
 
+/* Each getdents chunk gets two passes, non-directories first and then
+   the directories. The entries unlinked in the first pass get their
+   names blanked so the second one skips them. */
+
+static void unlink_files(int fd, char* dir, char* ptr, char* end)
+{
+	int ret;
+
+	while(ptr < end) {
+		struct dirent* de = (struct dirent*) ptr;
+
+		ptr += de->reclen;
+
+		if(!de->reclen)
+			break;
+		if(de->type == DT_DIR)
+			continue;
+		if(dotddot(de->name))
+			continue;
+
+		if((ret = sys_unlinkat(fd, de->name, 0)) == -EISDIR)
+			continue;
+		if(ret < 0)
+			warn_at(dir, de->name, ret);
+
+		de->name[0] = '\0';
+	}
+}
+
+static void remove_dirs(CTX, int fd, char* dir, char* ptr, char* end)
+{
+	while(ptr < end) {
+		struct dirent* de = (struct dirent*) ptr;
+
+		ptr += de->reclen;
+
+		if(!de->reclen)
+			break;
+		if(!de->name[0])
+			continue;
+		if(dotddot(de->name))
+			continue;
+
+		delete_dir(ctx, fd, dir, de->name);
+	}
+}
+
 static void delete_rec(CTX, int fd, char* dir)
 {
-	char debuf[1024];
+	char debuf[4096];
 	int delen = sizeof(debuf);
 	long rd;
 
 	while((rd = sys_getdents(fd, debuf, delen)) > 0)
 	{
-		char* ptr = debuf;
 		char* end = debuf + rd;
 
-		while(ptr < end)
-		{
-			struct dirent* de = (struct dirent*) ptr;
-
-			ptr += de->reclen;
-
-			if(!de->reclen)
-				break;
-			if(dotddot(de->name))
-				return;
-
-			delete_ent(ctx, fd, dir, de);
-		}
+		unlink_files(fd, dir, debuf, end);
+		remove_dirs(ctx, fd, dir, debuf, end);
 	};
 }
 
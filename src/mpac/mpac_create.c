@@ -1,9 +1,9 @@
 #include <sys/file.h>
 #include <sys/mman.h>
 #include <sys/fpath.h>
-#include <sys/dents.h>
 #include <sys/splice.h>
 
+#include <dirscan.h>
 #include <string.h>
 #include <format.h>
 #include <main.h>
@@ -26,62 +26,6 @@ struct ent {
 	char name[];
 };
 
-static int cmp_ent(void* pa, void* pb)
-{
-	struct ent* a = pa;
-	struct ent* b = pb;
-
-	int da = (a->type == TAG_DIR);
-	int db = (b->type == TAG_DIR);
-
-	if(!da && db)
-		return -1;
-	if(da && !db)
-		return 1;
-
-	return strcmp(a->name, b->name);
-}
-
-static struct ent** index_dir(CTX, void* p0, void* p1)
-{
-	int i = 0, count = 0;
-
-	void* p = p0;
-	void* e = p1;
-
-	while(p < e) {
-		struct ent* et = p;
-		int len = et->len;
-
-		if(len <= 0) break;
-
-		p += len;
-		count++;
-	}
-
-	void* q = p0;
-
-	int size = (count+1)*sizeof(struct ent*);
-	struct ent** idx = heap_alloc(ctx, size);
-
-	while(q < e) {
-		struct ent* et = q;
-		int len = et->len;
-
-		if(len <= 0) break;
-		if(i >= count) break;
-
-		q += len;
-		idx[i++] = et;
-	}
-
-	qsortp(idx, i, cmp_ent);
-
-	idx[i] = NULL;
-
-	return idx;
-}
-
 static void update_header_size(CTX, int mode, int nlen)
 {
 	int hdrsize = ctx->hsize;
@@ -97,18 +41,29 @@ static void update_header_size(CTX, int mode, int nlen)
 	ctx->hsize = hdrsize;
 }
 
-static void check_dent(CTX, int at, char* name)
+static void fail_dsent(CTX, const char* msg, struct dsent* de, int ret)
 {
-	struct stat st;
-	int flags = AT_SYMLINK_NOFOLLOW;
-	int ret;
+	char* root = ctx->root;
+	int len = strlen(root) + dspathlen(de) + 2;
+	char* buf = alloca(len);
+	char* p = buf;
+	char* e = buf + len - 1;
+
+	p = fmtstr(p, e, root);
+	p = fmtstr(p, e, "/");
+	p = fmtdspath(p, e, de);
+
+	*p++ = '\0';
 
-	if((ret = sys_fstatat(at, name, &st, flags)) < 0)
-		failx(ctx, "stat", name, ret);
+	fail(msg, buf, ret);
+}
 
+static struct ent* convert_dent(CTX, struct dsent* de)
+{
 	struct ent* ep;
+	char* name = de->name;
 	int nlen = strlen(name);
-	int mode = st.mode;
+	int mode = de->mode;
 	int need = sizeof(*ep) + nlen + 1;
 	int type = mode & S_IFMT;
 	uint size;
@@ -117,17 +72,17 @@ static void check_dent(CTX, int at, char* name)
 		size = 0;
 		type = TAG_DIR;
 	} else if(type == S_IFLNK) {
-		if(st.size > 0xFFFF)
+		if(de->size > 0xFFFF)
 			fail(NULL, name, -E2BIG);
-		size = st.size;
+		size = de->size;
 		type = TAG_LINK;
 	} else if(type == S_IFREG) {
-		if(st.size > 0xFFFFFFFF)
+		if(de->size > 0xFFFFFFFF)
 			fail(NULL, name, -E2BIG);
-		size = st.size;
+		size = de->size;
 		type = (mode & 0111) ? TAG_EXEC : TAG_FILE;
 	} else {
-		failx(ctx, "special file:", name, 0);
+		fail_dsent(ctx, "special file:", de, 0);
 	}
 
 	need = (need + 3) & ~3;
@@ -141,6 +96,8 @@ static void check_dent(CTX, int at, char* name)
 	memcpy(ep->name, name, nlen + 1);
 
 	update_header_size(ctx, mode, nlen);
+
+	return ep;
 };
 
 static uint last_idx_offset(CTX)
@@ -160,103 +117,66 @@ static uint last_idx_offset(CTX)
 	return off;
 }
 
-static void scan_directory(CTX);
+/* The tree from dirscan() comes already sorted the way the index
+   should be, non-dirs first, so all that's left is to convert it
+   into ent-s and lay the indexes out in the heap. Subdirectory
+   entries refer to their indexes by offset from ctx->brk. */
 
-static void enter_dir(CTX, char* name)
+static void convert_dir(CTX, struct dsent* dir)
 {
-	int at = ctx->at;
-	int depth = ctx->depth;
-	int fd, ret;
-
-	if(depth >= MAXDEPTH)
-		failx(ctx, NULL, name, -ELOOP);
-
-	if((fd = sys_openat(at, name, O_DIRECTORY)) < 0)
-		failx(ctx, NULL, name, fd);
+	struct dsent **sp, *de;
+	int i, count = 0;
 
-	ctx->path[depth] = name;
-	ctx->pfds[depth] = at;
-	ctx->depth = depth + 1;
-	ctx->at = fd;
+	for(sp = dir->sub; *sp; sp++)
+		count++;
 
-	scan_directory(ctx);
+	int size = (count+1)*sizeof(struct ent*);
+	struct ent** idx = heap_alloc(ctx, size);
 
-	if((ret = sys_close(ctx->at)) < 0)
-		fail("close", NULL, ret);
+	for(i = 0; i < count; i++)
+		idx[i] = convert_dent(ctx, dir->sub[i]);
 
-	depth = ctx->depth - 1;
-	ctx->at = ctx->pfds[depth];
-	ctx->depth = depth;
-}
-
-static void process_dir(CTX, struct ent** idx)
-{
-	struct ent *ep, **epp;
+	idx[count] = NULL;
 
-	for(epp = idx; (ep = *epp); epp++) {
-		int type = ep->type;
+	for(i = 0; i < count; i++) {
+		de = dir->sub[i];
 
-		if(type != TAG_DIR) continue;
+		if(idx[i]->type != TAG_DIR)
+			continue;
 
-		enter_dir(ctx, ep->name);
+		convert_dir(ctx, de);
 
-		ep->size = last_idx_offset(ctx);
+		idx[i]->size = last_idx_offset(ctx);
 	}
 
 	ctx->idx = idx;
 }
 
-static void scan_directory(CTX)
+static void scan_files(CTX, char* start)
 {
-	int fd = ctx->at;
-	void* buf = ctx->dirbuf;
-	int len = ctx->dirlen;
-	int ret;
-
-	void* p0 = ctx->ptr;
-
-	while((ret = sys_getdents(fd, buf, len)) > 0) {
-		void* ptr = buf;
-		void* end = buf + ret;
-
-		while(ptr < end) {
-			struct dirent* de = ptr;
-
-			char* name = de->name;
-			int reclen = de->reclen;
-
-			if(reclen <= 0)
-				break;
-
-			ptr += reclen;
-
-			if(dotddot(name))
-				continue;
+	struct dscan ds;
+	int fd, ret;
 
-			check_dent(ctx, fd, name);
-		}
-	} if(ret < 0) {
-		failx(ctx, NULL, "", ret);
-	};
+	memzero(&ds, sizeof(ds));
 
-	void* p1 = ctx->ptr;
+	if((fd = sys_open(start, O_DIRECTORY)) < 0)
+		fail(NULL, start, fd);
 
-	struct ent** idx = index_dir(ctx, p0, p1);
+	ctx->root = start;
+	ds.maxdepth = MAXDEPTH;
 
-	process_dir(ctx, idx);
-}
+	if((ret = dirscan(&ds, fd)) < 0) {
+		if(ds.bad)
+			fail_dsent(ctx, NULL, ds.bad, ret);
+		else
+			fail(NULL, start, ret);
+	}
 
-static void scan_files(CTX, char* start)
-{
-	int fd;
+	convert_dir(ctx, ds.top);
 
-	if((fd = sys_open(start, O_DIRECTORY)) < 0)
-		fail(NULL, start, fd);
+	dsfree(&ds);
 
-	ctx->root = start;
 	ctx->at = fd;
-
-	scan_directory(ctx);
 }
 
 static void append(CTX, void* buf, int len)
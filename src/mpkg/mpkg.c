@@ -37,6 +37,10 @@ static void dispatch_command(CTX, char* cmd)
 		return cmd_remove(ctx);
 	if(!strcmp(cmd, "list"))
 		return cmd_list(ctx);
+	if(!strcmp(cmd, "owner"))
+		return cmd_owner(ctx);
+	if(!strcmp(cmd, "reindex"))
+		return cmd_reindex(ctx);
 
 	fail("unknown command", cmd, 0);
 }
@@ -56,6 +60,7 @@ int main(int argc, char** argv)
 	ctx->nullfd = -1;
 	ctx->pacfd = -1;
 	ctx->lstfd = -1;
+	ctx->datafd = -1;
 
 	if(argc < 2)
 		fail("too few arguments", NULL, 0);
@@ -3,6 +3,8 @@
 
 #define MAXDEPTH 31
 
+#define DATADIR BASE_VAR "/mpkg"
+
 /* Bits in the leading byte (tag) of each entry from .pac index */
 #define TAG_DIR  (1<<7)
 
@@ -24,6 +26,7 @@
 #define BIT_NEED (1<<11)
 #define BIT_DENY (1<<12)
 #define BIT_EXST (1<<13)
+#define BIT_OWND (1<<14)
 
 struct node {
 	char* name;
@@ -103,6 +106,14 @@ struct top {
 	char* path[MAXDEPTH]; /* stack of directory names */
 	int pfds[MAXDEPTH]; /* path fds, stack of saved `at` values */
 
+	/* global file ownership index, see mpkg_owner.c */
+	int datafd;    /* fd of DATADIR, locked if we're going to modify it */
+	void* oidx;    /* mmaped index file */
+	uint olen;     /* size of the above */
+
+	struct leaf** leaves; /* sorted full paths of the files to deploy */
+	uint nleaves;
+
 	int fail; /* delayed-failure flag, see warnx() */
 };
 
@@ -119,6 +130,8 @@ void failz(CTX, const char* msg, char* name, int err) noreturn;
 void cmd_deploy(CTX);
 void cmd_remove(CTX);
 void cmd_list(CTX);
+void cmd_owner(CTX);
+void cmd_reindex(CTX);
 
 void* alloc_tight(CTX, int size);
 void* alloc_exact(CTX, int size);
@@ -134,6 +147,11 @@ void take_pacfile_arg(CTX);
 void check_filedb(CTX);
 void write_filedb(CTX);
 
+void check_owners(CTX);
+void add_owners(CTX);
+void lock_owners(CTX);
+void drop_owners(CTX);
+
 void need_zero_depth(CTX);
 
 void prep_pacname(CTX);
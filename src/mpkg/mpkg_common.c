@@ -8,8 +8,6 @@
 
 #include "mpkg.h"
 
-#define DATADIR BASE_VAR "/mpkg"
-
 static void* heap_alloc(CTX, int size)
 {
 	void* brk = ctx->brk;
@@ -17,8 +17,10 @@
 
     * locate and open the .pac file, load its index
     * check the index against the rules in config file
+    * check the index against the file ownership index
     * check the index for filesystem conflicts
     * save the list of stuff to be deployed
+    * record ownership of the files in the global index
     * unpack everything
 
   The overall idea is to maintain undo-ability and every point
@@ -38,6 +40,8 @@ static void check_leaf(CTX, struct node* nd)
 
 	if(!(nd->bits & BIT_NEED))
 		return;
+	if(nd->bits & BIT_OWND)
+		return; /* already reported in check_owners */
 
 	if((ret = sys_fstatat(at, name, &st, flags)) >= 0)
 		warnx(ctx, NULL, name, -EEXIST);
@@ -389,8 +393,10 @@ void cmd_deploy(CTX)
 	setup_prefix(ctx);
 	check_filedb(ctx);
 	check_index(ctx);
+	check_owners(ctx);
 	check_conflict(ctx);
 	write_filedb(ctx);
+	add_owners(ctx);
 
 	maybe_open_null(ctx);
 	unpack_content(ctx);
@@ -0,0 +1,940 @@
+#include <sys/file.h>
+#include <sys/fpath.h>
+#include <sys/dents.h>
+#include <sys/mman.h>
+#include <sys/sync.h>
+
+#include <config.h>
+#include <format.h>
+#include <string.h>
+#include <output.h>
+#include <util.h>
+
+#include "mpkg.h"
+
+/* Package lists in DATADIR tell which files a given package owns, but
+   answering the reverse question ("which package owns /usr/lib/foo.so")
+   would require reading all of them. So alongside the lists, mpkg keeps
+   a single sorted path-to-package map, DATADIR/owners:
+
+       struct ohead               tag, counts, total size
+       uint pkgs[npkgs]           offsets of package names
+       struct oent ents[nents]    offsets of paths and package indexes
+       char strings[]             0-terminated names and paths
+
+   Entries are sorted by path in plain byte order, so owner lookups are
+   binary searches, and conflict checks during deployment are merge-joins
+   against the (sorted) list of files in the package being deployed.
+
+   All paths are absolute and normalized, "/usr/lib/foo.so", regardless
+   of how they appear in the lists. Package names are "name" or "group:name".
+
+   The file is mmaped read-only and never modified in place. Updates get
+   written into owners.new which then gets renamed over owners, and the
+   whole check-and-update sequence runs with DATADIR flock'ed.
+
+   The lists remain the primary record. If the index gets lost or goes
+   out of sync, `mpkg reindex` rebuilds it from the lists. */
+
+#define OWNERS "owners"
+#define OWNNEW "owners.new"
+
+struct ohead {
+	char tag[4];
+	uint npkgs;
+	uint nents;
+	uint size;
+};
+
+struct oent {
+	uint path;
+	uint pkg;
+};
+
+/* In-memory entries for the new index being written */
+
+struct owned {
+	char* path;
+	uint pkg;
+};
+
+/* Files from the package being deployed */
+
+struct leaf {
+	struct node* nd;
+	char path[];
+};
+
+static void* alloc_ptrs(CTX, int count, int size)
+{
+	ulong pad = -((ulong)ctx->ptr) & (sizeof(void*) - 1);
+
+	if(pad) alloc_tight(ctx, pad);
+
+	return alloc_align(ctx, count*size);
+}
+
+/* Paths in the index, in the lists and in owner queries may come with
+   leading "./" or doubled slashes (prefix "/" gives "//usr/bin/foo"),
+   or trailing slashes. Everything that gets stored or looked up goes
+   through this, so that all of them end up in the same form: a single
+   leading slash, no empty or "." components, no trailing slash.
+   The output is at most one byte longer than the input. */
+
+static int canon_path(char* dst, char* src, char* end)
+{
+	char* q = dst;
+	char* p = src;
+
+	while(p < end) {
+		char* s = p;
+
+		while(p < end && *p != '/')
+			p++;
+
+		int len = p - s;
+
+		if(p < end)
+			p++;
+		if(!len)
+			continue;
+		if(len == 1 && *s == '.')
+			continue;
+
+		*q++ = '/';
+		memcpy(q, s, len);
+		q += len;
+	}
+
+	if(q == dst)
+		*q++ = '/';
+
+	*q = '\0';
+
+	return q - dst;
+}
+
+static char* canon_copy(CTX, char* src, char* end)
+{
+	char* buf = alloc_align(ctx, end - src + 2);
+
+	canon_path(buf, src, end);
+
+	return buf;
+}
+
+static struct ohead* index_head(CTX)
+{
+	return ctx->oidx;
+}
+
+static uint index_npkgs(CTX)
+{
+	struct ohead* oh = index_head(ctx);
+
+	return oh ? oh->npkgs : 0;
+}
+
+static uint index_nents(CTX)
+{
+	struct ohead* oh = index_head(ctx);
+
+	return oh ? oh->nents : 0;
+}
+
+static uint* index_pkgs(CTX)
+{
+	struct ohead* oh = index_head(ctx);
+
+	return (uint*)(oh + 1);
+}
+
+static struct oent* index_ents(CTX)
+{
+	return (struct oent*)(index_pkgs(ctx) + index_npkgs(ctx));
+}
+
+static char* index_str(CTX, uint off)
+{
+	return ctx->oidx + off;
+}
+
+static char* index_pkg(CTX, uint i)
+{
+	return index_str(ctx, index_pkgs(ctx)[i]);
+}
+
+static int bad_offset(uint off, uint hlen, uint size)
+{
+	return (off < hlen || off >= size);
+}
+
+static void validate_index(CTX, char* name)
+{
+	struct ohead* oh = index_head(ctx);
+	uint size = ctx->olen;
+	uint i;
+
+	if(size < sizeof(*oh))
+		goto corrupt;
+	if(memcmp(oh->tag, "OWNX", 4))
+		goto corrupt;
+	if(oh->size != size)
+		goto corrupt;
+	if(oh->npkgs > size || oh->nents > size)
+		goto corrupt;
+
+	uint npkgs = oh->npkgs;
+	uint nents = oh->nents;
+	ulong hlen = sizeof(*oh) + npkgs*sizeof(uint)
+	                         + nents*sizeof(struct oent);
+	if(hlen > size)
+		goto corrupt;
+	if(hlen < size && *index_str(ctx, size - 1))
+		goto corrupt;
+
+	uint* pkgs = index_pkgs(ctx);
+	struct oent* ents = index_ents(ctx);
+
+	for(i = 0; i < npkgs; i++)
+		if(bad_offset(pkgs[i], hlen, size))
+			goto corrupt;
+
+	for(i = 0; i < nents; i++)
+		if(bad_offset(ents[i].path, hlen, size))
+			goto corrupt;
+		else if(ents[i].pkg >= npkgs)
+			goto corrupt;
+
+	return;
+corrupt:
+	fail("corrupt index", name, 0);
+}
+
+static void load_index(CTX)
+{
+	char* name = DATADIR "/" OWNERS;
+	int fd, ret, at = ctx->datafd;
+	struct stat st;
+
+	if((fd = sys_openat(at, OWNERS, O_RDONLY)) < 0) {
+		if(fd == -ENOENT)
+			return;
+		fail(NULL, name, fd);
+	}
+
+	if((ret = sys_fstat(fd, &st)) < 0)
+		fail("stat", name, ret);
+	if(st.size > 0x7FFFFFFF)
+		fail(NULL, name, -E2BIG);
+	if(!st.size)
+		fail("corrupt index", name, 0);
+
+	uint size = st.size;
+	int proto = PROT_READ;
+	int flags = MAP_PRIVATE;
+
+	void* buf = sys_mmap(NULL, size, proto, flags, fd, 0);
+
+	if((ret = mmap_error(buf)))
+		fail("mmap", name, ret);
+
+	sys_close(fd);
+
+	ctx->oidx = buf;
+	ctx->olen = size;
+
+	validate_index(ctx, name);
+}
+
+/* Readers (mpkg owner) do not need the lock since the index only ever
+   gets replaced as a whole, but anything that modifies it must hold
+   the lock from loading the old index to renaming the new one. */
+
+static void lock_index(CTX)
+{
+	char* name = DATADIR;
+	int fd, ret;
+
+	if((fd = sys_open(name, O_DIRECTORY)) < 0)
+		fail(NULL, name, fd);
+	if((ret = sys_flock(fd, LOCK_EX)) < 0)
+		fail("lock", name, ret);
+
+	ctx->datafd = fd;
+}
+
+static void open_index(CTX)
+{
+	char* name = DATADIR;
+	int fd;
+
+	if((fd = sys_open(name, O_DIRECTORY | O_PATH)) < 0)
+		fail(NULL, name, fd);
+
+	ctx->datafd = fd;
+}
+
+/* Lower bound search, first entry in [oe, oz) with path >= key. */
+
+static struct oent* locate(CTX, struct oent* oe, struct oent* oz, char* key)
+{
+	while(oe < oz) {
+		struct oent* om = oe + (oz - oe)/2;
+
+		if(strcmp(index_str(ctx, om->path), key) < 0)
+			oe = om + 1;
+		else
+			oz = om;
+	}
+
+	return oe;
+}
+
+static int find_package(CTX, char* key)
+{
+	uint i, n = index_npkgs(ctx);
+
+	for(i = 0; i < n; i++)
+		if(!strcmp(index_pkg(ctx, i), key))
+			return i;
+
+	return -1;
+}
+
+static char* package_key(CTX)
+{
+	char* group = ctx->group;
+	char* name = ctx->name;
+	int len = strlen(name) + 2;
+
+	if(group) len += strlen(group) + 1;
+
+	char* buf = alloc_align(ctx, len);
+	char* p = buf;
+	char* e = buf + len - 1;
+
+	if(group) {
+		p = fmtstr(p, e, group);
+		p = fmtchar(p, e, ':');
+	}
+
+	p = fmtstr(p, e, name);
+
+	*p++ = '\0';
+
+	return buf;
+}
+
+/* Writing the index. The string area follows the tables immediately,
+   package names first, then the paths in the same order as ents[]. */
+
+static void put(struct bufout* bo, void* data, int len)
+{
+	int ret;
+
+	if((ret = bufout(bo, data, len)) < 0)
+		fail("write", DATADIR "/" OWNNEW, ret);
+}
+
+static void put_uint(struct bufout* bo, uint val)
+{
+	put(bo, &val, sizeof(val));
+}
+
+static void put_str(struct bufout* bo, char* str)
+{
+	put(bo, str, strlen(str) + 1);
+}
+
+static void write_index(CTX, char** pkgs, uint npkgs, struct owned** ents, uint nents)
+{
+	char* name = DATADIR "/" OWNNEW;
+	int flags = O_WRONLY | O_CREAT | O_TRUNC;
+	int fd, ret, at = ctx->datafd;
+	uint i, off, size;
+	void* ptr = ctx->ptr;
+	struct ohead oh;
+	struct bufout bo;
+
+	size = sizeof(oh) + npkgs*sizeof(uint) + nents*sizeof(struct oent);
+
+	for(i = 0; i < npkgs; i++)
+		size += strlen(pkgs[i]) + 1;
+	for(i = 0; i < nents; i++)
+		size += strlen(ents[i]->path) + 1;
+
+	if((fd = sys_openat4(at, OWNNEW, flags, 0644)) < 0)
+		fail(NULL, name, fd);
+
+	bo.fd = fd;
+	bo.len = 1<<16;
+	bo.buf = alloc_align(ctx, bo.len);
+	bo.ptr = 0;
+
+	memcpy(oh.tag, "OWNX", 4);
+	oh.npkgs = npkgs;
+	oh.nents = nents;
+	oh.size = size;
+
+	put(&bo, &oh, sizeof(oh));
+
+	off = sizeof(oh) + npkgs*sizeof(uint) + nents*sizeof(struct oent);
+
+	for(i = 0; i < npkgs; i++) {
+		put_uint(&bo, off);
+		off += strlen(pkgs[i]) + 1;
+	}
+	for(i = 0; i < nents; i++) {
+		put_uint(&bo, off);
+		put_uint(&bo, ents[i]->pkg);
+		off += strlen(ents[i]->path) + 1;
+	}
+
+	for(i = 0; i < npkgs; i++)
+		put_str(&bo, pkgs[i]);
+	for(i = 0; i < nents; i++)
+		put_str(&bo, ents[i]->path);
+
+	if((ret = bufoutflush(&bo)) < 0)
+		fail("write", name, ret);
+	if((ret = sys_fsync(fd)) < 0)
+		fail("fsync", name, ret);
+	if((ret = sys_close(fd)) < 0)
+		fail("close", name, ret);
+
+	if((ret = sys_renameat2(at, OWNNEW, at, OWNERS, 0)) < 0)
+		fail("rename", name, ret);
+
+	ctx->ptr = ptr;
+}
+
+static char** index_pkg_list(CTX, uint extra)
+{
+	uint i, n = index_npkgs(ctx);
+	char** pkgs = alloc_ptrs(ctx, n + extra, sizeof(char*));
+
+	for(i = 0; i < n; i++)
+		pkgs[i] = index_pkg(ctx, i);
+
+	return pkgs;
+}
+
+static struct owned** alloc_owned(CTX, uint count)
+{
+	struct owned** ents = alloc_ptrs(ctx, count, sizeof(*ents));
+	struct owned* recs = alloc_ptrs(ctx, count, sizeof(*recs));
+	uint i;
+
+	for(i = 0; i < count; i++)
+		ents[i] = &recs[i];
+
+	return ents;
+}
+
+/* Deployment. Collect the paths of the files to be written, the same set
+   write_filedb() puts into the list, sort them, and check whether any of
+   them are already owned by some other package.
+
+   Both sides of the join are sorted, so the index cursor only moves
+   forward; with small packages against a large index, each step is
+   a binary search over the remaining part of the index. */
+
+static int cmp_leaf(void* a, void* b)
+{
+	struct leaf* la = a;
+	struct leaf* lb = b;
+
+	return strcmp(la->path, lb->path);
+}
+
+static struct leaf* make_leaf(CTX, struct node* nd)
+{
+	int i, depth = ctx->depth;
+	char* prefix = ctx->prefix;
+	int len = strlen(nd->name) + 2;
+
+	if(prefix)
+		len += strlen(prefix);
+
+	for(i = 0; i < depth; i++)
+		len += strlen(ctx->path[i]) + 1;
+
+	char* buf = alloca(len);
+	char* p = buf;
+	char* e = buf + len - 1;
+
+	if(prefix)
+		p = fmtstr(p, e, prefix);
+
+	for(i = 0; i < depth; i++) {
+		p = fmtchar(p, e, '/');
+		p = fmtstr(p, e, ctx->path[i]);
+	}
+
+	p = fmtchar(p, e, '/');
+	p = fmtstr(p, e, nd->name);
+
+	struct leaf* lf = alloc_ptrs(ctx, 1, sizeof(*lf) + (p - buf) + 2);
+
+	canon_path(lf->path, buf, p);
+
+	lf->nd = nd;
+
+	return lf;
+}
+
+static uint count_leaves(CTX)
+{
+	struct node* nd = ctx->index;
+	struct node* ne = nd + ctx->nodes;
+	uint count = 0;
+
+	for(; nd < ne; nd++)
+		if(nd->bits & TAG_DIR)
+			continue;
+		else if(nd->bits & BIT_NEED)
+			count++;
+
+	return count;
+}
+
+static void collect_leaves(CTX)
+{
+	struct node* nd = ctx->index;
+	struct node* ne = nd + ctx->nodes;
+	uint count = count_leaves(ctx);
+	struct leaf** leaves = alloc_ptrs(ctx, count, sizeof(*leaves));
+	uint i = 0;
+
+	need_zero_depth(ctx);
+
+	for(; nd < ne; nd++) {
+		int bits = nd->bits;
+		int depth = ctx->depth;
+
+		if(bits & TAG_DIR) {
+			int lvl = bits & TAG_DEPTH;
+
+			if(lvl > depth || lvl >= MAXDEPTH)
+				fail("invalid pac index", NULL, 0);
+
+			ctx->path[lvl] = nd->name;
+			ctx->depth = lvl + 1;
+		} else if(bits & BIT_NEED) {
+			leaves[i++] = make_leaf(ctx, nd);
+		}
+	}
+
+	ctx->depth = 0;
+
+	qsortp(leaves, count, cmp_leaf);
+
+	ctx->leaves = leaves;
+	ctx->nleaves = count;
+}
+
+static void report_owned(CTX, struct leaf* lf, uint pkg)
+{
+	char* path = lf->path;
+	char* owner = index_pkg(ctx, pkg);
+	int len = strlen(path) + strlen(owner) + 20;
+	char* buf = alloca(len);
+	char* p = buf;
+	char* e = buf + len - 1;
+
+	p = fmtstr(p, e, path);
+	p = fmtstr(p, e, ": owned by ");
+	p = fmtstr(p, e, owner);
+
+	*p++ = '\0';
+
+	warn(NULL, buf, 0);
+
+	lf->nd->bits |= BIT_OWND;
+	ctx->fail = 1;
+}
+
+static void join_index(CTX)
+{
+	struct leaf** lp = ctx->leaves;
+	struct leaf** le = lp + ctx->nleaves;
+	struct oent* oe = index_ents(ctx);
+	struct oent* oz = oe + index_nents(ctx);
+
+	for(; lp < le && oe < oz; lp++) {
+		struct leaf* lf = *lp;
+
+		oe = locate(ctx, oe, oz, lf->path);
+
+		if(oe >= oz)
+			break;
+		if(strcmp(index_str(ctx, oe->path), lf->path))
+			continue;
+
+		report_owned(ctx, lf, oe->pkg);
+	}
+}
+
+void check_owners(CTX)
+{
+	lock_index(ctx);
+	load_index(ctx);
+
+	collect_leaves(ctx);
+
+	if(ctx->oidx)
+		join_index(ctx);
+}
+
+/* Called right after write_filedb(), with the lock still held
+   since check_owners(). */
+
+void add_owners(CTX)
+{
+	char* key = package_key(ctx);
+	int pkg = find_package(ctx, key);
+	uint npkgs = index_npkgs(ctx);
+	char** pkgs = index_pkg_list(ctx, 1);
+
+	if(pkg < 0) {
+		pkg = npkgs;
+		pkgs[npkgs++] = key;
+	}
+
+	struct leaf** lp = ctx->leaves;
+	struct leaf** le = lp + ctx->nleaves;
+	struct oent* oe = index_ents(ctx);
+	struct oent* oz = oe + index_nents(ctx);
+	struct owned** ents = alloc_owned(ctx, ctx->nleaves + (oz - oe));
+	uint n = 0;
+
+	while(lp < le || oe < oz) {
+		struct owned* ow = ents[n++];
+		int cmp;
+
+		if(lp >= le)
+			cmp = -1;
+		else if(oe >= oz)
+			cmp = 1;
+		else
+			cmp = strcmp(index_str(ctx, oe->path), (*lp)->path);
+
+		if(cmp < 0) {
+			ow->path = index_str(ctx, oe->path);
+			ow->pkg = oe->pkg;
+			oe++;
+		} else {
+			if(!cmp) oe++; /* stale entry */
+			ow->path = (*lp)->path;
+			ow->pkg = pkg;
+			lp++;
+		}
+	}
+
+	write_index(ctx, pkgs, npkgs, ents, n);
+}
+
+/* Removal. The lock is taken before any files get unlinked, so that
+   a concurrent deploy would not see stale entries for this package. */
+
+void lock_owners(CTX)
+{
+	lock_index(ctx);
+	load_index(ctx);
+}
+
+void drop_owners(CTX)
+{
+	char* key = package_key(ctx);
+	int pkg = find_package(ctx, key);
+
+	if(pkg < 0) return; /* not indexed */
+
+	uint i, npkgs = index_npkgs(ctx);
+	char** pkgs = index_pkg_list(ctx, 0);
+	struct oent* oe = index_ents(ctx);
+	struct oent* oz = oe + index_nents(ctx);
+	struct owned** ents = alloc_owned(ctx, oz - oe);
+	uint n = 0;
+
+	for(i = pkg + 1; i < npkgs; i++)
+		pkgs[i-1] = pkgs[i];
+
+	npkgs--;
+
+	for(; oe < oz; oe++) {
+		int op = oe->pkg;
+
+		if(op == pkg)
+			continue;
+
+		struct owned* ow = ents[n++];
+
+		ow->path = index_str(ctx, oe->path);
+		ow->pkg = op > pkg ? op - 1 : op;
+	}
+
+	write_index(ctx, pkgs, npkgs, ents, n);
+}
+
+/* Command: owner /path/to/file */
+
+void cmd_owner(CTX)
+{
+	char* path = shift(ctx);
+
+	no_more_arguments(ctx);
+
+	char* key = canon_copy(ctx, path, strpend(path));
+
+	open_index(ctx);
+	load_index(ctx);
+
+	struct oent* oe = index_ents(ctx);
+	struct oent* oz = oe + index_nents(ctx);
+
+	oe = locate(ctx, oe, oz, key);
+
+	if(oe >= oz || strcmp(index_str(ctx, oe->path), key))
+		fail("no package owns", path, 0);
+
+	char* owner = index_pkg(ctx, oe->pkg);
+	int len = strlen(owner) + 2;
+	char* buf = alloca(len);
+	char* p = buf;
+	char* e = buf + len;
+	int ret;
+
+	p = fmtstr(p, e, owner);
+	p = fmtchar(p, e, '\n');
+
+	if((ret = writeall(STDOUT, buf, p - buf)) < 0)
+		fail("write", NULL, ret);
+}
+
+/* Command: reindex
+
+   Rebuild the index from scratch using the list files in DATADIR.
+   This is the upgrade path for systems that had packages deployed before
+   the index was introduced, and the recovery path in case the index gets
+   damaged. The list files are not validated beyond basic syntax. */
+
+struct mlist {
+	char* buf;
+	uint size;
+};
+
+struct scan {
+	struct top* ctx;
+
+	char** pkgs;
+	struct mlist* lists;
+	uint npkgs;
+	uint maxpkgs;
+};
+
+static int list_suffix(char* name)
+{
+	int len = strlen(name);
+
+	if(len <= 5)
+		return 0;
+	if(memcmp(name + len - 5, ".list", 5))
+		return 0;
+
+	return len - 5;
+}
+
+static void add_package(struct scan* sc, char* group, char* name, int nlen)
+{
+	struct top* ctx = sc->ctx;
+
+	if(sc->npkgs >= sc->maxpkgs)
+		fail("too many packages", NULL, 0);
+
+	int len = nlen + 2;
+
+	if(group) len += strlen(group) + 1;
+
+	char* buf = alloc_align(ctx, len);
+	char* p = buf;
+	char* e = buf + len - 1;
+
+	if(group) {
+		p = fmtstr(p, e, group);
+		p = fmtchar(p, e, ':');
+	}
+
+	p = fmtraw(p, e, name, nlen);
+
+	*p++ = '\0';
+
+	sc->pkgs[sc->npkgs++] = buf;
+}
+
+static void map_list(struct scan* sc, int at, char* name)
+{
+	struct mlist* ml = &sc->lists[sc->npkgs - 1];
+	int fd, ret;
+	struct stat st;
+
+	if((fd = sys_openat(at, name, O_RDONLY)) < 0)
+		fail(NULL, name, fd);
+	if((ret = sys_fstat(fd, &st)) < 0)
+		fail("stat", name, ret);
+	if(st.size > 0x7FFFFFFF)
+		fail(NULL, name, -E2BIG);
+	if(!st.size)
+		goto out;
+
+	uint size = st.size;
+	char* buf = sys_mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+	if((ret = mmap_error(buf)))
+		fail("mmap", name, ret);
+
+	ml->buf = buf;
+	ml->size = size;
+out:
+	sys_close(fd);
+}
+
+static void scan_dir(struct scan* sc, int at, char* dir, char* group)
+{
+	int fd, rd, len = 2048;
+	char* buf = alloca(len);
+
+	if((fd = sys_openat(at, dir, O_DIRECTORY)) < 0)
+		fail(NULL, dir, fd);
+
+	while((rd = sys_getdents(fd, buf, len)) > 0) {
+		void* ptr = buf;
+		void* end = buf + rd;
+
+		while(ptr < end) {
+			struct dirent* de = ptr;
+			int nlen;
+
+			if(!de->reclen)
+				break;
+
+			ptr += de->reclen;
+
+			char* name = de->name;
+			int type = de->type;
+
+			if(dotddot(name))
+				continue;
+
+			if(type == DT_DIR && !group) {
+				char* grp = copy_string(sc->ctx, name, strpend(name));
+				scan_dir(sc, fd, name, grp);
+			} else if((nlen = list_suffix(name))) {
+				add_package(sc, group, name, nlen);
+				map_list(sc, fd, name);
+			}
+		}
+	}
+
+	if(rd < 0)
+		fail("getdents", dir, rd);
+
+	sys_close(fd);
+}
+
+/* The prefix line (the first line, ending with a slash) is not a file.
+   Everything else gets canonicalized when copied. */
+
+static char* trim_line(char* ls, char* le)
+{
+	if(ls >= le || le[-1] == '/')
+		return NULL;
+
+	return ls;
+}
+
+static uint count_lines(struct scan* sc)
+{
+	uint i, count = 0;
+
+	for(i = 0; i < sc->npkgs; i++) {
+		char* p = sc->lists[i].buf;
+		char* e = p + sc->lists[i].size;
+
+		while(p < e) {
+			char* le = strecbrk(p, e, '\n');
+
+			if(trim_line(p, le))
+				count++;
+
+			p = le + 1;
+		}
+	}
+
+	return count;
+}
+
+static uint fill_owned(struct scan* sc, struct owned** ents)
+{
+	struct top* ctx = sc->ctx;
+	uint i, n = 0;
+
+	for(i = 0; i < sc->npkgs; i++) {
+		char* p = sc->lists[i].buf;
+		char* e = p + sc->lists[i].size;
+
+		while(p < e) {
+			char* le = strecbrk(p, e, '\n');
+			char* ls = trim_line(p, le);
+
+			p = le + 1;
+
+			if(!ls) continue;
+
+			struct owned* ow = ents[n++];
+
+			ow->path = canon_copy(ctx, ls, le);
+			ow->pkg = i;
+		}
+	}
+
+	return n;
+}
+
+static int cmp_owned(void* a, void* b)
+{
+	struct owned* oa = a;
+	struct owned* ob = b;
+
+	return strcmp(oa->path, ob->path);
+}
+
+void cmd_reindex(CTX)
+{
+	struct scan context, *sc = &context;
+	uint maxpkgs = 1<<16;
+
+	no_more_arguments(ctx);
+
+	lock_index(ctx);
+
+	memzero(sc, sizeof(*sc));
+
+	sc->ctx = ctx;
+	sc->maxpkgs = maxpkgs;
+	sc->pkgs = alloc_ptrs(ctx, maxpkgs, sizeof(char*));
+	sc->lists = alloc_ptrs(ctx, maxpkgs, sizeof(struct mlist));
+
+	memzero(sc->lists, maxpkgs*sizeof(struct mlist));
+
+	scan_dir(sc, AT_FDCWD, DATADIR, NULL);
+
+	uint count = count_lines(sc);
+	struct owned** ents = alloc_owned(ctx, count);
+	uint n = fill_owned(sc, ents);
+
+	qsortp(ents, n, cmp_owned);
+
+	write_index(ctx, sc->pkgs, sc->npkgs, ents, n);
+}
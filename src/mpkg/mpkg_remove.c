@@ -346,7 +346,9 @@ void cmd_remove(CTX)
 
 	check_prefix(ctx);
 	setup_prefix(ctx);
+	lock_owners(ctx);
 
 	unlink_files(ctx);
+	drop_owners(ctx);
 	unlink_filedb(ctx);
 }
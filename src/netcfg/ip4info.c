@@ -31,14 +31,19 @@ ERRTAG("ip4info");
 
 /* Link and IP lists are cached in the heap, because we need freely
    accessible to format links and routes properly. Route data is not
-   cached, just show one message at a time. */
+   cached, just show one message at a time.
+
+   The receive buffer is large and mmaped so that the kernel would send
+   dumps in the largest possible chunks. With a full routing table, there
+   may be hundreds of thousands of entries to go through. */
+
+#define RXBUF (64*1024)
 
 char ifbuf[1024];
 
 char txbuf[1024];
-char rxbuf[5*1024];
 
-char outbuf[1024];
+char outbuf[16*1024];
 
 struct top {
 	int netlink;
@@ -147,7 +152,7 @@ static void recv_all_addrs(CTX, char* cmdtag)
 	int fd = ctx->netlink;
 	int ret;
 recv:
-	if((ret = nr_recv(fd, nr)) <= 0)
+	if((ret = nr_recv_whole(fd, nr)) <= 0)
 		fail("recv", "NETLINK", ret);
 
 	struct nlmsg* msg;
@@ -181,8 +186,11 @@ static void fetch_ips(CTX)
 
 	nc_header(nc, RTM_GETADDR, NLM_F_DUMP, 0);
 
-	(void)nc_fixed(nc, sizeof(*req));
+	if(!(req = nc_fixed(nc, sizeof(*req))))
+		goto send;
 
+	req->family = AF_INET;
+send:
 	if((ret = nc_send(fd, nc)) < 0)
 		fail("send", "NETLINK", ret);
 
@@ -214,7 +222,7 @@ static void recv_all_ifaces(CTX, char* cmdtag)
 	int fd = ctx->netlink;
 	int ret;
 recv:
-	if((ret = nr_recv(fd, nr)) <= 0)
+	if((ret = nr_recv_whole(fd, nr)) <= 0)
 		fail("recv", "NETLINK", ret);
 
 	struct nlmsg* msg;
@@ -427,7 +435,7 @@ static void recv_all_routes(CTX, char* cmdtag)
 	int fd = ctx->netlink;
 	int ret;
 recv:
-	if((ret = nr_recv(fd, nr)) <= 0)
+	if((ret = nr_recv_whole(fd, nr)) <= 0)
 		fail("recv", "NETLINK", ret);
 
 	struct nlmsg* msg;
@@ -489,12 +497,16 @@ static void setup(CTX)
 	if((ret = sys_bind(fd, (struct sockaddr*)&nls, sizeof(nls))) < 0)
 		fail("bind", "NETLINK", ret);
 
+	(void)nl_strict(fd);
+
 	ctx->netlink = fd;
 
 	bufoutset(&ctx->bo, STDOUT, outbuf, sizeof(outbuf));
 
 	nc_buf_set(&ctx->nc, txbuf, sizeof(txbuf));
-	nr_buf_set(&ctx->nr, rxbuf, sizeof(rxbuf));
+
+	if((ret = nr_buf_map(&ctx->nr, RXBUF)) < 0)
+		fail("mmap", NULL, ret);
 }
 
 static void flush(CTX)
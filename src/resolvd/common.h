@@ -0,0 +1,30 @@
+#include <config.h>
+
+#define CONTROL RUN_CTRL "/resolvd"
+
+#define NSERVS 4 /* upstream servers */
+
+#define CMD_STATUS     1
+#define CMD_SERVER     2
+#define CMD_FLUSH      3
+#define CMD_RESET      4
+
+#define REP_STATUS     1
+
+#define ATTR_SERVER    1
+#define ATTR_ADDR      2
+#define ATTR_PORT      3
+#define ATTR_SENT      4
+#define ATTR_WON       5
+#define ATTR_FAILED    6
+
+#define ATTR_QUERIES  10
+#define ATTR_HITS     11
+#define ATTR_NEGHITS  12
+#define ATTR_MISSES   13
+#define ATTR_JOINED   14
+#define ATTR_UPSTREAM 15
+#define ATTR_TIMEOUTS 16
+#define ATTR_SRVFAIL  17
+#define ATTR_CACHED   18
+#define ATTR_PENDING  19
@@ -0,0 +1,35 @@
+#define DNSF_QR (1<<15)
+#define DNSF_OP (15<<11)
+# define DNSF_OP_QUERY  (0<<11)
+#define DNSF_AA (1<<10)
+#define DNSF_TC (1<<9)
+#define DNSF_RD (1<<8)
+#define DNSF_RA (1<<7)
+#define DNSF_RC (15<<0)
+# define DNSF_RC_SUCCESS (0<<0)
+# define DNSF_RC_FORMAT  (1<<0)
+# define DNSF_RC_SERVER  (2<<0)
+# define DNSF_RC_NAME    (3<<0)
+# define DNSF_RC_NOTIMPL (4<<0)
+# define DNSF_RC_REFUSED (5<<0)
+
+#define DNS_TYPE_SOA   6
+#define DNS_TYPE_OPT  41
+
+struct dnshdr {
+	ushort id;
+	ushort flags;
+
+	ushort qdcount;
+	ushort ancount;
+	ushort nscount;
+	ushort arcount;
+} __attribute__((packed));
+
+struct dnsres {
+	ushort type;
+	ushort class;
+	uint ttl;
+	ushort length;
+	byte data[];
+} __attribute__((packed));
@@ -0,0 +1,311 @@
+#include <bits/socket/unix.h>
+#include <sys/socket.h>
+
+#include <nlusctl.h>
+#include <string.h>
+#include <format.h>
+#include <main.h>
+#include <util.h>
+
+#include "common.h"
+
+ERRTAG("resctl");
+
+struct top {
+	int argc;
+	int argi;
+	char** argv;
+
+	int fd;
+	char txbuf[128];
+	char rxbuf[512];
+
+	struct ucbuf uc;
+};
+
+#define CTX struct top* ctx __attribute__((unused))
+#define MSG struct ucattr* msg __attribute__((unused))
+
+typedef struct ucattr* attr;
+
+static void prep_context(CTX, int argc, char** argv)
+{
+	int i = 1;
+
+	if(i < argc && argv[i][0] == '-' && argv[i++][1])
+		fail("no options allowed", NULL, 0);
+
+	ctx->argc = argc;
+	ctx->argv = argv;
+	ctx->argi = i;
+
+	uc_buf_set(&ctx->uc, ctx->txbuf, sizeof(ctx->txbuf));
+}
+
+static int init_socket(CTX)
+{
+	int fd, ret;
+	char* path = CONTROL;
+
+	if((fd = sys_socket(AF_UNIX, SOCK_SEQPACKET, 0)) < 0)
+		fail("socket", "AF_UNIX", fd);
+	if((ret = uc_connect(fd, path)) < 0)
+		fail("connect", path, ret);
+
+	ctx->fd = fd;
+
+	return fd;
+}
+
+static void send_command(CTX, struct ucbuf* uc)
+{
+	int wr, fd;
+
+	if(!(fd = ctx->fd))
+		fd = init_socket(ctx);
+	if((wr = uc_send(fd, uc)) < 0)
+		fail("send", NULL, wr);
+}
+
+static struct ucattr* recv_reply(CTX)
+{
+	int ret, fd = ctx->fd;
+	void* buf = ctx->rxbuf;
+	int len = sizeof(ctx->rxbuf);
+	struct ucattr* msg;
+
+	if((ret = uc_recv(fd, buf, len)) < 0)
+		fail("recv", NULL, ret);
+	if(!(msg = uc_msg(buf, ret)))
+		fail("invalid message", NULL, 0);
+
+	return msg;
+}
+
+static void send_check(CTX, struct ucbuf* uc)
+{
+	struct ucattr* msg;
+
+	send_command(ctx, uc);
+
+	msg = recv_reply(ctx);
+
+	int cmd = uc_repcode(msg);
+
+	if(cmd > 0)
+		fail("unexpected notification", NULL, 0);
+	if(cmd < 0)
+		fail(NULL, NULL, cmd);
+}
+
+static struct ucattr* send_recv(CTX, struct ucbuf* uc)
+{
+	send_command(ctx, uc);
+
+	return recv_reply(ctx);
+}
+
+static void output(char* buf, char* end)
+{
+	writeall(STDOUT, buf, end - buf);
+}
+
+static int get_int(attr msg, int key)
+{
+	int* ip = uc_get_int(msg, key);
+
+	return ip ? *ip : 0;
+}
+
+static char* fmt_count(char* p, char* e, attr msg, int key, char* tag)
+{
+	p = fmtstr(p, e, tag);
+	p = fmtchar(p, e, ' ');
+	p = fmtint(p, e, get_int(msg, key));
+
+	return p;
+}
+
+static char* fmt_server(char* p, char* e, attr at)
+{
+	attr ip = uc_get(at, ATTR_ADDR);
+	int port = get_int(at, ATTR_PORT);
+
+	p = fmtstr(p, e, "Server ");
+
+	if(ip && uc_paylen(ip) == 4)
+		p = fmtip(p, e, uc_payload(ip));
+	else
+		p = fmtstr(p, e, "???");
+
+	if(port != 53) {
+		p = fmtchar(p, e, ':');
+		p = fmtint(p, e, port);
+	}
+
+	p = fmt_count(p, e, at, ATTR_SENT, ": sent");
+	p = fmt_count(p, e, at, ATTR_WON, ", answered first");
+	p = fmt_count(p, e, at, ATTR_FAILED, ", failed");
+	p = fmtchar(p, e, '\n');
+
+	return p;
+}
+
+static void cmd_status(CTX)
+{
+	struct ucattr *msg, *at;
+	struct ucbuf* uc = &ctx->uc;
+	int cmd, servers = 0;
+
+	uc_put_hdr(uc, CMD_STATUS);
+
+	msg = send_recv(ctx, uc);
+
+	if((cmd = uc_repcode(msg)) < 0)
+		fail(NULL, NULL, cmd);
+	if(cmd != REP_STATUS)
+		fail("unexpected reply", NULL, 0);
+
+	FMTBUF(p, e, buf, 1024);
+
+	p = fmt_count(p, e, msg, ATTR_QUERIES, "Queries");
+	p = fmt_count(p, e, msg, ATTR_HITS, ", cached");
+	p = fmt_count(p, e, msg, ATTR_NEGHITS, ", cached negative");
+	p = fmt_count(p, e, msg, ATTR_MISSES, ", missed");
+	p = fmt_count(p, e, msg, ATTR_JOINED, ", joined in-flight");
+	p = fmtchar(p, e, '\n');
+
+	p = fmt_count(p, e, msg, ATTR_CACHED, "Cache entries");
+	p = fmt_count(p, e, msg, ATTR_PENDING, ", pending");
+	p = fmtchar(p, e, '\n');
+
+	p = fmt_count(p, e, msg, ATTR_UPSTREAM, "Upstream requests");
+	p = fmt_count(p, e, msg, ATTR_TIMEOUTS, ", timed out");
+	p = fmt_count(p, e, msg, ATTR_SRVFAIL, ", failed");
+	p = fmtchar(p, e, '\n');
+
+	for(at = uc_get_0(msg); at; at = uc_get_n(msg, at))
+		if(uc_is_keyed(at, ATTR_SERVER)) {
+			p = fmt_server(p, e, at);
+			servers++;
+		}
+
+	if(!servers)
+		p = fmtstr(p, e, "No upstream servers\n");
+
+	FMTEND(p, e);
+
+	output(buf, p);
+}
+
+static void parse_server(char* arg, byte ip[4], int* port)
+{
+	char* p;
+
+	if(!(p = parseip(arg, ip)))
+		fail("invalid address", arg, 0);
+
+	if(!*p)
+		*port = 53;
+	else if(*p != ':')
+		fail("invalid address", arg, 0);
+	else if(!(p = parseint(p+1, port)) || *p)
+		fail("invalid port", arg, 0);
+}
+
+static void cmd_server(CTX)
+{
+	int i, n = ctx->argc - ctx->argi;
+	struct ucbuf* uc = &ctx->uc;
+
+	uc_put_hdr(uc, CMD_SERVER);
+
+	/* DHCP may supply more servers than resolvd can use,
+	   the ones listed first are the preferred ones. */
+
+	for(i = 0; i < n; i++) {
+		char* arg = ctx->argv[ctx->argi++];
+		byte ip[4];
+		int port;
+
+		parse_server(arg, ip, &port);
+
+		if(i >= NSERVS)
+			continue;
+
+		struct ucattr* at = uc_put_nest(uc, ATTR_SERVER);
+		uc_put_bin(uc, ATTR_ADDR, ip, 4);
+		uc_put_int(uc, ATTR_PORT, port);
+		uc_end_nest(uc, at);
+	}
+
+	send_check(ctx, uc);
+}
+
+static void no_more_arguments(CTX)
+{
+	if((ctx->argc - ctx->argi) > 0)
+		fail("too many arguments", NULL, 0);
+}
+
+static void simple_command(CTX, int cmd)
+{
+	struct ucbuf* uc = &ctx->uc;
+
+	no_more_arguments(ctx);
+
+	uc_put_hdr(uc, cmd);
+
+	send_check(ctx, uc);
+}
+
+static void cmd_flush(CTX)
+{
+	simple_command(ctx, CMD_FLUSH);
+}
+
+static void cmd_reset(CTX)
+{
+	simple_command(ctx, CMD_RESET);
+}
+
+static const struct cmd {
+	char name[8];
+	void (*call)(CTX);
+} commands[] = {
+	{ "status", cmd_status },
+	{ "server", cmd_server },
+	{ "flush",  cmd_flush  },
+	{ "reset",  cmd_reset  }
+};
+
+static const struct cmd* find_command(CTX)
+{
+	const struct cmd* cc;
+
+	if(ctx->argi >= ctx->argc)
+		return &commands[0];
+
+	char* name = ctx->argv[ctx->argi++];
+
+	for(cc = commands; cc < ARRAY_END(commands); cc++)
+		if(!strcmpn(cc->name, name, sizeof(cc->name)))
+			return cc;
+
+	fail("unknown command", name, 0);
+}
+
+int main(int argc, char** argv)
+{
+	struct top context, *ctx = &context;
+	const struct cmd* cc;
+
+	memzero(ctx, sizeof(*ctx));
+	prep_context(ctx, argc, argv);
+
+	cc = find_command(ctx);
+
+	cc->call(ctx);
+
+	return 0;
+}
@@ -0,0 +1,311 @@
+#include <bits/socket/unix.h>
+#include <bits/socket/inet.h>
+
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/ppoll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include <string.h>
+#include <format.h>
+#include <endian.h>
+#include <nlusctl.h>
+#include <main.h>
+#include <util.h>
+
+#include "resolvd.h"
+
+ERRTAG("resolvd");
+
+struct poll {
+	struct pollfd pfds[NPOLLS];
+	int npfds;
+};
+
+static void setup_control(CTX)
+{
+	int fd, ret;
+	int flags = SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC;
+	char* path = CONTROL;
+
+	if((fd = sys_socket(AF_UNIX, flags, 0)) < 0)
+		fail("socket", "AF_UNIX", fd);
+	if((ret = uc_listen(fd, path, 5)) < 0)
+		fail("ucbind", path, ret);
+
+	ctx->ctlfd = fd;
+}
+
+static int udp_socket(byte ip[4], int port)
+{
+	int fd, ret;
+	int flags = SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC;
+	struct sockaddr_in addr = {
+		.family = AF_INET,
+		.port = htons(port)
+	};
+
+	memcpy(addr.addr, ip, 4);
+
+	if((fd = sys_socket(AF_INET, flags, IPPROTO_UDP)) < 0)
+		fail("socket", "AF_INET", fd);
+	if((ret = sys_bind(fd, &addr, sizeof(addr))) < 0)
+		fail("bind", NULL, ret);
+
+	return fd;
+}
+
+static int tcp_socket(byte ip[4], int port)
+{
+	int fd, ret;
+	int flags = SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC;
+	struct sockaddr_in addr = {
+		.family = AF_INET,
+		.port = htons(port)
+	};
+
+	memcpy(addr.addr, ip, 4);
+
+	if((fd = sys_socket(AF_INET, flags, IPPROTO_TCP)) < 0)
+		fail("socket", "AF_INET", fd);
+	if((ret = sys_setsockopti(fd, SOL_SOCKET, SO_REUSEADDR, 1)) < 0)
+		fail("setsockopt", "SO_REUSEADDR", ret);
+	if((ret = sys_bind(fd, &addr, sizeof(addr))) < 0)
+		fail("bind", NULL, ret);
+	if((ret = sys_listen(fd, 5)) < 0)
+		fail("listen", NULL, ret);
+
+	return fd;
+}
+
+static void setup_sockets(CTX, byte ip[4], int port)
+{
+	ctx->dnsfd = udp_socket(ip, port);
+	ctx->tcpfd = tcp_socket(ip, port);
+}
+
+static void setup_cache(CTX)
+{
+	int prot = PROT_READ | PROT_WRITE;
+	int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+	long size = NCACHE*sizeof(struct cent);
+	void* buf = sys_mmap(NULL, size, prot, flags, -1, 0);
+	int ret;
+
+	if((ret = mmap_error(buf)))
+		fail("mmap", NULL, ret);
+
+	ctx->cache = buf;
+}
+
+static void parse_listen_addr(char* arg, byte ip[4], int* port)
+{
+	char* p;
+
+	if(!(p = parseip(arg, ip)))
+		fail("invalid address", arg, 0);
+
+	if(!*p)
+		*port = 53;
+	else if(*p != ':')
+		fail("invalid address", arg, 0);
+	else if(!(p = parseint(p+1, port)) || *p)
+		fail("invalid port", arg, 0);
+}
+
+static void update_time(CTX)
+{
+	struct timespec ts;
+	int ret;
+
+	if((ret = sys_clock_gettime(CLOCK_BOOTTIME, &ts)) < 0)
+		fail("clock_gettime", NULL, ret);
+
+	ctx->now = ts.sec*1000 + ts.nsec/1000000;
+}
+
+static void setup_pollfds(CTX, struct poll* pp)
+{
+	struct pollfd* pf;
+
+	for(pf = pp->pfds; pf < ARRAY_END(pp->pfds); pf++)
+		pf->events = POLLIN;
+}
+
+static int ifgoodfd(int fd)
+{
+	return (fd > 0 ? fd : -1);
+}
+
+/* Each pending upstream query has its own socket, see resolvd_query.c.
+   These go into fixed slots past the client connections, so that there
+   is no need to keep track of which pollfd belongs to which query.
+   Same for the DNS clients connected over TCP. */
+
+static void update_poll_fds(CTX, struct poll* pp)
+{
+	int i, n = ctx->nconn;
+	struct pollfd* pfds = pp->pfds;
+	struct pollfd* pt = pfds + 3 + NCONNS;
+	struct pollfd* pq = pt + NTCPS;
+
+	pfds[0].fd = ctx->ctlfd;
+	pfds[1].fd = ctx->dnsfd;
+	pfds[2].fd = ctx->tcpfd;
+
+	for(i = 0; i < NCONNS; i++)
+		pfds[3+i].fd = i < n ? ifgoodfd(ctx->conns[i].fd) : -1;
+
+	for(i = 0; i < NTCPS; i++)
+		pt[i].fd = ifgoodfd(ctx->tcps[i].fd);
+
+	for(i = 0; i < NPEND; i++)
+		pq[i].fd = ctx->pends[i].qlen ? ctx->pends[i].fd : -1;
+
+	pp->npfds = NPOLLS;
+}
+
+void clear_client(CTX, CN)
+{
+	int i, n = 0;
+
+	sys_close(cn->fd);
+	cn->fd = -1;
+
+	for(i = 0; i < NCONNS; i++)
+		if(ctx->conns[i].fd > 0)
+			n = i + 1;
+
+	ctx->nconn = n;
+}
+
+static struct conn* grab_conn_slot(CTX)
+{
+	int i, n = NCONNS;
+
+	for(i = 0; i < n; i++) {
+		struct conn* cn = &ctx->conns[i];
+
+		if(cn->fd > 0)
+			continue;
+
+		if(i >= ctx->nconn)
+			ctx->nconn = i + 1;
+
+		return cn;
+	}
+
+	return NULL;
+}
+
+static void check_control(CTX)
+{
+	int fd, sfd = ctx->ctlfd;
+	int flags = SOCK_NONBLOCK;
+	struct sockaddr addr;
+	int addr_len = sizeof(addr);
+	struct conn* cn;
+
+	while((fd = sys_accept4(sfd, &addr, &addr_len, flags)) > 0) {
+		if(!(cn = grab_conn_slot(ctx)))
+			sys_close(fd);
+		else
+			cn->fd = fd;
+	}
+}
+
+static void check_polled_fds(CTX, struct poll* pp)
+{
+	struct pollfd* pfds = pp->pfds;
+	struct pollfd* pt = pfds + 3 + NCONNS;
+	struct pollfd* pq = pt + NTCPS;
+	int i, n = ctx->nconn;
+
+	if(pfds[0].revents & POLLIN)
+		check_control(ctx);
+
+	for(i = 0; i < NPEND; i++)
+		if(pq[i].fd >= 0 && (pq[i].revents & POLLIN))
+			check_upstream(ctx, &ctx->pends[i]);
+
+	if(pfds[1].revents & POLLIN)
+		check_query(ctx);
+	if(pfds[2].revents & POLLIN)
+		accept_tcp(ctx);
+
+	for(i = 0; i < NTCPS; i++) {
+		int revents = pt[i].revents;
+
+		if(pt[i].fd < 0)
+			continue;
+		if(revents & POLLIN)
+			check_tcp(ctx, i);
+		else if(revents)
+			close_tcp(ctx, i);
+	}
+
+	for(i = 0; i < n; i++) {
+		int revents = pfds[3+i].revents;
+
+		if(revents & POLLIN)
+			check_client(ctx, &ctx->conns[i]);
+		if(revents & ~POLLIN)
+			clear_client(ctx, &ctx->conns[i]);
+	}
+}
+
+static struct timespec* wait_timeout(CTX, struct timespec* ts)
+{
+	int ms;
+
+	if((ms = next_timeout(ctx)) < 0)
+		return NULL;
+
+	ts->sec = ms / 1000;
+	ts->nsec = (ms % 1000) * 1000000;
+
+	return ts;
+}
+
+int main(int argc, char** argv)
+{
+	struct top context, *ctx = &context;
+	struct poll pollctx, *pp = &pollctx;
+	struct timespec ts;
+	byte ip[4] = { 127, 0, 0, 1 };
+	int port = 53;
+	int ret;
+
+	if(argc > 2)
+		fail("too many arguments", NULL, 0);
+	if(argc > 1)
+		parse_listen_addr(argv[1], ip, &port);
+
+	memzero(ctx, sizeof(*ctx));
+	memzero(pp, sizeof(*pp));
+
+	setup_cache(ctx);
+	setup_sockets(ctx, ip, port);
+	setup_control(ctx);
+	setup_pollfds(ctx, pp);
+
+	update_time(ctx);
+
+	while(1) {
+		struct timespec* tp = wait_timeout(ctx, &ts);
+
+		update_poll_fds(ctx, pp);
+
+		ret = sys_ppoll(pp->pfds, pp->npfds, tp, NULL);
+
+		update_time(ctx);
+
+		if(ret > 0)
+			check_polled_fds(ctx, pp);
+		else if(ret < 0 && ret != -EINTR)
+			fail("ppoll", NULL, ret);
+
+		check_timeouts(ctx);
+	}
+}
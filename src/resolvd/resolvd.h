@@ -0,0 +1,146 @@
+#include <cdefs.h>
+
+#include "common.h"
+
+#define NCONNS 4
+#define NTCPS 8     /* DNS clients connected over TCP */
+#define NPEND 32    /* upstream queries in flight */
+#define NPOLLS (3 + NCONNS + NTCPS + NPEND)
+
+#define NWAIT 8     /* clients waiting on a single upstream query */
+#define NCACHE 1024 /* cache slots */
+#define NPROBE 8    /* slots checked for each key */
+
+#define MAXPKT 4096 /* EDNS buffer size advertised upstream */
+#define MAXUDP 512  /* plain DNS over UDP, no EDNS */
+#define MAXQRY 512  /* queries from clients */
+#define MAXQST 260  /* 255 bytes of name plus type and class */
+#define HDRLEN 12
+#define OPTLEN 11   /* EDNS OPT record with no options */
+
+#define MAXTTL (24*60*60)
+#define NEGTTL (60*60)
+
+#define RETRY_MS 1000
+#define NTRIES 3
+
+#define SF_SET  (1<<0)
+
+#define CF_NEG  (1<<0)
+
+struct conn {
+	int fd;
+};
+
+struct tcpc {
+	int fd;
+	ushort have;
+	byte buf[2 + MAXQRY];
+};
+
+struct serv {
+	ushort flags;
+	ushort port;
+	byte addr[4];
+	uint sent;
+	uint won;
+	uint failed;
+};
+
+struct waiter {
+	byte addr[4];
+	ushort port;
+	ushort id;
+	ushort max;   /* reply size limit */
+	ushort tcp;   /* TCP client slot + 1, or 0 for UDP */
+};
+
+struct pend {
+	ushort qlen;  /* 0 for free slots */
+	ushort plen;
+	uint hash;
+	int fd;       /* upstream socket, one per query */
+	byte tries;
+	byte nwait;
+	byte sent;    /* servers it went to, bitmask */
+	byte failed;  /* servers that gave up on it, bitmask */
+	uint64_t deadline;
+	struct waiter waits[NWAIT];
+	byte packet[HDRLEN + MAXQST + OPTLEN];
+};
+
+struct cent {
+	ushort len;   /* 0 for free slots */
+	ushort qlen;
+	uint hash;
+	uint flags;
+	uint64_t stored;
+	uint64_t expires;
+	uint64_t used;
+	byte data[MAXPKT];
+};
+
+struct stats {
+	uint queries;
+	uint hits;
+	uint neghits;
+	uint misses;
+	uint joined;
+	uint upstream;
+	uint timeouts;
+	uint srvfail;
+};
+
+struct top {
+	int dnsfd; /* listening sockets for local clients */
+	int tcpfd;
+	int ctlfd;
+
+	uint64_t now; /* ms, CLOCK_BOOTTIME */
+
+	int nconn;
+	struct conn conns[NCONNS];
+	struct tcpc tcps[NTCPS];
+	struct serv servs[NSERVS];
+
+	int npend;
+	struct pend pends[NPEND];
+
+	struct stats stats;
+
+	int avail;
+	byte rand[64];
+
+	struct cent* cache;
+};
+
+#define CTX struct top* ctx __attribute__((unused))
+#define CN struct conn* cn __attribute__((unused))
+#define MSG struct ucattr* msg __attribute__((unused))
+
+void check_client(CTX, CN);
+void clear_client(CTX, CN);
+
+void accept_tcp(CTX);
+void check_tcp(CTX, int i);
+void close_tcp(CTX, int i);
+void reply_tcp(CTX, int i, byte* buf, int len);
+
+void check_query(CTX);
+void handle_query(CTX, struct waiter* wt, byte* buf, int len);
+void drop_waiters(CTX, int tcp);
+void check_upstream(CTX, struct pend* pd);
+void check_timeouts(CTX);
+int next_timeout(CTX);
+void drop_pending(CTX);
+
+uint question_hash(byte* q, uint qlen);
+int question_match(byte* a, byte* b, uint qlen);
+int question_length(byte* buf, uint len);
+int strip_opt(byte* buf, uint len);
+
+struct cent* cache_lookup(CTX, byte* q, uint qlen, uint hash);
+void cache_store(CTX, byte* buf, uint len, uint qlen, uint hash);
+int cache_reply(CTX, struct cent* ce, byte* buf);
+void cache_flush(CTX);
+int cache_count(CTX);
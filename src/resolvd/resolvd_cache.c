@@ -0,0 +1,375 @@
+#include <string.h>
+#include <endian.h>
+#include <util.h>
+
+#include "dns.h"
+#include "resolvd.h"
+
+/* Cached entries are complete upstream replies, stored as received.
+   Serving one means patching in the client's query id and reducing
+   record TTLs by the time the entry has spent in the cache.
+
+   The cache is keyed by the question section (name, type, class),
+   with names compared case-insensitively. Each key has NPROBE slots
+   it may occupy, starting from the one picked by its hash; when all
+   of them are taken, the least recently used one gets evicted. */
+
+static int lower(int c)
+{
+	return (c >= 'A' && c <= 'Z') ? c + 'a' - 'A' : c;
+}
+
+/* Label length bytes are at most 63, so lowercasing them is harmless
+   and names can be treated as plain byte strings here. The last four
+   bytes, type and class, are compared as is. */
+
+uint question_hash(byte* q, uint qlen)
+{
+	uint i, h = 2166136261U;
+
+	for(i = 0; i < qlen - 4; i++)
+		h = (h ^ lower(q[i])) * 16777619U;
+	for(; i < qlen; i++)
+		h = (h ^ q[i]) * 16777619U;
+
+	return h;
+}
+
+int question_match(byte* a, byte* b, uint qlen)
+{
+	uint i;
+
+	for(i = 0; i < qlen - 4; i++)
+		if(lower(a[i]) != lower(b[i]))
+			return 0;
+
+	return !memcmp(a + i, b + i, 4);
+}
+
+/* Questions are not supposed to use name compression, so only plain
+   labels are accepted. Returns the length of the question section
+   starting at buf, including type and class. */
+
+int question_length(byte* buf, uint len)
+{
+	uint ptr = 0;
+
+	while(ptr < len) {
+		uint tag = buf[ptr];
+
+		if(!tag)
+			break;
+		if(tag > 63)
+			return 0;
+
+		ptr += tag + 1;
+	}
+
+	if(ptr >= len || ptr > 255)
+		return 0;
+
+	ptr += 1 + 4;
+
+	if(ptr > len)
+		return 0;
+
+	return ptr;
+}
+
+static uint skip_name(byte* data, uint len, uint ptr)
+{
+	while(ptr < len) {
+		uint tag = data[ptr];
+
+		if(!tag)
+			return ptr + 1;
+
+		int type = (tag >> 6) & 3;
+
+		if(type == 3) /* reference */
+			return ptr + 2;
+		else if(!type) /* string */
+			ptr += tag + 1;
+		else
+			return 0; /* reserved */
+	}
+
+	return 0;
+}
+
+typedef void (*rrfn)(struct dnsres* dr, int sect, void* arg);
+
+/* Calls fn for each resource record past the question section,
+   sect being 1 for answers, 2 for authority and 3 for additional
+   records. Returns -1 if the packet is malformed. */
+
+static int walk_records(byte* data, uint len, rrfn fn, void* arg)
+{
+	struct dnshdr* dh = (struct dnshdr*)data;
+	uint counts[4] = {
+		ntohs(dh->qdcount),
+		ntohs(dh->ancount),
+		ntohs(dh->nscount),
+		ntohs(dh->arcount)
+	};
+	uint ptr = HDRLEN;
+	uint i, s;
+
+	for(i = 0; i < counts[0]; i++) {
+		if(!(ptr = skip_name(data, len, ptr)))
+			return -1;
+		if((ptr += 4) > len)
+			return -1;
+	}
+
+	for(s = 1; s < 4; s++) {
+		for(i = 0; i < counts[s]; i++) {
+			if(!(ptr = skip_name(data, len, ptr)))
+				return -1;
+			if(ptr + sizeof(struct dnsres) > len)
+				return -1;
+
+			struct dnsres* dr = (struct dnsres*)(data + ptr);
+
+			ptr += sizeof(*dr) + ntohs(dr->length);
+
+			if(ptr > len)
+				return -1;
+
+			fn(dr, s, arg);
+		}
+	}
+
+	return 0;
+}
+
+struct ttlscan {
+	int rcode;
+	uint ttl;
+};
+
+static void min_ttl(struct ttlscan* ts, uint ttl)
+{
+	if(ttl < ts->ttl)
+		ts->ttl = ttl;
+}
+
+/* RFC 2308: negative answers are cached for the lesser of the SOA
+   record TTL and its MINIMUM field, the last 32 bits of the data. */
+
+static void scan_ttl(struct dnsres* dr, int sect, void* arg)
+{
+	struct ttlscan* ts = arg;
+	uint type = ntohs(dr->type);
+	uint dlen = ntohs(dr->length);
+
+	if(ts->rcode == DNSF_RC_SUCCESS) {
+		if(sect == 1)
+			min_ttl(ts, ntohl(dr->ttl));
+	} else if(sect == 2) {
+		if(type != DNS_TYPE_SOA || dlen < 20)
+			return;
+
+		uint minimum;
+		memcpy(&minimum, dr->data + dlen - 4, 4);
+
+		min_ttl(ts, ntohl(dr->ttl));
+		min_ttl(ts, ntohl(minimum));
+	}
+}
+
+static void age_ttl(struct dnsres* dr, int sect, void* arg)
+{
+	uint elapsed = *((uint*)arg);
+	uint ttl = ntohl(dr->ttl);
+
+	if(ntohs(dr->type) == DNS_TYPE_OPT)
+		return;
+
+	ttl = ttl > elapsed ? ttl - elapsed : 0;
+
+	dr->ttl = htonl(ttl);
+}
+
+struct optscan {
+	byte* start;
+	byte* end;
+};
+
+static void find_opt(struct dnsres* dr, int sect, void* arg)
+{
+	struct optscan* os = arg;
+	byte* rec = (byte*)dr;
+
+	if(sect != 3 || os->start)
+		return;
+	if(ntohs(dr->type) != DNS_TYPE_OPT)
+		return;
+
+	os->start = rec - 1; /* root name */
+	os->end = rec + sizeof(*dr) + ntohs(dr->length);
+}
+
+/* Removes the OPT record from an upstream reply. Its name is always
+   the root, so no other names in the packet may be pointing into it.
+   Returns the new length of the packet. */
+
+int strip_opt(byte* buf, uint len)
+{
+	struct dnshdr* dh = (struct dnshdr*)buf;
+	struct optscan os = { NULL, NULL };
+	byte* end = buf + len;
+
+	if(walk_records(buf, len, find_opt, &os) < 0)
+		return len;
+	if(!os.start || *os.start)
+		return len;
+
+	memmove(os.start, os.end, end - os.end);
+
+	dh->arcount = htons(ntohs(dh->arcount) - 1);
+
+	return len - (os.end - os.start);
+}
+
+static struct cent* first_slot(CTX, uint hash)
+{
+	return &ctx->cache[hash % (NCACHE - NPROBE)];
+}
+
+struct cent* cache_lookup(CTX, byte* q, uint qlen, uint hash)
+{
+	struct cent* ce = first_slot(ctx, hash);
+	struct cent* ee = ce + NPROBE;
+
+	for(; ce < ee; ce++) {
+		if(!ce->len)
+			continue;
+		if(ce->hash != hash || ce->qlen != qlen)
+			continue;
+		if(!question_match(ce->data + HDRLEN, q, qlen))
+			continue;
+
+		if(ce->expires <= ctx->now) {
+			ce->len = 0;
+			return NULL;
+		}
+
+		ce->used = ctx->now;
+
+		return ce;
+	}
+
+	return NULL;
+}
+
+static struct cent* grab_slot(CTX, byte* q, uint qlen, uint hash)
+{
+	struct cent* ce = first_slot(ctx, hash);
+	struct cent* ee = ce + NPROBE;
+	struct cent* lru = ce;
+
+	for(; ce < ee; ce++) {
+		if(!ce->len)
+			return ce;
+		if(ce->expires <= ctx->now)
+			return ce;
+		if(ce->hash == hash && ce->qlen == qlen)
+			if(question_match(ce->data + HDRLEN, q, qlen))
+				return ce;
+		if(ce->used < lru->used)
+			lru = ce;
+	}
+
+	return lru;
+}
+
+/* Only complete replies get cached. Truncated ones would make the
+   client retry over TCP, and server errors are likely transient. */
+
+void cache_store(CTX, byte* buf, uint len, uint qlen, uint hash)
+{
+	struct dnshdr* dh = (struct dnshdr*)buf;
+	uint flags = ntohs(dh->flags);
+	int rcode = flags & DNSF_RC;
+	struct ttlscan ts;
+	struct cent* ce;
+	uint max, cf;
+
+	if(len > MAXPKT || (flags & DNSF_TC))
+		return;
+
+	if(rcode == DNSF_RC_NAME) {
+		max = NEGTTL;
+		cf = CF_NEG;
+	} else if(rcode != DNSF_RC_SUCCESS) {
+		return;
+	} else if(!dh->ancount) {
+		max = NEGTTL;
+		cf = CF_NEG;
+		rcode = DNSF_RC_NAME; /* NODATA, same rules */
+	} else {
+		max = MAXTTL;
+		cf = 0;
+	}
+
+	ts.rcode = rcode;
+	ts.ttl = ~0U;
+
+	if(walk_records(buf, len, scan_ttl, &ts) < 0)
+		return;
+	if(ts.ttl == ~0U) /* no SOA for a negative reply */
+		return;
+	if(!ts.ttl)
+		return;
+	if(ts.ttl > max)
+		ts.ttl = max;
+
+	ce = grab_slot(ctx, buf + HDRLEN, qlen, hash);
+
+	ce->len = len;
+	ce->qlen = qlen;
+	ce->hash = hash;
+	ce->flags = cf;
+	ce->stored = ctx->now;
+	ce->expires = ctx->now + 1000*(uint64_t)ts.ttl;
+	ce->used = ctx->now;
+
+	memcpy(ce->data, buf, len);
+}
+
+/* Fills buf with the cached reply, except for the query id
+   which is left for the caller to set. */
+
+int cache_reply(CTX, struct cent* ce, byte* buf)
+{
+	uint len = ce->len;
+	uint elapsed = (ctx->now - ce->stored) / 1000;
+
+	memcpy(buf, ce->data, len);
+
+	if(elapsed)
+		walk_records(buf, len, age_ttl, &elapsed);
+
+	return len;
+}
+
+void cache_flush(CTX)
+{
+	struct cent* ce;
+
+	for(ce = ctx->cache; ce < ctx->cache + NCACHE; ce++)
+		ce->len = 0;
+}
+
+int cache_count(CTX)
+{
+	struct cent* ce;
+	int count = 0;
+
+	for(ce = ctx->cache; ce < ctx->cache + NCACHE; ce++)
+		if(ce->len && ce->expires > ctx->now)
+			count++;
+
+	return count;
+}
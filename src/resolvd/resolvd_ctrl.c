@@ -0,0 +1,197 @@
+#include <sys/socket.h>
+
+#include <nlusctl.h>
+#include <string.h>
+#include <util.h>
+
+#include "resolvd.h"
+
+#define UC struct ucbuf* uc
+#define REPLIED 1
+
+typedef struct ucattr* attr;
+
+static int send_reply(CTX, struct conn* cn, struct ucbuf* uc)
+{
+	int ret, fd = cn->fd;
+
+	if((ret = uc_send(fd, uc)) != -EAGAIN)
+		return ret;
+	if((ret = uc_wait_writable(fd)) < 0)
+		return ret;
+
+	if((ret = uc_send(fd, uc)) > 0)
+		return ret;
+
+	clear_client(ctx, cn);
+
+	return REPLIED;
+}
+
+static int reply(CTX, struct conn* cn, int err)
+{
+	char cbuf[16];
+	struct ucbuf uc;
+
+	uc_buf_set(&uc, cbuf, sizeof(cbuf));
+	uc_put_hdr(&uc, err);
+
+	return send_reply(ctx, cn, &uc);
+}
+
+static void put_servers(CTX, UC)
+{
+	struct serv* sv;
+
+	for(sv = ctx->servs; sv < ARRAY_END(ctx->servs); sv++) {
+		if(!(sv->flags & SF_SET))
+			continue;
+
+		attr at = uc_put_nest(uc, ATTR_SERVER);
+		uc_put_bin(uc, ATTR_ADDR, sv->addr, 4);
+		uc_put_int(uc, ATTR_PORT, sv->port);
+		uc_put_int(uc, ATTR_SENT, sv->sent);
+		uc_put_int(uc, ATTR_WON, sv->won);
+		uc_put_int(uc, ATTR_FAILED, sv->failed);
+		uc_end_nest(uc, at);
+	}
+}
+
+static void put_stats(CTX, UC)
+{
+	struct stats* st = &ctx->stats;
+
+	uc_put_int(uc, ATTR_QUERIES,  st->queries);
+	uc_put_int(uc, ATTR_HITS,     st->hits);
+	uc_put_int(uc, ATTR_NEGHITS,  st->neghits);
+	uc_put_int(uc, ATTR_MISSES,   st->misses);
+	uc_put_int(uc, ATTR_JOINED,   st->joined);
+	uc_put_int(uc, ATTR_UPSTREAM, st->upstream);
+	uc_put_int(uc, ATTR_TIMEOUTS, st->timeouts);
+	uc_put_int(uc, ATTR_SRVFAIL,  st->srvfail);
+	uc_put_int(uc, ATTR_CACHED,   cache_count(ctx));
+	uc_put_int(uc, ATTR_PENDING,  ctx->npend);
+}
+
+static int cmd_status(CTX, CN, MSG)
+{
+	char cbuf[512];
+	struct ucbuf uc;
+
+	uc_buf_set(&uc, cbuf, sizeof(cbuf));
+	uc_put_hdr(&uc, REP_STATUS);
+
+	put_stats(ctx, &uc);
+	put_servers(ctx, &uc);
+
+	return send_reply(ctx, cn, &uc);
+}
+
+static int check_server(attr srv, struct serv* sv)
+{
+	attr addr = uc_get(srv, ATTR_ADDR);
+	int* pptr = uc_get_int(srv, ATTR_PORT);
+
+	if(!addr || !pptr)
+		return -EINVAL;
+	if(uc_paylen(addr) != 4)
+		return -EINVAL;
+	if(*pptr <= 0 || *pptr > 0xFFFF)
+		return -EINVAL;
+
+	memzero(sv, sizeof(*sv));
+
+	sv->flags = SF_SET;
+	sv->port = *pptr;
+	memcpy(sv->addr, uc_payload(addr), 4);
+
+	return 0;
+}
+
+/* The list gets replaced as a whole, which is what dhconf scripts
+   need: each lease comes with a complete set of servers. */
+
+static int cmd_server(CTX, CN, MSG)
+{
+	struct serv servs[NSERVS];
+	int ret, n = 0;
+	attr at;
+
+	memzero(servs, sizeof(servs));
+
+	for(at = uc_get_0(msg); at; at = uc_get_n(msg, at)) {
+		if(!uc_is_keyed(at, ATTR_SERVER))
+			continue;
+		if(n >= NSERVS)
+			return -E2BIG;
+		if((ret = check_server(at, &servs[n++])) < 0)
+			return ret;
+	}
+
+	drop_pending(ctx);
+
+	memcpy(ctx->servs, servs, sizeof(servs));
+
+	return 0;
+}
+
+static int cmd_flush(CTX, CN, MSG)
+{
+	cache_flush(ctx);
+
+	return 0;
+}
+
+static int cmd_reset(CTX, CN, MSG)
+{
+	drop_pending(ctx);
+	cache_flush(ctx);
+
+	memzero(ctx->servs, sizeof(ctx->servs));
+	memzero(&ctx->stats, sizeof(ctx->stats));
+
+	return 0;
+}
+
+static const struct cmd {
+	int cmd;
+	int (*call)(CTX, CN, MSG);
+} commands[] = {
+	{ CMD_STATUS,  cmd_status  },
+	{ CMD_SERVER,  cmd_server  },
+	{ CMD_FLUSH,   cmd_flush   },
+	{ CMD_RESET,   cmd_reset   }
+};
+
+static int dispatch_cmd(CTX, CN, MSG)
+{
+	const struct cmd* cd;
+	int cmd = uc_repcode(msg);
+	int ret;
+
+	for(cd = commands; cd < ARRAY_END(commands); cd++)
+		if(cd->cmd == cmd)
+			break;
+	if(cd >= ARRAY_END(commands))
+		ret = reply(ctx, cn, -ENOSYS);
+	else if((ret = cd->call(ctx, cn, msg)) <= 0)
+		ret = reply(ctx, cn, ret);
+
+	return ret;
+}
+
+void check_client(CTX, CN)
+{
+	int ret, fd = cn->fd;
+	struct ucattr* msg;
+	char buf[200];
+
+	if((ret = uc_recv(fd, buf, sizeof(buf))) < 0)
+		goto err;
+	if(!(msg = uc_msg(buf, ret)))
+		goto err;
+	if((ret = dispatch_cmd(ctx, cn, msg)) >= 0)
+		return;
+err:
+	sys_shutdown(fd, SHUT_RDWR);
+}
@@ -0,0 +1,604 @@
+#include <bits/socket/inet.h>
+
+#include <sys/file.h>
+#include <sys/socket.h>
+#include <sys/random.h>
+
+#include <string.h>
+#include <endian.h>
+#include <util.h>
+
+#include "dns.h"
+#include "resolvd.h"
+
+/* Queries from local clients that miss the cache get forwarded to all
+   configured upstream servers at once, and the first usable reply wins.
+   Identical queries arriving while the upstream one is in flight get
+   attached to it as waiters instead of being sent again.
+
+   Upstream queries are always re-built here, with an EDNS record asking
+   for replies up to MAXPKT bytes, so that large answers come back whole
+   and can be cached. The OPT record is stripped from the replies since
+   it describes the upstream server, not this one. Clients get replies
+   up to the size they can take, 512 bytes or the EDNS size in their
+   query, and truncated ones above that, which makes them retry over TCP
+   (see resolvd_tcp.c).
+
+   Servers that reply with SERVFAIL or REFUSED are dropped from the race
+   for that query; the query fails once all of them have, or when the
+   retries run out.
+
+   Every upstream query gets a socket of its own, bound to a port the
+   kernel picks at random, and the socket is closed once the query is
+   done. Together with the random id, this leaves an off-path attacker
+   trying to spoof a reply some 32 bits to guess instead of 16. Replies
+   are only accepted from the servers the query has been sent to. */
+
+static byte rxbuf[MAXPKT];
+static byte txbuf[MAXPKT];
+
+static ushort random_id(CTX)
+{
+	ushort id;
+	int ret;
+
+	if(ctx->avail < 2) {
+		if((ret = sys_getrandom(ctx->rand, sizeof(ctx->rand), 0)) < 2)
+			fail("getrandom", NULL, ret);
+
+		ctx->avail = ret;
+	}
+
+	ctx->avail -= 2;
+
+	memcpy(&id, ctx->rand + ctx->avail, 2);
+
+	return id;
+}
+
+static void send_to(int fd, void* buf, int len, byte ip[4], int port)
+{
+	struct sockaddr_in to = {
+		.family = AF_INET,
+		.port = port
+	};
+
+	memcpy(to.addr, ip, 4);
+
+	sys_sendto(fd, buf, len, 0, &to, sizeof(to));
+}
+
+static void send_reply(CTX, struct waiter* wt, byte* buf, int len)
+{
+	if(wt->tcp)
+		reply_tcp(ctx, wt->tcp - 1, buf, len);
+	else
+		send_to(ctx->dnsfd, buf, len, wt->addr, wt->port);
+}
+
+/* The same buffer may go to several waiters with different limits,
+   so truncated replies are made in a copy. */
+
+static void send_truncated(CTX, struct waiter* wt, byte* buf, int len)
+{
+	byte tmp[HDRLEN + MAXQST];
+	struct dnshdr* dh = (struct dnshdr*)tmp;
+	int qlen = question_length(buf + HDRLEN, len - HDRLEN);
+
+	memcpy(tmp, buf, HDRLEN + qlen);
+
+	dh->flags |= htons(DNSF_TC);
+	dh->qdcount = htons(qlen ? 1 : 0);
+	dh->ancount = 0;
+	dh->nscount = 0;
+	dh->arcount = 0;
+
+	send_reply(ctx, wt, tmp, HDRLEN + qlen);
+}
+
+static void reply_to(CTX, struct waiter* wt, byte* buf, int len)
+{
+	struct dnshdr* dh = (struct dnshdr*)buf;
+
+	dh->id = wt->id;
+
+	if(len > wt->max)
+		send_truncated(ctx, wt, buf, len);
+	else
+		send_reply(ctx, wt, buf, len);
+}
+
+/* Error replies echo the client's question (if there is a usable one)
+   with the rcode set, and nothing else. */
+
+static void reply_error(CTX, struct waiter* wt, byte* q, int qlen, int rcode)
+{
+	struct dnshdr* dh = (struct dnshdr*)txbuf;
+	uint flags = DNSF_QR | DNSF_RD | DNSF_RA | rcode;
+
+	memzero(dh, sizeof(*dh));
+
+	dh->flags = htons(flags);
+
+	if(qlen > 0) {
+		memcpy(txbuf + HDRLEN, q, qlen);
+		dh->qdcount = htons(1);
+	}
+
+	reply_to(ctx, wt, txbuf, HDRLEN + qlen);
+}
+
+static int upstream_socket(void)
+{
+	int fd, ret;
+	int flags = SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC;
+	struct sockaddr_in addr = {
+		.family = AF_INET,
+		.port = 0
+	};
+
+	if((fd = sys_socket(AF_INET, flags, IPPROTO_UDP)) < 0)
+		return fd;
+	if((ret = sys_bind(fd, &addr, sizeof(addr))) < 0) {
+		sys_close(fd);
+		return ret;
+	}
+
+	return fd;
+}
+
+static void free_pending(CTX, struct pend* pd)
+{
+	sys_close(pd->fd);
+
+	pd->fd = -1;
+	pd->qlen = 0;
+	ctx->npend--;
+}
+
+static void fail_pending(CTX, struct pend* pd, int rcode)
+{
+	byte* q = pd->packet + HDRLEN;
+	int i, n = pd->nwait;
+
+	for(i = 0; i < n; i++)
+		reply_error(ctx, &pd->waits[i], q, pd->qlen, rcode);
+
+	free_pending(ctx, pd);
+}
+
+static void answer_pending(CTX, struct pend* pd, byte* buf, int len)
+{
+	int i, n = pd->nwait;
+
+	for(i = 0; i < n; i++)
+		reply_to(ctx, &pd->waits[i], buf, len);
+
+	free_pending(ctx, pd);
+}
+
+static void send_upstream(CTX, struct pend* pd)
+{
+	struct serv* sv;
+	int i = 0;
+
+	for(sv = ctx->servs; sv < ARRAY_END(ctx->servs); sv++, i++) {
+		if(!(sv->flags & SF_SET))
+			continue;
+		if(pd->failed & (1 << i))
+			continue;
+
+		send_to(pd->fd, pd->packet, pd->plen, sv->addr, htons(sv->port));
+
+		pd->sent |= (1 << i);
+		sv->sent++;
+		ctx->stats.upstream++;
+	}
+
+	pd->tries++;
+	pd->deadline = ctx->now + RETRY_MS*pd->tries;
+}
+
+static int got_servers(CTX)
+{
+	struct serv* sv;
+
+	for(sv = ctx->servs; sv < ARRAY_END(ctx->servs); sv++)
+		if(sv->flags & SF_SET)
+			return 1;
+
+	return 0;
+}
+
+static struct pend* find_pending(CTX, byte* q, uint qlen, uint hash)
+{
+	struct pend* pd;
+
+	if(!ctx->npend)
+		return NULL;
+
+	for(pd = ctx->pends; pd < ARRAY_END(ctx->pends); pd++) {
+		if(pd->qlen != qlen || pd->hash != hash)
+			continue;
+		if(!question_match(pd->packet + HDRLEN, q, qlen))
+			continue;
+
+		return pd;
+	}
+
+	return NULL;
+}
+
+static struct pend* grab_pending(CTX)
+{
+	struct pend* pd;
+
+	for(pd = ctx->pends; pd < ARRAY_END(ctx->pends); pd++)
+		if(!pd->qlen)
+			return pd;
+
+	return NULL;
+}
+
+static void add_opt_record(byte* p)
+{
+	struct dnsres* dr = (struct dnsres*)(p + 1);
+
+	p[0] = 0; /* root name */
+
+	dr->type = htons(DNS_TYPE_OPT);
+	dr->class = htons(MAXPKT);
+	dr->ttl = 0;
+	dr->length = 0;
+}
+
+static void start_pending(CTX, struct waiter* wt, byte* q, uint qlen, uint hash)
+{
+	struct pend* pd;
+	struct dnshdr* dh;
+	int fd;
+
+	if(!got_servers(ctx) || !(pd = grab_pending(ctx)))
+		goto fail;
+	if((fd = upstream_socket()) < 0)
+		goto fail;
+
+	memzero(pd, sizeof(*pd) - sizeof(pd->packet));
+
+	pd->fd = fd;
+
+	dh = (struct dnshdr*)pd->packet;
+	memzero(dh, sizeof(*dh));
+
+	dh->id = random_id(ctx);
+	dh->flags = htons(DNSF_RD);
+	dh->qdcount = htons(1);
+
+	memcpy(pd->packet + HDRLEN, q, qlen);
+
+	add_opt_record(pd->packet + HDRLEN + qlen);
+	dh->arcount = htons(1);
+
+	pd->qlen = qlen;
+	pd->plen = HDRLEN + qlen + OPTLEN;
+	pd->hash = hash;
+	pd->waits[0] = *wt;
+	pd->nwait = 1;
+
+	ctx->npend++;
+
+	send_upstream(ctx, pd);
+
+	return;
+fail:
+	ctx->stats.srvfail++;
+	reply_error(ctx, wt, q, qlen, DNSF_RC_SERVER);
+}
+
+static void join_pending(CTX, struct pend* pd, struct waiter* wt)
+{
+	byte* q = pd->packet + HDRLEN;
+	int i, n = pd->nwait;
+
+	for(i = 0; i < n; i++) {
+		struct waiter* pw = &pd->waits[i];
+
+		if(pw->id != wt->id || pw->port != wt->port)
+			continue;
+		if(memcmp(pw->addr, wt->addr, 4))
+			continue;
+
+		return; /* client re-sending its query */
+	}
+
+	if(n >= NWAIT) {
+		ctx->stats.srvfail++;
+		return reply_error(ctx, wt, q, pd->qlen, DNSF_RC_SERVER);
+	}
+
+	pd->waits[n] = *wt;
+	pd->nwait = n + 1;
+
+	ctx->stats.joined++;
+}
+
+/* Replies for TCP clients that are gone must not end up in whatever
+   connection gets their slot next. The query itself keeps going, its
+   reply will be cached. */
+
+void drop_waiters(CTX, int tcp)
+{
+	struct pend* pd;
+	int i, j;
+
+	for(pd = ctx->pends; pd < ARRAY_END(ctx->pends); pd++) {
+		if(!pd->qlen)
+			continue;
+
+		for(i = j = 0; i < pd->nwait; i++)
+			if(pd->waits[i].tcp != tcp)
+				pd->waits[j++] = pd->waits[i];
+
+		pd->nwait = j;
+	}
+}
+
+static void reply_cached(CTX, struct waiter* wt, struct cent* ce)
+{
+	int len = cache_reply(ctx, ce, txbuf);
+
+	if(ce->flags & CF_NEG)
+		ctx->stats.neghits++;
+	else
+		ctx->stats.hits++;
+
+	reply_to(ctx, wt, txbuf, len);
+}
+
+/* RFC 6891: the OPT record in the client's query carries the size
+   of the largest UDP reply it can take. Anything it may have added
+   after the OPT record is ignored. */
+
+static int client_limit(byte* buf, int len, int qlen)
+{
+	struct dnshdr* dh = (struct dnshdr*)buf;
+	byte* p = buf + HDRLEN + qlen;
+	struct dnsres* dr = (struct dnsres*)(p + 1);
+	int size;
+
+	if(!dh->arcount || len < HDRLEN + qlen + OPTLEN)
+		return MAXUDP;
+	if(p[0] || ntohs(dr->type) != DNS_TYPE_OPT)
+		return MAXUDP;
+
+	if((size = ntohs(dr->class)) < MAXUDP)
+		return MAXUDP;
+	if(size > MAXPKT)
+		return MAXPKT;
+
+	return size;
+}
+
+void handle_query(CTX, struct waiter* wt, byte* buf, int len)
+{
+	struct dnshdr* dh = (struct dnshdr*)buf;
+	uint flags = ntohs(dh->flags);
+	byte* q = buf + HDRLEN;
+	int qlen = question_length(q, len - HDRLEN);
+	struct cent* ce;
+	struct pend* pd;
+	uint hash;
+
+	wt->id = dh->id;
+
+	if(flags & DNSF_QR)
+		return;
+
+	ctx->stats.queries++;
+
+	if((flags & DNSF_OP) != DNSF_OP_QUERY)
+		return reply_error(ctx, wt, q, qlen, DNSF_RC_NOTIMPL);
+	if(ntohs(dh->qdcount) != 1 || !qlen)
+		return reply_error(ctx, wt, NULL, 0, DNSF_RC_FORMAT);
+
+	if(!wt->tcp)
+		wt->max = client_limit(buf, len, qlen);
+
+	hash = question_hash(q, qlen);
+
+	if((ce = cache_lookup(ctx, q, qlen, hash)))
+		return reply_cached(ctx, wt, ce);
+
+	ctx->stats.misses++;
+
+	if((pd = find_pending(ctx, q, qlen, hash)))
+		return join_pending(ctx, pd, wt);
+
+	start_pending(ctx, wt, q, qlen, hash);
+}
+
+void check_query(CTX)
+{
+	int fd = ctx->dnsfd;
+	struct sockaddr_in from;
+	int fromlen;
+	struct waiter wt;
+	int ret;
+
+	while(1) {
+		fromlen = sizeof(from);
+
+		ret = sys_recvfrom(fd, rxbuf, sizeof(rxbuf), 0, &from, &fromlen);
+
+		if(ret == -EAGAIN)
+			break;
+		if(ret < 0)
+			fail("recv", NULL, ret);
+		if(ret < HDRLEN)
+			continue;
+		if(from.family != AF_INET)
+			continue;
+
+		memcpy(wt.addr, from.addr, 4);
+		wt.port = from.port;
+		wt.max = MAXUDP;
+		wt.tcp = 0;
+
+		handle_query(ctx, &wt, rxbuf, ret);
+	}
+}
+
+static int find_server(CTX, struct pend* pd, struct sockaddr_in* from)
+{
+	struct serv* sv;
+	int i = 0;
+
+	for(sv = ctx->servs; sv < ARRAY_END(ctx->servs); sv++, i++) {
+		if(!(sv->flags & SF_SET))
+			continue;
+		if(!(pd->sent & (1 << i)))
+			continue;
+		if(htons(sv->port) != from->port)
+			continue;
+		if(memcmp(sv->addr, from->addr, 4))
+			continue;
+
+		return i;
+	}
+
+	return -1;
+}
+
+static int match_reply(struct pend* pd, byte* buf, int len)
+{
+	struct dnshdr* dh = (struct dnshdr*)buf;
+	struct dnshdr* ph = (struct dnshdr*)pd->packet;
+	int qlen;
+
+	if(!(ntohs(dh->flags) & DNSF_QR))
+		return 0;
+	if(ntohs(dh->qdcount) != 1)
+		return 0;
+	if(!(qlen = question_length(buf + HDRLEN, len - HDRLEN)))
+		return 0;
+	if(pd->qlen != qlen || ph->id != dh->id)
+		return 0;
+
+	return question_match(pd->packet + HDRLEN, buf + HDRLEN, qlen);
+}
+
+static int all_failed(CTX, struct pend* pd)
+{
+	int i;
+
+	for(i = 0; i < NSERVS; i++)
+		if(ctx->servs[i].flags & SF_SET)
+			if(!(pd->failed & (1 << i)))
+				return 0;
+
+	return 1;
+}
+
+static void handle_reply(CTX, struct pend* pd, int si, byte* buf, int len)
+{
+	struct dnshdr* dh = (struct dnshdr*)buf;
+	int rcode = ntohs(dh->flags) & DNSF_RC;
+	struct serv* sv = &ctx->servs[si];
+
+	if(!match_reply(pd, buf, len))
+		return;
+
+	if(rcode == DNSF_RC_SERVER || rcode == DNSF_RC_REFUSED) {
+		sv->failed++;
+		pd->failed |= (1 << si);
+
+		if(!all_failed(ctx, pd))
+			return;
+
+		ctx->stats.srvfail++;
+
+		return fail_pending(ctx, pd, rcode);
+	}
+
+	sv->won++;
+
+	len = strip_opt(buf, len);
+
+	cache_store(ctx, buf, len, pd->qlen, pd->hash);
+
+	answer_pending(ctx, pd, buf, len);
+}
+
+void check_upstream(CTX, struct pend* pd)
+{
+	int fd = pd->fd;
+	struct sockaddr_in from;
+	int fromlen;
+	int ret, si;
+
+	while(pd->qlen) {
+		fromlen = sizeof(from);
+
+		ret = sys_recvfrom(fd, rxbuf, sizeof(rxbuf), 0, &from, &fromlen);
+
+		if(ret < 0)
+			break; /* EAGAIN, or an error affecting this query only */
+		if(ret < HDRLEN)
+			continue;
+		if((si = find_server(ctx, pd, &from)) < 0)
+			continue;
+
+		handle_reply(ctx, pd, si, rxbuf, ret);
+	}
+}
+
+int next_timeout(CTX)
+{
+	struct pend* pd;
+	uint64_t min = 0;
+
+	if(!ctx->npend)
+		return -1;
+
+	for(pd = ctx->pends; pd < ARRAY_END(ctx->pends); pd++)
+		if(pd->qlen && (!min || pd->deadline < min))
+			min = pd->deadline;
+
+	if(min <= ctx->now)
+		return 0;
+
+	return min - ctx->now;
+}
+
+void check_timeouts(CTX)
+{
+	struct pend* pd;
+
+	if(!ctx->npend)
+		return;
+
+	for(pd = ctx->pends; pd < ARRAY_END(ctx->pends); pd++) {
+		if(!pd->qlen || pd->deadline > ctx->now)
+			continue;
+
+		if(pd->tries < NTRIES) {
+			send_upstream(ctx, pd);
+		} else {
+			ctx->stats.timeouts++;
+			fail_pending(ctx, pd, DNSF_RC_SERVER);
+		}
+	}
+}
+
+/* Server list changes invalidate the failure masks, and there might be
+   no servers left to retry with. Waiting clients will re-send their
+   queries if they still need them. */
+
+void drop_pending(CTX)
+{
+	struct pend* pd;
+
+	for(pd = ctx->pends; pd < ARRAY_END(ctx->pends); pd++)
+		if(pd->qlen)
+			free_pending(ctx, pd);
+}
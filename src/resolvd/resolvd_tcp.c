@@ -0,0 +1,116 @@
+#include <sys/file.h>
+#include <sys/iovec.h>
+#include <sys/socket.h>
+
+#include <string.h>
+#include <util.h>
+
+#include "resolvd.h"
+
+/* DNS over TCP, for clients re-trying queries that got truncated UDP
+   replies. Messages are prefixed with their 16-bit length. Queries are
+   handled one at a time as they come in, and go through the same path
+   as the UDP ones. Replies are small enough for a local socket buffer,
+   so they are written right away, and a connection that cannot take
+   one gets shut down.
+
+   Connections are only closed from the poll loop, since there may be
+   pending queries iterating over their waiters at the time a reply
+   fails to go through. */
+
+void accept_tcp(CTX)
+{
+	int fd, sfd = ctx->tcpfd;
+	int flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+	struct tcpc* tc;
+
+	while((fd = sys_accept4(sfd, NULL, NULL, flags)) > 0) {
+		for(tc = ctx->tcps; tc < ARRAY_END(ctx->tcps); tc++)
+			if(tc->fd <= 0)
+				break;
+
+		if(tc >= ARRAY_END(ctx->tcps)) {
+			sys_close(fd);
+			continue;
+		}
+
+		tc->fd = fd;
+		tc->have = 0;
+	}
+}
+
+void close_tcp(CTX, int i)
+{
+	struct tcpc* tc = &ctx->tcps[i];
+
+	sys_close(tc->fd);
+
+	tc->fd = -1;
+	tc->have = 0;
+
+	drop_waiters(ctx, i + 1);
+}
+
+void reply_tcp(CTX, int i, byte* buf, int len)
+{
+	struct tcpc* tc = &ctx->tcps[i];
+	byte pref[2] = { len >> 8, len };
+	struct iovec iov[2] = {
+		{ .base = pref, .len = 2 },
+		{ .base = buf, .len = len }
+	};
+	int ret;
+
+	if(tc->fd <= 0)
+		return;
+	if((ret = sys_writev(tc->fd, iov, 2)) == 2 + len)
+		return;
+
+	sys_shutdown(tc->fd, SHUT_RDWR);
+}
+
+static void handle_message(CTX, int i, byte* buf, int len)
+{
+	struct waiter wt;
+
+	memzero(&wt, sizeof(wt));
+
+	wt.max = MAXPKT;
+	wt.tcp = i + 1;
+
+	handle_query(ctx, &wt, buf, len);
+}
+
+void check_tcp(CTX, int i)
+{
+	struct tcpc* tc = &ctx->tcps[i];
+	byte* buf = tc->buf;
+	int rd, len;
+
+	rd = sys_read(tc->fd, buf + tc->have, sizeof(tc->buf) - tc->have);
+
+	if(rd == -EAGAIN)
+		return;
+	if(rd <= 0)
+		goto out;
+
+	tc->have += rd;
+
+	while(tc->have >= 2) {
+		len = (buf[0] << 8) | buf[1];
+
+		if(len < HDRLEN || len > MAXQRY)
+			goto out;
+		if(tc->have < 2 + len)
+			break;
+
+		handle_message(ctx, i, buf + 2, len);
+
+		tc->have -= 2 + len;
+		memmove(buf, buf + 2 + len, tc->have);
+	}
+
+	return;
+out:
+	close_tcp(ctx, i);
+}
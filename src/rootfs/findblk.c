@@ -8,7 +8,10 @@
 #include <sys/inotify.h>
 #include <sys/ppoll.h>
 #include <sys/socket.h>
+#include <sys/proc.h>
+#include <sys/prctl.h>
 
+#include <sigset.h>
 #include <format.h>
 #include <string.h>
 #include <util.h>
@@ -18,20 +21,38 @@ ERRTAG("findblk");
 
 #define UDEV_MGRP_KERNEL   (1<<0)
 
+#define NAMELEN 32
+#define MAXPROBES 16
+#define MAXSEEN 64
+#define PROBETIME 30 /* seconds */
+
 #define CTX struct top* ctx
 
+struct probe {
+	int pid;
+	char name[NAMELEN];
+};
+
 struct top {
 	int udev;  /* socket fd */
+	int sigfd; /* SIGCHLD from probes */
 
 	char* key; /* "mbr:1234ABEF", what we're looking for */
 	int (*match)(CTX, char* name); /* one of the match_* functions */
 	char* id;  /* "1234ABEF" in the above example */
+	int slow;  /* match() needs to read the device */
 
 	char** parts; /* { "1:boot", "2:root" }, partitions to link */
 	int nparts;
 
-	char device[32]; /* "sda", once it's been found */
+	char device[NAMELEN]; /* "sda", once it's been found */
 	uint partbits;   /* which of the parts[] are still missing */
+
+	struct probe probes[MAXPROBES];
+	int nprobes;
+
+	char seen[MAXSEEN][NAMELEN];
+	int nseen;
 };
 
 static const char devmapper[] = "/dev/mapper";
@@ -271,7 +292,7 @@ static int mark_partition(CTX, char* suff)
 	for(i = 0; i < n; i++) {
 		uint mask = (1 << i);
 
-		if(!(partbits && mask))
+		if(!(partbits & mask))
 			continue;
 
 		char* part = parts[i];
@@ -295,20 +316,140 @@ static int mark_partition(CTX, char* suff)
 	return partbits ? -EAGAIN : 0;
 }
 
-static int check(CTX, char* name)
+static int set_device(CTX, char* name)
 {
-	if(ctx->match) { /* waiting for device */
-		if(!ctx->match(ctx, name))
-			return -EAGAIN;
+	uint need = strlen(name) + 1;
 
-		uint need = strlen(name) + 1;
+	if(need > sizeof(ctx->device))
+		fail("device name too long:", name, 0);
 
-		if(need > sizeof(ctx->device))
-			fail("device name too long:", name, 0);
+	memcpy(ctx->device, name, need);
+
+	return 0;
+}
 
-		memcpy(ctx->device, name, need);
+/* Devices may show up both in the initial /sys/block scan and in udev
+   events, since the socket gets opened before the scan. Each device
+   only gets checked once. */
 
+static int check_seen(CTX, char* name)
+{
+	int i, n = ctx->nseen;
+	uint len = strlen(name);
+
+	if(len >= NAMELEN)
 		return 0;
+
+	for(i = 0; i < n; i++)
+		if(!strcmp(ctx->seen[i], name))
+			return 1;
+
+	if(n < MAXSEEN) {
+		memcpy(ctx->seen[n], name, len + 1);
+		ctx->nseen = n + 1;
+	}
+
+	return 0;
+}
+
+/* MBR and GPT matching means reading the device, which may take a while
+   for slow or sleeping devices, and with several candidates it's better
+   to read them all at once. Each read happens in a child process which
+   reports the result via its exit status, and the first one to match
+   wins. The rest get killed. */
+
+static void kill_probes(CTX)
+{
+	int i, n = ctx->nprobes;
+
+	for(i = 0; i < n; i++)
+		sys_kill(ctx->probes[i].pid, SIGKILL);
+
+	ctx->nprobes = 0;
+}
+
+static int reap_probe(CTX, int flags)
+{
+	int i, n = ctx->nprobes;
+	int pid, status;
+
+	if((pid = sys_waitpid(-1, &status, flags)) <= 0)
+		return -ECHILD;
+
+	for(i = 0; i < n; i++)
+		if(ctx->probes[i].pid == pid)
+			break;
+	if(i >= n)
+		return 0;
+
+	struct probe pb = ctx->probes[i];
+
+	ctx->probes[i] = ctx->probes[n-1];
+	ctx->nprobes = n - 1;
+
+	if(status)
+		return 0;
+
+	kill_probes(ctx);
+	set_device(ctx, pb.name);
+
+	return 1;
+}
+
+static int check_probes(CTX)
+{
+	struct siginfo si;
+	int ret;
+
+	while(sys_read(ctx->sigfd, &si, sizeof(si)) > 0)
+		;
+	while((ret = reap_probe(ctx, WNOHANG)) == 0)
+		;
+
+	return ret > 0 ? 0 : -EAGAIN;
+}
+
+static int start_probe(CTX, char* name)
+{
+	uint len = strlen(name);
+	struct probe* pb;
+	int pid, ret;
+
+	if(len >= NAMELEN)
+		fail("device name too long:", name, 0);
+
+	while(ctx->nprobes >= MAXPROBES)
+		if((ret = reap_probe(ctx, 0)) > 0)
+			return 0;
+		else if(ret < 0)
+			ctx->nprobes = 0;
+
+	if((pid = sys_fork()) < 0)
+		fail("fork", NULL, pid);
+
+	if(pid == 0) {
+		sys_prctl(PR_SET_PDEATHSIG, SIGTERM, 0, 0, 0);
+		_exit(ctx->match(ctx, name) ? 0x00 : 0x01);
+	}
+
+	pb = &ctx->probes[ctx->nprobes++];
+	pb->pid = pid;
+	memcpy(pb->name, name, len + 1);
+
+	return -EAGAIN;
+}
+
+static int check(CTX, char* name)
+{
+	if(ctx->match) { /* waiting for device */
+		if(check_seen(ctx, name))
+			return -EAGAIN;
+		if(ctx->slow)
+			return start_probe(ctx, name);
+		if(!ctx->match(ctx, name))
+			return -EAGAIN;
+
+		return set_device(ctx, name);
 	} else if(!ctx->device[0]) { /* should never happen */
 		fail("attempt to match partition w/o device", NULL, 0);
 	} else { /* got device, waiting for partitions */
@@ -347,6 +488,22 @@ static void open_udev(CTX)
 	ctx->udev = fd;
 }
 
+static void open_sigfd(CTX)
+{
+	int fd, ret;
+	struct sigset mask;
+
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGCHLD);
+
+	if((fd = sys_signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC)) < 0)
+		fail("signalfd", NULL, fd);
+	if((ret = sys_sigprocmask(SIG_BLOCK, &mask, NULL)) < 0)
+		fail("sigprocmask", NULL, ret);
+
+	ctx->sigfd = fd;
+}
+
 static char* restof(char* line, char* pref)
 {
 	int plen = strlen(pref);
@@ -401,25 +558,56 @@ static int recv_udev_event(CTX, char* type)
 	return check(ctx, devname);
 }
 
-static int wait_devices(CTX, struct timespec* ts, char* type)
+static int wait_event(CTX, struct timespec* ts, char* type)
 {
 	int ret;
-	struct pollfd pfd = {
-		.fd = ctx->udev,
-		.events = POLLIN
+	struct pollfd pfds[2] = {
+		{ .fd = ctx->udev, .events = POLLIN },
+		{ .fd = ctx->sigfd, .events = POLLIN }
 	};
-poll:
-	if((ret = sys_ppoll(&pfd, 1, ts, NULL)) < 0)
+
+	if((ret = sys_ppoll(pfds, 2, ts, NULL)) < 0)
 		fail("ppoll", "udev", ret);
 	if(ret == 0)
 		return -ETIMEDOUT;
 
-	if((ret = recv_udev_event(ctx, type)) < 0)
-		goto poll;
+	if(pfds[1].revents & POLLIN)
+		if((ret = check_probes(ctx)) >= 0)
+			return ret;
+	if(pfds[0].revents & POLLIN)
+		if((ret = recv_udev_event(ctx, type)) >= 0)
+			return ret;
+
+	return -EAGAIN;
+}
+
+static int wait_devices(CTX, struct timespec* ts, char* type)
+{
+	int ret;
+
+	while((ret = wait_event(ctx, ts, type)) == -EAGAIN)
+		;
 
 	return ret;
 }
 
+/* The timeouts above are for devices to show up. Probes still running
+   once they expire are reading devices that did show up, just slowly,
+   so they get some more time. The wait ends as soon as the last one
+   reports, there's no point in waiting any longer if none matched. */
+
+static int wait_probes(CTX)
+{
+	struct timespec ts = { PROBETIME, 0 };
+	int ret;
+
+	while(ctx->nprobes)
+		if((ret = wait_event(ctx, &ts, "disk")) != -EAGAIN)
+			return ret;
+
+	return -ENOENT;
+}
+
 static int scan_devices(CTX, const char* dir)
 {
 	int fd, rd, ret;
@@ -436,7 +624,7 @@ static int scan_devices(CTX, const char* dir)
 			struct dirent* de = p;
 
 			if(!de->reclen)
-				continue;
+				break;
 
 			p += de->reclen;
 
@@ -474,6 +662,8 @@ static void locate_device(CTX)
 
 	if(wait_devices(ctx, &ts, "disk") >= 0)
 		return;
+	if(wait_probes(ctx) >= 0)
+		return;
 
 	fail("timed out", NULL, 0);
 }
@@ -585,6 +775,7 @@ static void set_match_key(CTX, char* key)
 
 	ctx->id = sep + 1;
 	ctx->key = key;
+	ctx->slow = (ctx->match == match_mbr || ctx->match == match_gpt);
 }
 
 static void setup_context(CTX, int argc, char** argv)
@@ -622,6 +813,7 @@ int main(int argc, char** argv)
 	setup_context(ctx, argc, argv);
 
 	open_udev(ctx);
+	open_sigfd(ctx);
 	locate_device(ctx);
 	locate_parts(ctx);
 	link_parts(ctx);
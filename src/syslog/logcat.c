@@ -44,6 +44,10 @@ struct top {
 	int in;
 	int inf;
 	int ind;
+
+	uint64_t stampts;
+	int stamplen;
+	char stamp[48];
 };
 
 #define CTX struct top* ctx
@@ -152,17 +156,11 @@ static char* reset(char* p, char* e, int opts)
 	return p;
 }
 
-static void outcolor(CTX, int a, int b)
+static void outcolor(CTX, char* seq)
 {
-	int opts = ctx->opts;
-
-	if(opts & OPT_c) return;
-
-	FMTBUF(p, e, buf, 10);
-	p = color(p, e, opts, a, b);
-	FMTEND(p, e);
+	if(ctx->opts & OPT_c) return;
 
-	output(ctx, buf, p - buf);
+	output(ctx, seq, strlen(seq));
 }
 
 static void outreset(CTX)
@@ -183,35 +181,49 @@ static char* skip_prefix(char* ls, char* le)
 	return NULL;
 }
 
-static void format(CTX, uint64_t ts, int prio, char* ls, char* le)
+/* Timestamps have 1s resolution, and a busy log has lots of lines
+   sharing the same one. The formatted stamp is kept for the next line. */
+
+static void prep_stamp(CTX, uint64_t ts)
 {
 	int opts = ctx->opts;
 	struct timeval tv = { ts, 0 };
 	struct tm tm;
-	char* sep;
 
 	tv2tm(&tv, &tm);
 
-	FMTBUF(p, e, buf, 50 + le - ls + 50);
+	char* p = ctx->stamp;
+	char* e = p + sizeof(ctx->stamp);
+
 	p = color(p, e, opts, 0, 32);
 	p = fmttm(p, e, &tm);
 	p = reset(p, e, opts);
 	p = fmtstr(p, e, opts & OPT_c ? "  " : " ");
-	FMTEND(p, e);
 
-	output(ctx, buf, p - buf);
+	ctx->stampts = ts;
+	ctx->stamplen = p - ctx->stamp;
+}
+
+static void format(CTX, uint64_t ts, int prio, char* ls, char* le)
+{
+	char* sep;
+
+	if(!ctx->stamplen || ts != ctx->stampts)
+		prep_stamp(ctx, ts);
+
+	output(ctx, ctx->stamp, ctx->stamplen);
 
 	if((sep = skip_prefix(ls, le))) {
-		outcolor(ctx, 0, 33);
+		outcolor(ctx, "\033[0;33m");
 		output(ctx, ls, sep - ls);
 		outreset(ctx);
 		ls = sep;
 	}
 
 	if(prio < 2)
-		outcolor(ctx, 1, 31);
+		outcolor(ctx, "\033[1;31m");
 	else if(prio < 4)
-		outcolor(ctx, 1, 37);
+		outcolor(ctx, "\033[1;37m");
 
 	output(ctx, ls, le - ls);
 
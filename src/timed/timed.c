@@ -169,6 +169,8 @@ static void check_polled_fds(CTX, struct poll* pp)
 
 	if(pfds[0].revents & POLLIN)
 		check_control(ctx);
+	if(pfds[1].revents & POLLERR)
+		check_errqueue(ctx);
 	if(pfds[1].revents & POLLIN)
 		check_packet(ctx);
 
@@ -4,7 +4,7 @@
 #define NCONNS 4
 #define NSERVS 4
 #define NPOLLS (2 + NCONNS)
-#define NPOINT 16
+#define NBURST 4
 
 /* top.state */
 #define TS_IDLE        0
@@ -49,6 +49,11 @@ struct conn {
 	int fd;
 };
 
+struct sample {
+	int64_t lo;
+	int64_t hi;
+};
+
 struct serv {
 	ushort flags;
 	ushort port;
@@ -75,8 +80,13 @@ struct top {
 	int state;
 
 	uint64_t sendtime;
+	uint64_t sendstamp;
+	uint64_t recvtime;
 	uint64_t reference;
 
+	int nsamples;
+	struct sample samples[NBURST];
+
 	int current; /* index of one of the servs[] above, or < 0 if none */
 	int failures;
 
@@ -104,6 +114,7 @@ void init_clock_state(CTX);
 void check_client(CTX, CN);
 void clear_client(CTX, CN);
 void check_packet(CTX);
+void check_errqueue(CTX);
 void handle_timeout(CTX);
 
 void set_timed(CTX, int state, int sec);
@@ -6,6 +6,7 @@
 #include <sys/time.h>
 #include <sys/random.h>
 
+#include <cmsg.h>
 #include <endian.h>
 #include <string.h>
 #include <util.h>
@@ -17,6 +18,25 @@ static inline int imax(int a, int b)
 	return a > b ? a : b;
 }
 
+/* Timestamps taken in userspace around sendto and recvfrom include
+   scheduling delays, which are often larger than the network RTT on
+   a LAN. The kernel can timestamp the packets instead, as they pass
+   through the network stack: SO_TIMESTAMPNS for incoming ones, and
+   SO_TIMESTAMPING for outgoing ones, reported via the error queue.
+
+   Neither is critical, if the kernel does not support them the code
+   falls back to reading the clock in userspace. */
+
+static void enable_timestamps(int fd)
+{
+	int flags = SOF_TIMESTAMPING_TX_SOFTWARE
+	          | SOF_TIMESTAMPING_SOFTWARE
+	          | SOF_TIMESTAMPING_OPT_TSONLY;
+
+	sys_setsockopti(fd, SOL_SOCKET, SO_TIMESTAMPNS, 1);
+	sys_setsockopti(fd, SOL_SOCKET, SO_TIMESTAMPING, flags);
+}
+
 static int maybe_open_socket(CTX)
 {
 	int fd;
@@ -27,6 +47,8 @@ static int maybe_open_socket(CTX)
 	if((fd = sys_socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP)) < 0)
 		return fd;
 
+	enable_timestamps(fd);
+
 	ctx->ntpfd = fd;
 	ctx->pollready = 0;
 
@@ -53,6 +75,15 @@ static void maybe_close_socket(CTX)
 	ctx->pollready = 0;
 }
 
+static uint64_t ntp_time(struct timespec* ts)
+{
+	uint64_t ns = ts->nsec;
+	uint64_t fs = ns*(1ULL<<32)/(1000000000ULL);
+	uint64_t ss = ts->sec + 2208988800UL;
+
+	return ((ss << 32) | fs);
+}
+
 static uint64_t get_system_time(void)
 {
 	int ret;
@@ -61,11 +92,58 @@ static uint64_t get_system_time(void)
 	if((ret = sys_clock_gettime(CLOCK_REALTIME, &ts)) < 0)
 		quit("clock_gettime", "REALTIME", ret);
 
-	uint64_t ns = ts.nsec;
-	uint64_t fs = ns*(1ULL<<32)/(1000000000ULL);
-	uint64_t ss = ts.sec + 2208988800UL;
+	return ntp_time(&ts);
+}
 
-	return ((ss << 32) | fs);
+static uint64_t cmsg_time(void* p, void* e, int type)
+{
+	struct cmsg* cm;
+	struct timespec* ts;
+
+	if(!(cm = cmsg_get(p, e, SOL_SOCKET, type)))
+		return 0;
+	if(cmsg_paylen(cm) < (int)sizeof(*ts))
+		return 0;
+
+	ts = cmsg_payload(cm);
+
+	if(!ts->sec && !ts->nsec)
+		return 0;
+
+	return ntp_time(ts);
+}
+
+/* Send timestamps make the socket report POLLERR until the error queue
+   is drained, so this gets called from the main loop as well as before
+   processing a reply. The queue may hold timestamps for earlier requests
+   that never got a reply; the last one is for the latest request. */
+
+void check_errqueue(CTX)
+{
+	int fd = ctx->ntpfd;
+	uint64_t ts;
+	char data[64];
+	char ctrl[256];
+	struct iovec iov = { data, sizeof(data) };
+	struct msghdr msg = {
+		.iov = &iov,
+		.iovlen = 1,
+		.control = ctrl
+	};
+
+	while(1) {
+		msg.controllen = sizeof(ctrl);
+
+		if(sys_recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+			break;
+		if((ts = cmsg_time(ctrl, ctrl + msg.controllen, SCM_TIMESTAMPING)))
+			ctx->sendstamp = ts;
+	}
+
+	/* a pending socket error would keep POLLERR up as well */
+	int err, len = sizeof(err);
+
+	sys_getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len);
 }
 
 static int put_server_address(CTX, void* buf, uint size)
@@ -123,6 +201,7 @@ static int send_packet(CTX)
 		return ret;
 
 	ctx->sendtime = sendtime;
+	ctx->sendstamp = 0;
 	ctx->reference = reference;
 
 	return 0;
@@ -304,9 +383,39 @@ out:
 		ping_pass_complete(ctx);
 }
 
-static void add_poll_point(CTX, uint64_t ref, int64_t lo, int64_t hi)
+/* Regular polls are done in short bursts, and only the sample with
+   the lowest RTT gets used. Queuing delays only ever make packets late,
+   so the fastest exchange is the one least affected by them, and it
+   also yields the narrowest [lo; hi] interval.
+
+   Intersecting the intervals would be even better but the clock may be
+   slewing at up to 500ppm while the burst goes, which is enough to make
+   sub-millisecond intervals taken a few seconds apart inconsistent. */
+
+static void pick_best_sample(CTX, int64_t* lo, int64_t* hi)
 {
-	int64_t rtt = (hi - lo);
+	struct sample* sp = ctx->samples;
+	struct sample* best = sp;
+	int i, n = ctx->nsamples;
+
+	for(i = 1; i < n; i++)
+		if(sp[i].hi - sp[i].lo < best->hi - best->lo)
+			best = &sp[i];
+
+	*lo = best->lo;
+	*hi = best->hi;
+
+	ctx->nsamples = 0;
+}
+
+static void finish_poll(CTX)
+{
+	int64_t lo, hi;
+	int64_t rtt;
+
+	pick_best_sample(ctx, &lo, &hi);
+
+	rtt = hi - lo;
 
 	if(rtt < 0)
 		rtt = 0;
@@ -322,7 +431,6 @@ static void add_poll_point(CTX, uint64_t ref, int64_t lo, int64_t hi)
 	if(sv->rtt > urtt)
 		sv->rtt = urtt;
 
-	ctx->ref = ref;
 	ctx->lo = lo;
 	ctx->hi = hi;
 
@@ -335,6 +443,24 @@ static void add_poll_point(CTX, uint64_t ref, int64_t lo, int64_t hi)
 	set_timed(ctx, TS_POLL_WAIT, ival);
 }
 
+static void add_poll_point(CTX, uint64_t ref, int64_t lo, int64_t hi)
+{
+	int i = ctx->nsamples;
+
+	if(i < NBURST) {
+		ctx->samples[i].lo = lo;
+		ctx->samples[i].hi = hi;
+		ctx->nsamples = ++i;
+	}
+
+	ctx->ref = ref;
+
+	if(i < NBURST)
+		set_timed(ctx, TS_POLL_WAIT, 1);
+	else
+		finish_poll(ctx);
+}
+
 static void handle_packet(CTX, struct ntpreq* rp)
 {
 	int state = ctx->state;
@@ -353,7 +479,15 @@ static void handle_packet(CTX, struct ntpreq* rp)
 	uint64_t T1 = ctx->sendtime;
 	uint64_t T2 = ntohx(rp->receive);
 	uint64_t T3 = ntohx(rp->transmit);
-	uint64_t T4 = get_system_time();
+	uint64_t T4 = ctx->recvtime;
+	uint64_t TS;
+
+	check_errqueue(ctx);
+
+	TS = ctx->sendstamp;
+
+	if(TS >= T1 && TS <= T4) /* the kernel stamp is later and better */
+		T1 = TS;
 
 	uint64_t ref = T2 + (T3 - T2)/2;
 	int64_t lo = T1 - T2;
@@ -390,16 +524,32 @@ static struct ntpreq* recv_packet(CTX, void* buf, int len)
 	int rd, fd = ctx->ntpfd;
 
 	byte addr[ADDRLEN];
-	int alen = sizeof(addr);
+	int alen;
 	byte bddr[ADDRLEN];
 	int blen = sizeof(bddr);
+	char ctrl[128];
+
+	struct iovec iov = { buf, len };
+	struct msghdr msg = {
+		.name = addr,
+		.namelen = sizeof(addr),
+		.iov = &iov,
+		.iovlen = 1,
+		.control = ctrl,
+		.controllen = sizeof(ctrl)
+	};
 
 	memzero(addr, sizeof(addr));
 	memzero(bddr, sizeof(bddr));
 
-	if((rd = sys_recvfrom(fd, buf, len, 0, addr, &alen)) < 0)
+	if((rd = sys_recvmsg(fd, &msg, 0)) < 0)
 		return NULL;
 
+	alen = msg.namelen;
+
+	if(!(ctx->recvtime = cmsg_time(ctrl, ctrl + msg.controllen, SCM_TIMESTAMPNS)))
+		ctx->recvtime = get_system_time();
+
 	if(ctx->current < 0)
 		return NULL;
 	if((blen = put_server_address(ctx, bddr, blen)) < 0)
@@ -461,6 +611,9 @@ static void send_poll_request(CTX)
 	if(send_packet(ctx) >= 0) {
 		/* success, wait for reply */
 		set_timed(ctx, TS_POLL_SENT, 1);
+	} else if(ctx->nsamples) {
+		/* mid-burst, go with what we have */
+		finish_poll(ctx);
 	} else if(ctx->failures < 3) {
 		/* retry in 60s, noting a failure */
 		ctx->failures++;
@@ -475,7 +628,9 @@ static void send_poll_request(CTX)
 
 static void handle_poll_timeout(CTX)
 {
-	if(ctx->failures < 3) {
+	if(ctx->nsamples) {
+		finish_poll(ctx);
+	} else if(ctx->failures < 3) {
 		ctx->failures++;
 		set_timed(ctx, TS_POLL_WAIT, 60 - 1);
 	} else {
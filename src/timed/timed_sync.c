@@ -55,6 +55,14 @@ static void decrease_interval(CTX)
 		ctx->interval /= 2;
 }
 
+/* Small offsets are passed to the kernel PLL, which slews the clock
+   and, more importantly, adjusts its frequency to compensate for drift.
+   The PLL needs regular updates to do that, so it gets one after every
+   poll, including the ones where the local time is within [lo; hi].
+
+   At long poll intervals the kernel FLL works better than the PLL
+   alone, so it gets enabled too once the interval grows. */
+
 static void request_clock_slew(struct timex* tmx, int64_t dt, int ival)
 {
 	int64_t ns = (dt * 1000000000 / (1LL<<32));
@@ -63,6 +71,9 @@ static void request_clock_slew(struct timex* tmx, int64_t dt, int ival)
 	tmx->status = STA_PLL;
 	tmx->offset = ns;
 	tmx->constant = slew_time_constant(ival);
+
+	if(ival >= MAX_POLL_INTERVAL/2)
+		tmx->status |= STA_FLL;
 }
 
 static void request_clock_step(struct timex* tmx, int64_t dt)
@@ -91,24 +102,25 @@ void consider_synching(CTX)
 		dt = -(lo + over);  /* with a bit of overlap.            */
 	else if(hi < 0)
 		dt = -(hi - over);
-	else
-		return increase_interval(ctx);
+	else                        /* No correction needed, but the PLL */
+		dt = -(lo + hi)/2;  /* still wants the best estimate.    */
 
 	int64_t ad = dt < 0 ? -dt : dt; /* abs(dt) */
 
 	if((ad < (1<<22))) /* ~1ms */
-		return increase_interval(ctx);
-
-	ctx->syncdt = dt;
-	ctx->synctime = ctx->polltime;
-
-	if(ad >= (1<<31)) /* 500ms, step threshold */
+		increase_interval(ctx);
+	else if(ad >= (1<<31)) /* 500ms, step threshold */
 		reset_interval(ctx);
 	else if(ad >= (1<<29)) /* 125ms */
 		decrease_interval(ctx);
 	else
 		increase_interval(ctx);
 
+	if(ad >= (1<<22)) {
+		ctx->syncdt = dt;
+		ctx->synctime = ctx->polltime;
+	}
+
 	memzero(&tmx, sizeof(tmx));
 
 	if(ad >= (1LL<<31))
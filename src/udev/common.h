@@ -0,0 +1,18 @@
+#include <config.h>
+
+#define CONTROL RUN_CTRL "/udevmod"
+
+#define CMD_STATUS     1
+#define CMD_RESCAN     2
+
+#define REP_STATUS     1
+
+#define ATTR_EVENTS    1
+#define ATTR_BATCHES   2
+#define ATTR_MAXBATCH  3
+#define ATTR_TRUNCATED 4
+#define ATTR_SENT      5
+#define ATTR_SENDFAIL  6
+#define ATTR_OVERRUNS  7
+#define ATTR_RESCANS   8
+#define ATTR_RCVBUF    9
@@ -0,0 +1,194 @@
+#include <bits/socket/unix.h>
+#include <sys/socket.h>
+
+#include <nlusctl.h>
+#include <string.h>
+#include <format.h>
+#include <main.h>
+#include <util.h>
+
+#include "common.h"
+
+ERRTAG("udevctl");
+
+struct top {
+	int argc;
+	int argi;
+	char** argv;
+
+	int fd;
+	char txbuf[64];
+	char rxbuf[256];
+
+	struct ucbuf uc;
+};
+
+#define CTX struct top* ctx __attribute__((unused))
+
+typedef struct ucattr* attr;
+
+static void prep_context(CTX, int argc, char** argv)
+{
+	int i = 1;
+
+	if(i < argc && argv[i][0] == '-' && argv[i++][1])
+		fail("no options allowed", NULL, 0);
+
+	ctx->argc = argc;
+	ctx->argv = argv;
+	ctx->argi = i;
+
+	uc_buf_set(&ctx->uc, ctx->txbuf, sizeof(ctx->txbuf));
+}
+
+static void init_socket(CTX)
+{
+	int fd, ret;
+	char* path = CONTROL;
+
+	if((fd = sys_socket(AF_UNIX, SOCK_SEQPACKET, 0)) < 0)
+		fail("socket", "AF_UNIX", fd);
+	if((ret = uc_connect(fd, path)) < 0)
+		fail("connect", path, ret);
+
+	ctx->fd = fd;
+}
+
+static attr send_recv(CTX, struct ucbuf* uc)
+{
+	int ret, fd;
+	void* buf = ctx->rxbuf;
+	int len = sizeof(ctx->rxbuf);
+	attr msg;
+
+	init_socket(ctx);
+
+	fd = ctx->fd;
+
+	if((ret = uc_send(fd, uc)) < 0)
+		fail("send", NULL, ret);
+	if((ret = uc_recv(fd, buf, len)) < 0)
+		fail("recv", NULL, ret);
+	if(!(msg = uc_msg(buf, ret)))
+		fail("invalid message", NULL, 0);
+
+	return msg;
+}
+
+static void no_more_arguments(CTX)
+{
+	if((ctx->argc - ctx->argi) > 0)
+		fail("too many arguments", NULL, 0);
+}
+
+static int get_int(attr msg, int key)
+{
+	int* ip = uc_get_int(msg, key);
+
+	return ip ? *ip : 0;
+}
+
+static char* fmt_count(char* p, char* e, attr msg, int key, char* tag)
+{
+	p = fmtstr(p, e, tag);
+	p = fmtchar(p, e, ' ');
+	p = fmtuint(p, e, get_int(msg, key));
+
+	return p;
+}
+
+static void cmd_status(CTX)
+{
+	struct ucbuf* uc = &ctx->uc;
+	attr msg;
+	int cmd;
+
+	no_more_arguments(ctx);
+
+	uc_put_hdr(uc, CMD_STATUS);
+
+	msg = send_recv(ctx, uc);
+
+	if((cmd = uc_repcode(msg)) < 0)
+		fail(NULL, NULL, cmd);
+	if(cmd != REP_STATUS)
+		fail("unexpected reply", NULL, 0);
+
+	FMTBUF(p, e, buf, 512);
+
+	p = fmt_count(p, e, msg, ATTR_EVENTS, "Events");
+	p = fmt_count(p, e, msg, ATTR_BATCHES, ", batches");
+	p = fmt_count(p, e, msg, ATTR_MAXBATCH, ", largest");
+	p = fmt_count(p, e, msg, ATTR_TRUNCATED, ", truncated");
+	p = fmtchar(p, e, '\n');
+
+	p = fmt_count(p, e, msg, ATTR_SENT, "Re-transmitted");
+	p = fmt_count(p, e, msg, ATTR_SENDFAIL, ", failed");
+	p = fmtchar(p, e, '\n');
+
+	p = fmt_count(p, e, msg, ATTR_OVERRUNS, "Overruns");
+	p = fmt_count(p, e, msg, ATTR_RESCANS, ", rescans");
+	p = fmt_count(p, e, msg, ATTR_RCVBUF, ", receive buffer");
+	p = fmtchar(p, e, '\n');
+
+	FMTEND(p, e);
+
+	writeall(STDOUT, buf, p - buf);
+}
+
+static void cmd_rescan(CTX)
+{
+	struct ucbuf* uc = &ctx->uc;
+	attr msg;
+	int cmd;
+
+	no_more_arguments(ctx);
+
+	uc_put_hdr(uc, CMD_RESCAN);
+
+	msg = send_recv(ctx, uc);
+
+	if((cmd = uc_repcode(msg)) < 0)
+		fail(NULL, NULL, cmd);
+	if(cmd > 0)
+		fail("unexpected reply", NULL, 0);
+}
+
+static const struct cmd {
+	char name[8];
+	void (*call)(CTX);
+} commands[] = {
+	{ "status", cmd_status },
+	{ "rescan", cmd_rescan }
+};
+
+static const struct cmd* find_command(CTX)
+{
+	const struct cmd* cc;
+
+	if(ctx->argi >= ctx->argc)
+		return &commands[0];
+
+	char* name = ctx->argv[ctx->argi++];
+
+	for(cc = commands; cc < ARRAY_END(commands); cc++)
+		if(!strcmpn(cc->name, name, sizeof(cc->name)))
+			return cc;
+
+	fail("unknown command", name, 0);
+}
+
+int main(int argc, char** argv)
+{
+	struct top context, *ctx = &context;
+	const struct cmd* cc;
+
+	memzero(ctx, sizeof(*ctx));
+	prep_context(ctx, argc, argv);
+
+	cc = find_command(ctx);
+
+	cc->call(ctx);
+
+	return 0;
+}
@@ -9,6 +9,7 @@
 #include <sys/socket.h>
 #include <sys/signal.h>
 #include <sys/mman.h>
+#include <sys/time.h>
 
 #include <format.h>
 #include <string.h>
@@ -100,14 +101,26 @@ static void dev_removed(CTX)
 
    The original udevd prepends a libudev-specific header to re-transmitted
    messages, but current libudev will happily accept raw kernel messages
-   as well. Not sure whether it's intentional or not but it works. */
+   as well. Not sure whether it's intentional or not but it works.
 
-static void rebroadcast(CTX)
+   Events that arrive in bursts (device scan at startup, hotplugging
+   a hub) get received, and re-transmitted, in batches, using a single
+   recvmmsg and a single sendmmsg call. The messages are processed, and
+   possibly extended, in place in the receive buffers.
+
+   Processing an event may block on a modprobe run. Whatever has been
+   processed by then gets sent out right before that (see modprobe), so
+   clients do not have to wait for someone else's module to load. Sent
+   entries get their outlen zeroed and are skipped by later flushes
+   within the same batch. */
+
+void flush_rebroadcast(CTX)
 {
+	int i, k, n = ctx->nout;
 	int ret, fd = ctx->udev;
-
-	char* buf = ctx->uevent;
-	int len = ctx->ptr;
+	struct mmsghdr msgs[NBATCH];
+	struct iovec iovs[NBATCH];
+	struct stats* st = &ctx->stats;
 
 	struct sockaddr_nl addr = {
 		.family = AF_NETLINK,
@@ -116,34 +129,67 @@ static void rebroadcast(CTX)
 		.groups = UDEV_MGRP_LIBUDEV
 	};
 
-	if((ret = sys_sendto(fd, buf, len, 0, &addr, sizeof(addr))) >= 0)
-		return;
-	if(ret == -ECONNREFUSED)
-		return; /* this is ok apparently */
+	memzero(msgs, n*sizeof(*msgs));
+
+	for(i = 0, k = 0; i < n; i++) {
+		struct msghdr* hdr = &msgs[k].hdr;
+
+		if(!ctx->outlen[i])
+			continue;
+
+		iovs[k].base = ctx->evbuf[i];
+		iovs[k].len = ctx->outlen[i];
+
+		hdr->name = &addr;
+		hdr->namelen = sizeof(addr);
+		hdr->iov = &iovs[k];
+		hdr->iovlen = 1;
 
-	warn("send", NULL, ret);
+		ctx->outlen[i] = 0;
+		k++;
+	}
+
+	n = k;
+
+	for(i = 0; i < n; i++) {
+		if((ret = sys_sendmmsg(fd, msgs + i, n - i, 0)) > 0) {
+			st->sent += ret;
+			i += ret - 1;
+			continue;
+		}
+		if(ret == -ECONNREFUSED)
+			continue; /* this is ok apparently */
+
+		st->sendfail++;
+		warn("send", NULL, ret);
+	}
+
+	ctx->nout = 0;
 }
 
-static void recv_event(CTX)
+static void handle_event(CTX, int i, struct mmsghdr* msg)
 {
-	int rd, fd = ctx->udev;
-	int max = sizeof(ctx->uevent) - 2;
-	char* buf = ctx->uevent;
+	char* buf = ctx->evbuf[i];
+	uint len = msg->len;
 
-	if((rd = sys_recv(fd, buf, max, 0)) < 0)
-		fail("recv", "udev", rd);
+	if(len > UEVENT)
+		len = UEVENT;
+	if(msg->hdr.flags & MSG_TRUNC)
+		ctx->stats.truncated++;
 
-	buf[rd] = '\0';
+	buf[len] = '\0';
 
-	ctx->sep = rd;
-	ctx->ptr = rd;
+	ctx->uevent = buf;
+	ctx->sep = len;
+	ctx->ptr = len;
 
 	if(!strncmp(buf, "remove@", 7))
 		dev_removed(ctx);
 	else if(!strncmp(buf, "add@", 4))
 		dev_added(ctx);
 
-	rebroadcast(ctx);
+	ctx->outlen[i] = ctx->ptr;
+	ctx->nout = i + 1;
 }
 
 static void open_udev(CTX)
@@ -171,9 +217,28 @@ static void open_udev(CTX)
 	ctx->udev = fd;
 }
 
+/* The default socket buffer is not enough to hold event bursts from
+   plugging in a loaded USB hub or a docking station. SO_RCVBUFFORCE
+   ignores rmem_max but needs CAP_NET_ADMIN; without it, we get as much
+   as SO_RCVBUF allows. */
+
+static void size_udev_buffer(CTX)
+{
+	int fd = ctx->udev;
+	int val, len = sizeof(val);
+	int ret;
+
+	if((ret = sys_setsockopti(fd, SOL_SOCKET, SO_RCVBUFFORCE, RCVBUF)) < 0)
+		if((ret = sys_setsockopti(fd, SOL_SOCKET, SO_RCVBUF, RCVBUF)) < 0)
+			warn("setsockopt", "SO_RCVBUF", ret);
+
+	if((ret = sys_getsockopt(fd, SOL_SOCKET, SO_RCVBUF, &val, &len)) >= 0)
+		ctx->rcvbuf = val;
+}
+
 /* During startup, modaliases for pre-existing devices are picked
    up by scanning /sys/devices recursively and reading "modalias"
-   files there. */
+   files there. See udevmod_alias.c on what happens to them. */
 
 static void pick_modalias(CTX, FN)
 {
@@ -266,6 +331,137 @@ static void scan_devices(CTX)
 	scan_dir(ctx, &start);
 }
 
+/* Re-scanning /sys, like it's done on startup, is the best we can do
+   to recover if the kernel had to drop some events: any devices that
+   were left without modules get them loaded, and input devices get
+   their udev data re-written. Events that were lost cannot be passed
+   on to libudev clients; the counters at least make it visible.
+
+   This is a full rescan, walking all of /sys/devices, so it should
+   not run on every overrun in a burst. ENOBUFS only marks a rescan
+   as pending, see wait_poll. */
+
+static uint64_t monotime(void)
+{
+	struct timespec ts;
+
+	if(sys_clock_gettime(CLOCK_MONOTONIC, &ts) < 0)
+		return 0;
+
+	return ts.sec;
+}
+
+void rescan(CTX)
+{
+	ctx->stats.rescans++;
+	ctx->overrun = 0;
+	ctx->lastscan = monotime();
+
+	open_modprobe(ctx);
+	scan_devices(ctx);
+	stop_modprobe(ctx);
+
+	ctx->uevent = ctx->evbuf[0];
+
+	rescan_inputs(ctx);
+}
+
+static void recv_events(CTX)
+{
+	struct mmsghdr msgs[NBATCH];
+	struct iovec iovs[NBATCH];
+	struct stats* st = &ctx->stats;
+	int i, n, fd = ctx->udev;
+	int flags = MSG_DONTWAIT | MSG_WAITFORONE;
+
+	memzero(msgs, sizeof(msgs));
+
+	for(i = 0; i < NBATCH; i++) {
+		iovs[i].base = ctx->evbuf[i];
+		iovs[i].len = UEVENT;
+		msgs[i].hdr.iov = &iovs[i];
+		msgs[i].hdr.iovlen = 1;
+	}
+
+	if((n = sys_recvmmsg(fd, msgs, NBATCH, flags, NULL)) == -EAGAIN)
+		return;
+
+	if(n == -ENOBUFS) {
+		if(!ctx->overrun)
+			warn("udev socket overrun, full rescan pending", NULL, 0);
+		st->overruns++;
+		ctx->overrun = 1;
+		return;
+	} else if(n < 0) {
+		fail("recvmmsg", "udev", n);
+	}
+
+	st->events += n;
+	st->batches++;
+
+	if((uint)n > st->maxbatch)
+		st->maxbatch = n;
+
+	for(i = 0; i < n; i++)
+		handle_event(ctx, i, &msgs[i]);
+
+	flush_rebroadcast(ctx);
+}
+
+static int ifgoodfd(int fd)
+{
+	return (fd > 0 ? fd : -1);
+}
+
+/* Pending rescan happens once the socket has been drained, that is
+   once ppoll times out with no events coming in, and no sooner than
+   RESCANGAP seconds after the previous one. Overruns arriving meanwhile
+   get merged into the same rescan. */
+
+static struct timespec* rescan_timeout(CTX, struct timespec* ts)
+{
+	uint64_t now = monotime();
+	uint64_t due = ctx->lastscan + RESCANGAP;
+
+	if(!ctx->overrun)
+		return NULL;
+
+	ts->sec = (ctx->lastscan && due > now) ? due - now : 0;
+	ts->nsec = 0;
+
+	return ts;
+}
+
+static void wait_poll(CTX)
+{
+	struct pollfd pfds[2 + NCONNS];
+	struct timespec ts, *tp = rescan_timeout(ctx, &ts);
+	int i, n = 2 + NCONNS;
+	int ret;
+
+	pfds[0].fd = ctx->udev;
+	pfds[1].fd = ifgoodfd(ctx->ctlfd);
+
+	for(i = 0; i < NCONNS; i++)
+		pfds[2+i].fd = ifgoodfd(ctx->conns[i]);
+	for(i = 0; i < n; i++)
+		pfds[i].events = POLLIN;
+
+	if((ret = sys_ppoll(pfds, n, tp, NULL)) < 0)
+		fail("ppoll", NULL, ret);
+	if(ret == 0)
+		return rescan(ctx);
+
+	if(pfds[0].revents)
+		recv_events(ctx);
+	if(pfds[1].revents)
+		accept_client(ctx);
+
+	for(i = 0; i < NCONNS; i++)
+		if(pfds[2+i].revents)
+			check_client(ctx, i);
+}
+
 /* modprobe running in pipe mode may die. That's not good, may
    be that pipe mode not supported, but it should not kill udevmod. */
 
@@ -286,8 +482,10 @@ int main(int argc, char** argv)
 	memzero(ctx, sizeof(*ctx));
 
 	ctx->envp = argv + argc + 1;
+	ctx->uevent = ctx->evbuf[0];
 
 	open_udev(ctx);
+	size_udev_buffer(ctx);
 
 	suppress_sigpipe();
 	open_modprobe(ctx);
@@ -295,6 +493,7 @@ int main(int argc, char** argv)
 	stop_modprobe(ctx);
 
 	init_inputs(ctx);
+	setup_control(ctx);
 
-	while(1) recv_event(ctx);
+	while(1) wait_poll(ctx);
 }
@@ -1,5 +1,11 @@
 #include <bits/types.h>
 
+#define UEVENT 1024
+#define NBATCH 16
+#define NCONNS 4
+#define RCVBUF (8*1024*1024)
+#define RESCANGAP 5 /* seconds, between overrun-triggered rescans */
+
 struct mbuf {
 	char* buf;
 	uint len;
@@ -42,18 +48,49 @@ struct evbits {
 
 #undef BITSET
 
+struct stats {
+	uint events;
+	uint batches;
+	uint maxbatch;
+	uint truncated;
+	uint sent;
+	uint sendfail;
+	uint overruns;
+	uint rescans;
+};
+
 struct top {
 	int udev;
+	int rcvbuf;
 	char** envp;
 
+	int ctlfd;
+	int conns[NCONNS];
+
 	int fd;  /* of a running modprobe -p process */
 	int pid;
 
 	uint sep;
 	uint ptr;
-	char uevent[1024+2];
+	char* uevent; /* the one being processed, in evbuf */
 
 	char saveid[16];
+
+	/* modaliases collected during the initial scan */
+	uint* ahash;
+	char* abuf;
+	uint aptr;
+	uint acnt;
+
+	struct stats stats;
+
+	int overrun;       /* full rescan pending */
+	uint64_t lastscan; /* CLOCK_MONOTONIC seconds */
+
+	/* received in a single batch, and re-transmitted once processed */
+	int nout;
+	uint outlen[NBATCH];
+	char evbuf[NBATCH][UEVENT+2];
 };
 
 #define CTX struct top* ctx __unused
@@ -66,7 +103,15 @@ void open_modprobe(CTX);
 void stop_modprobe(CTX);
 void modprobe(CTX, char* alias);
 
+void rescan(CTX);
+void flush_rebroadcast(CTX);
+
+void setup_control(CTX);
+void accept_client(CTX);
+void check_client(CTX, int i);
+
 void init_inputs(CTX);
+void rescan_inputs(CTX);
 void probe_input(CTX);
 void clear_input(CTX);
 
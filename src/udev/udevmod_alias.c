@@ -1,4 +1,5 @@
 #include <sys/file.h>
+#include <sys/mman.h>
 #include <sys/proc.h>
 
 #include <config.h>
@@ -10,6 +11,9 @@
 
 #define CONFDIR BASE_ETC "/udev"
 
+#define ALIASHASH 4096
+#define ALIASBUF (256*1024)
+
 /* During the initial device scan, udevmod will try dozens of modaliases
    in quick succession, most of them invalid. There is no point in spawning
    that many modprobe processes. Instead, we spawn one and pipe it aliases
@@ -17,7 +21,110 @@
 
    After the initial scan, this becomes pointless since udev events are
    rare and the ones with modaliases tend to arrive one at a time, so we
-   switch to spawning modprobe on each event. */
+   switch to spawning modprobe on each event.
+
+   Lots of devices found during the scan share the same modaliases
+   (think PCI bridges, USB hubs, CPU cores), so the aliases get collected
+   first with duplicates dropped, and then piped to modprobe in large
+   writes, in the order they were found. The set is an open-addressing
+   hash table of offsets into the string buffer that follows it. Once
+   it gets full, whatever has been collected gets written out and the set
+   starts over, so that the order is kept. */
+
+static void init_aliases(CTX)
+{
+	uint size = ALIASHASH*sizeof(uint) + ALIASBUF;
+	int prot = PROT_READ | PROT_WRITE;
+	int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+	void* buf = sys_mmap(NULL, size, prot, flags, -1, 0);
+
+	if(mmap_error(buf))
+		return; /* no deduplication then */
+
+	ctx->ahash = buf;
+	ctx->abuf = buf + ALIASHASH*sizeof(uint);
+	ctx->aptr = 0;
+	ctx->acnt = 0;
+}
+
+static uint hash(char* str)
+{
+	uint h = 2166136261U;
+
+	for(; *str; str++)
+		h = (h ^ (byte)*str) * 16777619U;
+
+	return h;
+}
+
+static int add_alias(CTX, char* name)
+{
+	uint* ht = ctx->ahash;
+	char* buf = ctx->abuf;
+	uint nlen = strlen(name);
+	uint mask = ALIASHASH - 1;
+	uint i, off;
+
+	if(!ht)
+		return -ENOMEM;
+
+	for(i = hash(name) & mask; (off = ht[i]); i = (i + 1) & mask) {
+		char* str = buf + off - 1;
+
+		if(!strncmp(str, name, nlen) && str[nlen] == '\n')
+			return 0;
+	}
+
+	if(ctx->acnt >= ALIASHASH/2)
+		return -ENOMEM;
+	if(ctx->aptr + nlen + 1 > ALIASBUF)
+		return -ENOMEM;
+
+	off = ctx->aptr;
+
+	memcpy(buf + off, name, nlen);
+	buf[off + nlen] = '\n';
+
+	ctx->aptr = off + nlen + 1;
+	ctx->acnt++;
+
+	ht[i] = off + 1;
+
+	return 0;
+}
+
+static void write_aliases(CTX)
+{
+	int ret, fd = ctx->fd;
+
+	if(!ctx->ahash)
+		return;
+
+	if(fd > 0 && ctx->aptr)
+		if((ret = writeall(fd, ctx->abuf, ctx->aptr)) == -EPIPE)
+			ctx->fd = -fd;
+
+	memzero(ctx->ahash, ALIASHASH*sizeof(uint));
+
+	ctx->aptr = 0;
+	ctx->acnt = 0;
+}
+
+static void flush_aliases(CTX)
+{
+	void* buf = ctx->ahash;
+	uint size = ALIASHASH*sizeof(uint) + ALIASBUF;
+
+	if(!buf)
+		return;
+
+	write_aliases(ctx);
+
+	sys_munmap(buf, size);
+
+	ctx->ahash = NULL;
+	ctx->abuf = NULL;
+}
 
 void open_modprobe(CTX)
 {
@@ -41,6 +148,8 @@ void open_modprobe(CTX)
 
 	ctx->pid = pid;
 	ctx->fd = fds[1];
+
+	init_aliases(ctx);
 }
 
 void stop_modprobe(CTX)
@@ -49,7 +158,9 @@ void stop_modprobe(CTX)
 	int ret, status;
 	int fd = ctx->fd;
 
-	if(fd < 0) fd = -fd;
+	flush_aliases(ctx);
+
+	if((fd = ctx->fd) < 0) fd = -fd;
 
 	sys_close(fd);
 
@@ -96,10 +207,20 @@ static void out_modprobe(CTX, char* name)
 	if(ret == -EPIPE) ctx->fd = -ctx->fd;
 }
 
+/* Events waiting to be re-transmitted go out before a blocking
+   modprobe run, see flush_rebroadcast. */
+
 void modprobe(CTX, char* name)
 {
-	if(ctx->pid)
-		out_modprobe(ctx, name);
-	else
+	if(!ctx->pid) {
+		flush_rebroadcast(ctx);
 		run_modprobe(ctx, name);
+	} else if(add_alias(ctx, name) >= 0) {
+		return;
+	} else {
+		write_aliases(ctx);
+
+		if(add_alias(ctx, name) < 0)
+			out_modprobe(ctx, name);
+	}
 }
@@ -0,0 +1,155 @@
+#include <bits/socket/unix.h>
+#include <sys/socket.h>
+#include <sys/file.h>
+
+#include <nlusctl.h>
+#include <string.h>
+#include <util.h>
+
+#include "udevmod.h"
+#include "common.h"
+
+/* Control socket, for udevctl to query the event counters and to request
+   a rescan. Commands are tiny and get answered right away, so there is no
+   need to keep any per-client state beyond the fd.
+
+   Unlike for most other services, failure to set up the socket is not
+   fatal here. Losing modalias loading because of a missing /run would
+   be much worse than losing the statistics. */
+
+#define MSG struct ucattr* msg __unused
+
+void setup_control(CTX)
+{
+	int fd, ret;
+	int flags = SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC;
+	char* path = CONTROL;
+
+	if((fd = sys_socket(AF_UNIX, flags, 0)) < 0) {
+		warn("socket", "AF_UNIX", fd);
+		return;
+	}
+	if((ret = uc_listen(fd, path, 5)) < 0) {
+		warn("ucbind", path, ret);
+		sys_close(fd);
+		return;
+	}
+
+	ctx->ctlfd = fd;
+}
+
+void accept_client(CTX)
+{
+	int i, cfd;
+	int flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+
+	if((cfd = sys_accept4(ctx->ctlfd, NULL, NULL, flags)) < 0)
+		return;
+
+	for(i = 0; i < NCONNS; i++)
+		if(ctx->conns[i] <= 0)
+			break;
+
+	if(i >= NCONNS) {
+		sys_close(cfd);
+		return;
+	}
+
+	ctx->conns[i] = cfd;
+}
+
+static void close_client(CTX, int i)
+{
+	sys_close(ctx->conns[i]);
+	ctx->conns[i] = 0;
+}
+
+static int reply(int fd, struct ucbuf* uc)
+{
+	int ret;
+
+	if((ret = uc_send(fd, uc)) != -EAGAIN)
+		return ret;
+	if((ret = uc_wait_writable(fd)) < 0)
+		return ret;
+
+	return uc_send(fd, uc);
+}
+
+static int cmd_status(CTX, int fd, MSG)
+{
+	struct stats* st = &ctx->stats;
+	char cbuf[256];
+	struct ucbuf uc;
+
+	uc_buf_set(&uc, cbuf, sizeof(cbuf));
+	uc_put_hdr(&uc, REP_STATUS);
+
+	uc_put_int(&uc, ATTR_EVENTS,    st->events);
+	uc_put_int(&uc, ATTR_BATCHES,   st->batches);
+	uc_put_int(&uc, ATTR_MAXBATCH,  st->maxbatch);
+	uc_put_int(&uc, ATTR_TRUNCATED, st->truncated);
+	uc_put_int(&uc, ATTR_SENT,      st->sent);
+	uc_put_int(&uc, ATTR_SENDFAIL,  st->sendfail);
+	uc_put_int(&uc, ATTR_OVERRUNS,  st->overruns);
+	uc_put_int(&uc, ATTR_RESCANS,   st->rescans);
+	uc_put_int(&uc, ATTR_RCVBUF,    ctx->rcvbuf);
+
+	return reply(fd, &uc);
+}
+
+static int cmd_rescan(CTX, int fd, MSG)
+{
+	rescan(ctx);
+
+	return 0;
+}
+
+static const struct cmd {
+	int cmd;
+	int (*call)(CTX, int fd, MSG);
+} commands[] = {
+	{ CMD_STATUS, cmd_status },
+	{ CMD_RESCAN, cmd_rescan }
+};
+
+static int dispatch_cmd(CTX, int fd, MSG)
+{
+	const struct cmd* cd;
+	int cmd = uc_repcode(msg);
+	int ret;
+	char cbuf[16];
+	struct ucbuf uc;
+
+	for(cd = commands; cd < ARRAY_END(commands); cd++)
+		if(cd->cmd == cmd)
+			break;
+
+	if(cd >= ARRAY_END(commands))
+		ret = -ENOSYS;
+	else if((ret = cd->call(ctx, fd, msg)) > 0)
+		return ret;
+
+	uc_buf_set(&uc, cbuf, sizeof(cbuf));
+	uc_put_hdr(&uc, ret);
+
+	return reply(fd, &uc);
+}
+
+void check_client(CTX, int i)
+{
+	int ret, fd = ctx->conns[i];
+	struct ucattr* msg;
+	char buf[100];
+
+	if((ret = uc_recv(fd, buf, sizeof(buf))) == -EAGAIN)
+		return;
+	if(ret < 0)
+		goto out;
+	if(!(msg = uc_msg(buf, ret)))
+		goto out;
+	if(dispatch_cmd(ctx, fd, msg) >= 0)
+		return;
+out:
+	close_client(ctx, i);
+}
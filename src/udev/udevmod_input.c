@@ -45,7 +45,7 @@ static void append(CTX, char* str)
 {
 	int len = strlen(str);
 
-	int size = sizeof(ctx->uevent) - 2;
+	int size = UEVENT;
 	int left = size - ctx->ptr;
 
 	if(len + 1 >= left)
@@ -366,6 +366,11 @@ void init_inputs(CTX)
 	touch(HERE "/run/udev/control");
 }
 
+void rescan_inputs(CTX)
+{
+	scan_devices(ctx);
+}
+
 /* These two are called for incoming messages with subsystem="input".
    There are two kinds of messages (and devices), inputN and eventM:
 
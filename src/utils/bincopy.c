@@ -4,7 +4,14 @@
 #include <sys/fprop.h>
 #include <sys/splice.h>
 #include <sys/ioctl.h>
-
+#include <sys/proc.h>
+#include <sys/prctl.h>
+#include <sys/signal.h>
+#include <sys/sync.h>
+#include <sys/time.h>
+
+#include <crypto/sha256.h>
+#include <format.h>
 #include <string.h>
 #include <util.h>
 #include <main.h>
@@ -13,10 +20,15 @@ ERRTAG("bincopy");
 ERRLIST(NEAGAIN NEBADF NEFAULT NEINTR NEINVAL NEIO NEISDIR
 	NEFBIG NENOSPC NEPERM NEPIPE NENOENT NEEXIST);
 
-#define OPTS "rwz"
+#define OPTS "rwzdscpt"
 #define OPT_r (1<<0)
 #define OPT_w (1<<1)
 #define OPT_z (1<<2)
+#define OPT_d (1<<3)	/* O_DIRECT */
+#define OPT_s (1<<4)	/* sparse, skip zero blocks */
+#define OPT_c (1<<5)	/* check (verify) the copy */
+#define OPT_p (1<<6)	/* progress */
+#define OPT_t (1<<7)	/* trim (discard) instead of zeroing */
 
 #define SET_size (1<<16)
 
@@ -26,6 +38,7 @@ struct file {
 	char* name;
 	int fd;
 	int type;
+	int direct;
 	uint64_t size;
 	uint64_t off;
 };
@@ -135,7 +148,9 @@ static void parseopts(struct bcp* ctx, int argc, char** argv)
 
 static char* mmapempty(long size)
 {
-	void* ptr = sys_mmap(NULL, size, PROT_READ, MAP_ANONYMOUS, -1, 0);
+	int prot = PROT_READ | PROT_WRITE;
+	int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+	void* ptr = sys_mmap(NULL, size, prot, flags, -1, 0);
 
 	if(mmap_error(ptr))
 		fail("mmap", NULL, (long)ptr);
@@ -145,18 +160,37 @@ static char* mmapempty(long size)
 
 /* Struct file utils */
 
-static void openstat(struct file* f, long flags)
+/* O_DIRECT needs aligned offsets, and not every filesystem supports it
+   (tmpfs does not). Not getting it is not an error, the copy just goes
+   through the page cache then. */
+
+#define ALIGN 4096
+
+static void openstat(struct file* f, long flags, int direct)
 {
 	struct stat st;
 	int fd, ret;
 
+	if(f->off % ALIGN)
+		direct = 0;
+
+	if(!direct)
+		;
+	else if((fd = sys_open3(f->name, flags | O_DIRECT, 0666)) >= 0)
+		goto open;
+	else if(fd != -EINVAL)
+		fail("cannot open", f->name, fd);
+
 	if((fd = sys_open3(f->name, flags, 0666)) < 0)
 		fail("cannot open", f->name, fd);
 
+	direct = 0;
+open:
 	if((ret = sys_fstat(fd, &st)) < 0)
 		fail("cannot stat", f->name, ret);
 
 	f->fd = fd;
+	f->direct = direct;
 	f->type = st.mode & S_IFMT;
 
 	if(f->type != S_IFBLK)
@@ -296,8 +330,420 @@ static void readwrite(struct file* dst, struct file* src, uint64_t size)
 	sys_munmap(buf, blen);
 }
 
+/* Buffered copy, used whenever any of -dscp is given. The source is read
+   by a forked child into a ring of shared buffers while the parent writes
+   out the ones already filled, so reading and writing overlap. Buffer
+   indexes are passed back and forth through a pair of pipes; the child
+   fills them in order and the parent knows the sizes, so a single byte
+   per buffer is enough.
+
+   The parent also does everything that needs to look at the data:
+   hashing for -c, zero block detection for -s, and progress reports.
+
+   The ring depth is fixed rather than tunable. There is exactly one
+   reader and one writer, each with at most one block in flight, so two
+   buffers already let them overlap; the other two only absorb short
+   stalls on either side. Deeper rings would not raise the throughput of
+   a single sequential stream, they would only hold more data that has
+   been read but not yet written. */
+
+#define BLOCK (1024*1024)
+#define DEPTH 4
+
+struct pump {
+	struct bcp* ctx;
+	struct file* dst;	/* NULL for the verification pass */
+	struct file* src;
+	uint64_t size;
+	uint64_t hole;		/* dst is all zeroes past this offset */
+
+	char* bufs;
+	int full[2];
+	int free[2];
+	int pid;
+
+	struct sha256 sh;
+	uint64_t done;
+	uint64_t start;
+	uint64_t shown;
+};
+
+static void undirect(struct file* f)
+{
+	int ret, flags;
+
+	if((flags = sys_fcntl(f->fd, F_GETFL)) < 0)
+		fail("fcntl", f->name, flags);
+	if((ret = sys_fcntl3(f->fd, F_SETFL, flags & ~O_DIRECT)) < 0)
+		fail("fcntl", f->name, ret);
+
+	f->direct = 0;
+}
+
+static void readblock(struct file* src, char* buf, long len, uint64_t off)
+{
+	long rd;
+
+	if(src->direct && (len % ALIGN))
+		undirect(src);
+
+	while(len > 0) {
+		if(!sizable(src))
+			rd = sys_read(src->fd, buf, len);
+		else
+			rd = sys_pread(src->fd, buf, len, src->off + off);
+
+		if(rd < 0)
+			fail("read", src->name, rd);
+		if(!rd)
+			fail("unexpected EOF in", src->name, 0);
+
+		buf += rd;
+		off += rd;
+		len -= rd;
+	}
+}
+
+static void writeblock(struct file* dst, char* buf, long len, uint64_t off)
+{
+	long wr;
+
+	if(dst->direct && (len % ALIGN))
+		undirect(dst);
+
+	if(!sizable(dst)) {
+		if((wr = writeall(dst->fd, buf, len)) < 0)
+			fail("write", dst->name, wr);
+		return;
+	}
+
+	while(len > 0) {
+		if((wr = sys_pwrite(dst->fd, buf, len, dst->off + off)) <= 0)
+			fail("write", dst->name, wr);
+
+		buf += wr;
+		off += wr;
+		len -= wr;
+	}
+}
+
+static long blocklen(struct pump* pm, uint64_t off)
+{
+	uint64_t left = pm->size - off;
+
+	return left > BLOCK ? BLOCK : left;
+}
+
+static void reader(struct pump* pm)
+{
+	uint64_t off;
+	byte idx;
+	int ret;
+
+	for(off = 0; off < pm->size; off += blocklen(pm, off)) {
+		if((ret = sys_read(pm->free[0], &idx, 1)) <= 0)
+			_exit(0xFF); /* the parent is gone */
+
+		char* buf = pm->bufs + idx*BLOCK;
+
+		readblock(pm->src, buf, blocklen(pm, off), off);
+
+		if((ret = sys_write(pm->full[1], &idx, 1)) <= 0)
+			_exit(0xFF);
+	}
+
+	/* The parent keeps returning buffers until the end, wait for it
+	   to close the pipe so it would not get SIGPIPE. */
+
+	while(sys_read(pm->free[0], &idx, 1) > 0)
+		;
+
+	_exit(0);
+}
+
+static void start_reader(struct pump* pm)
+{
+	int prot = PROT_READ | PROT_WRITE;
+	int flags = MAP_SHARED | MAP_ANONYMOUS;
+	int i, ret, pid;
+	char* bufs;
+
+	bufs = sys_mmap(NULL, DEPTH*BLOCK, prot, flags, -1, 0);
+
+	if((ret = mmap_error(bufs)))
+		fail("mmap", NULL, ret);
+	if((ret = sys_pipe(pm->full)) < 0)
+		fail("pipe", NULL, ret);
+	if((ret = sys_pipe(pm->free)) < 0)
+		fail("pipe", NULL, ret);
+
+	pm->bufs = bufs;
+
+	for(i = 0; i < DEPTH; i++) {
+		byte idx = i;
+		sys_write(pm->free[1], &idx, 1);
+	}
+
+	if((pid = sys_fork()) < 0)
+		fail("fork", NULL, pid);
+
+	if(pid == 0) {
+		sys_prctl(PR_SET_PDEATHSIG, SIGTERM, 0, 0, 0);
+		sys_close(pm->full[0]);
+		sys_close(pm->free[1]);
+		reader(pm);
+	}
+
+	sys_close(pm->full[1]);
+	sys_close(pm->free[0]);
+
+	pm->pid = pid;
+}
+
+static void stop_reader(struct pump* pm)
+{
+	int ret, status;
+
+	sys_close(pm->full[0]);
+	sys_close(pm->free[1]);
+
+	if((ret = sys_waitpid(pm->pid, &status, 0)) < 0)
+		fail("wait", NULL, ret);
+	if(status)
+		_exit(0xFF); /* the child has reported the error */
+
+	sys_munmap(pm->bufs, DEPTH*BLOCK);
+}
+
+static void hashblock(struct pump* pm, char* buf, long len, uint64_t off)
+{
+	char* p = buf;
+	char* e = buf + len;
+
+	while(e - p >= 64) {
+		sha256_proc(&pm->sh, p);
+		p += 64;
+	}
+
+	if(off + len >= pm->size)
+		sha256_last(&pm->sh, p, e - p, pm->size);
+}
+
+static int allzero(char* buf, long len)
+{
+	ulong* p = (ulong*)buf;
+	ulong* e = (ulong*)(buf + len - len % sizeof(ulong));
+	char* q;
+
+	for(; p < e; p++)
+		if(*p) return 0;
+
+	for(q = (char*)e; q < buf + len; q++)
+		if(*q) return 0;
+
+	return 1;
+}
+
+static int unsupported(int ret)
+{
+	return (ret == -EOPNOTSUPP || ret == -ENOSYS
+	     || ret == -EINVAL || ret == -ENOTTY);
+}
+
+/* Zeroing ranges without writing out the zeroes. On regular files, this
+   means punching holes. On block devices, BLKZEROOUT lets the device do
+   it (WRITE ZEROES / unmap) if it can, and the kernel falls back to
+   writing zero pages if it cannot. */
+
+static int zerorange(struct file* dst, uint64_t off, uint64_t len)
+{
+	const int flags = FALLOC_FL_KEEP_SIZE | FALLOC_FL_PUNCH_HOLE;
+	uint64_t range[2] = { dst->off + off, len };
+	long ret;
+
+	if(regular(dst))
+		ret = sys_fallocate(dst->fd, flags, range[0], range[1]);
+	else if(dst->type == S_IFBLK)
+		ret = sys_ioctl(dst->fd, BLKZEROOUT, range);
+	else
+		return 0;
+
+	if(ret >= 0)
+		return 1;
+	if(unsupported(ret))
+		return 0;
+
+	fail("cannot zero out", dst->name, ret);
+}
+
+static int skipzero(struct pump* pm, char* buf, long len, uint64_t off)
+{
+	struct file* dst = pm->dst;
+
+	if(!(pm->ctx->opts & OPT_s))
+		return 0;
+	if(!allzero(buf, len))
+		return 0;
+	if(off >= pm->hole)
+		return 1;
+
+	return zerorange(dst, off, len);
+}
+
+static uint64_t now_ms(void)
+{
+	struct timespec ts;
+
+	sys_clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.sec*1000 + ts.nsec/1000000;
+}
+
+static void report(struct pump* pm, int last)
+{
+	uint64_t now = now_ms();
+
+	if(!(pm->ctx->opts & OPT_p))
+		return;
+	if(!last && now - pm->shown < 1000)
+		return;
+
+	uint64_t ms = now - pm->start;
+	uint64_t rate = ms ? pm->done*1000/ms : 0;
+
+	FMTBUF(p, e, buf, 100);
+
+	p = fmtstr(p, e, "\r");
+	p = fmtstr(p, e, pm->dst ? "copied " : "verified ");
+	p = fmtsize(p, e, pm->done);
+	p = fmtstr(p, e, " of ");
+	p = fmtsize(p, e, pm->size);
+
+	if(rate) {
+		p = fmtstr(p, e, ", ");
+		p = fmtsize(p, e, rate);
+		p = fmtstr(p, e, "/s");
+	}
+
+	p = fmtstr(p, e, "   ");
+
+	if(last)
+		p = fmtstr(p, e, "\n");
+
+	writeall(STDERR, buf, p - buf);
+
+	pm->shown = now;
+}
+
+static void pump(struct pump* pm, byte hash[32])
+{
+	uint64_t off;
+	byte idx;
+	int ret;
+
+	sha256_init(&pm->sh);
+
+	pm->start = pm->shown = now_ms();
+	pm->done = 0;
+
+	start_reader(pm);
+
+	for(off = 0; off < pm->size; off += blocklen(pm, off)) {
+		long len = blocklen(pm, off);
+
+		if((ret = sys_read(pm->full[0], &idx, 1)) <= 0) {
+			stop_reader(pm);
+			fail("reader exited early", NULL, 0);
+		}
+
+		char* buf = pm->bufs + idx*BLOCK;
+
+		if(hash)
+			hashblock(pm, buf, len, off);
+		if(!pm->dst)
+			;
+		else if(skipzero(pm, buf, len, off))
+			;
+		else writeblock(pm->dst, buf, len, off);
+
+		pm->done += len;
+		report(pm, 0);
+
+		if((ret = sys_write(pm->free[1], &idx, 1)) <= 0)
+			fail("write", "pipe", ret);
+	}
+
+	stop_reader(pm);
+
+	if(!pm->size)
+		sha256_last(&pm->sh, NULL, 0, 0);
+	if(hash)
+		sha256_fini(&pm->sh, hash);
+
+	report(pm, 1);
+}
+
+/* With -c, the source data gets hashed on the way, and once everything is
+   written and synced, the destination range gets read back and hashed.
+   The read-back uses O_DIRECT when possible, to get the data from the
+   device and not from the page cache. */
+
+static void verify(struct pump* pm, byte hash[32])
+{
+	struct file* dst = pm->dst;
+	struct file copy = *dst;
+	byte check[32];
+	int ret;
+
+	if((ret = sys_fdatasync(dst->fd)) < 0)
+		fail("fdatasync", dst->name, ret);
+
+	openstat(&copy, O_RDONLY, 1);
+
+	pm->src = &copy;
+	pm->dst = NULL;
+
+	pump(pm, check);
+
+	closefile(&copy);
+
+	if(memcmp(hash, check, 32))
+		fail("verification failed for", dst->name, 0);
+}
+
+static void pipeline(struct bcp* ctx, struct file* dst, struct file* src)
+{
+	struct pump pm;
+	byte hash[32];
+	int check = ctx->opts & OPT_c;
+
+	memzero(&pm, sizeof(pm));
+
+	pm.ctx = ctx;
+	pm.dst = dst;
+	pm.src = src;
+	pm.size = ctx->size;
+	pm.hole = regular(dst) ? dst->size - dst->off : pm.size;
+
+	if(check && !sizable(dst))
+		fail("cannot verify", dst->name, 0);
+
+	pump(&pm, check ? hash : NULL);
+
+	if(regular(dst) && dst->off + pm.size > dst->size)
+		truncate(dst, dst->off + pm.size);
+	if(check)
+		verify(&pm, hash);
+
+	closefile(dst);
+	closefile(src);
+}
+
 static void transfer(struct bcp* ctx, struct file* dst, struct file* src)
 {
+	if(ctx->opts & (OPT_d | OPT_s | OPT_c | OPT_p))
+		return pipeline(ctx, dst, src);
+
 	seekfile(dst);
 	seekfile(src);
 
@@ -320,14 +766,14 @@ static void wmode(struct bcp* ctx)
 	int opts = ctx->opts;
 	int setsize = opts & SET_size;
 
-	openstat(src, O_RDONLY);
+	openstat(src, O_RDONLY, opts & OPT_d);
 
 	if(!setsize && sizable(src))
 		ctx->size = src->size;
 	else if(!setsize)
 		fail("transfer size must be specified for", src->name, 0);
 
-	openstat(dst, O_WRONLY);
+	openstat(dst, O_WRONLY, opts & OPT_d);
 
 	if(!sizable(dst))
 		fail("refusing to write to", dst->name, 0);
@@ -346,7 +792,7 @@ static void rmode(struct bcp* ctx)
 	int opts = ctx->opts;
 	int setsize = opts & SET_size;
 
-	openstat(src, O_RDONLY);
+	openstat(src, O_RDONLY, opts & OPT_d);
 
 	if(!setsize && sizable(src))
 		ctx->size = src->size - src->off;
@@ -355,10 +801,10 @@ static void rmode(struct bcp* ctx)
 	if(!checksize(src, ctx->size))
 		fail("cannot read past EOF in", src->name, 0);
 
-	openstat(dst, O_WRONLY | O_CREAT);
+	openstat(dst, O_WRONLY | O_CREAT, opts & OPT_d);
 
 	if(regular(dst) && ctx->size + dst->off >= dst->size)
-		truncate(dst, dst->off);
+		truncate(dst, dst->size = dst->off);
 
 	transfer(ctx, dst, src);
 }
@@ -371,18 +817,18 @@ static void truncate2(struct file* dst, uint64_t size)
 	truncate(dst, dst->off + size);
 }
 
-static int zerohole(struct file* dst, uint64_t size)
-{
-	const int flags = FALLOC_FL_KEEP_SIZE | FALLOC_FL_PUNCH_HOLE;
-
-	long ret = sys_fallocate(dst->fd, flags, dst->off, size);
+/* Unlike zeroing, discarding leaves the contents undefined on most
+   devices. That's fine for flash that is about to be re-imaged. */
 
-	if(!ret)
-		return 1;
-	if(ret == -EOPNOTSUPP || ret == -ENOSYS)
-		return 0;
+static void discard(struct file* dst, uint64_t size)
+{
+	uint64_t range[2] = { dst->off, size };
+	int ret;
 
-	fail("cannot fallocate", dst->name, ret);
+	if(dst->type != S_IFBLK)
+		fail("not a block device:", dst->name, 0);
+	if((ret = sys_ioctl(dst->fd, BLKDISCARD, range)) < 0)
+		fail("cannot discard", dst->name, ret);
 }
 
 static void zerommap(struct file* dst, uint64_t size)
@@ -429,7 +875,7 @@ static void zwmode(struct bcp* ctx)
 	int opts = ctx->opts;
 	int setsize = opts & SET_size;
 
-	openstat(dst, O_WRONLY);
+	openstat(dst, O_WRONLY, 0);
 
 	uint64_t size = setsize ? ctx->size : dst->size - dst->off;
 	uint64_t end = dst->off + size;
@@ -437,15 +883,13 @@ static void zwmode(struct bcp* ctx)
 	if(end > dst->size)
 		fail("refusing to write past EOF in", dst->name, 0);
 
-	if(regular(dst)) {
-		if(end == dst->size)
-			truncate2(dst, size);
-		else if(zerohole(dst, size))
-			;
-		else zerommap(dst, size);
-	} else {
-		zerommap(dst, size);
-	}
+	if(opts & OPT_t)
+		discard(dst, size);
+	else if(regular(dst) && end == dst->size)
+		truncate2(dst, size);
+	else if(zerorange(dst, 0, size))
+		;
+	else zerommap(dst, size);
 
 	closefile(dst);
 }
@@ -458,7 +902,7 @@ static void zrmode(struct bcp* ctx)
 	int opts = ctx->opts;
 	int setsize = opts & SET_size;
 
-	openstat(dst, O_WRONLY);
+	openstat(dst, O_WRONLY, 0);
 
 	uint64_t size = setsize ? ctx->size : dst->size - dst->off;
 
@@ -74,6 +74,34 @@ static void open_target_dir(CTX, CCT)
 	cct->dst.dir = dst;
 }
 
+/* Subtrees get copied by forked processes, see copy_tree.c, and the only
+   thing they need to share is the hardlinks table, see copy_file.c. */
+
+#define SHSIZE (4*1024*1024)
+#define MAXPROCS 16
+
+static void prep_shared(CTX, CCT)
+{
+	int prot = PROT_READ | PROT_WRITE;
+	int flags = MAP_SHARED | MAP_ANONYMOUS;
+	struct shared* sh;
+	int ret, procs;
+
+	sh = sys_mmap(NULL, SHSIZE, prot, flags, -1, 0);
+
+	if((ret = mmap_error(sh)))
+		fail("mmap", NULL, ret);
+
+	sh->size = SHSIZE - sizeof(*sh);
+
+	if((procs = ncpus()) > MAXPROCS)
+		procs = MAXPROCS;
+
+	ctx->sh = sh;
+	ctx->procs = procs;
+	ctx->topat = cct->dst.at;
+}
+
 static int prep_opts(CTX, int argc, char** argv)
 {
 	int i = 1, opts = 0;
@@ -145,6 +173,8 @@ int main(int argc, char** argv)
 	if(opts & OPT_t)
 		open_target_dir(ctx, &cct);
 
+	prep_shared(ctx, &cct);
+
 	if(opts & (OPT_t | OPT_h))
 		tryrun(copy_many, ctx, &cct);
 	else if(opts & (OPT_n | OPT_o))
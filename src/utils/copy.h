@@ -24,13 +24,24 @@ struct top {
 	int uid;
 	int gid;
 
-	void* brk;
-	void* ptr;
-	void* end;
+	int topat;
+	int procs;
+	struct shared* sh;
+	struct jobs* jobs;
 
 	int errors;
 };
 
+/* Shared between all the processes copying the tree */
+
+struct shared {
+	int lock;
+	int running;
+	ulong used;
+	ulong size;
+	char data[];
+};
+
 struct atf {
 	int at;
 	char* dir;
@@ -43,19 +54,22 @@ struct cct {
 	struct atf dst;
 	struct atf src;
 	struct stat st;
+	char* rel;
 	int wrchecked;
+	int noclone;
+	int nocopyrange;
 	int nosendfile;
-	int dstatdup;
 };
 
 struct link {
 	int len;
-	int at;
+	int state;
+	int pid;
 	uint64_t sdev;
 	uint64_t sino;
 	uint64_t ddev;
 	uint64_t dino;
-	char name[];
+	char path[];
 };
 
 #define CTX struct top* ctx
@@ -70,8 +84,7 @@ void failat(const char* msg, struct atf* dd, int err) noreturn;
 void run(CCT, char* dst, char* src);
 
 void copyfile(CCT);
+void drop_claim(void);
 void trychown(CCT);
 
-void note_ino(CCT);
-
-int link_dst(CCT);
+void check_workers(CTX);
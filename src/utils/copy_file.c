@@ -4,6 +4,12 @@
 #include <sys/fprop.h>
 #include <sys/mman.h>
 #include <sys/splice.h>
+#include <sys/sched.h>
+#include <sys/ioctl.h>
+#include <sys/creds.h>
+#include <sys/signal.h>
+
+#include <bits/ioctl/clone.h>
 
 #include <format.h>
 #include <memoff.h>
@@ -17,7 +23,48 @@
 
 #define RWBUFSIZE 1024*1024
 
-static int sendfile(CCT, off_t* size)
+/* Errors indicating the call is not supported for this pair of files,
+   as opposed to errors indicating something went wrong. */
+
+static int unsupported(int ret)
+{
+	return (ret == -EXDEV || ret == -EINVAL || ret == -ENOSYS
+	     || ret == -EOPNOTSUPP || ret == -ENOTTY);
+}
+
+/* Reflink, for CoW filesystems (btrfs, xfs, bcachefs). The whole file
+   gets cloned in one call without copying the data at all. */
+
+static int clone(CCT)
+{
+	int sfd = cct->src.fd;
+	int dfd = cct->dst.fd;
+	int ret;
+
+	if(cct->noclone)
+		return -1;
+	if((ret = sys_ioctli(dfd, FICLONE, sfd)) >= 0)
+		return 0;
+	if(!unsupported(ret))
+		failat("clone", &cct->dst, ret);
+
+	cct->noclone = 1;
+
+	return -1;
+}
+
+/* In-kernel copy. Unlike sendfile, this can be offloaded to the fs
+   (NFS, SMB server-side copy) and works for any pair of regular files
+   on reasonably recent kernels.
+
+   Both in-kernel methods count the remaining bytes down in *left.
+   A zero return before everything has been copied means a short copy
+   (some filesystems do that instead of reporting an error), in which
+   case the rest gets passed to the next method down the list. */
+
+#define MAXRUN 0x7ffff000
+
+static int copyrange(CCT, off_t* left)
 {
 	struct atf* dst = &cct->dst;
 	struct atf* src = &cct->src;
@@ -25,34 +72,65 @@ static int sendfile(CCT, off_t* size)
 	int sfd = src->fd;
 	int dfd = dst->fd;
 
-	off_t done = 0;
+	off_t size = *left;
 	long ret = 0;
-	long run = 0x7ffff000;
+	long run;
 
-	if(*size < run)
-		run = *size;
+	while(*left > 0) {
+		run = *left < MAXRUN ? *left : MAXRUN;
 
-	while(1) {
-		if(done >= *size)
+		if((ret = sys_copy_file_range(sfd, NULL, dfd, NULL, run, 0)) <= 0)
 			break;
+
+		*left -= ret;
+	}
+
+	if(ret >= 0)
+		return *left > 0 ? -1 : 0;
+	if(*left < size || !unsupported(ret))
+		failat("copy_file_range", dst, ret);
+
+	cct->nocopyrange = 1;
+
+	return -1;
+}
+
+static int sendfile(CCT, off_t* left)
+{
+	struct atf* dst = &cct->dst;
+	struct atf* src = &cct->src;
+
+	int sfd = src->fd;
+	int dfd = dst->fd;
+
+	off_t size = *left;
+	long ret = 0;
+	long run;
+
+	while(*left > 0) {
+		run = *left < MAXRUN ? *left : MAXRUN;
+
 		if((ret = sys_sendfile(dfd, sfd, NULL, run)) <= 0)
 			break;
-		done += ret;
-	};
+
+		*left -= ret;
+	}
 
 	if(ret >= 0)
-		return 0;
-	if(!done && ret == -EINVAL)
-		return -1;
+		return *left > 0 ? -1 : 0;
+	if(*left < size || ret != -EINVAL)
+		failat("sendfile", dst, ret);
 
-	failat("sendfile", dst, ret);
+	cct->nosendfile = 1;
+
+	return -1;
 }
 
 static void alloc_rw_buf(CTX)
 {
 	long len = RWBUFSIZE;
 	int prot = PROT_READ | PROT_WRITE;
-	int flags = MAP_ANONYMOUS;
+	int flags = MAP_PRIVATE | MAP_ANONYMOUS;
 	char* buf = sys_mmap(NULL, len, prot, flags, -1, 0);
 
 	if(mmap_error(buf))
@@ -62,7 +140,10 @@ static void alloc_rw_buf(CTX)
 	ctx->len = len;
 }
 
-static void readwrite(CCT, off_t* size)
+/* Last resort. If the source file got shorter since stat(), the copy
+   ends at the actual EOF here, the same way cat would do it. */
+
+static void readwrite(CCT, off_t* left)
 {
 	struct atf* dst = &cct->dst;
 	struct atf* src = &cct->src;
@@ -71,52 +152,59 @@ static void readwrite(CCT, off_t* size)
 	if(!ctx->buf)
 		alloc_rw_buf(ctx);
 
-	off_t done = 0;
-
 	char* buf = ctx->buf;
-	size_t len = ctx->len;
-
-	if(mem_off_cmp(len, *size) > 0)
-		len = *size;
+	size_t len;
 
 	int rd = 0, wr;
 	int sfd = src->fd;
 	int dfd = dst->fd;
 
-	while(1) {
-		if(done >= *size)
-			break;
+	while(*left > 0) {
+		len = ctx->len;
+
+		if(mem_off_cmp(len, *left) > 0)
+			len = *left;
 		if((rd = sys_read(sfd, buf, len)) <= 0)
 			break;
 		if((wr = writeall(dfd, buf, rd)) < 0)
 			failat("write", dst, wr);
-		done += rd;
+
+		*left -= rd;
 	} if(rd < 0) {
 		failat("read", src, rd);
 	}
 }
 
-/* Sendfile may not work on a given pair of descriptors for various reasons.
-   If this happens, fall back to read/write calls.
+/* Neither copy_file_range nor sendfile may work on a given pair of
+   descriptors, for various reasons. If this happens, fall back to the next
+   method, down to plain read/write calls.
 
    Generally the reasons depend on directory (and the underlying fs), so if
-   sendfile fails for one file we stop using it for the whole directory. */
+   some method fails for one file we stop using it for the whole directory.
+   Short copies do not count as failures, only the remaining part of the
+   block gets passed down. */
 
 static void moveblock(CCT, off_t* size)
 {
+	off_t left = *size;
+
+	if(cct->nocopyrange)
+		;
+	else if(copyrange(cct, &left) >= 0)
+		return;
+
 	if(cct->nosendfile)
 		;
-	else if(sendfile(cct, size) >= 0)
+	else if(sendfile(cct, &left) >= 0)
 		return;
-	else
-		cct->nosendfile = 1;
 
-	readwrite(cct, size);
+	readwrite(cct, &left);
 }
 
-/* Except for the last line, the code below is only there to deal with sparse
-   files. See lseek(2) for explanation. The idea is to seek over the holes and
-   only write data-filled blocks.
+/* Cloning preserves holes, so it goes first. Other than that and the last
+   line, the code below is only there to deal with sparse files. See lseek(2)
+   for explanation. The idea is to seek over the holes and only write
+   data-filled blocks.
 
    Non-sparse files contain one block spanning the whole file and no holes,
    so a single call to moveblock is enough.
@@ -133,6 +221,8 @@ static void transfer(CCT)
 	int wfd = cct->dst.fd;
 	int ret;
 
+	if(clone(cct) >= 0)
+		return;
 	if(512*st->blocks >= st->size)
 		goto plain;
 
@@ -143,7 +233,7 @@ static void transfer(CCT)
 
 	if(((sys_llseek(rfd, 0, &ds, SEEK_DATA)) < 0) || ds >= size)
 		goto plain;
-	if(((sys_llseek(rfd, ds, &de, SEEK_HOLE)) < 0) || de >= size)
+	if(((sys_llseek(rfd, ds, &de, SEEK_HOLE)) < 0) || (!ds && de >= size))
 		goto plain;
 
 	sys_ftruncate(wfd, size);
@@ -169,6 +259,9 @@ static void transfer(CCT)
 	return;
 
 plain:
+	if((ret = sys_seek(rfd, 0)) < 0) /* SEEK_DATA/SEEK_HOLE moved it */
+		fail("seek", rname, ret);
+
 	moveblock(cct, &st->size);
 }
 
@@ -225,28 +318,70 @@ static void open_dst(CCT)
    should hold for dst/a and dst/b, but dst/a should still refer to a copy
    of src/a.
 
-   To achieve this, we remember destination (at,name) and source (dev:ino)
+   To achieve this, we remember destination path and source (dev:ino)
    the first time we copy a file with nlink > 1, and try to link to that
    first copy when we encounter the same source (dev:ino) again.
 
-   Directory handle $at must remain open way long than it would otherwise,
-   so we just dup() it and let the original be closed as usual. Keeping the
-   original one open would mess up the tree-walking code a lot for no good
-   reason. Hard links are presumably rare.
+   Subtrees may be copied by different processes (see copy_tree.c), so
+   the records are kept in a shared mapping, and the destination is stored
+   as a path relative to the top-level at-dir which all of them share.
 
-   This wastes one fd for each directory with multi-linked files in it.
-   Typical open file limit in Linux is around 1024, so we should be good. */
+   Two processes may run into the same source file at the same time.
+   The first one to record it makes the copy, the other one waits for
+   the copy to be done and then links to it.
+
+   The process making the copy may die half-way through. failat() marks
+   its claim failed before exiting, and the waiting side also gives up
+   once the owner is gone, whatever the reason. Either way the waiting
+   process ends up making its own copy. */
+
+#define LN_PENDING 1
+#define LN_DONE    2
+#define LN_FAILED  3
+
+static struct link* claimed; /* pending claim of this process */
+
+static void pause(CTX)
+{
+	struct timespec ts = { 0, 100*1000 };
+
+	check_workers(ctx);
+
+	sys_nanosleep(&ts, NULL);
+}
+
+static void lock(CTX)
+{
+	struct shared* sh = ctx->sh;
+
+	while(__atomic_exchange_n(&sh->lock, 1, __ATOMIC_ACQUIRE))
+		pause(ctx);
+}
+
+static void unlock(CTX)
+{
+	struct shared* sh = ctx->sh;
+
+	__atomic_store_n(&sh->lock, 0, __ATOMIC_RELEASE);
+}
+
+static int get_state(struct link* ln)
+{
+	return __atomic_load_n(&ln->state, __ATOMIC_ACQUIRE);
+}
+
+static void set_state(struct link* ln, int state)
+{
+	__atomic_store_n(&ln->state, state, __ATOMIC_RELEASE);
+}
 
 static struct link* find_link(CCT)
 {
-	struct top* ctx = cct->top;
+	struct shared* sh = cct->top->sh;
 	struct stat* st = &cct->st;
 
-	if(!ctx->brk)
-		return NULL;
-
-	char* p = ctx->brk;
-	char* e = ctx->ptr;
+	char* p = sh->data;
+	char* e = sh->data + sh->used;
 
 	while(p < e) {
 		struct link* ln = (struct link*) p;
@@ -262,94 +397,129 @@ static struct link* find_link(CCT)
 	return NULL;
 }
 
-static int linklen(int slen)
+static int align8(int len)
 {
-	return sizeof(struct link) + slen + 1;
+	return (len + 7) & ~7;
 }
 
-static int align4(int len)
+static int relpath_len(CCT)
 {
-	return len + (4 - len%4) % 4;
+	char* rel = cct->rel;
+	char* name = cct->dst.name;
+
+	return (rel ? strlen(rel) + 1 : 0) + strlen(name) + 1;
 }
 
-static struct link* alloc_link(CCT, int len)
+static void make_relpath(CCT, char* buf, int len)
+{
+	char* p = buf;
+	char* e = buf + len - 1;
+	char* rel = cct->rel;
+
+	if(rel) {
+		p = fmtstr(p, e, rel);
+		p = fmtstr(p, e, "/");
+	}
+
+	p = fmtstr(p, e, cct->dst.name);
+
+	*p = '\0';
+}
+
+/* Either return the existing record, or make a new pending one
+   and return NULL, meaning the caller should make the copy. */
+
+static struct link* claim_link(CCT)
 {
 	struct top* ctx = cct->top;
+	struct shared* sh = ctx->sh;
+	struct stat* st = &cct->st;
+	struct link* ln;
 
-	if(!ctx->brk) {
-		void* brk = sys_brk(0);
-		void* new = sys_brk(brk + PAGE);
+	int plen = relpath_len(cct);
+	int alen = align8(sizeof(*ln) + plen);
 
-		if(brk_error(brk, new))
-			return NULL;
+	lock(ctx);
 
-		ctx->brk = brk;
-		ctx->ptr = brk;
-		ctx->end = new;
-	}
+	if((ln = find_link(cct)))
+		goto out;
+	if(sh->used + alen > sh->size)
+		goto out; /* no more links, just copy */
 
-	void* ptr = ctx->ptr;
-	void* req = ptr + len;
+	ln = (struct link*)(sh->data + sh->used);
 
-	if(req > ctx->end) {
-		void* end = ctx->end;
-		void* new = sys_brk(end + PAGE);
+	ln->state = LN_PENDING;
+	ln->pid = sys_getpid();
+	ln->sdev = st->dev;
+	ln->sino = st->ino;
+	ln->ddev = 0;
+	ln->dino = 0;
+	make_relpath(cct, ln->path, plen);
+	ln->len = alen;
 
-		if(brk_error(end, new))
-			return NULL;
+	sh->used += alen;
 
-		ctx->end = new;
-	}
+	claimed = ln;
+	ln = NULL;
+out:
+	unlock(ctx);
+
+	return ln;
+}
 
-	ctx->ptr = req;
+void drop_claim(void)
+{
+	struct link* ln = claimed;
+
+	if(!ln) return;
 
-	return ptr;
+	claimed = NULL;
+
+	set_state(ln, LN_FAILED);
 }
 
-void note_ino(CCT)
+static int owner_gone(struct link* ln)
+{
+	return sys_kill(ln->pid, 0) == -ESRCH;
+}
+
+static void note_ino(CCT)
 {
 	struct atf* dst = &cct->dst;
-	struct stat* st = &cct->st;
+	struct link* ln = claimed;
 	struct stat ds;
-	struct link* ln;
-	int ret;
 
-	char* name = dst->name;
-	int slen = strlen(name);
-	int alen = align4(linklen(slen));
+	if(!ln) return;
 
-	if(!(ln = alloc_link(cct, alen)))
-		return;
-	if((ret = sys_fstat(dst->fd, &ds)) < 0)
-		goto drop;
-	if(cct->dstatdup)
-		ln->at = cct->dstatdup;
-	else if((ret = sys_dup(dst->at)) < 0)
-		goto drop;
-	else
-		ln->at = cct->dstatdup = ret;
+	claimed = NULL;
+
+	if(dst->fd < 0 || sys_fstat(dst->fd, &ds) < 0)
+		return set_state(ln, LN_FAILED);
 
-	ln->sdev = st->dev;
-	ln->sino = st->ino;
 	ln->ddev = ds.dev;
 	ln->dino = ds.ino;
 
-	memcpy(ln->name, name, slen + 1);
-	ln->len = alen;
-
-	return;
-drop:
-	cct->top->ptr = ln;
+	set_state(ln, LN_DONE);
 }
 
-int link_dst(CCT)
+static int link_dst(CCT)
 {
+	struct top* ctx = cct->top;
 	struct atf* dst = &cct->dst;
 	struct link* ln;
 	struct stat ds;
 	int ret;
 
-	if(!(ln = find_link(cct)))
+	if(!(ln = claim_link(cct)))
+		return 0;
+
+	while(get_state(ln) == LN_PENDING)
+		if(owner_gone(ln))
+			return 0;
+		else
+			pause(ctx);
+
+	if(get_state(ln) != LN_DONE)
 		return 0;
 
 	if((ret = sys_unlinkat(AT(dst), 0)) >= 0)
@@ -357,7 +527,7 @@ int link_dst(CCT)
 	else if(ret != -ENOENT)
 		return 0;
 
-	if((ret = sys_linkat(AT(ln), AT(dst), 0)) < 0)
+	if((ret = sys_linkat(ctx->topat, ln->path, AT(dst), 0)) < 0)
 		return 0;
 
 	/* Check for mis-linking, fall back to copy if it happens.
@@ -386,15 +556,8 @@ void copyfile(CCT)
 
 	open_dst(cct);
 
-	if(dst->fd < 0)
-		return;
-	if(!st->size)
-		return;
-
-	transfer(cct);
-
-	if(st->nlink < 2)
-		return;
+	if(dst->fd >= 0 && st->size)
+		transfer(cct);
 
 	note_ino(cct);
 }
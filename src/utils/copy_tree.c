@@ -4,6 +4,9 @@
 #include <sys/fprop.h>
 #include <sys/mman.h>
 #include <sys/splice.h>
+#include <sys/proc.h>
+#include <sys/prctl.h>
+#include <sys/signal.h>
 
 #include <format.h>
 #include <string.h>
@@ -62,6 +65,7 @@ void warnat(const char* msg, struct atf* dd, int err)
 
 void failat(const char* msg, struct atf* dd, int err)
 {
+	drop_claim();
 	warnat(msg, dd, err);
 	_exit(-1);
 }
@@ -268,14 +272,138 @@ static int check_top_dst(CCT, char* name)
 	return access(dst->at, dir, X_OK | W_OK);
 }
 
+/* Subdirectories get copied in parallel, each in its own forked process,
+   up to ctx->procs processes total across the whole tree. The count of
+   running ones is kept in the shared area, so that nested directories
+   do not spawn more than that. When there are no free slots, the parent
+   just walks the subdirectory by itself.
+
+   There is no parallelism during the dry run, it's supposed to be quick
+   and it needs to count errors. */
+
+#define NJOBS 16
+
+struct jobs {
+	struct jobs* up;
+	int count;
+	int pids[NJOBS];
+};
+
+static int take_slot(CTX)
+{
+	struct shared* sh = ctx->sh;
+	int max = ctx->procs - 1;
+	int cur = __atomic_load_n(&sh->running, __ATOMIC_RELAXED);
+
+	while(cur < max)
+		if(__atomic_compare_exchange_n(&sh->running, &cur, cur + 1,
+				0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+			return 1;
+
+	return 0;
+}
+
+static void free_slot(CTX)
+{
+	__atomic_sub_fetch(&ctx->sh->running, 1, __ATOMIC_ACQ_REL);
+}
+
+static int spawn_subtree(CCT, struct jobs* jb, char* name)
+{
+	struct top* ctx = cct->top;
+	int pid;
+
+	if(set(cct, DRY))
+		return 0;
+	if(ctx->procs < 2)
+		return 0;
+	if(jb->count >= NJOBS)
+		return 0;
+	if(!take_slot(ctx))
+		return 0;
+
+	if((pid = sys_fork()) < 0) {
+		free_slot(ctx);
+		return 0;
+	} else if(pid == 0) {
+		sys_prctl(PR_SET_PDEATHSIG, SIGTERM, 0, 0, 0);
+		ctx->jobs = NULL; /* not our children */
+		runrec(cct, name, name, DT_DIR);
+		free_slot(ctx);
+		_exit(0);
+	}
+
+	jb->pids[jb->count++] = pid;
+
+	return 1;
+}
+
+static void check_status(int status)
+{
+	if(status)
+		_exit(-1); /* the child has reported the error already */
+}
+
+static void reap(int* pp, int flags)
+{
+	int pid = *pp;
+	int status;
+
+	if(pid <= 0)
+		return;
+	if(sys_waitpid(pid, &status, flags) <= 0)
+		return;
+
+	*pp = 0;
+
+	check_status(status);
+}
+
+/* Children fail the same way the main process does, by reporting
+   the error and exiting. Anything waiting for other processes must
+   check for that, otherwise it may end up waiting forever.
+
+   Only the recorded pids get reaped here, and their slots get cleared,
+   so that wait_subtrees() for the directory that spawned them does not
+   wait for them again. Waiting for any child would steal the workers
+   of the outer directories from their wait_subtrees() calls. */
+
+void check_workers(CTX)
+{
+	struct jobs* jb;
+	int i;
+
+	for(jb = ctx->jobs; jb; jb = jb->up)
+		for(i = 0; i < jb->count; i++)
+			reap(&jb->pids[i], WNOHANG);
+}
+
+/* Each directory waits for its own workers only. The directory may be
+   a subdirectory of another one being scanned by the same process, and
+   the outer workers may still be running. */
+
+static void wait_subtrees(CTX, struct jobs* jb)
+{
+	int i;
+
+	for(i = 0; i < jb->count; i++)
+		reap(&jb->pids[i], 0);
+
+	ctx->jobs = jb->up;
+}
+
 /* Tree walking routines. These are shared between the dry and the real runs,
    and it's leaf calls for specific file types (regular, symlink, directory)
    that have to check for or perform the action. */
 
 static void scan_directory(CCT)
 {
+	struct top* ctx = cct->top;
 	int rd, fd = cct->src.at;
 	char buf[1024];
+	struct jobs jb = { .up = ctx->jobs, .count = 0 };
+
+	ctx->jobs = &jb;
 
 	while((rd = sys_getdents(fd, buf, sizeof(buf))) > 0) {
 		char* p = buf;
@@ -288,13 +416,17 @@ static void scan_directory(CCT)
 
 			if(dotddot(de->name))
 				continue;
+			if(de->type == DT_DIR && spawn_subtree(cct, &jb, de->name))
+				continue;
 
 			runrec(cct, de->name, de->name, de->type);
 
 			if(cct->wrchecked < 0)
-				return; /* abort early during dryrun */
+				goto out; /* abort early during dryrun */
 		}
 	}
+out:
+	wait_subtrees(ctx, &jb);
 }
 
 static int open_src_dir(CCT)
@@ -385,10 +517,25 @@ static void directory(CCT)
 	makepath(spath, sizeof(spath), src);
 	makepath(dpath, sizeof(dpath), dst);
 
+	char* rel = cct->rel;
+	int rlen = (rel ? strlen(rel) + 1 : 0) + strlen(dst->name);
+
+	FMTBUF(p, e, rpath, rlen);
+
+	if(rel) {
+		p = fmtstr(p, e, rel);
+		p = fmtstr(p, e, "/");
+	}
+
+	p = fmtstr(p, e, dst->name);
+
+	FMTEND(p, e);
+
 	struct cct next;
 	memzero(&next, sizeof(next));
 
 	next.top = cct->top;
+	next.rel = rpath;
 	next.dst.at = dst->fd; next.dst.dir = dpath;
 	next.src.at = src->fd; next.src.dir = spath;
 	next.src.fd = -1;
@@ -1,6 +1,8 @@
 #include <sys/file.h>
 #include <sys/fpath.h>
 #include <sys/dents.h>
+#include <sys/proc.h>
+#include <sys/prctl.h>
 
 #include <string.h>
 #include <printf.h>
@@ -15,7 +17,7 @@
 #define OPT_d (1<<3)    /* rmdir */
 #define OPT_Z (1<<4)    /* no-keep-root */
 
-#define DEBUFSIZE 2048
+#define DEBUFSIZE 8192
 
 ERRTAG("del");
 ERRLIST(NEACCES NEBUSY NEFAULT NEIO NEISDIR NELOOP NENAMETOOLONG NENOENT
@@ -29,6 +31,9 @@ struct top {
 	uint64_t rino;
 
 	uint64_t sdev; /* starting dir */
+
+	int procs;     /* max number of workers */
+	int running;
 };
 
 struct rfn {
@@ -131,11 +136,113 @@ static int check_xdev(CTX, FN, int fd)
 	return 0;
 }
 
+/* Subdirectories of the top-level directory being removed get handed
+   off to forked workers, up to the number of CPUs, since independent
+   subtrees can be removed independently. The top directory itself can
+   only be removed once all the workers are done with it. */
+
+static void wait_worker(CTX)
+{
+	int opts = ctx->opts;
+	int ret, status;
+
+	if((ret = sys_waitpid(-1, &status, 0)) < 0) {
+		ctx->running = 0;
+		return;
+	}
+
+	ctx->running--;
+
+	if(status && !(opts & OPT_f))
+		_exit(-1);
+}
+
+static void spawn_worker(CTX, FN)
+{
+	int pid;
+
+	while(ctx->running >= ctx->procs)
+		wait_worker(ctx);
+
+	if((pid = sys_fork()) < 0) {
+		delete(ctx, fn, DT_DIR);
+	} else if(pid == 0) {
+		sys_prctl(PR_SET_PDEATHSIG, SIGTERM, 0, 0, 0);
+		ctx->procs = 0;
+		ctx->running = 0;
+		delete(ctx, fn, DT_DIR);
+		_exit(0);
+	} else {
+		ctx->running++;
+	}
+}
+
+/* Each getdents chunk is handled in two passes: all non-directories
+   first, in a tight sequence of unlinkat calls, then the directories.
+   Entries with DT_UNKNOWN type (filesystems not reporting d_type) are
+   tried as files, and EISDIR re-marks them as directories. Nothing
+   in this path needs stat, the only one is the per-directory xdev
+   check. */
+
+static void unlink_files(CTX, FN, char* buf, char* end)
+{
+	char* p = buf;
+	int ret;
+
+	while(p < end) {
+		struct dirent* de = (struct dirent*) p;
+		p += de->reclen;
+
+		if(!de->reclen)
+			break;
+		if(de->type == DT_DIR)
+			continue;
+		if(dotddot(de->name))
+			continue;
+
+		if((ret = sys_unlinkat(fn->at, de->name, 0)) >= 0)
+			;
+		else if(ret == -EISDIR)
+			continue;
+		else {
+			fn->name = de->name;
+			failat(ctx, fn, ret);
+		}
+
+		de->name[0] = '\0';
+	}
+}
+
+static void remove_dirs(CTX, FN, char* buf, char* end, int spawn)
+{
+	char* p = buf;
+
+	while(p < end) {
+		struct dirent* de = (struct dirent*) p;
+		p += de->reclen;
+
+		if(!de->reclen)
+			break;
+		if(!de->name[0])
+			continue;
+		if(dotddot(de->name))
+			continue;
+
+		fn->name = de->name;
+
+		if(spawn)
+			spawn_worker(ctx, fn);
+		else
+			delete(ctx, fn, DT_DIR);
+	}
+}
+
 static void enter(CTX, FN)
 {
 	int len = DEBUFSIZE;
 	char buf[len];
 	int fd, rd;
+	int spawn = (fn->at == AT_FDCWD && ctx->procs > 1);
 
 	if((fd = sys_openat(AT(fn), O_DIRECTORY)) < 0)
 		return failat(ctx, fn, fd);
@@ -148,24 +255,15 @@ static void enter(CTX, FN)
 		goto out;
 
 	while((rd = sys_getdents(fd, buf, len)) > 0) {
-		char* p = buf;
-		char* e = buf + rd;
-
-		while(p < e) {
-			struct dirent* de = (struct dirent*) p;
-			p += de->reclen;
-
-			if(!de->reclen)
-				break;
-			if(dotddot(de->name))
-				continue;
-
-			next.name = de->name;
+		char* end = buf + rd;
 
-			delete(ctx, &next, de->type);
-		}
-	};
+		unlink_files(ctx, &next, buf, end);
+		remove_dirs(ctx, &next, buf, end, spawn);
+	}
 out:
+	while(spawn && ctx->running > 0)
+		wait_worker(ctx);
+
 	sys_close(fd);
 };
 
@@ -209,6 +307,9 @@ int main(int argc, char** argv)
 
 	ctx.opts = opts;
 
+	if(!(opts & (OPT_n | OPT_d)))
+		ctx.procs = ncpus();
+
 	while(i < argc) {
 		char* name = argv[i++];
 		struct rfn fn = { AT_FDCWD, NULL, name };
@@ -0,0 +1,1222 @@
+#include <sys/file.h>
+#include <sys/dents.h>
+#include <sys/mman.h>
+#include <sys/proc.h>
+#include <sys/prctl.h>
+#include <sys/sched.h>
+#include <sys/statfs.h>
+
+#include <string.h>
+#include <format.h>
+#include <output.h>
+#include <util.h>
+#include <main.h>
+
+#define PAGE 4096
+
+#define OPTS "scbndailDt"
+#define OPT_s (1<<0)	/* size individual dirents */
+#define OPT_c (1<<1)	/* show total size */
+#define OPT_b (1<<2)	/* -an */
+#define OPT_n (1<<3)	/* show raw byte values, w/o KMG suffix */
+#define OPT_d (1<<4)	/* directories only */
+#define OPT_a (1<<5)	/* count apparent size */
+#define OPT_i (1<<6)	/* in given directories */
+#define OPT_l (1<<7)	/* count hardlinked files each time */
+#define OPT_D (1<<8)	/* show subdirectories down to given depth */
+#define OPT_t (1<<9)	/* only show N largest entries */
+
+#define DENTBUF 4096       /* getdents buffer, per directory level */
+#define NINODES (1<<12)    /* min inode set slots, must be a power of 2 */
+#define NPROBE 64          /* max inode set probes per lookup */
+#define ARENA (64<<20)     /* shared space for results */
+#define NODES (16<<20)     /* shared space for split-off directories */
+#define NQUEUE 256         /* split-off job queue slots */
+#define MAXPATH 4096       /* longest path a split-off job may get */
+
+#if BITS == 32
+#define MAXINODES (1<<20)
+#else
+#define MAXINODES (1<<24)
+#endif
+
+#define STATX_DU (STATX_TYPE | STATX_NLINK | STATX_INO | \
+                  STATX_SIZE | STATX_BLOCKS)
+
+ERRTAG("du");
+
+struct res {
+	int len;
+	int depth;
+	uint64_t size;
+	char name[];
+};
+
+struct job {
+	int len;
+	uint64_t size;
+	char path[];
+};
+
+struct node {
+	struct node* up;
+	int pending;
+	int depth;
+	uint64_t size;
+	char path[];
+};
+
+struct slot {
+	int state;
+	uint64_t dev;
+	uint64_t ino;
+};
+
+struct shared {
+	int lock;
+	int next;        /* next top-level job */
+	int head;        /* next split-off job */
+	int tail;        /* next free queue slot */
+	int undone;      /* jobs not yet finished */
+	int abort;
+	int incomplete;
+	int lost;
+	int full;
+	ulong used;      /* in the result arena */
+	ulong nused;     /* in the node arena */
+	struct node* queue[NQUEUE];
+};
+
+struct top {
+	int opts;
+
+	int argc;
+	int argi;
+	char** argv;
+
+	int depth;
+	int topn;
+
+	char* brk;
+	char* ptr;
+	char* end;
+
+	struct shared* sh;
+	char* arena;
+	char* nodes;
+	struct slot* inodes;
+	uint nslots;
+
+	char* jobs;
+	struct job** idx;
+	int njobs;
+	int nprocs;
+
+	uint64_t* best;
+	int nbest;
+
+	uint64_t total;
+};
+
+struct rfn {
+	int at;
+	char* dir;
+	char* name;
+};
+
+struct frame {
+	struct frame* up;
+	struct node* node;
+	char* path;
+	int depth;
+};
+
+struct info {
+	int mode;
+	uint nlink;
+	uint64_t dev;
+	uint64_t ino;
+	uint64_t size;
+	uint64_t blocks;
+};
+
+#define CTX struct top* ctx
+#define FN struct rfn* fn
+#define AT(dd) dd->at, dd->name
+
+/* Heap routines. The process-local heap holds the job list and the
+   dirent buffers, which get reset in scan_directory() once the directory
+   has been read. Results go into a shared arena instead, see below. */
+
+static void init_heap(CTX)
+{
+	void* brk = sys_brk(0);
+	void* end = sys_brk(brk + 2*PAGE);
+
+	if(brk_error(brk, end))
+		fail("cannot allocate memory", NULL, 0);
+
+	ctx->brk = brk;
+	ctx->ptr = brk;
+	ctx->end = end;
+}
+
+static void heap_extend(CTX, long need)
+{
+	need += (PAGE - need % PAGE) % PAGE;
+	char* req = ctx->end + need;
+	char* new = sys_brk(req);
+
+	if(mmap_error(new))
+		fail("cannot allocate memory", NULL, 0);
+
+	ctx->end = new;
+}
+
+static void* heap_alloc(CTX, int len)
+{
+	char* ptr = ctx->ptr;
+	long avail = ctx->end - ptr;
+
+	if(avail < len)
+		heap_extend(ctx, len - avail);
+
+	ctx->ptr += len;
+
+	return ptr;
+}
+
+static long heap_left(CTX)
+{
+	return ctx->end - ctx->ptr;
+}
+
+static void* map_shared(ulong size)
+{
+	int prot = PROT_READ | PROT_WRITE;
+	int flags = MAP_SHARED | MAP_ANONYMOUS | MAP_NORESERVE;
+	void* ptr = sys_mmap(NULL, pagealign(size), prot, flags, -1, 0);
+	int ret;
+
+	if((ret = mmap_error(ptr)))
+		fail("mmap", NULL, ret);
+
+	return ptr;
+}
+
+/* Everything the forked workers share lives in anonymous mappings set
+   up before the fork: the job queue, the split-off directory nodes, the
+   inode set and the result arena. The pages only get allocated as they
+   are touched, so the mostly-empty inode set costs little. */
+
+static void init_shared(CTX)
+{
+	ctx->sh = map_shared(sizeof(struct shared));
+	ctx->arena = map_shared(ARENA);
+	ctx->nodes = map_shared(NODES);
+}
+
+static void lock(CTX)
+{
+	struct shared* sh = ctx->sh;
+
+	while(__atomic_exchange_n(&sh->lock, 1, __ATOMIC_ACQUIRE))
+		;
+}
+
+static void unlock(CTX)
+{
+	struct shared* sh = ctx->sh;
+
+	__atomic_store_n(&sh->lock, 0, __ATOMIC_RELEASE);
+}
+
+/* The number of hardlinked files cannot exceed the number of inodes in
+   use on the filesystems being scanned, so that is what the inode set
+   gets sized for, within MAXINODES. Filesystems that do not report their
+   inode counts get the maximum. Paths on the same filesystem get counted
+   more than once, which only makes the set sparser. */
+
+static ulong used_inodes(char* path)
+{
+	struct statfs st;
+
+	if(sys_statfs(path, &st) < 0)
+		return 0;
+	if(!st.files)
+		return MAXINODES;
+
+	return st.files - st.ffree;
+}
+
+static void init_inodes(CTX)
+{
+	ulong need = 0;
+	uint n = NINODES;
+	int i;
+
+	if(ctx->opts & OPT_l)
+		return;
+
+	if(ctx->argi >= ctx->argc)
+		need = used_inodes(".");
+	else for(i = ctx->argi; i < ctx->argc; i++)
+		need += used_inodes(ctx->argv[i]);
+
+	while(n < MAXINODES && n/2 < need)
+		n *= 2;
+
+	ctx->inodes = map_shared(n*sizeof(struct slot));
+	ctx->nslots = n;
+}
+
+static void set_incomplete(CTX)
+{
+	ctx->sh->incomplete = 1;
+}
+
+/* Results are appended to the arena with an atomic bump of the shared
+   offset, so any process may add one at any time without locking.
+   Once the arena fills up, the remaining results get dropped. */
+
+static struct res* add_result(CTX, char* path, int isdir, uint64_t size, int depth)
+{
+	struct shared* sh = ctx->sh;
+	int len = strlen(path);
+	int slash = isdir && len && path[len-1] != '/';
+	int alen = sizeof(struct res) + len + slash + 1;
+
+	alen = (alen + 7) & ~7;
+
+	ulong off = __sync_fetch_and_add(&sh->used, alen);
+
+	if(off + alen > ARENA) {
+		sh->full = 1;
+		return NULL;
+	}
+
+	struct res* rs = (struct res*)(ctx->arena + off);
+
+	memcpy(rs->name, path, len);
+
+	if(slash)
+		rs->name[len++] = '/';
+
+	rs->name[len] = '\0';
+	rs->len = alen;
+	rs->depth = depth;
+	rs->size = size;
+
+	return rs;
+}
+
+/* With -t, each process tracks the sizes of the N largest directories
+   it has seen so far, and only records the ones that make it into that
+   set. Anything else cannot make it into the global top N either. */
+
+static int worth_keeping(CTX, uint64_t size, int depth)
+{
+	uint64_t* best = ctx->best;
+	int i, n = ctx->topn, min = 0;
+
+	if(depth > ctx->depth)
+		return 0;
+	if(!n)
+		return 1;
+
+	if(ctx->nbest < n) {
+		best[ctx->nbest++] = size;
+		return 1;
+	}
+
+	for(i = 1; i < n; i++)
+		if(best[i] < best[min])
+			min = i;
+
+	if(size <= best[min])
+		return 0;
+
+	best[min] = size;
+
+	return 1;
+}
+
+/* Files with more than one link should only be counted once. Seen
+   (dev, ino) pairs go into an open-addressed hash set shared between
+   all processes. A slot gets claimed with a CAS on its state word,
+   then filled, then marked ready; concurrent lookups of a claimed slot
+   spin until it is ready. Lookups give up after NPROBE slots, in which
+   case the file gets counted anyway and a warning is issued. */
+
+static int inode_seen(CTX, struct info* fi)
+{
+	struct slot* inodes = ctx->inodes;
+	uint64_t hash = (fi->ino ^ (fi->dev << 40)) * 0x9E3779B97F4A7C15ULL;
+	uint i, idx = hash >> 32, mask = ctx->nslots - 1;
+
+	for(i = 0; i < NPROBE; i++) {
+		struct slot* sl = &inodes[(idx + i) & mask];
+
+		if(!sl->state) {
+			if(!__sync_bool_compare_and_swap(&sl->state, 0, 1))
+				goto busy;
+
+			sl->dev = fi->dev;
+			sl->ino = fi->ino;
+
+			__sync_synchronize();
+
+			sl->state = 2;
+
+			return 0;
+		}
+	busy:
+		while(*(volatile int*)&sl->state != 2)
+			;
+
+		__sync_synchronize();
+
+		if(sl->ino == fi->ino && sl->dev == fi->dev)
+			return 1;
+	}
+
+	ctx->sh->lost = 1;
+
+	return 0;
+}
+
+/* Only a few fields are needed, and statx lets the kernel skip the rest. */
+
+static int stat_at(CTX, int at, char* name, int flags, struct info* fi)
+{
+	struct statx stx;
+	int ret;
+
+	if((ret = statxat(at, name, flags, STATX_DU, &stx)) < 0)
+		return ret;
+
+	fi->mode = stx.mode;
+	fi->nlink = stx.nlink;
+	fi->dev = ((uint64_t)stx.dev_major << 32) | stx.dev_minor;
+	fi->ino = stx.ino;
+	fi->size = stx.size;
+	fi->blocks = stx.blocks;
+
+	return ret;
+}
+
+static int isdirmode(struct info* fi)
+{
+	return ((fi->mode & S_IFMT) == S_IFDIR);
+}
+
+static uint64_t st_size(CTX, struct info* fi)
+{
+	int opts = ctx->opts;
+
+	if(fi->nlink > 1 && !isdirmode(fi) && !(opts & OPT_l))
+		if(inode_seen(ctx, fi))
+			return 0;
+
+	if(opts & OPT_a)
+		return fi->size;
+	else
+		return fi->blocks*512;
+}
+
+/* Result sorting and final output */
+
+static int sizecmp(void* pa, void* pb)
+{
+	struct res* a = pa;
+	struct res* b = pb;
+
+	if(a->size < b->size)
+		return -1;
+	if(a->size > b->size)
+		return  1;
+
+	return strcmp(a->name, b->name);
+}
+
+static int count_results(CTX)
+{
+	char* ptr = ctx->arena;
+	char* end = ptr + ctx->sh->used;
+	int count = 0;
+
+	if(end > ctx->arena + ARENA)
+		end = ctx->arena + ARENA;
+
+	while(ptr + sizeof(struct res) <= end) {
+		struct res* rs = (struct res*) ptr;
+
+		if(!rs->len)
+			break;
+
+		ptr += rs->len;
+		count++;
+	}
+
+	return count;
+}
+
+static struct res** index_results(CTX, int count)
+{
+	struct res** idx = heap_alloc(ctx, count*sizeof(struct res*));
+	char* p = ctx->arena;
+	int i;
+
+	for(i = 0; i < count; i++) {
+		struct res* rs = (struct res*) p;
+		p += rs->len;
+
+		if(!rs->depth)
+			ctx->total += rs->size;
+
+		idx[i] = rs;
+	}
+
+	qsortp(idx, count, sizecmp);
+
+	return idx;
+}
+
+static void prep_bufout(CTX, struct bufout* bo)
+{
+	long len;
+
+	if((len = heap_left(ctx)) < PAGE) {
+		heap_extend(ctx, PAGE);
+		len = heap_left(ctx);
+	};
+
+	bo->fd = STDOUT;
+	bo->buf = heap_alloc(ctx, len);
+	bo->len = len;
+	bo->ptr = 0;
+}
+
+static void dump_single(CTX, struct bufout* bo, struct res* rs)
+{
+	int opts = ctx->opts;
+
+	FMTBUF(p, e, line, 50 + strlen(rs->name));
+
+	if(opts & OPT_n)
+		p = fmtpad(p, e, 8, fmtu64(p, e, rs->size));
+	else
+		p = fmtpad(p, e, 5, fmtsize(p, e, rs->size));
+
+	if(rs->name[0]) {
+		p = fmtstr(p, e, "  ");
+		p = fmtstr(p, e, rs->name);
+	}
+
+	FMTENL(p, e);
+
+	char* q = line;
+
+	if(!(opts & OPT_s))
+		while(*q == ' ') q++;
+
+	bufout(bo, q, p - q);
+}
+
+static void dump_total(CTX, struct bufout* bo)
+{
+	int opts = ctx->opts;
+
+	FMTBUF(p, e, line, 80);
+
+	if(opts & OPT_n)
+		p = fmtpad(p, e, 8, fmtu64(p, e, ctx->total));
+	else
+		p = fmtpad(p, e, 5, fmtsize(p, e, ctx->total));
+
+	if(opts & OPT_s)
+		p = fmtstr(p, e, " total");
+
+	FMTENL(p, e);
+
+	bufout(bo, line, p - line);
+}
+
+static void dump_results(CTX)
+{
+	struct shared* sh = ctx->sh;
+	int opts = ctx->opts;
+	int count = count_results(ctx);
+	struct res** idx = index_results(ctx, count);
+	int i = 0;
+
+	struct bufout bo;
+
+	prep_bufout(ctx, &bo);
+
+	if(ctx->topn && count > ctx->topn)
+		i = count - ctx->topn;
+
+	if(!(opts & OPT_s))
+		;
+	else for(; i < count; i++)
+		dump_single(ctx, &bo, idx[i]);
+
+	if(ctx->opts & OPT_c)
+		dump_total(ctx, &bo);
+
+	bufoutflush(&bo);
+
+	if(sh->full)
+		warn("too many results, some not shown", NULL, 0);
+	if(sh->lost)
+		warn("too many hardlinks, some counted more than once", NULL, 0);
+	if(sh->incomplete)
+		warn("incomplete results due to scan errors", NULL, 0);
+}
+
+/* Support routines for at-filenames */
+
+static int pathlen(struct rfn* dd)
+{
+	char* name = dd->name;
+	char* dir = dd->dir;
+	int len = 0;
+
+	if(name)
+		len += strlen(name);
+
+	if(name && name[0] == '/')
+		;
+	else if(dir)
+		len += strlen(dir) + 1;
+
+	return len + 1;
+}
+
+static void makepath(char* buf, int size, struct rfn* dd)
+{
+	char* p = buf;
+	char* e = buf + size - 1;
+	char* dir = dd->dir;
+	char* name = dd->name;
+
+	if(dir && (!name || name[0] != '/')) {
+		p = fmtstr(p, e, dir);
+		p = fmtstr(p, e, "/");
+	} if(name) {
+		p = fmtstr(p, e, name);
+	}
+
+	*p = '\0';
+}
+
+static uint64_t errin(CTX, struct rfn* dd, char* msg, int ret)
+{
+	char path[pathlen(dd)];
+
+	makepath(path, sizeof(path), dd);
+
+	warn(msg, path, ret);
+
+	set_incomplete(ctx);
+
+	return 0;
+}
+
+/* Directories that get split off from a scan become nodes in shared
+   memory, and their sizes get summed up there. A node is pending until
+   its own scan and the scans of all its split-off subdirectories are
+   done; the last one to finish adds the total to the parent node and
+   records the result. Nodes are only ever created, the arena is not
+   reused. */
+
+static struct node* new_node(CTX, struct node* up, char* path, int depth)
+{
+	struct shared* sh = ctx->sh;
+	int len = strlen(path);
+	int alen = sizeof(struct node) + len + 1;
+
+	alen = (alen + 7) & ~7;
+
+	ulong off = __sync_fetch_and_add(&sh->nused, alen);
+
+	if(off + alen > NODES)
+		return NULL;
+
+	struct node* nd = (struct node*)(ctx->nodes + off);
+
+	memcpy(nd->path, path, len + 1);
+	nd->up = up;
+	nd->pending = 1;
+	nd->depth = depth;
+	nd->size = 0;
+
+	if(!up)
+		return nd;
+
+	lock(ctx);
+	up->pending++;
+	unlock(ctx);
+
+	return nd;
+}
+
+static void node_done(CTX, struct node* nd, uint64_t size)
+{
+	lock(ctx);
+
+	for(; nd; nd = nd->up) {
+		nd->size += size;
+
+		if(--nd->pending > 0)
+			break;
+
+		size = nd->size;
+
+		if(!nd->depth || worth_keeping(ctx, size, nd->depth))
+			add_result(ctx, nd->path, 1, size, nd->depth);
+	}
+
+	unlock(ctx);
+}
+
+/* Any directory being scanned may need to become a node, once one of
+   its subdirectories gets split off. Its parents up to the job being
+   run then have to become nodes as well, so that the size of the split
+   subtree gets into their totals. */
+
+static struct node* promote(CTX, struct frame* fr)
+{
+	struct node* up = NULL;
+
+	if(fr->node)
+		return fr->node;
+	if(fr->up && !(up = promote(ctx, fr->up)))
+		return NULL;
+
+	return (fr->node = new_node(ctx, up, fr->path, fr->depth));
+}
+
+static void scan_split(CTX, struct node* nd);
+
+/* want_split() checks the queue without locking, so several processes
+   may decide to split at once. If the queue turns out to be full by
+   then, the node gets scanned right here, the way a worker would. */
+
+static void push_job(CTX, struct node* nd)
+{
+	struct shared* sh = ctx->sh;
+	int full;
+
+	lock(ctx);
+
+	if(!(full = (sh->tail - sh->head >= NQUEUE))) {
+		sh->queue[sh->tail++ % NQUEUE] = nd;
+		sh->undone++;
+	}
+
+	unlock(ctx);
+
+	if(full)
+		scan_split(ctx, nd);
+}
+
+static struct node* take_job(CTX)
+{
+	struct shared* sh = ctx->sh;
+	struct node* nd = NULL;
+
+	lock(ctx);
+
+	if(sh->head < sh->tail)
+		nd = sh->queue[sh->head++ % NQUEUE];
+
+	unlock(ctx);
+
+	return nd;
+}
+
+/* Subdirectories get split off only once the top-level jobs have all
+   been taken, and only while the queue is shorter than the number of
+   processes, so there is always something for an idle worker to pick up
+   but no more than that. Split-off jobs get opened by path from the cwd,
+   since the fds of the process that found them are not shared. */
+
+static int want_split(CTX)
+{
+	struct shared* sh = ctx->sh;
+
+	if(ctx->nprocs < 2)
+		return 0;
+	if(__atomic_load_n(&sh->next, __ATOMIC_RELAXED) < ctx->njobs)
+		return 0;
+
+	int head = __atomic_load_n(&sh->head, __ATOMIC_RELAXED);
+	int tail = __atomic_load_n(&sh->tail, __ATOMIC_RELAXED);
+	int max = ctx->nprocs < NQUEUE ? ctx->nprocs : NQUEUE;
+
+	return (tail - head < max);
+}
+
+static int split_off(CTX, struct frame* up, struct rfn* dd)
+{
+	struct node *parent, *nd;
+	int plen;
+
+	if(!want_split(ctx))
+		return 0;
+	if((plen = pathlen(dd)) > MAXPATH)
+		return 0;
+	if(!(parent = promote(ctx, up)))
+		return 0;
+
+	char path[plen];
+
+	makepath(path, plen, dd);
+
+	if(!(nd = new_node(ctx, parent, path, up->depth + 1)))
+		return 0;
+
+	push_job(ctx, nd);
+
+	return 1;
+}
+
+/* Directory tree walking. Entries reported as DT_DIR by getdents get
+   opened right away and stat'ed by fd; everything else gets a single
+   statx call, and only turns out to be a directory if the filesystem
+   does not report d_type. */
+
+static uint64_t scan_entry(CTX, struct frame* up, struct rfn* dd, int type);
+
+static uint64_t scan_directory(CTX, struct frame* fr, struct rfn* dd, int fd, uint64_t size)
+{
+	int plen = pathlen(dd);
+	char path[plen];
+
+	makepath(path, plen, dd);
+
+	fr->path = path;
+
+	struct rfn next = { fd, path, NULL };
+
+	char* ptr = ctx->ptr;
+	int blen = DENTBUF;
+	char* buf = heap_alloc(ctx, blen);
+	int rd;
+
+	while((rd = sys_getdents(fd, buf, blen)) > 0) {
+		char* p = buf;
+		char* e = buf + rd;
+
+		while(p < e) {
+			struct dirent* de = (struct dirent*) p;
+
+			p += de->reclen;
+
+			if(dotddot(de->name))
+				continue;
+
+			next.name = de->name;
+
+			size += scan_entry(ctx, fr, &next, de->type);
+		}
+	}
+
+	if(rd < 0)
+		errin(ctx, dd, NULL, rd);
+
+	ctx->ptr = ptr;
+
+	sys_close(fd);
+
+	if(fr->node) {
+		node_done(ctx, fr->node, size);
+		return 0;
+	}
+
+	if(!fr->depth || worth_keeping(ctx, size, fr->depth))
+		add_result(ctx, path, 1, size, fr->depth);
+
+	return size;
+}
+
+static int open_dir(CTX, struct rfn* dd, struct info* fi)
+{
+	int fd, ret;
+
+	if((fd = sys_openat(AT(dd), O_DIRECTORY)) < 0) {
+		errin(ctx, dd, NULL, fd);
+		return fd;
+	}
+
+	if((ret = stat_at(ctx, fd, "", AT_EMPTY_PATH, fi)) < 0) {
+		sys_close(fd);
+		errin(ctx, dd, "stat", ret);
+		return ret;
+	}
+
+	return fd;
+}
+
+static uint64_t scan_entry(CTX, struct frame* up, struct rfn* dd, int type)
+{
+	struct frame fr = { up, NULL, NULL, up->depth + 1 };
+	struct info fi;
+	int ret, fd;
+
+	if(type == DT_DIR) {
+		if(split_off(ctx, up, dd))
+			return 0;
+		if((fd = open_dir(ctx, dd, &fi)) < 0)
+			return 0;
+	} else {
+		if((ret = stat_at(ctx, AT(dd), AT_SYMLINK_NOFOLLOW, &fi)) < 0)
+			return errin(ctx, dd, "stat", ret);
+
+		if(!isdirmode(&fi))
+			return st_size(ctx, &fi);
+		if(split_off(ctx, up, dd))
+			return 0;
+
+		if((fd = sys_openat(AT(dd), O_DIRECTORY)) < 0)
+			return errin(ctx, dd, NULL, fd);
+	}
+
+	return scan_directory(ctx, &fr, dd, fd, st_size(ctx, &fi));
+}
+
+/* Top-level directories become jobs, taken off a shared counter by
+   however many processes there are. Job paths are relative to the cwd
+   just like the arguments, so the directories given with -i need not
+   be kept open until the jobs get done. */
+
+static void add_job(CTX, char* path, uint64_t size)
+{
+	int len = strlen(path);
+	int alen = sizeof(struct job) + len + 1;
+
+	alen = (alen + 7) & ~7;
+
+	struct job* jb = heap_alloc(ctx, alen);
+
+	memcpy(jb->path, path, len + 1);
+	jb->len = alen;
+	jb->size = size;
+
+	ctx->njobs++;
+}
+
+static void scan_top(CTX, struct rfn* dd)
+{
+	int opts = ctx->opts;
+	struct info fi;
+	int ret;
+
+	if((ret = stat_at(ctx, AT(dd), AT_SYMLINK_NOFOLLOW, &fi)) < 0) {
+		errin(ctx, dd, "stat", ret);
+		return;
+	}
+
+	int isdir = isdirmode(&fi);
+
+	if((opts & OPT_d) && !isdir)
+		return; /* skip top-level non-directories */
+
+	int plen = pathlen(dd);
+	char path[plen];
+
+	makepath(path, plen, dd);
+
+	if(isdir)
+		add_job(ctx, path, st_size(ctx, &fi));
+	else
+		add_result(ctx, path, 0, st_size(ctx, &fi), 0);
+}
+
+static void index_jobs(CTX)
+{
+	int i, count = ctx->njobs;
+	struct job** idx = heap_alloc(ctx, count*sizeof(struct job*));
+	char* p = ctx->jobs;
+
+	for(i = 0; i < count; i++) {
+		struct job* jb = (struct job*) p;
+		p += jb->len;
+		idx[i] = jb;
+	}
+
+	ctx->idx = idx;
+	ctx->sh->undone = count;
+}
+
+static void scan_root(CTX, struct job* jb)
+{
+	struct frame fr = { NULL, NULL, NULL, 0 };
+	struct rfn dd = { AT_FDCWD, NULL, jb->path };
+	struct info fi;
+	int fd;
+
+	if((fd = open_dir(ctx, &dd, &fi)) >= 0)
+		scan_directory(ctx, &fr, &dd, fd, st_size(ctx, &fi));
+	else
+		add_result(ctx, jb->path, 1, jb->size, 0);
+}
+
+static void scan_split(CTX, struct node* nd)
+{
+	struct frame fr = { NULL, nd, NULL, nd->depth };
+	struct rfn dd = { AT_FDCWD, NULL, nd->path };
+	struct info fi;
+	int fd;
+
+	if((fd = open_dir(ctx, &dd, &fi)) >= 0)
+		scan_directory(ctx, &fr, &dd, fd, st_size(ctx, &fi));
+	else
+		node_done(ctx, nd, 0);
+}
+
+/* A worker killed mid-job would leave its jobs undone forever, so idle
+   processes keep reaping whatever exits, and give up if that was not
+   a clean exit. */
+
+static void check_workers(CTX)
+{
+	int status;
+
+	while(sys_waitpid(-1, &status, WNOHANG) > 0) {
+		if(!status)
+			continue;
+
+		set_incomplete(ctx);
+		ctx->sh->abort = 1;
+	}
+}
+
+static void run_jobs(CTX)
+{
+	struct shared* sh = ctx->sh;
+	struct timespec ts = { 0, 100*1000 };
+	struct node* nd;
+	int i;
+
+	while(!__atomic_load_n(&sh->abort, __ATOMIC_RELAXED)) {
+		if(sh->next < ctx->njobs && (i = __sync_fetch_and_add(&sh->next, 1)) < ctx->njobs) {
+			scan_root(ctx, ctx->idx[i]);
+		} else if((nd = take_job(ctx))) {
+			scan_split(ctx, nd);
+		} else if(!__atomic_load_n(&sh->undone, __ATOMIC_ACQUIRE)) {
+			break;
+		} else {
+			check_workers(ctx);
+			sys_nanosleep(&ts, NULL);
+			continue;
+		}
+
+		__sync_fetch_and_sub(&sh->undone, 1);
+	}
+}
+
+/* Workers get forked up to the number of CPUs, with the parent working
+   alongside them. Whoever runs out of work picks up the subdirectories
+   split off by the others, so a single huge subtree gets spread among
+   all of them too. */
+
+static void spawn_workers(CTX)
+{
+	int i, n = ncpus();
+	int pid, status;
+
+	ctx->nprocs = n;
+
+	for(i = 1; i < n; i++) {
+		if((pid = sys_fork()) < 0) {
+			break; /* the parent will take the rest */
+		} else if(pid == 0) {
+			sys_prctl(PR_SET_PDEATHSIG, SIGTERM, 0, 0, 0);
+			run_jobs(ctx);
+			_exit(0);
+		}
+	}
+
+	ctx->nprocs = i;
+
+	run_jobs(ctx);
+
+	while(sys_waitpid(-1, &status, 0) > 0)
+		if(status)
+			set_incomplete(ctx);
+}
+
+static void scan_jobs(CTX)
+{
+	if(!ctx->njobs)
+		return;
+
+	index_jobs(ctx);
+
+	spawn_workers(ctx);
+}
+
+/* Options and invocation */
+
+static int got_args(CTX)
+{
+	return (ctx->argi < ctx->argc);
+}
+
+static char* shift_arg(CTX)
+{
+	if(ctx->argi >= ctx->argc)
+		return NULL;
+
+	return ctx->argv[ctx->argi++];
+}
+
+static int shift_int(CTX)
+{
+	char *arg, *p;
+	int val;
+
+	if(!(arg = shift_arg(ctx)))
+		fail("too few arguments", NULL, 0);
+	if(!(p = parseint(arg, &val)) || *p)
+		fail("integer required:", arg, 0);
+
+	return val;
+}
+
+static void scan_all_entries_in(CTX, int fd, char* dir)
+{
+	char buf[1024];
+	int rd;
+
+	while((rd = sys_getdents(fd, buf, sizeof(buf))) > 0) {
+		char* p = buf;
+		char* e = buf + rd;
+
+		while(p < e) {
+			struct dirent* de = (struct dirent*) p;
+
+			p += de->reclen;
+
+			if(dotddot(de->name))
+				continue;
+
+			struct rfn dd = { fd, dir, de->name };
+
+			scan_top(ctx, &dd);
+		}
+	}
+}
+
+static void scan_dirs(CTX)
+{
+	char* dir;
+	int fd;
+
+	while((dir = shift_arg(ctx))) {
+		if((fd = sys_open(dir, O_DIRECTORY)) < 0)
+			fail(NULL, dir, fd);
+
+		scan_all_entries_in(ctx, fd, dir);
+
+		sys_close(fd);
+	}
+}
+
+static void scan_each(CTX)
+{
+	char* name;
+
+	while((name = shift_arg(ctx))) {
+		struct rfn dd = { AT_FDCWD, NULL, name };
+		scan_top(ctx, &dd);
+	}
+}
+
+static void scan_cwd(CTX)
+{
+	int fd;
+
+	if((fd = sys_open(".", O_DIRECTORY)) < 0)
+		fail("cannot open", ".", fd);
+
+	scan_all_entries_in(ctx, fd, NULL);
+
+	sys_close(fd);
+}
+
+static int parse_opts(CTX, int argc, char** argv)
+{
+	int i = 1, opts = 0;
+
+	if(i < argc && argv[i][0] == '-')
+		opts = argbits(OPTS, argv[i++] + 1);
+
+	ctx->argi = i;
+	ctx->argc = argc;
+	ctx->argv = argv;
+
+	if(opts & OPT_D)
+		ctx->depth = shift_int(ctx);
+	if(opts & OPT_t)
+		ctx->topn = shift_int(ctx);
+
+	if(ctx->depth < 0)
+		fail("invalid depth", NULL, 0);
+	if((opts & OPT_t) && (ctx->topn <= 0 || ctx->topn > (1<<20)))
+		fail("invalid count", NULL, 0);
+	if((opts & OPT_t) && !(opts & OPT_D))
+		ctx->depth = 0x7FFFFFFF;
+
+	int left = argc - ctx->argi;
+
+	if(opts & OPT_b)
+		opts |= OPT_a | OPT_n;
+	if(opts & (OPT_D | OPT_t))
+		opts |= OPT_s;
+
+	if(opts & (OPT_s | OPT_c))
+		;
+	else if(left == 1 && !(opts & OPT_i))
+		opts |= OPT_c;
+	else
+		opts |= OPT_s;
+
+	ctx->opts = opts;
+
+	return opts;
+}
+
+int main(int argc, char** argv)
+{
+	struct top context, *ctx = &context;
+
+	memzero(ctx, sizeof(*ctx));
+
+	int opts = parse_opts(ctx, argc, argv);
+
+	init_heap(ctx);
+	init_shared(ctx);
+	init_inodes(ctx);
+
+	if(ctx->topn)
+		ctx->best = heap_alloc(ctx, ctx->topn*sizeof(uint64_t));
+
+	ctx->jobs = ctx->ptr;
+
+	if(opts & OPT_i)
+		scan_dirs(ctx);
+	else if(got_args(ctx))
+		scan_each(ctx);
+	else
+		scan_cwd(ctx);
+
+	scan_jobs(ctx);
+
+	dump_results(ctx);
+
+	return 0;
+}
@@ -1,6 +1,10 @@
 #include <sys/file.h>
 #include <sys/mman.h>
 #include <sys/dents.h>
+#include <sys/proc.h>
+#include <sys/prctl.h>
+#include <sys/signal.h>
+#include <sys/time.h>
 
 #include <string.h>
 #include <format.h>
@@ -38,15 +42,29 @@ ERRTAG("find");
 
    This gives one-dir limit on sort input and still guarantees correct
    output, because anything under a given dir shares the same prefix
-   and will get sorted exactly where the dir itself would be. */
+   and will get sorted exactly where the dir itself would be.
+
+   The same property allows scanning the subdirs in parallel. At any
+   directory that has more than one subdir, the subdirs past the current
+   one get handed over to child processes, as long as there are free
+   process slots, each child writing its output into a pipe. The parent
+   then goes through the list in order, copying pipe contents to its own
+   output whenever it reaches a subdir, and scanning the ones that did
+   not get a child itself. Children may split their own subdirs the same
+   way. The output remains exactly the same as that of a sequential scan. */
 
 #define PAGE 4096
 
-#define OPTS "i"
+#define OPTS "ir"
 #define OPT_i (1<<0)
+#define OPT_r (1<<1)
+
+#define MFILE (1<<0) /* print the name */
+#define MDIR  (1<<1) /* descend into it */
 
-#define MFILE 0
-#define MDIR 1
+#define TYPE_F (1<<0)
+#define TYPE_D (1<<1)
+#define TYPE_L (1<<2)
 
 struct shortent {
 	short len;
@@ -55,10 +73,63 @@ struct shortent {
 	char name[];
 };
 
+/* Compiled glob or regex. Both get reduced to the same simple form,
+   a sequence of single-char matchers with optional repetition. */
+
+#define RX_CHAR 0
+#define RX_ANY  1
+#define RX_SET  2
+
+#define REP_ONE   0
+#define REP_STAR  1
+#define REP_PLUS  2
+#define REP_QUEST 3
+
+struct rxop {
+	byte type;
+	byte rep;
+	byte chr;
+	byte neg;
+	uint32_t set[8];
+};
+
+struct regex {
+	int nops;
+	int bol;
+	int eol;
+	struct rxop ops[];
+};
+
+#define PREFIX 0
+#define SUFFIX 1
+#define REGEX 2
+
 struct pattern {
 	char* name;
 	int len;
 	int where;
+	struct regex* rx;
+};
+
+struct range {
+	int set;
+	int cmp;
+	int64_t val;
+};
+
+struct job {
+	int pid;
+	int fd;
+};
+
+struct level {
+	struct level* up;
+	struct job* jobs;
+	int count;
+};
+
+struct shared {
+	int running;
 };
 
 struct top {
@@ -68,6 +139,17 @@ struct top {
 	struct pattern* patt;
 	int pcnt;
 	struct bufout bo;
+
+	int types;
+	struct range size;
+	struct range mtime;
+	struct regex* skip;
+	int nstat;
+
+	int split;
+	int procs;
+	struct shared* sh;
+	struct level* level;
 };
 
 struct dir {
@@ -118,6 +200,18 @@ static void* setbrk(void* old, int incr)
 	return ptr;
 }
 
+static void init_shared(TC)
+{
+	int prot = PROT_READ | PROT_WRITE;
+	int flags = MAP_SHARED | MAP_ANONYMOUS;
+	void* ptr = sys_mmap(NULL, PAGE, prot, flags, -1, 0);
+
+	if(mmap_error(ptr))
+		tc->split = 0;
+	else
+		tc->sh = ptr;
+}
+
 static void* extend(TC, int size)
 {
 	if(tc->brk - tc->ptr < size) {
@@ -130,6 +224,174 @@ static void* extend(TC, int size)
 	return ret;
 }
 
+/* Pattern compiler. Globs are anchored at both ends, regexes only
+   where ^ and $ say so. Regex support is limited to what globs can't
+   do: . [] * + ? ^ $ and \ for escaping. No groups, no alternatives. */
+
+static void set_bit(struct rxop* op, int c)
+{
+	c &= 0xFF;
+	op->set[c/32] |= (1U << (c % 32));
+}
+
+static int has_bit(struct rxop* op, int c)
+{
+	c &= 0xFF;
+	return !!(op->set[c/32] & (1U << (c % 32)));
+}
+
+static char* parse_set(struct rxop* op, char* p, char* patt)
+{
+	op->type = RX_SET;
+
+	if(*p == '!' || *p == '^') {
+		op->neg = 1;
+		p++;
+	} if(*p == ']') {
+		set_bit(op, *p++);
+	}
+
+	while(*p && *p != ']') {
+		int lo = *p++ & 0xFF;
+
+		if(*p == '-' && p[1] && p[1] != ']') {
+			int hi = p[1] & 0xFF;
+
+			for(int c = lo; c <= hi; c++)
+				set_bit(op, c);
+
+			p += 2;
+		} else {
+			set_bit(op, lo);
+		}
+	}
+
+	if(*p != ']')
+		fail("unterminated [] in", patt, 0);
+
+	return p + 1;
+}
+
+static struct regex* compile(TC, char* patt, int isregex)
+{
+	int len = strlen(patt);
+	struct regex* rx;
+	struct rxop* op = NULL;
+	char* p = patt;
+	int size = sizeof(*rx) + (len + 1)*sizeof(*op);
+
+	rx = extend(tc, size);
+	memzero(rx, size);
+
+	if(!isregex) {
+		rx->bol = 1;
+		rx->eol = 1;
+	} else if(*p == '^') {
+		rx->bol = 1;
+		p++;
+	}
+
+	while(*p) {
+		char c = *p++;
+
+		if(isregex && c == '$' && !*p) {
+			rx->eol = 1;
+			break;
+		}
+
+		if(isregex && (c == '*' || c == '+' || c == '?')) {
+			if(!op || op->rep != REP_ONE)
+				fail("misplaced repetition in", patt, 0);
+			op->rep = (c == '*') ? REP_STAR : (c == '+') ? REP_PLUS : REP_QUEST;
+			continue;
+		}
+
+		op = &rx->ops[rx->nops++];
+
+		if(c == '\\' && *p) {
+			op->type = RX_CHAR;
+			op->chr = *p++;
+		} else if(c == '[') {
+			p = parse_set(op, p, patt);
+		} else if(c == (isregex ? '.' : '?')) {
+			op->type = RX_ANY;
+		} else if(c == '*' && !isregex) {
+			op->type = RX_ANY;
+			op->rep = REP_STAR;
+		} else {
+			op->type = RX_CHAR;
+			op->chr = c;
+		}
+	}
+
+	tc->ptr = (void*)&rx->ops[rx->nops];
+
+	return rx;
+}
+
+static int match_one(struct rxop* op, char c)
+{
+	if(op->type == RX_ANY)
+		return 1;
+	if(op->type == RX_CHAR)
+		return (op->chr == (byte)c);
+
+	return has_bit(op, c) ^ op->neg;
+}
+
+static int match_here(struct regex* rx, struct rxop* op, char* s)
+{
+	struct rxop* end = rx->ops + rx->nops;
+
+	for(; op < end; op++) {
+		if(op->rep == REP_ONE) {
+			if(!*s || !match_one(op, *s))
+				return 0;
+			s++;
+			continue;
+		}
+
+		int min = (op->rep == REP_PLUS) ? 1 : 0;
+		int max = (op->rep == REP_QUEST) ? 1 : -1;
+		int n = 0;
+
+		while(s[n] && n != max && match_one(op, s[n]))
+			n++;
+
+		for(; n >= min; n--)
+			if(match_here(rx, op + 1, s + n))
+				return 1;
+
+		return 0;
+	}
+
+	return !rx->eol || !*s;
+}
+
+static int match(struct regex* rx, char* name)
+{
+	if(rx->bol)
+		return match_here(rx, rx->ops, name);
+
+	do {
+		if(match_here(rx, rx->ops, name))
+			return 1;
+	} while(*name++);
+
+	return 0;
+}
+
+static int is_glob(char* patt)
+{
+	char* p;
+
+	for(p = patt; *p; p++)
+		if(*p == '*' || *p == '?' || *p == '[')
+			return 1;
+
+	return 0;
+}
+
 static int pathsize(DC, char* name)
 {
 	if(dc->dir)
@@ -167,34 +429,142 @@ static void enqueue(DC, char* name, int isdir)
 	dc->count++;
 }
 
-static void check_file(DC, char* name)
+static int match_name(TC, char* name)
 {
-	struct top* tc = dc->tc;
 	int namelen = strlen(name);
 	int i;
 
+	if(!tc->pcnt)
+		return 1;
+
 	for(i = 0; i < tc->pcnt; i++) {
 		struct pattern* p = &tc->patt[i];
 
+		if(p->where == REGEX) {
+			if(match(p->rx, name))
+				return 1;
+			continue;
+		}
+
 		if(p->len > namelen)
 			continue;
 
 		char* anchor = p->where ? name + namelen - p->len : name;
 
-		if(strncmp(anchor, p->name, p->len))
-			continue;
+		if(!strncmp(anchor, p->name, p->len))
+			return 1;
+	}
+
+	return 0;
+}
+
+/* Non-name predicates, all of them need stat */
+
+static int check_range(struct range* rg, int64_t val)
+{
+	if(!rg->set)
+		return 1;
+	if(rg->cmp > 0)
+		return val > rg->val;
+	if(rg->cmp < 0)
+		return val < rg->val;
+
+	return val == rg->val;
+}
+
+static int type_bit(int mode)
+{
+	int type = mode & S_IFMT;
+
+	if(type == S_IFDIR)
+		return TYPE_D;
+	if(type == S_IFLNK)
+		return TYPE_L;
+	if(type == S_IFREG)
+		return TYPE_F;
+
+	return 0;
+}
+
+static int check_stat(TC, struct stat* st)
+{
+	if(tc->types && !(tc->types & type_bit(st->mode)))
+		return 0;
+	if(!check_range(&tc->size, st->size))
+		return 0;
+	if(!check_range(&tc->mtime, st->mtime.sec))
+		return 0;
+
+	return 1;
+}
+
+static void check_dir(DC, char* name)
+{
+	struct top* tc = dc->tc;
+	int flags = AT_SYMLINK_NOFOLLOW;
+	struct stat st;
+	int mark = MDIR;
+
+	if(tc->skip && match(tc->skip, name))
+		return;
+
+	if(!(tc->types & TYPE_D) || !match_name(tc, name))
+		;
+	else if(!tc->nstat)
+		mark |= MFILE;
+	else if(sys_fstatat(dc->fd, name, &st, flags) < 0)
+		;
+	else if(check_stat(tc, &st))
+		mark |= MFILE;
+
+	enqueue(dc, name, mark);
+}
+
+static void check_file(DC, char* name, int type)
+{
+	struct top* tc = dc->tc;
+	int flags = AT_SYMLINK_NOFOLLOW;
+	struct stat st;
+
+	if(!match_name(tc, name))
+		return;
 
-		enqueue(dc, name, MFILE);
-		break;
+	if(tc->nstat) {
+		if(sys_fstatat(dc->fd, name, &st, flags) < 0)
+			return;
+		if(!check_stat(tc, &st))
+			return;
+	} else if(tc->types) {
+		if(type == DT_REG && !(tc->types & TYPE_F))
+			return;
+		if(type == DT_LNK && !(tc->types & TYPE_L))
+			return;
+		if(type != DT_REG && type != DT_LNK)
+			return;
 	}
+
+	enqueue(dc, name, MFILE);
 }
 
-static void check_stat(DC, char* name)
+static void check_unknown(DC, char* name)
 {
-	(void)dc;
-	(void)name;
+	int flags = AT_SYMLINK_NOFOLLOW;
+	struct stat st;
+	int type;
+
+	if(sys_fstatat(dc->fd, name, &st, flags) < 0)
+		return;
 
-	fail("not implemented", NULL, 0);
+	type = st.mode & S_IFMT;
+
+	if(type == S_IFDIR)
+		check_dir(dc, name);
+	else if(type == S_IFLNK)
+		check_file(dc, name, DT_LNK);
+	else if(type == S_IFREG)
+		check_file(dc, name, DT_REG);
+	else
+		check_file(dc, name, DT_UNKNOWN);
 }
 
 static void check_dent(DC, struct dirent* de)
@@ -203,11 +573,11 @@ static void check_dent(DC, struct dirent* de)
 	char* name = de->name;
 
 	if(type == DT_DIR)
-		enqueue(dc, name, MDIR);
+		check_dir(dc, name);
 	else if(type == DT_UNKNOWN)
-		check_stat(dc, name);
+		check_unknown(dc, name);
 	else
-		check_file(dc, name);
+		check_file(dc, name, type);
 }
 
 static void read_scan(DC, int fd)
@@ -278,19 +648,187 @@ static void index_entries(DC)
 
 static void scan_dir(TC, int at, char* openname, char* dirname);
 
+static void print_entry(DC, struct shortent* se)
+{
+	struct top* tc = dc->tc;
+
+	if(se->isdir & MFILE)
+		outstrnl(tc, se->name);
+	if(se->isdir & MDIR)
+		scan_dir(tc, dc->fd, se->name + se->pre, se->name);
+}
+
 static void print_indexed(DC)
+{
+	for(int i = 0; i < dc->count; i++)
+		print_entry(dc, dc->idx[i]);
+}
+
+/* Parallel scan. Only subdirs get children, and at most tc->procs
+   of them run at any given time across the whole process tree, counted
+   in shared memory. Children past the one being copied may block on full
+   pipes, but that's fine since the output is expected to be small. */
+
+static int take_slot(TC)
+{
+	struct shared* sh = tc->sh;
+	int cur = __atomic_load_n(&sh->running, __ATOMIC_RELAXED);
+
+	while(cur < tc->procs)
+		if(__atomic_compare_exchange_n(&sh->running, &cur, cur + 1,
+				0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+			return 1;
+
+	return 0;
+}
+
+static void free_slot(TC)
+{
+	__atomic_sub_fetch(&tc->sh->running, 1, __ATOMIC_ACQ_REL);
+}
+
+/* A child only needs the write end of its own pipe. The read ends of
+   the pipes of its siblings, and of any pending jobs further up in the
+   parent, along with the parent's own output pipe, get closed. */
+
+static void close_inherited(TC)
+{
+	struct level* lv;
+	int i;
+
+	for(lv = tc->level; lv; lv = lv->up)
+		for(i = 0; i < lv->count; i++)
+			if(lv->jobs[i].fd >= 0)
+				sys_close(lv->jobs[i].fd);
+
+	if(tc->bo.fd != STDOUT)
+		sys_close(tc->bo.fd);
+
+	tc->level = NULL;
+}
+
+static int start_job(DC, struct shortent* se, struct job* jb)
 {
 	struct top* tc = dc->tc;
-	int at = dc->fd;
+	int fds[2];
+	int pid, ret;
+
+	if(!take_slot(tc))
+		return 0;
+
+	if((ret = sys_pipe(fds)) < 0)
+		goto out;
+
+	if((pid = sys_fork()) < 0) {
+		sys_close(fds[0]);
+		sys_close(fds[1]);
+		goto out;
+	}
 
-	for(int i = 0; i < dc->count; i++) {
+	if(pid == 0) {
+		sys_prctl(PR_SET_PDEATHSIG, SIGTERM, 0, 0, 0);
+		sys_close(fds[0]);
+		close_inherited(tc);
+
+		tc->bo.fd = fds[1];
+		tc->bo.ptr = 0;
+
+		scan_dir(tc, dc->fd, se->name + se->pre, se->name);
+
+		bufoutflush(&tc->bo);
+		free_slot(tc);
+		_exit(0);
+	}
+
+	sys_close(fds[1]);
+
+	jb->pid = pid;
+	jb->fd = fds[0];
+
+	return 1;
+out:
+	free_slot(tc);
+	return 0;
+}
+
+static void copy_job(DC, struct shortent* se, struct job* jb)
+{
+	struct top* tc = dc->tc;
+	char* buf = dirbuf;
+	int len = sizeof(dirbuf);
+	int rd, ret, status;
+
+	if(jb->pid <= 0) /* no child for this one */
+		return scan_dir(tc, dc->fd, se->name + se->pre, se->name);
+
+	bufoutflush(&tc->bo);
+
+	while((rd = sys_read(jb->fd, buf, len)) > 0)
+		if((ret = writeall(tc->bo.fd, buf, rd)) < 0)
+			fail("write", NULL, ret);
+
+	sys_close(jb->fd);
+	sys_waitpid(jb->pid, &status, 0);
+
+	jb->fd = -1;
+}
+
+/* The job list lives in the heap and gets dropped along with the rest
+   of the directory data once scan_dir() is done. */
+
+static void print_parallel(DC)
+{
+	struct top* tc = dc->tc;
+	int i, count = dc->count;
+	int next = 0;
+	struct level lv = {
+		.up = tc->level,
+		.jobs = extend(tc, count*sizeof(struct job)),
+		.count = count
+	};
+
+	for(i = 0; i < count; i++) {
+		lv.jobs[i].pid = 0;
+		lv.jobs[i].fd = -1;
+	}
+
+	tc->level = &lv;
+
+	bufoutflush(&tc->bo);
+
+	for(i = 0; i < count; i++) {
 		struct shortent* se = dc->idx[i];
 
-		if(se->isdir)
-			scan_dir(tc, at, se->name + se->pre, se->name);
-		else
+		if(next <= i)
+			next = i + 1;
+
+		for(; next < count; next++) {
+			struct shortent* sn = dc->idx[next];
+
+			if(!(sn->isdir & MDIR))
+				continue;
+			if(!start_job(dc, sn, &lv.jobs[next]))
+				break;
+		}
+
+		if(se->isdir & MFILE)
 			outstrnl(tc, se->name);
+		if(se->isdir & MDIR)
+			copy_job(dc, se, &lv.jobs[i]);
 	}
+
+	tc->level = lv.up;
+}
+
+static int count_subdirs(DC)
+{
+	int i, n = 0;
+
+	for(i = 0; i < dc->count; i++)
+		if(dc->idx[i]->isdir & MDIR)
+			n++;
+
+	return n;
 }
 
 static void scan_dir(TC, int at, char* openname, char* listname)
@@ -315,24 +853,150 @@ static void scan_dir(TC, int at, char* openname, char* listname)
 	read_scan(&dc, fd);
 
 	index_entries(&dc);
-	print_indexed(&dc);
+
+	if(tc->split && count_subdirs(&dc) > 1)
+		print_parallel(&dc);
+	else
+		print_indexed(&dc);
 
 	sys_close(fd);
 
 	tc->ptr = ptr;
 }
 
+/* Arguments other than name patterns have the form key=value. */
+
+static int64_t parse_num(char* arg, char* str)
+{
+	char* p = str;
+	int64_t val = 0;
+	int64_t unit = 1;
+
+	if(!*p)
+		fail("missing value in", arg, 0);
+
+	for(; *p >= '0' && *p <= '9'; p++)
+		val = val*10 + (*p - '0');
+
+	if(!*p)
+		;
+	else if(p[1])
+		fail("invalid value in", arg, 0);
+	else if(*p == 'k')
+		unit = 1024;
+	else if(*p == 'M')
+		unit = 1024*1024;
+	else if(*p == 'G')
+		unit = 1024*1024*1024;
+	else
+		fail("invalid value in", arg, 0);
+
+	return val*unit;
+}
+
+static void parse_range(struct range* rg, char* arg, char* str)
+{
+	rg->set = 1;
+
+	if(*str == '+')
+		rg->cmp = 1;
+	else if(*str == '-')
+		rg->cmp = -1;
+	else
+		rg->cmp = 0;
+
+	if(rg->cmp) str++;
+
+	rg->val = parse_num(arg, str);
+}
+
+static void parse_mtime(TC, char* arg, char* str)
+{
+	struct range* rg = &tc->mtime;
+	struct timespec ts;
+	int ret;
+
+	parse_range(rg, arg, str);
+
+	if((ret = sys_clock_gettime(CLOCK_REALTIME, &ts)) < 0)
+		fail("clock_gettime", NULL, ret);
+
+	/* N days ago; +N = older, -N or N = newer, so the sign gets flipped */
+
+	if(!rg->cmp)
+		rg->cmp = -1;
+
+	rg->val = ts.sec - rg->val*24*60*60;
+	rg->cmp = -rg->cmp;
+}
+
+static void parse_types(TC, char* arg, char* str)
+{
+	char* p;
+
+	for(p = str; *p; p++) {
+		if(*p == 'f')
+			tc->types |= TYPE_F;
+		else if(*p == 'd')
+			tc->types |= TYPE_D;
+		else if(*p == 'l')
+			tc->types |= TYPE_L;
+		else
+			fail("invalid type in", arg, 0);
+	}
+}
+
+static int parse_term(TC, char* arg)
+{
+	char* eq = strchr(arg, '=');
+
+	if(!eq)
+		return 0;
+
+	int klen = eq - arg;
+	char* val = eq + 1;
+
+	if(klen == 4 && !strncmp(arg, "type", 4))
+		parse_types(tc, arg, val);
+	else if(klen == 4 && !strncmp(arg, "size", 4))
+		parse_range(&tc->size, arg, val);
+	else if(klen == 5 && !strncmp(arg, "mtime", 5))
+		parse_mtime(tc, arg, val);
+	else if(klen == 4 && !strncmp(arg, "skip", 4))
+		tc->skip = compile(tc, val, 0);
+	else
+		return 0;
+
+	return 1;
+}
+
 static void prep_patterns(TC, int argc, char** argv)
 {
 	int i;
 
 	for(i = 0; i < argc; i++) {
 		char* argi = argv[i];
-		struct pattern* p = &tc->patt[i];
+
+		if(parse_term(tc, argi))
+			continue;
+
+		struct pattern* p = &tc->patt[tc->pcnt++];
+
 		p->name = argi;
 		p->len = strlen(argi);
-		p->where = (*argi == '.');
+
+		if(tc->opts & OPT_r) {
+			p->where = REGEX;
+			p->rx = compile(tc, argi, 1);
+		} else if(is_glob(argi)) {
+			p->where = REGEX;
+			p->rx = compile(tc, argi, 0);
+		} else {
+			p->where = (*argi == '.') ? SUFFIX : PREFIX;
+		}
 	}
+
+	tc->nstat = tc->size.set || tc->mtime.set;
 }
 
 int main(int argc, char** argv)
@@ -362,7 +1026,12 @@ int main(int argc, char** argv)
 	tc->ptr = setbrk(NULL, 0);
 	tc->brk = setbrk(tc->ptr, PAGE);
 	tc->patt = patt;
-	tc->pcnt = argc;
+	tc->pcnt = 0;
+	tc->procs = ncpus();
+	tc->split = (tc->procs > 1);
+
+	if(tc->split)
+		init_shared(tc);
 
 	init_output(tc);
 	prep_patterns(tc, argc, argv);
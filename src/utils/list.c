@@ -18,6 +18,10 @@ ERRTAG("list");
 
 #define DT_LNK_DIR 71	/* symlink pointing to a dir, custom value */
 
+#define DENTMIN (2*PAGE)     /* getdents buffer, initial size */
+#define DENTMAX (64*PAGE)    /* ... and the limit it may grow to */
+#define BATCH 2048           /* min number of entries per stat process */
+
 #define OPTS "acdnluy"
 #define OPT_a (1<<0)
 #define OPT_c (1<<1)
@@ -37,11 +41,30 @@ struct ent {
 	char name[];
 };
 
+struct attr {
+	int type;
+	int mode;
+	int uid;
+	int gid;
+	uint64_t size;
+};
+
 struct mmaped {
 	char* buf;
 	size_t len;
 };
 
+struct idname {
+	int id;
+	int len;
+	char* name;
+};
+
+struct idmap {
+	struct idname* tab;
+	uint mask;
+};
+
 struct top {
 	int opts;
 	struct bufout bo;
@@ -55,13 +78,16 @@ struct top {
 	void* end;
 
 	struct ent** idx;
+	int count;
+
+	uint mask;
 
 	int sizelen;
 	int uidlen;
 	int gidlen;
 
-	struct mmaped passwd;
-	struct mmaped group;
+	struct idmap users;
+	struct idmap groups;
 };
 
 #define CTX struct top* ctx __unused
@@ -118,10 +144,10 @@ static void init_context(CTX, int opts)
 
 	ctx->fd = fd;
 
-	if(opts & OPT_l) {
-		mmap_file(&ctx->passwd, "/etc/passwd");
-		mmap_file(&ctx->group,  "/etc/group");
-	}
+	ctx->mask = STATX_TYPE | STATX_MODE | STATX_SIZE;
+
+	if(opts & OPT_l)
+		ctx->mask |= STATX_UID | STATX_GID;
 }
 
 static void fini_context(CTX)
@@ -152,56 +178,143 @@ got:
 	return ret;
 }
 
-static void stat_entry(CTX, int at, struct ent* en)
+/* User and group names. Both files get parsed once into small
+   open-addressing hash tables keyed by id, with the names pointing
+   into the mmaped files. As with the linear scan, the first line
+   for any given id wins. */
+
+static uint idhash(int id, uint mask)
 {
-	char* name = en->name;
-	int flags = AT_NO_AUTOMOUNT | AT_SYMLINK_NOFOLLOW;
-	struct stat st;
+	return ((uint)id * 2654435761U) & mask;
+}
 
-	if((sys_fstatat(at, name, &st, flags)) < 0)
-		return;
+static uint count_lines(char* p, char* e)
+{
+	uint n = 1;
+
+	for(; p < e; p++)
+		if(*p == '\n')
+			n++;
 
-	en->mode = st.mode;
-	en->size = st.size;
-	en->uid = st.uid;
-	en->gid = st.gid;
+	return n;
 }
 
-static void stat_target(CTX, int at, struct ent* en)
+static void add_idname(struct idmap* im, int id, char* name, int len)
 {
-	char* name = en->name;
-	int flags = AT_NO_AUTOMOUNT;
-	struct stat st;
+	struct idname* tab = im->tab;
+	uint mask = im->mask;
+	uint i;
 
-	if(en->type != DT_LNK)
-		return;
-	if(sys_fstatat(at, name, &st, flags) < 0)
+	for(i = idhash(id, mask); tab[i].name; i = (i + 1) & mask)
+		if(tab[i].id == id)
+			return;
+
+	tab[i].id = id;
+	tab[i].len = len;
+	tab[i].name = name;
+}
+
+static void load_ids(CTX, struct idmap* im, const char* fname)
+{
+	struct mmaped mf;
+
+	mmap_file(&mf, fname);
+
+	char* buf = mf.buf;
+	char* end = buf + mf.len;
+
+	if(!buf) return;
+
+	uint need = 2*count_lines(buf, end);
+	uint size = 16;
+
+	while(size < need)
+		size *= 2;
+
+	int len = size*sizeof(struct idname);
+	struct idname* tab = alloc(ctx, len);
+
+	memzero(tab, len);
+
+	im->tab = tab;
+	im->mask = size - 1;
+
+	char *ls, *le; /* line start/end */
+	for(ls = buf; ls < end; ls = le + 1) {
+		le = strecbrk(ls, end, '\n');
+
+		char* ns = ls;                     /* 1st field, name */
+		char* ne = strecbrk(ls, le, ':');
+		char* ps = ne + 1;                 /* 2nd field, password */
+		char* pe = strecbrk(ps, le, ':');
+		char* is = pe + 1;                 /* 3rd field, id */
+		char* ie = strecbrk(is, le, ':');
+		char* p;
+		int id;
+
+		if(ie >= le)
+			continue;
+		if(!(p = parseint(is, &id)) || p != ie)
+			continue;
+
+		add_idname(im, id, ns, ne - ns);
+	}
+}
+
+static void init_names(CTX)
+{
+	if(!(ctx->opts & OPT_l))
 		return;
-	if(S_ISDIR(st.mode))
-		en->type = DT_LNK_DIR;
+
+	load_ids(ctx, &ctx->users,  "/etc/passwd");
+	load_ids(ctx, &ctx->groups, "/etc/group");
 }
 
-static void add_dirent(CTX, int at, struct dirent* de)
+static struct idname* find_id(struct idmap* im, int id)
 {
-	int opts = ctx->opts;
-	void* ptr = ctx->ptr;
+	struct idname* tab = im->tab;
+	uint mask = im->mask;
+	uint i;
+
+	if(!tab) return NULL;
 
+	for(i = idhash(id, mask); tab[i].name; i = (i + 1) & mask)
+		if(tab[i].id == id)
+			return &tab[i];
+
+	return NULL;
+}
+
+static int isdirtype(int t)
+{
+	return (t == DT_DIR || t == DT_LNK_DIR);
+}
+
+static int maybedir(int t)
+{
+	return (t == DT_DIR || t == DT_LNK || t == DT_UNKNOWN);
+}
+
+/* Only the name and the type get stored while reading the directory,
+   stat() calls are done later for the whole list at once. With -d,
+   entries known to be non-directories are dropped right away. */
+
+static void add_dirent(CTX, struct dirent* de)
+{
 	char* name = de->name;
 	int len = strlen(name);
+	int type = de->type;
+
+	if((ctx->opts & OPT_d) && !maybedir(type))
+		return;
 
 	struct ent* en = alloc(ctx, sizeof(struct ent) + len + 1);
 
 	memzero(en, sizeof(*en));
 
 	en->namelen = len;
-	en->type = de->type;
+	en->type = type;
 	memcpy(en->name, name, len + 1);
-
-	stat_entry(ctx, at, en);
-	stat_target(ctx, at, en);
-
-	if((opts & OPT_d) && (en->type != DT_DIR && en->type != DT_LNK_DIR))
-		ctx->ptr = ptr; /* undo entry */
 }
 
 static int match(CTX, char* name)
@@ -222,12 +335,22 @@ static int match(CTX, char* name)
 	return 0;
 }
 
+/* Most directories fit into the initial buffer whole. If getdents
+   fills it up, the directory is probably a large one, so the buffer
+   gets doubled to cut down the number of syscalls. */
+
 static void read_whole(CTX)
 {
-	char buf[2048];
-	int rd, fd = ctx->fd;
+	int prot = PROT_READ | PROT_WRITE;
+	int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+	int rd, ret, fd = ctx->fd;
+	long size = DENTMIN;
+	void* buf = sys_mmap(NULL, size, prot, flags, -1, 0);
+
+	if((ret = mmap_error(buf)))
+		fail("mmap", NULL, ret);
 
-	while((rd = sys_getdents(fd, buf, sizeof(buf))) > 0) {
+	while((rd = sys_getdents(fd, buf, size)) > 0) {
 		void* ptr = buf;
 		void* end = buf + rd;
 
@@ -241,11 +364,24 @@ static void read_whole(CTX)
 			if(!match(ctx, de->name))
 				continue;
 
-			add_dirent(ctx, fd, de);
+			add_dirent(ctx, de);
 		}
+
+		if(size >= DENTMAX || rd + 512 < size)
+			continue;
+
+		void* new = sys_mremap(buf, size, 2*size, MREMAP_MAYMOVE);
+
+		if(mmap_error(new))
+			continue;
+
+		buf = new;
+		size *= 2;
 	} if(rd < 0) {
 		fail("getdents", NULL, rd);
 	}
+
+	sys_munmap(buf, size);
 }
 
 static int entlen(void* p)
@@ -264,7 +400,7 @@ static void index_entries(CTX, void* ents, void* eend)
 
 	int len = (nument+1) * sizeof(void*);
 	struct ent** idx = alloc(ctx, len);
-	struct ent** end = idx + len;
+	struct ent** end = idx + nument;
 	struct ent** ptr = idx;
 
 	for(p = ents; p < eend; p += entlen(p)) {
@@ -276,11 +412,138 @@ static void index_entries(CTX, void* ents, void* eend)
 	*ptr = NULL;
 
 	ctx->idx = idx;
+	ctx->count = ptr - idx;
 }
 
-static int isdirtype(int t)
+/* Only the fields that the output needs get requested from statx,
+   which lets the kernel skip the rest on filesystems where getting
+   them is expensive. Kernels older than 4.11 get plain fstatat. */
+
+static int stat_name(CTX, char* name, int flags, uint mask, struct attr* at)
 {
-	return (t == DT_DIR || t == DT_LNK_DIR);
+	struct statx sx;
+	int ret;
+
+	flags |= AT_NO_AUTOMOUNT;
+
+	if((ret = statxat(ctx->fd, name, flags, mask, &sx)) < 0)
+		return ret;
+
+	at->mode = sx.mode;
+	at->uid = sx.uid;
+	at->gid = sx.gid;
+	at->size = sx.size;
+
+	return 0;
+}
+
+static void stat_entry(CTX, struct ent* en, struct attr* at)
+{
+	char* name = en->name;
+	struct attr ta;
+
+	memzero(at, sizeof(*at));
+	at->type = en->type;
+
+	if(stat_name(ctx, name, AT_SYMLINK_NOFOLLOW, ctx->mask, at) < 0)
+		return;
+	if(at->type == DT_UNKNOWN)
+		at->type = (at->mode & S_IFMT) >> 12;
+
+	if(at->type != DT_LNK || (ctx->opts & OPT_y))
+		return;
+	if(stat_name(ctx, name, 0, STATX_TYPE, &ta) < 0)
+		return;
+	if(S_ISDIR(ta.mode))
+		at->type = DT_LNK_DIR;
+}
+
+static void stat_range(CTX, struct attr* res, int from, int to)
+{
+	struct ent** idx = ctx->idx;
+
+	for(int i = from; i < to; i++)
+		stat_entry(ctx, idx[i], &res[i]);
+}
+
+/* For really large directories, the list gets split into contiguous
+   ranges stat'ed by several forked processes at once. The results go
+   into a shared anonymous mapping. */
+
+struct stres {
+	struct top* ctx;
+	struct attr* res;
+};
+
+static void stat_part(void* arg, int part, int from, int to)
+{
+	struct stres* sr = arg;
+
+	stat_range(sr->ctx, sr->res, from, to);
+}
+
+static void stat_parallel(CTX, struct attr* res, int n)
+{
+	struct stres sr = { ctx, res };
+
+	forkranges(n, ctx->count, stat_part, &sr);
+}
+
+static void apply_attrs(CTX, struct attr* res)
+{
+	struct ent** idx = ctx->idx;
+	int dirsonly = (ctx->opts & OPT_d);
+	int i, n = 0, count = ctx->count;
+
+	for(i = 0; i < count; i++) {
+		struct ent* en = idx[i];
+		struct attr* at = &res[i];
+
+		en->type = at->type;
+		en->mode = at->mode;
+		en->uid = at->uid;
+		en->gid = at->gid;
+		en->size = at->size;
+
+		if(dirsonly && !isdirtype(en->type))
+			continue;
+
+		idx[n++] = en;
+	}
+
+	idx[n] = NULL;
+	ctx->count = n;
+}
+
+static void stat_indexed(CTX)
+{
+	int count = ctx->count;
+	int procs = rangeprocs(0, count, BATCH);
+	ulong size = count*sizeof(struct attr);
+	struct attr* res;
+
+	if(procs > 1) {
+		int prot = PROT_READ | PROT_WRITE;
+		int flags = MAP_SHARED | MAP_ANONYMOUS;
+
+		size = pagealign(size);
+		res = sys_mmap(NULL, size, prot, flags, -1, 0);
+
+		if(mmap_error(res))
+			goto serial;
+
+		stat_parallel(ctx, res, procs);
+		apply_attrs(ctx, res);
+
+		sys_munmap(res, size);
+
+		return;
+	}
+serial:
+	res = alloc(ctx, size);
+
+	stat_range(ctx, res, 0, count);
+	apply_attrs(ctx, res);
 }
 
 static int cmpidx(void* a, void* b, long opts)
@@ -305,62 +568,29 @@ static void sort_indexed(CTX)
 {
 	int opts = ctx->opts;
 	struct ent** idx = ctx->idx;
-	struct ent** p;
-	int count = 0;
-
-	for(p = idx; *p; p++)
-		count++;
+	int count = ctx->count;
 
 	qsortx(idx, count, cmpidx, opts);
 }
 
-static char* fmt_name(char* p, char* e, int id, struct mmaped* mp)
+static char* fmt_name(char* p, char* e, int id, struct idmap* im)
 {
-	char idstr[20];
-	char* idend = idstr + sizeof(idstr) - 1;
-	char* idptr = fmti32(idstr, idend, id);
-	*idptr++ = ':';
-	int idlen = idptr - idstr;
+	struct idname* in;
 
-	char* buf = mp->buf;
-	char* end = buf + mp->len;
-
-	if(!buf) goto asnum;
-
-	char *ls, *le; /* line start/end */
-	for(ls = buf; ls < end; ls = le + 1) {
-		le = strecbrk(ls, end, '\n');
-
-		char* ns = ls;                     /* 1st field, name */
-		char* ne = strecbrk(ls, le, ':');
-		char* ps = ne + 1;                 /* 2nd field, password */
-		char* pe = strecbrk(ps, le, ':');
-		char* is = pe + 1;                 /* 3rd field, id */
-		char* ie = strecbrk(is, le, ':');
-
-		if(ie >= le)
-			continue;
-		if(strncmp(idstr, is, idlen))
-			continue;
-
-		return fmtstrn(p, e, ns, ne - ns);
-	}
-asnum:
-	return fmtstrn(p, e, idstr, idlen - 1);
+	if((in = find_id(im, id)))
+		return fmtstrn(p, e, in->name, in->len);
+	else
+		return fmti32(p, e, id);
 }
 
-/* Very dumb and straightforward approach for now. Definitely needs
-   some sort of caching here, in most cases all or almost all files
-   in the directory are owned by just one or two ids. */
-
 static char* fmt_uid(char* p, char* e, int id, CTX)
 {
-	return fmt_name(p, e, id, &ctx->passwd);
+	return fmt_name(p, e, id, &ctx->users);
 }
 
 static char* fmt_gid(char* p, char* e, int id, CTX)
 {
-	return fmt_name(p, e, id, &ctx->group);
+	return fmt_name(p, e, id, &ctx->groups);
 }
 
 static int numlen(uint64_t n)
@@ -544,6 +774,7 @@ static void list_directory(CTX)
 	void* eend = ctx->ptr;
 
 	index_entries(ctx, ents, eend);
+	stat_indexed(ctx);
 	sort_indexed(ctx);
 	dump_indexed(ctx);
 }
@@ -562,6 +793,7 @@ int main(int argc, char** argv)
 	ctx->patt = argv + i;
 
 	init_context(ctx, opts);
+	init_names(ctx);
 	list_directory(ctx);
 	fini_context(ctx);
 
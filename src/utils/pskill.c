@@ -1,7 +1,7 @@
 #include <sys/signal.h>
-#include <sys/dents.h>
 #include <sys/file.h>
 
+#include <procscan.h>
 #include <string.h>
 #include <format.h>
 #include <util.h>
@@ -13,12 +13,8 @@ ERRLIST(NEINVAL NEPERM NESRCH NENOSYS);
 struct top {
 	char** args;
 	int argn;
-	int fd;
 	int pid;
-	int len;
 	int sig;
-
-	char name[64];
 };
 
 #define CTX struct top* ctx
@@ -50,8 +46,6 @@ static const struct signame {
 	{ 0, "" }
 };
 
-static char cmdbuf[4096];
-
 static int sigbyname(char* name)
 {
 	const struct signame* sn;
@@ -91,72 +85,14 @@ static int find_by_pid(CTX, char* name)
 	return -1;
 }
 
-static int read_entry(CTX, int at, char* name)
-{
-	int fd, rd, ret;
-
-	if((fd = sys_openat(at, name, O_RDONLY)) < 0)
-		return fd;
-
-	if((rd = sys_read(fd, cmdbuf, sizeof(cmdbuf))) > 0)
-		ctx->len = rd;
-
-	if((ret = sys_close(fd)) < 0)
-		fail("close", NULL, ret);
-
-	return rd;
-}
-
-static int read_status(CTX, int at)
-{
-	int ret;
-
-	if((ret = read_entry(ctx, at, "status")) < 0)
-		return ret;
-
-	if(ret < 6) /* Name:_ */
-		return 0;
-	if(strncmp(cmdbuf, "Name:", 5))
-		return 0;
-
-	char* p = cmdbuf + 5;
-	char* e = cmdbuf + ret;
-
-	if(*p++ != '\t')
-		return 0;
-
-	char* s = p;
-
-	for(; p < e; p++)
-		if(*p == '\n')
-			break;
-	if(p >= e)
-		return 0;
-
-	ulong len = p - s;
-
-	if(len > sizeof(ctx->name))
-		return 0;
-
-	memzero(ctx->name, sizeof(ctx->name));
-	memcpy(ctx->name, s, len);
-
-	return len;
-}
-
-static int read_cmdline(CTX, int at)
-{
-	return read_entry(ctx, at, "cmdline");
-}
-
-static int find_by_name(CTX)
+static int find_by_name(CTX, struct psent* pe)
 {
 	int i, n = ctx->argn;
 	char** args = ctx->args;
 	char* arg;
 
-	char* name = ctx->name;
-	int size = sizeof(ctx->name);
+	char* name = pe->name;
+	int size = sizeof(pe->name);
 
 	for(i = 0; i < n; i++)
 		if(!(arg = args[i]))
@@ -167,25 +103,25 @@ static int find_by_name(CTX)
 	return -1;
 }
 
-static int find_by_cmd(CTX)
+static int find_by_cmd(CTX, struct psent* pe)
 {
 	int i, n = ctx->argn;
 	char** args = ctx->args;
 	char* arg;
 
-	char* p = cmdbuf;
-	char* e = cmdbuf + ctx->len;
+	char* p = pe->cmd;
+	char* e = p + pe->cmdlen;
 
 	for(; p < e; p++)
 		if(!*p) break;
 	if(p >= e)
-		return 0;
+		return -1;
 
 	char* s = p;
-	char* c = cmdbuf;
+	char* c = pe->cmd;
 
 	for(p = c; p < s; p++)
-		if(*p == '/') c = p;
+		if(*p == '/') c = p + 1;
 
 	char* cmd = c;
 	int len = s - c;
@@ -199,33 +135,29 @@ static int find_by_cmd(CTX)
 	return -1;
 }
 
-static void read_proc(CTX, char* name)
+static void check_proc(CTX, struct psent* pe)
 {
-	int at = ctx->fd;
-	int fd = -1, ret;
-	char* p;
+	int ret;
+
+	FMTBUF(p, e, name, 20);
+	p = fmtint(p, e, pe->pid);
+	FMTEND(p, e);
+
+	ctx->pid = pe->pid;
 
-	if(!(p = parseint(name, &ctx->pid)) || *p)
-		return;
 	if((ret = find_by_pid(ctx, name)) >= 0)
 		goto got;
-	if((fd = sys_openat(at, name, O_DIRECTORY)) < 0)
+	if(pe->err)
 		return;
-
-	if((ret = read_status(ctx, fd)) <= 0)
-		goto out;
-	if((ret = find_by_name(ctx)) >= 0)
+	if((ret = find_by_name(ctx, pe)) >= 0)
+		goto got;
+	if((ret = find_by_cmd(ctx, pe)) >= 0)
 		goto got;
 
-	if((ret = read_cmdline(ctx, fd)) <= 0)
-		goto out;
-	if((ret = find_by_cmd(ctx)) < 0)
-		goto out;
+	return;
 got:
 	ctx->args[ret] = NULL;
 	kill_proc(ctx, name);
-out:
-	if(fd >= 0) sys_close(fd);
 }
 
 static void report_remaining(CTX)
@@ -253,35 +185,21 @@ static void report_remaining(CTX)
 static void kill_by_name(char** args, int n, int sig)
 {
 	struct top context, *ctx = &context;
-	int fd, rd;
-	char* dir = "/proc";
-	char buf[2048];
+	struct pscan scan, *sc = &scan;
+	int i, ret;
 
 	ctx->args = args;
 	ctx->argn = n;
 	ctx->sig = sig;
 
-	if((fd = sys_open(dir, O_DIRECTORY)) < 0)
-		fail(NULL, dir, fd);
-
-	ctx->fd = fd;
-
-	while((rd = sys_getdents(ctx->fd, buf, sizeof(buf))) > 0) {
-		void* ptr = buf;
-		void* end = buf + rd;
+	memzero(sc, sizeof(*sc));
+	sc->flags = PS_CMDLINE;
 
-		while(ptr < end) {
-			struct dirent* de = ptr;
-			ptr += de->reclen;
+	if((ret = procscan(sc, NULL, 0)) < 0)
+		fail("scan", "/proc", ret);
 
-			if(de->reclen <= 0)
-				break;
-			if(de->type != DT_DIR)
-				continue;
-
-			read_proc(ctx, de->name);
-		}
-	}
+	for(i = 0; i < sc->count; i++)
+		check_proc(ctx, &sc->ents[i]);
 
 	report_remaining(ctx);
 }
@@ -1,10 +1,9 @@
 #include <sys/file.h>
-#include <sys/dents.h>
-#include <sys/mman.h>
 #include <sys/creds.h>
+#include <sys/sched.h>
 
+#include <procscan.h>
 #include <format.h>
-#include <printf.h>
 #include <string.h>
 #include <output.h>
 #include <util.h>
@@ -12,25 +11,20 @@
 
 ERRTAG("pslist");
 
-#define OPTS "rc"
+#define OPTS "rcw"
 #define OPT_r (1<<0)
 #define OPT_c (1<<1)
+#define OPT_w (1<<2)
 
 struct top {
 	int self;
 	int opts;
 
-	void* brk;
-	void* ptr;
-	void* end;
-
 	int npatt;
 	char** patts;
 
-	char state;
-	int pid, ppid;
-	int uid, euid;
-	int gid, egid;
+	int* pids;
+	int npids;
 
 	struct bufout bo;
 };
@@ -44,11 +38,12 @@ static void output(CTX, char* buf, int len)
 	bufout(&ctx->bo, buf, len);
 }
 
-static void format_proc_status(CTX)
+static void format_proc_status(CTX, struct psent* pe, char mark)
 {
 	FMTBUF(p, e, buf, 50);
+	if(mark) p = fmtchar(p, e, mark);
 	p = fmtstr(p, e, "\033[33m");
-	p = fmtint(p, e, ctx->pid);
+	p = fmtint(p, e, pe->pid);
 	p = fmtstr(p, e, "\033[0m");
 	FMTEND(p, e);
 
@@ -115,10 +110,10 @@ static void out_one_arg(CTX, char* arg, int len)
 		output(ctx, arg, len);
 }
 
-static void format_proc_cmdline(CTX)
+static void format_proc_cmdline(CTX, struct psent* pe)
 {
-	char* p = ctx->brk;
-	char* e = ctx->ptr;
+	char* p = pe->cmd;
+	char* e = p + pe->cmdlen;
 	char* s = p;
 
 	while(e > p && !*(e-1))
@@ -138,115 +133,44 @@ static void format_proc_cmdline(CTX)
 	output(ctx, "\n", 1);
 }
 
-static int isspace(int c)
-{
-	return (c == ' ' || c == '\t');
-}
-
-static char* skipspace(char* p, char* e)
-{
-	for(; p < e; p++)
-		if(!isspace(*p))
-			break;
-
-	return p;
-}
-
-static void set_int(char* p, int* dst)
-{
-	(void)parseint(p, dst);
-}
-
-static void set_uids(char* p, int* uid, int* euid)
-{
-	if(!(p = parseint(p, uid)))
-		return;
-	while(*p && isspace(*p))
-		p++;
-
-	(void)parseint(p, euid);
-}
-
-static int parse_status(CTX, char* buf, int len)
-{
-	int needstate = ctx->opts & OPT_r;
-
-	char* end = buf + len;
-	char* ls;
-	char* le;
-
-	for(ls = buf; ls < end; ls = le + 1) {
-		if((le = strecbrk(ls, end, '\n')) >= end)
-			break;
-
-		char* key = ls;
-		char* val;
-
-		if((val = strecbrk(ls, le, ':')) >= le)
-			break;
-
-		*le = '\0'; *val++ = '\0';
-		val = skipspace(val, le);
-
-		if(!strcmp(key, "Pid"))
-			set_int(val, &ctx->pid);
-		else if(!strcmp(key, "PPid"))
-			set_int(val, &ctx->ppid);
-		else if(!strcmp(key, "Uid"))
-			set_uids(val, &ctx->uid, &ctx->euid);
-		else if(!strcmp(key, "Gid"))
-			set_uids(val, &ctx->gid, &ctx->egid);
-		else if(needstate && !strcmp(key, "State"))
-			ctx->state = *val;
-	}
-
-	return 0;
-}
-
-static int read_proc_status(CTX, int at)
+static void format_proc(CTX, struct psent* pe, char mark)
 {
-	char buf[512];
-	int fd, rd;
-
-	if((fd = sys_openat(at, "status", O_RDONLY)) < 0)
-		return fd;
-	if((rd = sys_read(fd, buf, sizeof(buf))) < 0)
-		return rd;
-
-	sys_close(fd);
-
-	return parse_status(ctx, buf, rd);
+	format_proc_status(ctx, pe, mark);
+	format_proc_cmdline(ctx, pe);
 }
 
-static int check_proc_info(CTX)
+static int check_proc_info(CTX, struct psent* pe)
 {
-	if(ctx->pid < 0 || ctx->ppid < 0)
+	if(pe->err)
 		return -1;
-	if(ctx->pid == 2 || ctx->ppid == 2)
+	if(pe->pid == 2 || pe->ppid == 2)
 		return -1;
-	if(ctx->pid == ctx->self)
+	if(pe->pid == ctx->self)
 		return -1;
 
-	if((ctx->opts & OPT_r) && ctx->state != 'R')
+	if((ctx->opts & OPT_r) && pe->state != 'R')
 		return -1;
 
 	return 0;
 }
 
-static int check_proc_cmdline(CTX, char* pidstr)
+static int check_proc_cmdline(CTX, struct psent* pe)
 {
 	int i, n = ctx->npatt;
 	char** patts = ctx->patts;
 
 	if(!n) return 0;
 
-	char* cmd = ctx->brk;
-	char* end = ctx->ptr;
-	int len = end - cmd;
+	char* cmd = pe->cmd;
+	int len = pe->cmdlen;
 
 	if(ctx->opts & OPT_c)
 		len = strnlen(cmd, len);
 
+	FMTBUF(p, e, pidstr, 20);
+	p = fmtint(p, e, pe->pid);
+	FMTEND(p, e);
+
 	for(i = 0; i < n; i++)
 		if(!strcmp(patts[i], pidstr))
 			return 0;
@@ -256,151 +180,134 @@ static int check_proc_cmdline(CTX, char* pidstr)
 	return -1;
 }
 
-static void reset_proc_data(CTX)
+static int listed(CTX, struct psent* pe)
 {
-	ctx->state = 0;
+	if(check_proc_info(ctx, pe))
+		return 0;
+	if(check_proc_cmdline(ctx, pe))
+		return 0;
 
-	ctx->pid = -1;
-	ctx->ppid = -1;
-
-	ctx->ptr = ctx->brk;
+	return 1;
 }
 
-static int read_proc_cmdline(CTX, int at)
-{
-	int fd, rd;
-	void* buf = ctx->ptr;
-	int len = ctx->end - buf;
-
-	if((fd = sys_openat(at, "cmdline", O_RDONLY)) < 0)
-		return fd;
+/* Normally this tool must scan the whole /proc directory, but if it gets
+   called with pids only, doing so is unnecessary and it can just read
+   relevant /proc/$pid directories directly. */
 
-	while(1) {
-		rd = sys_read(fd, buf, len);
+static void check_pid_list(CTX, int* pids)
+{
+	int i, n = ctx->npatt;
+	char *p, **patts = ctx->patts;
 
-		if(rd > 0)
-			ctx->ptr += rd;
-		if(rd < len)
-			break;
+	for(i = 0; i < n; i++)
+		if(!(p = parseint(patts[i], &pids[i])) || *p)
+			return;
+	if(!n)
+		return;
 
-		void* old = ctx->end;
-		void* new = sys_brk(old + PAGE);
+	ctx->pids = pids;
+	ctx->npids = n;
+}
 
-		if((rd = brk_error(old, new)) < 0)
-			break;
+static void take_snapshot(CTX, struct pscan* ps)
+{
+	int ret;
 
-		ctx->end = new;
-		buf = ctx->ptr;
-		len = new - buf;
-	}
+	memzero(ps, sizeof(*ps));
 
-	if(rd < 0)
-		ctx->ptr = ctx->brk;
+	ps->flags = PS_CMDLINE;
 
-	sys_close(fd);
+	if(ctx->opts & OPT_w)
+		ps->flags |= PS_STAT;
 
-	return rd;
+	if((ret = procscan(ps, ctx->pids, ctx->npids)) < 0)
+		fail("scan", "/proc", ret);
 }
 
-static void read_proc(CTX, int at, char* pidstr)
+static void list_snapshot(CTX, struct pscan* ps)
 {
-	int fd;
+	struct psent* pe = ps->ents;
+	struct psent* pend = pe + ps->count;
 
-	if((fd = sys_openat(at, pidstr, O_DIRECTORY)) < 0)
-		return;
-
-	reset_proc_data(ctx);
-
-	if(read_proc_status(ctx, fd) < 0)
-		goto out;
-	if(check_proc_info(ctx))
-		goto out;
-	if(read_proc_cmdline(ctx, fd) < 0)
-		goto out;
-	if(check_proc_cmdline(ctx, pidstr))
-		goto out;
-
-	format_proc_status(ctx);
-	format_proc_cmdline(ctx);
-out:
-	sys_close(fd);
+	for(; pe < pend; pe++)
+		if(listed(ctx, pe))
+			format_proc(ctx, pe, 0);
 }
 
-static int isdigit(int c)
+/* Watch mode: after the initial listing, only the changes between
+   consecutive snapshots get printed, + for new processes, - for those
+   that exited, and ~ for those that changed their command line (exec).
+   Pids may get reused, so entries with the same pid are only considered
+   the same process if their start times match.
+
+   Both tables are sorted by pid, so the diff is a simple merge. */
+
+static int same_proc(struct psent* a, struct psent* b)
 {
-	return (c >= '0' && c <= '9');
+	return (a->pid == b->pid && a->start == b->start);
 }
 
-static void read_proc_list(CTX)
+static int same_cmd(struct psent* a, struct psent* b)
 {
-	int fd, rd;
-	char* dir = "/proc";
-	char buf[2048];
+	if(a->cmdlen != b->cmdlen)
+		return 0;
 
-	if((fd = sys_open(dir, O_DIRECTORY)) < 0)
-		fail(NULL, dir, fd);
-
-	while((rd = sys_getdents(fd, buf, sizeof(buf))) > 0) {
-		void* ptr = buf;
-		void* end = buf + rd;
-
-		while(ptr < end) {
-			struct dirent* de = ptr;
-			ptr += de->reclen;
-
-			if(de->reclen <= 0)
-				break;
-			if(de->type != DT_DIR)
-				continue;
-			if(!isdigit(de->name[0]))
-				continue;
-
-			read_proc(ctx, fd, de->name);
-		}
-	}
+	return !memcmp(a->cmd, b->cmd, a->cmdlen);
 }
 
-/* Normally this tool must scan the whole /proc directory, but if it gets
-   called with pids only, doing so is unnecessary and it can just open
-   relevant /proc/$pid directories directly. */
-
-static int need_whole_list(CTX)
+static struct psent* next_listed(CTX, struct psent* pe, struct psent* end)
 {
-	int i, n = ctx->npatt;
-	char *p, **patts = ctx->patts;
-	int pid;
-
-	for(i = 0; i < n; i++)
-		if(!(p = parseint(patts[i], &pid)) || *p)
-			return 1;
+	while(pe < end && !listed(ctx, pe))
+		pe++;
 
-	return !n;
+	return pe;
 }
 
-static void read_selected_pids(CTX)
+static void diff_snapshots(CTX, struct pscan* old, struct pscan* new)
 {
-	int i, n = ctx->npatt;
-	char* dir = "/proc";
-	int fd;
-
-	if((fd = sys_open(dir, O_DIRECTORY)) < 0)
-		fail(NULL, dir, fd);
-
-	for(i = 0; i < n; i++)
-		read_proc(ctx, fd, ctx->patts[i]);
+	struct psent* oe = old->ents + old->count;
+	struct psent* ne = new->ents + new->count;
+	struct psent* op = next_listed(ctx, old->ents, oe);
+	struct psent* np = next_listed(ctx, new->ents, ne);
+
+	while(op < oe || np < ne) {
+		if(np >= ne || (op < oe && op->pid < np->pid)) {
+			format_proc(ctx, op, '-');
+			op = next_listed(ctx, op + 1, oe);
+		} else if(op >= oe || np->pid < op->pid) {
+			format_proc(ctx, np, '+');
+			np = next_listed(ctx, np + 1, ne);
+		} else {
+			if(!same_proc(op, np)) {
+				format_proc(ctx, op, '-');
+				format_proc(ctx, np, '+');
+			} else if(!same_cmd(op, np)) {
+				format_proc(ctx, np, '~');
+			}
+			op = next_listed(ctx, op + 1, oe);
+			np = next_listed(ctx, np + 1, ne);
+		}
+	}
 }
 
-static void init_cmdmem(CTX)
+static void watch(CTX, struct pscan* ps)
 {
-	void* brk = sys_brk(NULL);
-	void* end = sys_brk(brk + PAGE);
+	struct pscan next;
+	struct timespec ts = { 1, 0 };
+	int ret;
+
+	while(1) {
+		bufoutflush(&ctx->bo);
 
-	if(brk_error(brk, end))
-		fail("cannot initialize heap", NULL, 0);
+		if((ret = sys_nanosleep(&ts, NULL)) < 0)
+			fail("nanosleep", NULL, ret);
 
-	ctx->brk = brk;
-	ctx->ptr = brk;
-	ctx->end = end;
+		take_snapshot(ctx, &next);
+		diff_snapshots(ctx, ps, &next);
+
+		psfree(ps);
+		*ps = next;
+	}
 }
 
 static void init_output(CTX)
@@ -419,6 +326,8 @@ int main(int argc, char** argv)
 {
 	int i = 1;
 	struct top context, *ctx = &context;
+	struct pscan snap, *ps = &snap;
+	int pids[argc];
 
 	memzero(ctx, sizeof(*ctx));
 
@@ -429,13 +338,14 @@ int main(int argc, char** argv)
 	ctx->npatt = argc - i;
 	ctx->patts = argv + i;
 
-	init_cmdmem(ctx);
 	init_output(ctx);
+	check_pid_list(ctx, pids);
 
-	if(need_whole_list(ctx))
-		read_proc_list(ctx);
-	else
-		read_selected_pids(ctx);
+	take_snapshot(ctx, ps);
+	list_snapshot(ctx, ps);
+
+	if(ctx->opts & OPT_w)
+		watch(ctx, ps);
 
 	fini_output(ctx);
 
@@ -1,8 +1,8 @@
 #include <sys/file.h>
-#include <sys/dents.h>
 #include <sys/mman.h>
 #include <sys/creds.h>
 
+#include <procscan.h>
 #include <format.h>
 #include <string.h>
 #include <output.h>
@@ -89,12 +89,9 @@ static void* alloc(CTX, int len)
 	return ret;
 }
 
-/* Proc entries are read into a growing heap (as structs proc),
-   then the heap is indexed.
-
-   The status files, /proc/$$/status, contain lots of stuff we
-   don't need, and all we need is always near the top of the file,
-   so only a 512-byte head is read. */
+/* Proc entries are taken from a /proc snapshot, see lib/procscan.c,
+   and copied into a growing heap (as structs proc), then the heap
+   is indexed. The snapshot is sorted by pid, so the index is too. */
 
 static void index_entries(CTX, void* ptr, void* end)
 {
@@ -115,191 +112,103 @@ static void index_entries(CTX, void* ptr, void* end)
 	ctx->procs = idx;
 }
 
-static int isspace(int c)
-{
-	return (c == ' ' || c == '\t');
-}
-
-static char* skipspace(char* p, char* e)
-{
-	for(; p < e; p++)
-		if(!isspace(*p))
-			break;
-
-	return p;
-}
-
-static void set_int(char* p, int* dst)
-{
-	(void)parseint(p, dst);
-}
-
-static void set_uids(char* p, int* uid, int* euid)
-{
-	if(!(p = parseint(p, uid)))
-		return;
-	while(*p && isspace(*p))
-		p++;
-
-	(void)parseint(p, euid);
-}
-
-static void parse_status(CTX, char* buf, int len)
+static void add_proc(CTX, struct psent* pe)
 {
-	char* end = buf + len;
-	char* ls;
-	char* le;
-
-	char* name = NULL;
-	int pid = 0, ppid = 0, euid = 0, uid = 0;
-
-	for(ls = buf; ls < end; ls = le + 1) {
-		if((le = strecbrk(ls, end, '\n')) >= end)
-			break;
-
-		char* key = ls;
-		char* val;
-
-		if((val = strecbrk(ls, le, ':')) >= le)
-			break;
-
-		*le = '\0'; *val++ = '\0';
-		val = skipspace(val, le);
-
-		if(!strcmp(key, "Name"))
-			name = val;
-		else if(!strcmp(key, "Pid"))
-			set_int(val, &pid);
-		else if(!strcmp(key, "PPid"))
-			set_int(val, &ppid);
-		else if(!strcmp(key, "Uid"))
-			set_uids(val, &uid, &euid);
-	}
+	int nlen = strlen(pe->name);
+	int plen = sizeof(struct proc) + nlen + 1;
 
-	if(!name) return;
+	plen = (plen + sizeof(int) - 1) & ~(sizeof(int) - 1);
 
-	int nlen = strlen(name);
-	int plen = sizeof(struct proc) + nlen + 1;
 	struct proc* ps = alloc(ctx, plen);
 
 	ps->len = plen;
-	ps->pid = pid;
-	ps->ppid = ppid;
-	ps->uid = uid;
-	ps->euid = euid;
+	ps->pid = pe->pid;
+	ps->ppid = pe->ppid;
+	ps->uid = pe->uid;
+	ps->euid = pe->euid;
 
 	ps->pidx = -1;
 	ps->ridx = -1;
 	ps->didx = -1;
 	ps->mark = (ctx->opts & SET_mark ? 0 : 2);
 
-	memcpy(ps->name, name, nlen + 1);
+	memcpy(ps->name, pe->name, nlen + 1);
 
 	ctx->nprocs++;
 }
 
-static void read_proc_status(CTX, int at, char* pstr)
-{
-	char buf[512];
-	int fd, rd;
-
-	FMTBUF(p, e, path, 40);
-	p = fmtstr(p, e, pstr);
-	p = fmtstr(p, e, "/status");
-	FMTEND(p, e);
-
-	if((fd = sys_openat(at, path, O_RDONLY)) < 0)
-		return;
-	if((rd = sys_read(fd, buf, sizeof(buf))) < 0)
-		return;
-
-	sys_close(fd);
-
-	return parse_status(ctx, buf, rd);
-}
-
-static int isdigit(int c)
-{
-	return (c >= '0' && c <= '9');
-}
-
 static void read_proc_list(CTX)
 {
-	int fd, rd;
-	char* dir = "/proc";
-	char buf[2048];
+	struct pscan scan, *sc = &scan;
+	int i, ret, self = sys_getpid();
 
-	if((fd = sys_open(dir, O_DIRECTORY)) < 0)
-		fail(NULL, dir, fd);
+	memzero(sc, sizeof(*sc));
 
-	FMTBUF(p, e, self, 50);
-	p = fmtint(p, e, sys_getpid());
-	FMTEND(p, e);
+	if((ret = procscan(sc, NULL, 0)) < 0)
+		fail("scan", "/proc", ret);
 
 	void* ptr = ctx->ptr;
 
-	while((rd = sys_getdents(fd, buf, sizeof(buf))) > 0) {
-		void* ptr = buf;
-		void* end = buf + rd;
+	for(i = 0; i < sc->count; i++) {
+		struct psent* pe = &sc->ents[i];
 
-		while(ptr < end) {
-			struct dirent* de = ptr;
-			ptr += de->reclen;
+		if(pe->err || pe->pid == self)
+			continue;
 
-			if(de->reclen <= 0)
-				break;
-			if(de->type != DT_DIR)
-				continue;
-			if(!isdigit(de->name[0]))
-				continue;
-			if(!strcmp(de->name, self))
-				continue;
-
-			read_proc_status(ctx, fd, de->name);
-		}
+		add_proc(ctx, pe);
 	}
 
 	void* end = ctx->ptr;
 
-	sys_close(fd);
+	psfree(sc);
 
 	index_entries(ctx, ptr, end);
 }
 
-/* The proc data comes with (pid, ppid) pairs from which a full tree
-   must be built. The following is an awful awful O(n^2) algorithm.
+static int find_index(CTX, int pid)
+{
+	struct proc** idx = ctx->procs;
+	int lo = 0, hi = ctx->nprocs;
+
+	while(lo < hi) {
+		int mid = lo + (hi - lo)/2;
+		int mp = idx[mid]->pid;
+
+		if(mp == pid)
+			return mid;
+		if(mp < pid)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
 
-   The entries are already sorted by pid, no need to sort them again
-   or disturb their order. */
+	return -1;
+}
+
+/* The proc data comes with (pid, ppid) pairs from which a full tree
+   must be built. Parents are located with a binary search over the
+   sorted index. Children are linked in reverse, so that each list
+   ends up sorted by pid as well. */
 
 static void build_ps_tree(CTX)
 {
 	int nprocs = ctx->nprocs;
 	struct proc** idx = ctx->procs;
 
-	for(int i = 0; i < nprocs; i++) {
-		struct proc* psi = idx[i];
-		struct proc* chi = NULL;
-		int pid = psi->pid;
-		int ridx = -1;
-
-		for(int j = 0; j < nprocs; j++) {
-			struct proc* psj = idx[j];
+	for(int j = nprocs - 1; j >= 0; j--) {
+		struct proc* psj = idx[j];
+		int i;
 
-			if(psj->ppid != pid)
-				continue;
-
-			psj->pidx = i;
-
-			if(ridx < 0)
-				ridx = j;
-			if(chi)
-				chi->didx = j;
+		if(!psj->ppid)
+			continue;
+		if((i = find_index(ctx, psj->ppid)) < 0)
+			continue;
 
-			chi = psj;
-		}
+		struct proc* psi = idx[i];
 
-		psi->ridx = ridx;
+		psj->pidx = i;
+		psj->didx = psi->ridx;
+		psi->ridx = j;
 	}
 }
 
@@ -1,7 +1,9 @@
 #include <sys/file.h>
 #include <sys/info.h>
 
+#include <procscan.h>
 #include <format.h>
+#include <string.h>
 #include <util.h>
 #include <main.h>
 
@@ -131,7 +133,67 @@ static char* fmtline4(char* p, char* e, struct sysinfo* si)
 	return p;
 }
 
-static void showall(struct sysinfo* si)
+/* sysinfo(2) only reports the total number of tasks, threads included.
+   The breakdown comes from a /proc snapshot. Kernel threads are those
+   of kthreadd (pid 2), and kthreadd itself. */
+
+struct counts {
+	int user;
+	int kernel;
+	int running;
+	int blocked;
+};
+
+static void count_procs(struct counts* pc)
+{
+	struct pscan scan, *sc = &scan;
+	int i;
+
+	memzero(sc, sizeof(*sc));
+	memzero(pc, sizeof(*pc));
+
+	if(procscan(sc, NULL, 0) < 0)
+		return;
+
+	for(i = 0; i < sc->count; i++) {
+		struct psent* pe = &sc->ents[i];
+
+		if(pe->err)
+			continue;
+		if(pe->pid == 2 || pe->ppid == 2)
+			pc->kernel++;
+		else
+			pc->user++;
+
+		if(pe->state == 'R')
+			pc->running++;
+		else if(pe->state == 'D')
+			pc->blocked++;
+	}
+
+	psfree(sc);
+}
+
+static char* fmtline5(char* p, char* e, struct counts* pc)
+{
+	if(!pc->user && !pc->kernel)
+		return p;
+
+	p = fmtstr(p, e, "Processes ");
+	p = fmti32(p, e, pc->user);
+	p = fmtstr(p, e, " user, ");
+	p = fmti32(p, e, pc->kernel);
+	p = fmtstr(p, e, " kernel, ");
+	p = fmti32(p, e, pc->running);
+	p = fmtstr(p, e, " running, ");
+	p = fmti32(p, e, pc->blocked);
+	p = fmtstr(p, e, " blocked");
+	p = fmtstr(p, e, "\n");
+
+	return p;
+}
+
+static void showall(struct sysinfo* si, struct counts* pc)
 {
 	char buf[1024];
 	char* p = buf;
@@ -141,6 +203,7 @@ static void showall(struct sysinfo* si)
 	p = fmtline2(p, e, si);
 	p = fmtline3(p, e, si);
 	p = fmtline4(p, e, si);
+	p = fmtline5(p, e, pc);
 
 	sys_write(1, buf, p - buf);
 }
@@ -148,6 +211,7 @@ static void showall(struct sysinfo* si)
 int main(int argc, char** argv)
 {
 	struct sysinfo si;
+	struct counts pc;
 	int ret;
 
 	(void)argv;
@@ -157,7 +221,9 @@ int main(int argc, char** argv)
 	if((ret = sys_info(&si)) < 0)
 		fail("sysinfo", NULL, ret);
 
-	showall(&si);
+	count_procs(&pc);
+
+	showall(&si, &pc);
 
 	return 0;
 }
@@ -33,8 +33,12 @@
    the failure. In GENL, nlerr does not carry the command itself, so seq is
    the only way to identify incoming errors */
 
+/* Scan dumps with lots of BSSes can be large, and the kernel packs them
+   into datagrams sized after the receive buffer. */
+
+#define RXBUF (32*1024)
+
 char txbuf[512];
-char rxbuf[8*1024];
 
 int netlink; /* file descriptor */
 uint nlseq; /* common seq counter for both streams */
@@ -44,7 +48,11 @@ struct ncbuf nc;
 
 void setup_netlink(void)
 {
-	nr_buf_set(&nr, rxbuf, sizeof(rxbuf));
+	int ret;
+
+	if((ret = nr_buf_map(&nr, RXBUF)) < 0)
+		fail("mmap", NULL, ret);
+
 	nc_buf_set(&nc, txbuf, sizeof(txbuf));
 }
 
@@ -183,7 +191,7 @@ void handle_netlink(void)
 	struct nlmsg* msg;
 	struct nlgen* gen;
 
-	if((ret = nr_recv(fd, &nr)) > 0)
+	if((ret = nr_recv_whole(fd, &nr)) > 0)
 		;
 	else if(ret == -EAGAIN)
 		return;
@@ -55,7 +55,7 @@ static int send_recv(int fd, struct nlgen** out)
 
 	if((ret = nc_send(fd, &nc)) < 0)
 		return ret;
-	if((ret = nr_recv(fd, &nr)) < 0)
+	if((ret = nr_recv_whole(fd, &nr)) < 0)
 		return ret;
 
 	if(!(msg = nr_next(&nr)))
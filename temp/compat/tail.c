@@ -3,37 +3,121 @@
 #include <sys/inotify.h>
 
 #include <string.h>
-#include <memoff.h>
+#include <format.h>
 #include <util.h>
 #include <main.h>
 
 ERRTAG("tail");
 
-#define OPTS "fh"
-#define OPT_f (1<<0)
-#define OPT_h (1<<1)
+#define OPTS "fFh"
+#define OPT_f (1<<0)	/* follow file contents */
+#define OPT_F (1<<1)	/* ... and re-open the file if it gets replaced */
+#define OPT_h (1<<2)	/* head mode */
+
+#define BLOCK (64*1024)	/* backward scan step, and the follow read size */
+
+struct file {
+	char* name;
+	char* base;
+	int fd;
+	int wd;		/* inotify watch for the file itself */
+	int dwd;	/* ... and for its directory, with -F */
+	off_t pos;	/* how much has been output so far */
+};
 
 struct top {
 	unsigned count;
 	int opts;
-	char* name;
-	int fd;
+
+	struct file* files;
+	int nfiles;
+	int last;	/* file the last output came from */
 
 	char* buf;
 	size_t len;
 
-	int inofd; /* inotify fd */
-	int inowd; /* for the file itself */
+	char* ring;	/* for non-seekable files, see skip_file_tail */
+	size_t rlen;
 
-	off_t size;
+	int inofd; /* inotify fd */
 };
 
-/* tail -f sets up inotify for the file itself and for the directory it
-   resides in. Directory events are needed to catch log rotation: if inotify
-   reports IN_CREATE with the same name as the file we're monitoring, we drop
-   the old one and open the newly created file.
+#define CTX struct top* ctx
+#define FL struct file* fl
+
+static void output(char* buf, int len)
+{
+	int wr;
+
+	if((wr = writeall(STDOUT, buf, len)) < 0)
+		fail("write", "STDOUT", wr);
+}
+
+/* With several files, each chunk of output gets a header saying
+   which file it comes from. Follow mode only needs one when the output
+   switches to a different file. */
+
+static void header(CTX, FL)
+{
+	int idx = fl - ctx->files;
+
+	if(ctx->nfiles < 2)
+		return;
+	if(ctx->last == idx)
+		return;
+
+	FMTBUF(p, e, buf, strlen(fl->name) + 20);
+
+	if(ctx->last >= 0)
+		p = fmtstr(p, e, "\n");
 
-   This only makes sense for logs. */
+	p = fmtstr(p, e, "==> ");
+	p = fmtstr(p, e, fl->name);
+	p = fmtstr(p, e, " <==");
+
+	FMTENL(p, e);
+
+	output(buf, p - buf);
+
+	ctx->last = idx;
+}
+
+static char* heap_alloc(long len, size_t* got)
+{
+	void* brk = sys_brk(0);
+	void* end = sys_brk(brk + len);
+
+	if(brk_error(brk, end))
+		fail("cannot allocate memory", NULL, 0);
+
+	*got = end - brk;
+
+	return brk;
+}
+
+static void allocate_tail_buf(CTX, int len)
+{
+	ctx->buf = heap_alloc(len, &ctx->len);
+}
+
+static int open_file(char* name)
+{
+	int fd;
+
+	if((fd = sys_open(name, O_RDONLY)) < 0)
+		fail(NULL, name, fd);
+
+	return fd;
+}
+
+/* tail -f watches the files with inotify, all of them on a single
+   inotify fd. IN_MODIFY tracks the inodes, so renamed files keep
+   being followed.
+
+   tail -F also watches the directories the files reside in. If inotify
+   reports IN_CREATE or IN_MOVED_TO with the same name as one of the files
+   being monitored, we drain the old file and open the new one. This is
+   what log rotation looks like. */
 
 static void dirname(char* path, char* buf, int len)
 {
@@ -58,192 +142,164 @@ static void dirname(char* path, char* buf, int len)
 	}
 }
 
-static void start_inotify(struct top* ctx)
+static void start_inotify(CTX)
 {
-	char* name = ctx->name;
-	int fd, ret;
+	int fd;
 
-	if((fd = sys_inotify_init()) < 0)
+	if((fd = sys_inotify_init1(IN_CLOEXEC)) < 0)
 		fail("inotify-init", NULL, fd);
 
 	ctx->inofd = fd;
-
-	if((ret = sys_inotify_add_watch(fd, name, IN_MODIFY)) < 0)
-		fail("inotify-add", name, ret);
-
-	ctx->inowd = ret;
-
-	char dir[strlen(name)+2];
-	dirname(name, dir, sizeof(dir));
-
-	if((ret = sys_inotify_add_watch(fd, dir, IN_CREATE)) < 0)
-		fail("inotify-add", dir, ret);
 }
 
-static int wait_inotify(struct top* ctx, char* base)
+static void watch_file(CTX, FL)
 {
-	int fd = ctx->inofd;
-	char buf[500];
-	int newfile = 0;
-	int rd;
-
-	if((rd = sys_read(fd, buf, sizeof(buf))) < 0)
-		fail("inotify", NULL, rd);
-
-	void* p = buf;
-	void* e = buf + rd;
-
-	while(p < e) {
-		struct inotify_event* evt = p;
-
-		if(evt->mask != IN_CREATE)
-			;
-		else if(!strcmp(evt->name, base))
-			newfile = 1;
+	int ret;
 
-		p += sizeof(*evt) + evt->len;
-	}
+	if((ret = sys_inotify_add_watch(ctx->inofd, fl->name, IN_MODIFY)) < 0)
+		fail("inotify-add", fl->name, ret);
 
-	return newfile;
+	fl->wd = ret;
 }
 
-static int open_file(char* name)
+static void watch_dir(CTX, FL)
 {
-	int fd;
+	char* name = fl->name;
+	char dir[strlen(name)+2];
+	int ret, mask = IN_CREATE | IN_MOVED_TO;
 
-	if((fd = sys_open(name, O_RDONLY)) < 0)
-		fail(NULL, name, fd);
+	dirname(name, dir, sizeof(dir));
 
-	return fd;
-}
+	if((ret = sys_inotify_add_watch(ctx->inofd, dir, mask)) < 0)
+		fail("inotify-add", dir, ret);
 
-static void reopen_file(struct top* ctx)
-{
-	int fd = ctx->fd;
-	char* name = ctx->name;
+	fl->dwd = ret;
+}
 
-	warn("reopening", name, 0);
+/* Fun fact: if we read() till the end of file, wait until it grows,
+   and read() again, we'll get the appended data. No seeks needed.
 
-	sys_close(fd);
+   Each IN_MODIFY gets a stat call to see how much has been appended,
+   and exactly that much gets read. Logs may get truncated during e.g.
+   a daemon restart; this shows up as the size decreasing, and tail
+   rewinds the file and starts reading from the beginning.
 
-	ctx->fd = open_file(name);
-	ctx->size = 0;
+   The size may not actually decrease if the new file gets larger than
+   the old one fast enough. This part is inherently racy. Logs only. */
 
-	int inofd = ctx->inofd;
-	int inowd = ctx->inowd;
+static void check_truncation(CTX, FL, off_t size)
+{
 	int ret;
 
-	if((ret = sys_inotify_rm_watch(inofd, inowd)) < 0)
-		fail("inotify-rm", name, ret);
-
-	if((ret = sys_inotify_add_watch(inofd, name, IN_MODIFY)) < 0)
-		fail("inotify-add", name, ret);
+	if(size >= fl->pos)
+		return;
 
-	ctx->inowd = ret;
-}
+	warn("truncated", fl->name, 0);
 
-/* tail estimates the size (in bytes) the requested number of strings should
-   take up at most, and then reads about that much data. If there are more
-   than N strings there, the extra ones are skipped, otherwise the output
-   will be less than N strings. Which isn't the worst options by the way,
-   as it limits the about of garbage the users would get if the file happens
-   to be non-text. */
+	if((ret = sys_seek(fl->fd, 0)) < 0)
+		fail("seek", fl->name, ret);
 
-unsigned estimate_size(unsigned count)
-{
-	return 120*count;
+	fl->pos = 0;
 }
 
-void allocate_tail_buf(struct top* ctx, int len)
+static void read_appended(CTX, FL)
 {
-	void* brk = sys_brk(0);
-	void* end = sys_brk(brk + len);
+	char* buf = ctx->buf;
+	long len = ctx->len;
+	struct stat st;
+	int ret, rd;
 
-	if(brk_error(brk, end))
-		fail("cannot allocate memory", NULL, 0);
+	if((ret = sys_fstat(fl->fd, &st)) < 0)
+		fail("stat", fl->name, ret);
 
-	ctx->buf = brk;
-	ctx->len = end - brk;
-}
+	check_truncation(ctx, fl, st.size);
 
-static void output(char* buf, int len)
-{
-	int wr;
-
-	if((wr = writeall(STDOUT, buf, len)) < 0)
-		fail("write", "STDOUT", wr);
-}
+	while(fl->pos < st.size) {
+		long left = st.size - fl->pos;
 
-/* Fun fact: if we read() till the end of file, wait until it grows,
-   and read() again, we'll get the appended data. No seeks needed. */
+		if(left > len)
+			left = len;
 
-static void slurp_tail(struct top* ctx)
-{
-	int fd = ctx->fd;
-	int rd;
-	char* buf = ctx->buf;
-	int len = ctx->len;
+		if((rd = sys_read(fl->fd, buf, left)) < 0)
+			fail("read", fl->name, rd);
+		if(!rd)
+			break;
 
-	while((rd = sys_read(fd, buf, len)) > 0)
+		header(ctx, fl);
 		output(buf, rd);
-}
 
-/* Logs may get truncated during e.g. a daemon restart. This gets detected
-   with a stat() that should(*) show the size decreasing. If this happens,
-   tail rewinds the file and starts reading from the beginning. This only
-   makes sense for logs.
-
-   * actually it may not if the new file gets larger than the old one
-   fast enough. This part is inherently racy. Again, logs only. */
+		fl->pos += rd;
+	}
+}
 
-static int check_truncation(struct top* ctx)
+static void reopen_file(CTX, FL)
 {
-	int fd = ctx->fd;
-	struct stat st;
-	int ret;
+	read_appended(ctx, fl);
 
-	if((ret = sys_fstat(fd, &st)) < 0)
-		return ret;
+	warn("reopening", fl->name, 0);
 
-	if(st.size < ctx->size) {
-		warn("rewinding", ctx->name, 0);
+	if(fl->wd >= 0)
+		sys_inotify_rm_watch(ctx->inofd, fl->wd);
 
-		if((ret = sys_seek(fd, 0)) < 0)
-			fail("seek", ctx->name, ret);
+	sys_close(fl->fd);
 
-		ctx->size = 0;
+	fl->fd = open_file(fl->name);
+	fl->pos = 0;
 
-		return 1;
-	}
+	watch_file(ctx, fl);
+	read_appended(ctx, fl);
+}
 
-	ctx->size = st.size;
+static void file_event(CTX, struct inotify_event* evt)
+{
+	struct file* fl;
+	int i, n = ctx->nfiles;
+
+	for(i = 0; i < n; i++) {
+		fl = &ctx->files[i];
+
+		if(fl->wd == evt->wd) {
+			if(evt->mask & IN_IGNORED)
+				fl->wd = -1;
+			else
+				read_appended(ctx, fl);
+		} else if(fl->dwd == evt->wd) {
+			if(!evt->len || strcmp(evt->name, fl->base))
+				continue;
 
-	return 0;
+			reopen_file(ctx, fl);
+		}
+	}
 }
 
-static void follow_tail(struct top* ctx)
+static void follow_files(CTX)
 {
-	char* name = ctx->name;
-	char* base = basename(name);
+	int fd = ctx->inofd;
+	char buf[4096] __attribute__((aligned(8)));
+	int rd;
 
-	start_inotify(ctx);
+	while((rd = sys_read(fd, buf, sizeof(buf))) > 0) {
+		void* p = buf;
+		void* e = buf + rd;
 
-	while(1) {
-		slurp_tail(ctx);
+		while(p < e) {
+			struct inotify_event* evt = p;
 
-		if(check_truncation(ctx))
-			continue;
-		if(!wait_inotify(ctx, base))
-			continue;
+			file_event(ctx, evt);
+
+			p += sizeof(*evt) + evt->len;
+		}
+	}
 
-		slurp_tail(ctx);
-		reopen_file(ctx);
-	};
+	fail("inotify", NULL, rd);
 }
 
 /* To get the last N lines from a stream (or a non-seekable file), we read
    it into a ring buffer of estimated size until EOF and dump the last N
-   lines from the buffer.
+   lines from the buffer. tail estimates the size (in bytes) the requested
+   number of strings should take up at most. If there are more than N
+   strings there, the extra ones are skipped, otherwise the output will be
+   less than N strings.
 
    The buffer layout is very simple, it's just buf[est] and we call read()
    to fill it completely over and over again. If the last pass filled it
@@ -256,6 +312,11 @@ static void follow_tail(struct top* ctx)
    M - N lines noting the offset, and start dumping the buf contents from
    that offset. */
 
+static unsigned estimate_size(unsigned count)
+{
+	return 120*count;
+}
+
 static void dump_from_offset(char* buf, char* ptr, char* end, int full, int off)
 {
 	int len = 0;
@@ -269,30 +330,19 @@ static void dump_from_offset(char* buf, char* ptr, char* end, int full, int off)
 		output(buf + off, len - off);
 }
 
-static int count_lines_in(char* buf, int len)
-{
-	int cnt = 0;
-
-	for(char* p = buf; p < buf + len; p++)
-		if(*p == '\n')
-			cnt++;
-
-	return cnt;
-}
-
 static int count_lines(char* buf, char* ptr, char* end, int full)
 {
 	int cnt = 0;
 
 	if(full && ptr < end)
-		cnt += count_lines_in(ptr, end - ptr);
+		cnt += memcount(ptr, end - ptr, '\n');
 	if(ptr > buf)
-		cnt += count_lines_in(buf, ptr - buf);
+		cnt += memcount(buf, ptr - buf, '\n');
 
 	return cnt;
 }
 
-long skip_nlines_in(char* buf, char* ptr, long off, int skip, int* lines)
+static long skip_nlines_in(char* buf, char* ptr, long off, int skip, int* lines)
 {
 	char* p;
 	int cnt = *lines;
@@ -306,7 +356,7 @@ long skip_nlines_in(char* buf, char* ptr, long off, int skip, int* lines)
 	return 0;
 }
 
-int skip_nlines(char* buf, char* ptr, char* end, int full, int skip)
+static int skip_nlines(char* buf, char* ptr, char* end, int full, int skip)
 {
 	int lines = 0;
 	long off = 0;
@@ -330,26 +380,42 @@ int skip_nlines(char* buf, char* ptr, char* end, int full, int skip)
 	return off + 1;
 }
 
-static void skip_file_tail(struct top* ctx)
+/* Non-seekable files get read through a ring buffer sized for the
+   requested number of lines. It is kept apart from ctx->buf, which
+   the follow code and any seekable files that come next still need,
+   and gets allocated once for all the files. */
+
+static void allocate_ring(CTX)
+{
+	unsigned size = estimate_size(ctx->count);
+
+	if(ctx->ring)
+		return;
+	if(size < BLOCK)
+		size = BLOCK;
+
+	ctx->ring = heap_alloc(size, &ctx->rlen);
+}
+
+static void skip_file_tail(CTX, int fd, char* name)
 {
 	int count = ctx->count;
 
-	allocate_tail_buf(ctx, estimate_size(count));
+	allocate_ring(ctx);
 
-	char* buf = ctx->buf;
-	char* end = buf + ctx->len;
+	char* buf = ctx->ring;
+	char* end = buf + ctx->rlen;
 	char* ptr = buf;
-	int rd, fd = ctx->fd;
+	int rd;
 	int full = 0;
 
 	while((rd = sys_read(fd, ptr, end - ptr)) > 0) {
-		if(ptr < end) {
-			ptr += rd;
-		} else {
-			ptr = buf;
-			full = 1;
-		}
-	} if(rd < 0) fail("read", ctx->name, rd);
+		if((ptr += rd) < end)
+			continue;
+
+		ptr = buf;
+		full = 1;
+	} if(rd < 0) fail("read", name, rd);
 
 	int cnt = count_lines(buf, ptr, end, full);
 	int skip = cnt > count ? cnt - count : 0;
@@ -358,114 +424,97 @@ static void skip_file_tail(struct top* ctx)
 	dump_from_offset(buf, ptr, end, full, off);
 }
 
-/* Here's how seekable files are treated: tail reads the high estimate
-   of data at the end of the file and counts the lines there. If there
-   are M > N lines there, it seeks back to the same position and repeats
-   the read, but only starts writing them out after skipping the initial
-   M - N lines.
+/* Seekable files get scanned backwards from the end, a block at a time,
+   with only the line count taken for each block until the one holding
+   the start of the requested lines. No guessing involved, and nothing
+   before that block gets read. A newline at the very end of the file
+   terminates the last line and does not count. */
 
-   There are better ways to do it, but this approach is simple and if N
-   is small it should work well. And N should always be small. */
-
-static int count_tail_lines(struct top* ctx)
+static void read_block(FL, char* buf, long len, off_t off)
 {
-	int rd;
-	int fd = ctx->fd;
-	char* buf = ctx->buf;
-	int len = ctx->len;
-	char* p;
-	int count = 0;
-
-	while((rd = sys_read(fd, buf, len)) > 0)
-		for(p = buf; p < buf + rd; p++)
-			if(*p == '\n')
-				count++;
+	long rd;
 
-	return count;
+	if((rd = sys_pread(fl->fd, buf, len, off)) < 0)
+		fail("read", fl->name, rd);
+	if(rd < len)
+		fail("file shrunk while reading", fl->name, 0);
 }
 
-void read_skipping_first(struct top* ctx, int cnt)
+static off_t find_tail_start(CTX, FL, off_t size)
 {
-	int fd = ctx->fd;
 	char* buf = ctx->buf;
-	int len = ctx->len;
-	int rd;
+	off_t pos = size;
+	unsigned need = ctx->count;
 	char* p;
-	int seen = 0;
 
-	while((rd = sys_read(fd, buf, len)) > 0) {
-		for(p = buf; p < buf + rd; p++) {
-			if(*p != '\n')
-				continue;
-			if(++seen > cnt) {
-				output(p + 1, buf + rd - p - 1);
-				break;
-			}
-		}
-	} if(rd > 0) {
-		slurp_tail(ctx);
-	}
-}
+	read_block(fl, buf, 1, size - 1);
 
-static int is_regular_file(struct stat* st)
-{
-	return ((st->mode & S_IFMT) == S_IFREG);
-}
+	if(buf[0] == '\n')
+		need++;
+	if(!need)
+		return size;
 
-static void seek_file(struct top* ctx, off_t off)
-{
-	int ret;
+	while(pos > 0) {
+		long len = pos > BLOCK ? BLOCK : pos;
+
+		pos -= len;
 
-	if((ret = sys_seek(ctx->fd, off)) < 0)
-		fail("seek", ctx->name, ret);
+		read_block(fl, buf, len, pos);
+
+		unsigned cnt = memcount(buf, len, '\n');
+
+		if(cnt < need) {
+			need -= cnt;
+			continue;
+		}
+
+		for(p = buf + len - 1; p >= buf; p--)
+			if(*p == '\n' && !--need)
+				return pos + (p - buf) + 1;
+	}
+
+	return 0;
 }
 
-static void seek_file_tail(struct top* ctx)
+static void seek_file_tail(CTX, FL)
 {
-	unsigned count = ctx->count;
-	unsigned est = estimate_size(count);
 	struct stat st;
+	off_t start;
 	int ret;
 
-	if((ret = sys_fstat(ctx->fd, &st)) < 0)
-		fail("stat", ctx->name, ret);
-
-	if(!is_regular_file(&st) || !st.size)
-		return skip_file_tail(ctx);
+	if((ret = sys_fstat(fl->fd, &st)) < 0)
+		fail("stat", fl->name, ret);
 
-	ulong maxbuf = (1<<20);
-	ulong buflen = maxbuf;
+	header(ctx, fl);
 
-	if(mem_off_cmp(maxbuf, st.size) > 0)
-		buflen = st.size;
+	if((st.mode & S_IFMT) != S_IFREG)
+		return skip_file_tail(ctx, fl->fd, fl->name);
+	if(!st.size)
+		return;
 
-	allocate_tail_buf(ctx, buflen);
+	start = find_tail_start(ctx, fl, st.size);
 
-	if(est < st.size)
-		seek_file(ctx, st.size - est);
+	if((ret = sys_seek(fl->fd, start)) < 0)
+		fail("seek", fl->name, ret);
 
-	unsigned cnt = count_tail_lines(ctx);
-	unsigned skip = cnt > count ? cnt - count : 0;
+	fl->pos = start;
 
-	if(est < st.size)
-		seek_file(ctx, st.size - est);
-	else
-		seek_file(ctx, 0);
-
-	read_skipping_first(ctx, skip);
+	read_appended(ctx, fl);
 }
 
 /* Head mode, because head is too small to be a standalone tool.
    Only shares the memory allocation with the tail code here. */
 
-void skip_file_head(struct top* ctx)
+static void skip_file_head(CTX, int fd, char* name)
 {
-	int fd = ctx->fd;
 	char* buf = ctx->buf;
 	int len = ctx->len;
 	int count = ctx->count;
 	int rd, seen = 0;
 
+	if(!count)
+		return;
+
 	while((rd = sys_read(fd, buf, len))) {
 		char* p = buf;
 
@@ -480,62 +529,71 @@ void skip_file_head(struct top* ctx)
 		if(p < buf + rd)
 			break;
 
-	} if(rd < 0) fail(NULL, ctx->name, rd);
+	} if(rd < 0) fail(NULL, name, rd);
 }
 
 /* Options parsing and context setup. */
 
-static void run_file(int count, int opts, char* name)
+static void run_files(CTX)
 {
-	struct top context = {
-		.count = count,
-		.opts = opts,
-		.name = name,
-		.size = 0
-	}, *ctx = &context;
+	int i, n = ctx->nfiles;
+	int opts = ctx->opts;
 
-	ctx->fd = open_file(name);
+	allocate_tail_buf(ctx, BLOCK);
 
-	seek_file_tail(ctx);
+	if(opts & (OPT_f | OPT_F))
+		start_inotify(ctx);
 
-	if(!(opts & OPT_f)) return;
+	for(i = 0; i < n; i++) {
+		struct file* fl = &ctx->files[i];
 
-	follow_tail(ctx);
+		fl->fd = open_file(fl->name);
+		fl->base = basename(fl->name);
+		fl->wd = -1;
+		fl->dwd = -1;
+
+		if(opts & (OPT_f | OPT_F))
+			watch_file(ctx, fl);
+		if(opts & OPT_F)
+			watch_dir(ctx, fl);
+
+		seek_file_tail(ctx, fl);
+	}
+
+	if(opts & (OPT_f | OPT_F))
+		follow_files(ctx);
 }
 
-static void run_pipe(int count, int opts)
+static void run_pipe(CTX)
 {
-	struct top context = {
-		.count = count,
-		.opts = opts,
-		.name = NULL,
-		.fd = STDIN
-	}, *ctx = &context;
-
-	if(opts & OPT_f)
+	if(ctx->opts & (OPT_f | OPT_F))
 		fail("cannot follow stdin", NULL, 0);
 
-	skip_file_tail(ctx);
+	skip_file_tail(ctx, STDIN, NULL);
 }
 
-static void run_head(int count, int opts, char* name)
+static void run_head(CTX)
 {
-	struct top context = {
-		.count = count,
-		.opts = opts,
-		.name = name
-	}, *ctx = &context;
+	int i, n = ctx->nfiles;
 
-	if(opts & OPT_f)
+	if(ctx->opts & (OPT_f | OPT_F))
 		fail("-f cannot be used with -h", NULL, 0);
 
-	ctx->fd = name ? open_file(name) : STDIN;
+	allocate_tail_buf(ctx, estimate_size(ctx->count));
+
+	if(!n)
+		return skip_file_head(ctx, STDIN, NULL);
+
+	for(i = 0; i < n; i++) {
+		struct file* fl = &ctx->files[i];
 
-	int est = estimate_size(count);
+		fl->fd = open_file(fl->name);
 
-	allocate_tail_buf(ctx, est);
+		header(ctx, fl);
+		skip_file_head(ctx, fl->fd, fl->name);
 
-	skip_file_head(ctx);
+		sys_close(fl->fd);
+	}
 }
 
 static int isdigit(int c)
@@ -545,11 +603,11 @@ static int isdigit(int c)
 
 static void parse_opts(char* arg, int* opts, int* count)
 {
-	int cnt = 0;
+	int cnt = 0, digits = 0;
 
-	for(; isdigit(*arg); arg++)
+	for(; isdigit(*arg); arg++, digits++)
 		cnt = 10*cnt + (*arg - '0');
-	if(cnt)
+	if(digits)
 		*count = cnt;
 
 	*opts = argbits(OPTS, arg);
@@ -557,23 +615,35 @@ static void parse_opts(char* arg, int* opts, int* count)
 
 int main(int argc, char** argv)
 {
-	int i = 1;
+	struct top context, *ctx = &context;
+	int i = 1, n;
 	int opts = 0, count = 10;
 
 	if(i < argc && argv[i][0] == '-')
 		parse_opts(argv[i++] + 1, &opts, &count);
 
-	if(i < argc - 1)
-		fail("too many arguments", NULL, 0);
+	n = argc - i;
+
+	struct file files[n];
+
+	memzero(ctx, sizeof(*ctx));
+	memzero(files, sizeof(files));
+
+	ctx->count = count;
+	ctx->opts = opts;
+	ctx->files = files;
+	ctx->nfiles = n;
+	ctx->last = -1;
 
-	char* name = i < argc ? argv[i] : NULL;
+	for(int k = 0; k < n; k++)
+		files[k].name = argv[i + k];
 
 	if(opts & OPT_h)
-		run_head(count, opts, name);
-	else if(name)
-		run_file(count, opts, name);
+		run_head(ctx);
+	else if(n)
+		run_files(ctx);
 	else
-		run_pipe(count, opts);
+		run_pipe(ctx);
 
 	return 0;
 }
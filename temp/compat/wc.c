@@ -1,13 +1,15 @@
 #include <sys/file.h>
 #include <sys/mman.h>
+#include <sys/proc.h>
+#include <sys/prctl.h>
 
 #include <string.h>
 #include <format.h>
 #include <main.h>
 #include <util.h>
 
-#define BUFSIZE 16*4096
-#define MAPSIZE 0x80000000
+#define BUFSIZE (256*1024)	/* read buffer for stdin and non-regular files */
+#define MAPSIZE (64*1024*1024)	/* mmap window for regular files */
 
 #define OPTS "lcw"
 #define OPT_l (1<<0)	/* lines */
@@ -24,6 +26,8 @@ struct wc {
 	uint64_t lines;
 	uint64_t words;
 	uint64_t bytes;
+	int inword;	/* last byte counted was a word char */
+	int err;	/* for files counted by forked workers */
 };
 
 static void addcounts(struct wc* a, struct wc* c)
@@ -96,6 +100,70 @@ static void dump(struct wc* cnts, const char* file, int opts)
 		fail("write", NULL, ret);
 }
 
+/* Words are runs of printable non-space ASCII characters, 0x21 to 0x7E.
+   XXX: that's not what BB wc does.
+
+   The bulk of the data gets processed a word (machine word) at a time.
+   Each byte of the word gets its high bit set if it is a word character,
+   and word starts are the bytes flagged so with the preceding byte not
+   flagged. The preceding byte for the first one in the word is the last
+   one of the previous word, which gets carried over. Lines are counted
+   the same way memcount() does it. Both counts get accumulated per byte
+   lane, and folded before the lane counters could overflow.
+
+   There are no SSE2/AVX2/NEON kernels. The build is -nostdinc, so the
+   compiler's intrinsic headers are not available, and per-arch code
+   would need a scalar fallback anyway for the arches without vector
+   units. Plain C over ulong words works the same everywhere. */
+
+#define ONES  (~0UL/255)
+#define HIGHS (ONES*0x80)
+#define LOWS  (ONES*0x7F)
+#define PAIRS (~0UL/0xFFFF)
+#define EVENS (PAIRS*0xFF)
+
+#define W sizeof(ulong)
+
+static inline ulong load(const char* p)
+{
+	ulong w;
+
+	__builtin_memcpy(&w, p, sizeof(w));
+
+	return w;
+}
+
+static inline ulong newlines(ulong w)
+{
+	ulong x = w ^ (ONES*'\n');
+
+	return ~(((x & LOWS) + LOWS) | x) & HIGHS;
+}
+
+static inline ulong wordchars(ulong w)
+{
+	ulong lo = w & LOWS;
+	ulong above20 = lo + ONES*(0x80 - 0x21);
+	ulong is7F = lo + ONES;
+
+	return above20 & ~is7F & ~w & HIGHS;
+}
+
+#ifdef BIGENDIAN
+# define PREVBYTES(wc, carry) (((wc) >> 8) | ((carry) << 8*(W-1)))
+# define LASTBYTE(wc) ((wc) & 0x80)
+#else
+# define PREVBYTES(wc, carry) (((wc) << 8) | (carry))
+# define LASTBYTE(wc) ((wc) >> 8*(W-1))
+#endif
+
+static inline uint64_t fold(ulong acc)
+{
+	ulong sum = (acc & EVENS) + ((acc >> 8) & EVENS);
+
+	return (sum * PAIRS) >> (8*(W - 2));
+}
+
 static int wordchar(char* p)
 {
 	unsigned char* q = (unsigned char*) p;
@@ -103,90 +171,247 @@ static int wordchar(char* p)
 	return ((*q > 0x20) && (*q < 0x7F));
 }
 
-static void count(struct wc* cnts, char* buf, unsigned long len)
+static void count_tail(struct wc* cnts, char* p, char* end)
 {
-	char* p;
-	char* end = buf + len;
-	int inword = 0;
-	struct wc c = { 0, 0, 0 };
-
-	for(p = buf; p < end; p++) {
-		/* XXX: this should be unicode count, total file size
-		   is something stat should be used for, now wc. */
-		c.bytes++;
+	int inword = cnts->inword;
 
+	for(; p < end; p++) {
 		if(*p == '\n')
-			c.lines++;
+			cnts->lines++;
 		if(wordchar(p)) {
-			/* XXX: that's not what BB wc does */
-			if(!inword) {
-				inword = 1;
-				c.words++;
-			}
+			if(!inword)
+				cnts->words++;
+			inword = 1;
 		} else {
 			inword = 0;
 		};
 	}
 
-	addcounts(cnts, &c);
+	cnts->inword = inword;
 }
 
-static void countstdin(struct wc* cnts)
+static void count(struct wc* cnts, char* buf, unsigned long len)
 {
-	const int len = BUFSIZE;
+	char* p = buf;
+	char* end = buf + len;
+	ulong carry = cnts->inword ? 0x80 : 0;
 
-	const int prot = PROT_READ | PROT_WRITE;
-	const int flags = MAP_PRIVATE;
+	cnts->bytes += len;
+
+	while(end - p >= W) {
+		char* e = (end - p) > 255*W ? p + 255*W : end;
+		ulong lacc = 0, wacc = 0;
+
+		for(; e - p >= W; p += W) {
+			ulong w = load(p);
+			ulong wc = wordchars(w);
+
+			lacc += newlines(w) >> 7;
+			wacc += (wc & ~PREVBYTES(wc, carry)) >> 7;
+
+			carry = LASTBYTE(wc);
+		}
+
+		cnts->lines += fold(lacc);
+		cnts->words += fold(wacc);
+	}
+
+	cnts->inword = !!carry;
+
+	count_tail(cnts, p, end);
+}
+
+/* With -l, only the lines need counting, and there is a faster routine
+   for that. With -c, regular files do not need to be read at all. */
+
+static void count_chunk(struct wc* cnts, char* buf, unsigned long len, int opts)
+{
+	if(opts & OPT_l) {
+		cnts->lines += memcount(buf, len, '\n');
+		cnts->bytes += len;
+	} else {
+		count(cnts, buf, len);
+	}
+}
 
+static int count_stream(struct wc* cnts, int fd, int opts)
+{
+	const int len = BUFSIZE;
+	const int prot = PROT_READ | PROT_WRITE;
+	const int flags = MAP_PRIVATE | MAP_ANONYMOUS;
 	char* buf = sys_mmap(NULL, len, prot, flags, -1, 0);
+	long rd;
+	int ret;
 
-	if(mmap_error(buf))
-		fail("mmap", NULL, (long)buf);
+	if((ret = mmap_error(buf)))
+		return ret;
 
-	unsigned long rd;
+	while((rd = sys_read(fd, buf, len)) > 0)
+		count_chunk(cnts, buf, rd, opts);
 
-	while((rd = sys_read(STDIN, buf, len)) > 0)
-		count(cnts, buf, rd);
+	sys_munmap(buf, len);
+
+	return rd;
 }
 
-static void countfile(struct wc* cnts, const char* fname, int last)
+static int count_mapped(struct wc* cnts, int fd, off_t size, int opts)
+{
+	const int prot = PROT_READ;
+	const int flags = MAP_SHARED;
+	off_t off = 0; /* offset within the file */
+	int ret;
+
+	while(off < size) {
+		long map = size - off > MAPSIZE ? MAPSIZE : size - off;
+		char* buf = sys_mmap(NULL, map, prot, flags, fd, off);
+
+		if((ret = mmap_error(buf)))
+			return ret;
+
+		count_chunk(cnts, buf, map, opts);
+
+		sys_munmap(buf, map);
+
+		off += map;
+	}
+
+	return 0;
+}
+
+static int count_file(struct wc* cnts, const char* fname, int opts)
 {
 	int fd, ret;
 	struct stat st;
 
+	memzero(cnts, sizeof(*cnts));
+
 	if((fd = sys_open(fname, O_RDONLY)) < 0)
-		fail("open", fname, fd);
+		return fd;
 	if((ret = sys_fstat(fd, &st)) < 0)
-		fail("stat", fname, ret);
+		goto out;
+
+	if((st.mode & S_IFMT) != S_IFREG)
+		ret = count_stream(cnts, fd, opts);
+	else if(opts & OPT_c)
+		cnts->bytes = st.size;
+	else
+		ret = count_mapped(cnts, fd, st.size, opts);
+out:
+	sys_close(fd);
+
+	return ret;
+}
 
-	const int prot = PROT_READ;
-	const int flags = MAP_SHARED;
+static void count_one(char* fname, int opts)
+{
+	struct wc cnts;
+	int ret;
 
-	char* buf = NULL; /* mmaped window */
-	off_t off = 0; /* offset within the file */
-	long map = 0; /* bytes mmapped on this iter */
-	off_t rem = st.size; /* bytes remaining */
+	if((ret = count_file(&cnts, fname, opts)) < 0)
+		fail(NULL, fname, ret);
 
-	while(off < st.size) {
-		map = rem > MAPSIZE ? MAPSIZE : rem;
+	dump(&cnts, fname, opts);
+}
 
-		buf = sys_mmap(buf, map, prot, flags, fd, off);
+/* Several files get counted by forked workers, up to the number of CPUs,
+   each taking the next file off a shared counter. The results go into
+   a shared anonymous mapping, and the output is done in the original
+   order once everything has been counted.
 
-		if(mmap_error(buf))
-			fail("mmap", fname, (long)buf);
+   A worker that dies half-way through a file would leave partial counts
+   in the mapping, so the results are counted locally and only copied
+   there once complete. Slots start out marked NOTDONE, and any that
+   remain so after the workers are gone get reported. */
 
-		off += map;
-		rem -= map;
+#define NOTDONE 1
 
-		count(cnts, buf, map);
-	};
+static void count_range(struct wc* res, int* next, char** names, int n, int opts)
+{
+	struct wc cnts;
+	int i;
+
+	while((i = __sync_fetch_and_add(next, 1)) < n) {
+		cnts.err = count_file(&cnts, names[i], opts);
+		memcpy(&res[i], &cnts, sizeof(cnts));
+	}
+}
+
+static int count_parallel(struct wc* res, int* next, char** names, int n, int opts)
+{
+	int procs = ncpus();
+	int i, pid, status;
+	int failed = 0;
 
-	if(last) return;
+	if(procs > n)
+		procs = n;
 
-	if((ret = sys_munmap(buf, off > MAPSIZE ? MAPSIZE : map)) < 0)
-		fail("munmap", fname, ret);
-	if((ret = sys_close(fd)) < 0)
-		fail("close", fname, ret);
+	int pids[procs];
+
+	for(i = 0; i < n; i++)
+		res[i].err = NOTDONE;
+
+	for(i = 1; i < procs; i++) {
+		if((pid = sys_fork()) < 0) {
+			break;
+		} else if(pid == 0) {
+			sys_prctl(PR_SET_PDEATHSIG, SIGTERM, 0, 0, 0);
+			count_range(res, next, names, n, opts);
+			_exit(0);
+		}
+
+		pids[i] = pid;
+	}
+
+	procs = i;
+
+	count_range(res, next, names, n, opts);
+
+	for(i = 1; i < procs; i++) {
+		if(sys_waitpid(pids[i], &status, 0) < 0)
+			failed++;
+		else if(!WIFEXITED(status) || WEXITSTATUS(status))
+			failed++;
+	}
+
+	return failed;
+}
+
+static void count_many(char** names, int n, int opts)
+{
+	struct wc total;
+	ulong size = pagealign(n*sizeof(struct wc) + sizeof(int));
+	int prot = PROT_READ | PROT_WRITE;
+	int flags = MAP_SHARED | MAP_ANONYMOUS;
+	void* buf = sys_mmap(NULL, size, prot, flags, -1, 0);
+	int i, ret, failed;
+
+	if((ret = mmap_error(buf)))
+		fail("mmap", NULL, ret);
+
+	struct wc* res = buf;
+	int* next = (int*)(res + n);
+
+	failed = count_parallel(res, next, names, n, opts);
+
+	memzero(&total, sizeof(total));
+
+	/* try to make sure the numbers line up */
+	opts |= SET_pad;
+
+	for(i = 0; i < n; i++) {
+		if((ret = res[i].err) == NOTDONE)
+			fail("worker died while counting", names[i], 0);
+		if(ret < 0)
+			fail(NULL, names[i], ret);
+
+		dump(&res[i], names[i], opts);
+		addcounts(&total, &res[i]);
+	}
+
+	if(failed)
+		fail("worker process failed", NULL, 0);
+
+	dump(&total, NULL, opts);
 }
 
 static int countbits(long val, int bits)
@@ -205,7 +430,8 @@ int main(int argc, char** argv)
 {
 	int i = 1;
 	int opts = 0;
-	struct wc cnts = { 0, 0, 0 };
+	struct wc cnts;
+	int ret;
 
 	if(i < argc && argv[i][0] == '-')
 		opts = argbits(OPTS, argv[i++] + 1);
@@ -214,26 +440,18 @@ int main(int argc, char** argv)
 
 	if(i >= argc) {
 		/* no arguments, count stdin */
-		countstdin(&cnts);
+		memzero(&cnts, sizeof(cnts));
+
+		if((ret = count_stream(&cnts, STDIN, opts)) < 0)
+			fail("read", NULL, ret);
+
 		dump(&cnts, NULL, opts);
 	} else if(i == argc - 1) {
 		/* single file, count it but do not do totals */
-		countfile(&cnts, argv[i], 1);
-		dump(&cnts, argv[i], opts);
+		count_one(argv[i], opts);
 	} else {
 		/* more than one file, got to print totals */
-		struct wc total = { 0, 0, 0 };
-		/* and try to make sure the numbers line up */
-		opts |= SET_pad;
-
-		for(; i < argc; i++) {
-			int lastone = (i == argc - 1);
-			countfile(&cnts, argv[i], lastone);
-			dump(&cnts, argv[i], opts);
-			addcounts(&total, &cnts);
-		};
-
-		dump(&total, NULL, opts);
+		count_many(argv + i, argc - i, opts);
 	}
 
 	return 0;
@@ -1,33 +1,64 @@
 #include <sys/file.h>
 #include <sys/proc.h>
 #include <sys/fprop.h>
+#include <sys/mman.h>
+#include <sys/ppoll.h>
+#include <sys/signal.h>
+#include <sys/rlimit.h>
 
 #include <string.h>
+#include <sigset.h>
+#include <format.h>
 #include <main.h>
 #include <util.h>
 
-#define OPTS "01a"
+#define OPTS "01akP"
 #define OPT_0 (1<<0)	/* 0-terminated */
 #define OPT_1 (1<<1)	/* one argument per command */
 #define OPT_a (1<<2)	/* read arguments from a file */
+#define OPT_k (1<<3)	/* keep output in input order */
+#define OPT_P (1<<4)	/* run several commands at once */
 
 ERRTAG("xargs");
 ERRLIST(NEAGAIN NENOMEM NENOSYS NE2BIG NEACCES NEFAULT NEIO NEISDIR
 	NELIBBAD NELOOP NENFILE NEMFILE NENOEXEC NENOTDIR NEPERM NETXTBSY
 	NEFBIG NEINTR NEINVAL NENOENT NEBADF);
 
-#define MAXARGS 64	/* arguments to pass to a single spawned command */
+#define PAGE 4096
+#define INBUF (8*PAGE)	/* initial input buffer size, grows as needed */
+#define MAXJOBS 1024	/* limit for -P */
+#define ARGPAD 2048	/* headroom left below ARG_MAX */
+
+struct job {
+	int pid;	/* 0 for free slots, -1 once reaped */
+	int fd;		/* output pipe with -k, -1 otherwise */
+	int seq;	/* spawn order */
+	char* buf;	/* output held back until preceding jobs finish */
+	long len;
+	long size;
+};
 
-char inbuf[8*4096];	/* sizeof(inbuf)/2 is also the upper limit
-			   on a single argument length */
 struct exec {
 	int total;	/* slots in argv (w/o terminating NULL) */
 	int start;	/* index of the first non-constant slot */
 	int ptr;	/* index of the first free slot */
+	long room;	/* bytes available for the variable arguments */
+	long used;	/* ... and how much of that is taken */
 	char* exe;
 	char** argv;
 	char** envp;
 	int opts;
+
+	char* end;	/* heap */
+
+	int sigfd;
+	int failed;
+	int maxrun;	/* commands allowed to run at once */
+	int running;
+	int nslots;
+	int seq;	/* seq for the next job to be spawned */
+	int head;	/* seq of the first job with pending output */
+	struct job* jobs;
 };
 
 static int xopen(const char* fname)
@@ -40,21 +71,257 @@ static int xopen(const char* fname)
 	return fd;
 }
 
+/* Heap. The argv array goes first, since its size is fixed once
+   the limits are known, and the input buffer follows it, growing
+   at the end of the heap whenever a line does not fit. */
+
+static void* heap_alloc(struct exec* ctx, long len)
+{
+	char* ptr = ctx->end;
+	char* new;
+
+	if(!ptr)
+		ptr = sys_brk(0);
+
+	len = (len + PAGE - 1) & ~(PAGE - 1);
+	new = sys_brk(ptr + len);
+
+	if(brk_error(ptr, new))
+		fail("cannot allocate memory", NULL, 0);
+
+	ctx->end = new;
+
+	return ptr;
+}
+
+/* Output of a job that is not the first one in line with -k gets held
+   in anonymous mappings, grown with mremap as needed. */
+
+static void hold_output(struct job* jb, char* data, long len)
+{
+	long need = jb->len + len;
+
+	if(need > jb->size) {
+		long size = pagealign(2*need);
+		int prot = PROT_READ | PROT_WRITE;
+		int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+		char* buf;
+		int ret;
+
+		if(jb->buf)
+			buf = sys_mremap(jb->buf, jb->size, size, MREMAP_MAYMOVE);
+		else
+			buf = sys_mmap(NULL, size, prot, flags, -1, 0);
+
+		if((ret = mmap_error(buf)))
+			fail(jb->buf ? "mremap" : "mmap", NULL, ret);
+
+		jb->buf = buf;
+		jb->size = size;
+	}
+
+	memcpy(jb->buf + jb->len, data, len);
+	jb->len += len;
+}
+
+static void release_output(struct job* jb)
+{
+	if(jb->len)
+		writeall(STDOUT, jb->buf, jb->len);
+	if(jb->buf)
+		sys_munmap(jb->buf, jb->size);
+
+	jb->buf = NULL;
+	jb->len = 0;
+	jb->size = 0;
+}
+
+static struct job* find_job(struct exec* ctx, int seq)
+{
+	struct job* jb;
+
+	for(jb = ctx->jobs; jb < ctx->jobs + ctx->nslots; jb++)
+		if(jb->pid && jb->seq == seq)
+			return jb;
+
+	return NULL;
+}
+
+/* Jobs are done once reaped and, with -k, once their output pipe
+   has been drained. The output of the first job in line gets passed
+   through as it comes, so only the jobs behind it need holding. */
+
+static void flush_done(struct exec* ctx)
+{
+	struct job* jb;
+
+	while((jb = find_job(ctx, ctx->head))) {
+		release_output(jb);
+
+		if(jb->pid > 0 || jb->fd >= 0)
+			break;
+
+		jb->pid = 0;
+		ctx->head++;
+	}
+}
+
+static void check_output(struct exec* ctx, struct job* jb)
+{
+	char buf[4*PAGE];
+	int rd;
+
+	if((rd = sys_read(jb->fd, buf, sizeof(buf))) > 0) {
+		if(jb->seq == ctx->head)
+			writeall(STDOUT, buf, rd);
+		else
+			hold_output(jb, buf, rd);
+		return;
+	}
+
+	sys_close(jb->fd);
+	jb->fd = -1;
+}
+
+static void reap_children(struct exec* ctx)
+{
+	struct siginfo si;
+	struct job* jb;
+	int pid, status;
+
+	while(sys_read(ctx->sigfd, &si, sizeof(si)) > 0)
+		;
+
+	while((pid = sys_waitpid(-1, &status, WNOHANG)) > 0) {
+		for(jb = ctx->jobs; jb < ctx->jobs + ctx->nslots; jb++)
+			if(jb->pid == pid)
+				break;
+		if(jb >= ctx->jobs + ctx->nslots)
+			continue;
+
+		ctx->running--;
+
+		if(status)
+			ctx->failed = 1;
+
+		if(ctx->opts & OPT_k)
+			jb->pid = -1;
+		else
+			jb->pid = 0;
+	}
+}
+
+/* The event loop. SIGCHLD comes through a signalfd, and with -k
+   the output pipes of all the jobs are polled as well. */
+
+static void wait_events(struct exec* ctx)
+{
+	int i, n = ctx->nslots;
+	struct pollfd pfds[n + 1];
+	struct job* jobs = ctx->jobs;
+	int ret, k = 1;
+
+	pfds[0].fd = ctx->sigfd;
+	pfds[0].events = POLLIN;
+
+	for(i = 0; i < n; i++) {
+		if(jobs[i].fd < 0)
+			continue;
+
+		pfds[k].fd = jobs[i].fd;
+		pfds[k].events = POLLIN;
+		k++;
+	}
+
+	if((ret = sys_ppoll(pfds, k, NULL, NULL)) < 0)
+		fail("ppoll", NULL, ret);
+
+	for(i = 1; i < k; i++) {
+		if(!pfds[i].revents)
+			continue;
+
+		for(n = 0; n < ctx->nslots; n++)
+			if(jobs[n].fd == pfds[i].fd)
+				check_output(ctx, &jobs[n]);
+	}
+
+	if(pfds[0].revents)
+		reap_children(ctx);
+
+	flush_done(ctx);
+}
+
+static struct job* grab_slot(struct exec* ctx)
+{
+	struct job* jb;
+
+	if(ctx->running >= ctx->maxrun)
+		return NULL;
+
+	for(jb = ctx->jobs; jb < ctx->jobs + ctx->nslots; jb++)
+		if(!jb->pid && jb->fd < 0)
+			return jb;
+
+	return NULL;
+}
+
+static void wait_all(struct exec* ctx)
+{
+	while(ctx->running || ctx->head < ctx->seq)
+		wait_events(ctx);
+
+	if(ctx->failed)
+		fail("command failed, aborting", NULL, 0);
+}
+
+static void child(struct exec* ctx, int* fds)
+{
+	struct sigset empty;
+	int ret;
+
+	sigemptyset(&empty);
+	sys_sigprocmask(SIG_SETMASK, &empty, NULL);
+
+	if(fds && (ret = sys_dup2(fds[1], STDOUT)) < 0)
+		fail("dup2", NULL, ret);
+
+	ret = sys_execve(ctx->exe, ctx->argv, ctx->envp);
+	fail("exec", ctx->exe, ret);
+}
+
 static void spawn(struct exec* ctx)
 {
-	int pid, ret, status;
+	struct job* jb;
+	int fds[2];
+	int pid, ret;
 
-	if((pid = sys_fork()) < 0) {
+	while(!(jb = grab_slot(ctx)) || ctx->failed) {
+		if(ctx->failed)
+			wait_all(ctx);
+
+		wait_events(ctx);
+	}
+
+	if(!(ctx->opts & OPT_k))
+		;
+	else if((ret = sys_pipe2(fds, O_CLOEXEC)) < 0)
+		fail("pipe", NULL, ret);
+
+	if((pid = sys_fork()) < 0)
 		fail("fork", NULL, pid);
-	} else if(pid == 0) {
-		ret = sys_execve(ctx->exe, ctx->argv, ctx->envp);
-		fail("exec", ctx->exe, ret);
+	else if(pid == 0)
+		child(ctx, (ctx->opts & OPT_k) ? fds : NULL);
+
+	jb->pid = pid;
+	jb->seq = ctx->seq++;
+	ctx->running++;
+
+	if(ctx->opts & OPT_k) {
+		sys_close(fds[1]);
+		jb->fd = fds[0];
 	} else {
-		if((ret = sys_waitpid(pid, &status, 0)) < 0)
-			fail("waitpid", NULL, ret);
-		if(status)
-			fail("command failed, aborting", NULL, 0);
-	};
+		ctx->head = ctx->seq;
+	}
 }
 
 static char* endofline(char* ls, char* end, int opts)
@@ -70,14 +337,42 @@ static char* endofline(char* ls, char* end, int opts)
 	return NULL;
 }
 
+static void flush_args(struct exec* ctx)
+{
+	if(ctx->ptr <= ctx->start)
+		return;
+
+	ctx->argv[ctx->ptr] = NULL;
+
+	spawn(ctx);
+
+	ctx->ptr = ctx->start;
+	ctx->used = 0;
+}
+
+/* Arguments count against ARG_MAX with their pointers. A batch gets
+   spawned before the next argument would overflow it; an argument
+   that does not fit even on its own gets a command of its own, and
+   it is up to the kernel to refuse it. */
+
+static void add_arg(struct exec* ctx, char* arg, int len)
+{
+	long need = len + 1 + sizeof(char*);
+
+	if(ctx->used + need > ctx->room)
+		flush_args(ctx);
+
+	ctx->argv[ctx->ptr++] = arg;
+	ctx->used += need;
+
+	if(ctx->ptr >= ctx->total)
+		flush_args(ctx);
+}
+
 /* xargs always spawns whatever it gets for a single useblock call in
    a single command. With regular reading logic, this minimizes
    "reaction time" but may result in more spawns than necessary.
 
-   If large batches and lower number of spawns is preferable, the reading
-   loop can be adjusted to only call useblock() once enough data has been
-   accumulated. This is not implemented atm.
-
    For blocks that aren't last in the file, non-terminated lines
    (those not ending in \n) are assumed to be incomplete, and left
    untouched. Subsequent readinput will append more bytes to the
@@ -92,76 +387,61 @@ static int useblock(struct exec* ctx, char* buf, int len, int lastone)
 	char* end = buf + len;
 	char* ls = buf;  /* line start */
 	char* le;        /* line end */
-	int needflush;
-	int morelines;
-
-	ctx->ptr = ctx->start; /* assumption: start < total */
 
-	do {
+	while(ls < end) {
 		if((le = endofline(ls, end, ctx->opts)))
 			*le = '\0';
-
-		if(le || lastone)
-			ctx->argv[ctx->ptr++] = ls;
-
-		morelines = (le && (ls = le + 1) < end);
-
-		if(morelines && ctx->ptr < ctx->total)
-			needflush = 0;
+		else if(lastone)
+			le = end;
 		else
-			needflush = (ctx->ptr > ctx->start);
+			break;
 
-		if(needflush) {
-			ctx->argv[ctx->ptr] = NULL;
+		add_arg(ctx, ls, le - ls);
 
-			spawn(ctx);
+		ls = le + 1;
+	}
 
-			ctx->ptr = ctx->start;
-		}
-	} while(morelines);
+	flush_args(ctx);
 
-	return ls - buf;
+	return (ls < end ? ls : end) - buf;
 }
 
-/* Input stream is read blockwise, with inbuf acting as a moving window.
-   Stepping is non-constant, and we move the data to keep the start of
-   the next argument at the start of the buffer for each iteration.
-
-   That's probably not necessary if there's enough space remaining in buf,
-   but then if so, copying shouldn't take too much time anyway.
-
-   In case input is a real file, mmaping it and calling useblock(LASTONE)
-   on the mmaped buffer could be faster, but this case is so rare we
-   do not bother. And even with mmaped file there would be a moving window,
-   and lots of code to support it. */
+/* Input stream is read blockwise, with the buffer acting as a moving
+   window. Stepping is non-constant, and we move the data to keep the
+   start of the next argument at the start of the buffer for each
+   iteration. Whenever a single line fills the whole buffer, the buffer
+   gets extended, so there is no limit on the line length here. The
+   spawned commands get their own copies of the arguments with fork,
+   so the buffer can be reused right after useblock returns. */
 
 static void readinput(struct exec* ctx, int fd)
 {
 	long rd;
-	char* buf = inbuf;
-	int len = sizeof(inbuf) - 1;  /* total usable length */
-	int ptr = 0;  /* filled with data up to ptr */
-	int stp = 0;  /* start processing next chunk from here */
+	char* buf = heap_alloc(ctx, INBUF);
+	long len = ctx->end - buf - 1;  /* total usable length */
+	long ptr = 0;  /* filled with data up to ptr */
+	long stp = 0;  /* start processing next chunk from here */
 
 	while((rd = sys_read(fd, buf + ptr, len - ptr)) > 0) {
 		ptr += rd;
 
 		int used = useblock(ctx, buf + stp, ptr - stp, REGULAR);
 
-		if(used > len/2) {
-			memcpy(buf, buf + used, ptr - used);
+		stp += used;
+
+		if(stp > len/2) {
+			memmove(buf, buf + stp, ptr - stp);
+			ptr -= stp;
 			stp = 0;
-			ptr -= used;
 		} else if(ptr >= len) {
-			/* There's something longer than len/2 in buf
-			   that useblock could not consume. */
-			fail("argument too long", NULL, 0);
-		} else {
-			stp += used;
+			heap_alloc(ctx, len);
+			len = ctx->end - buf - 1;
 		}
 	} if(stp < ptr) {
 		useblock(ctx, buf + stp, ptr - stp, LASTONE);
 	}
+
+	wait_all(ctx);
 }
 
 /* The following chunk sets up the command to run.
@@ -241,35 +521,141 @@ static void runpath(struct exec* ctx, int fd)
 	readinput(ctx, fd);
 }
 
-static void makectx(int argc, char** argv, char** envp, int fd, int opts)
+/* Linux allows argv and envp, strings and pointers, to take up to 1/4
+   of the stack limit but no less than 128KB, and no more than 3/4 of
+   the default 8MB stack. The environment and the constant part of argv
+   are the same for all commands and get subtracted right away. */
+
+static long arg_max(void)
+{
+	struct rlimit rl;
+	long max;
+
+	if(sys_prlimit(0, RLIMIT_STACK, NULL, &rl) < 0)
+		return 128*1024;
+	if(rl.cur > 4*6*1024*1024)
+		return 6*1024*1024;
+
+	if((max = rl.cur/4) < 128*1024)
+		max = 128*1024;
+
+	return max;
+}
+
+static long strv_size(char** strv, int n)
 {
-	int args = ((opts & OPT_1) ? 1 : MAXARGS);
-	char* cmdv[argc + args + 1];
-	struct exec ctx = {
-		.start = argc,
-		.total = argc + args,
-		.ptr = 0,
-		.argv = cmdv,
-		.envp = envp,
-		.opts = opts
-	};
-	memcpy(cmdv, argv, argc*sizeof(char*));
-
-	if(lookslikepath(*cmdv))
+	long size = 0;
+	int i;
+
+	for(i = 0; strv[i] && (n < 0 || i < n); i++)
+		size += strlen(strv[i]) + 1 + sizeof(char*);
+
+	return size + sizeof(char*);
+}
+
+static void setup_limits(struct exec* ctx, int argc, char** argv)
+{
+	int opts = ctx->opts;
+	long room = arg_max() - ARGPAD;
+
+	room -= strv_size(ctx->envp, -1);
+	room -= strv_size(argv, argc);
+
+	if(room < PAGE)
+		fail("environment too large", NULL, 0);
+
+	int args = (opts & OPT_1) ? 1 : room/(sizeof(char*) + 1);
+
+	ctx->start = argc;
+	ctx->total = argc + args;
+	ctx->ptr = argc;
+	ctx->room = room;
+
+	ctx->argv = heap_alloc(ctx, (argc + args + 1)*sizeof(char*));
+
+	memcpy(ctx->argv, argv, argc*sizeof(char*));
+}
+
+static void setup_jobs(struct exec* ctx, int procs)
+{
+	struct sigset mask;
+	int i, fd, ret;
+
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGCHLD);
+
+	if((fd = sys_signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC)) < 0)
+		fail("signalfd", NULL, fd);
+	if((ret = sys_sigprocmask(SIG_BLOCK, &mask, NULL)) < 0)
+		fail("sigprocmask", NULL, ret);
+
+	ctx->sigfd = fd;
+	ctx->maxrun = procs;
+
+	/* with -k, finished jobs may hold their slots until the ones
+	   spawned before them are done, so there are twice as many */
+
+	if(ctx->opts & OPT_k)
+		ctx->nslots = 2*procs;
+	else
+		ctx->nslots = procs;
+
+	ctx->jobs = heap_alloc(ctx, ctx->nslots*sizeof(struct job));
+
+	memzero(ctx->jobs, ctx->nslots*sizeof(struct job));
+
+	for(i = 0; i < ctx->nslots; i++)
+		ctx->jobs[i].fd = -1;
+}
+
+static void makectx(int argc, char** argv, char** envp, int fd, int opts, int procs)
+{
+	struct exec ctx;
+
+	memzero(&ctx, sizeof(ctx));
+
+	ctx.envp = envp;
+	ctx.opts = opts;
+
+	setup_jobs(&ctx, procs);
+	setup_limits(&ctx, argc, argv);
+
+	if(lookslikepath(*argv))
 		runpath(&ctx, fd);
 	else
 		makecmd(&ctx, fd, envp);
 }
 
+static int parse_procs(char* arg)
+{
+	char* p;
+	int val;
+
+	if(!(p = parseint(arg, &val)) || *p || val < 0)
+		fail("invalid process count", arg, 0);
+	if(!val)
+		val = ncpus();
+	if(val > MAXJOBS)
+		val = MAXJOBS;
+
+	return val;
+}
+
 int main(int argc, char** argv)
 {
 	char** envp = argv + argc + 1;
 	int i = 1, opts = 0;
+	int procs = 1;
 	int fd = 0;
 
 	if(i < argc && argv[i][0] == '-')
 		opts = argbits(OPTS, argv[i++] + 1);
 
+	if(i < argc && (opts & OPT_P))
+		procs = parse_procs(argv[i++]);
+	else if(opts & OPT_P)
+		fail("process count required", NULL, 0);
+
 	if(i < argc && (opts & OPT_a))
 		fd = xopen(argv[i++]);
 	else if(opts & OPT_a)
@@ -278,7 +664,7 @@ int main(int argc, char** argv)
 	if(i >= argc)
 		fail("need a command to run", NULL, 0);
 
-	makectx(argc - i, argv + i, envp, fd, opts);
+	makectx(argc - i, argv + i, envp, fd, opts, procs);
 
 	return 0;
 }
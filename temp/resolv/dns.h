@@ -23,6 +23,7 @@
 #define DNS_TYPE_CNAME 5
 #define DNS_TYPE_SOA   6
 #define DNS_TYPE_PTR  12
+#define DNS_TYPE_OPT  41
 
 #define DNS_CLASS_IN 1
 
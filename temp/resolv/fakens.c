@@ -0,0 +1,211 @@
+#include <bits/socket/inet.h>
+#include <sys/socket.h>
+#include <sys/sched.h>
+
+#include <format.h>
+#include <string.h>
+#include <endian.h>
+#include <util.h>
+#include <main.h>
+
+#include "dns.h"
+
+/* Stand-in DNS server for testing resolvd. Answers any A query
+   with 10.0.0.1 and logs it to stdout, so that the number of queries
+   that made it upstream can be counted. Names starting with certain
+   prefixes get special treatment:
+
+       nx...     NXDOMAIN, with a SOA record (TTL 300, minimum 60)
+       fail...   SERVFAIL
+       drop...   no reply at all
+       slow...   reply delayed by 0.5s
+       short...  A record with TTL 2s
+       big...    40 A records, truncated unless the query has EDNS
+
+   Usage: fakens 127.0.0.2[:port] */
+
+ERRTAG("fakens");
+
+static byte rxbuf[512];
+static byte txbuf[1024];
+
+static int startswith(char* name, char* pref)
+{
+	return !strncmp(name, pref, strlen(pref));
+}
+
+static int put_short(byte* p, int v)
+{
+	p[0] = (v >> 8) & 0xFF;
+	p[1] = (v >> 0) & 0xFF;
+	return 2;
+}
+
+static int put_long(byte* p, uint v)
+{
+	put_short(p + 0, v >> 16);
+	put_short(p + 2, v & 0xFFFF);
+	return 4;
+}
+
+static int prep_name(byte* q, int qlen, char* buf, int size)
+{
+	int i = 0, o = 0;
+
+	while(i < qlen && q[i]) {
+		int n = q[i++];
+
+		if(o && o < size - 1)
+			buf[o++] = '.';
+		while(n-- > 0 && i < qlen && o < size - 1)
+			buf[o++] = q[i++];
+	}
+
+	buf[o] = '\0';
+
+	return i + 1 + 4;
+}
+
+static int put_rr(byte* p, int type, uint ttl, int dlen)
+{
+	int n = 0;
+
+	n += put_short(p + n, 0xC00C); /* the name from the question */
+	n += put_short(p + n, type);
+	n += put_short(p + n, 1);
+	n += put_long(p + n, ttl);
+	n += put_short(p + n, dlen);
+
+	return n;
+}
+
+static int answer(byte* rx, int len, char* name, int size)
+{
+	struct dnshdr* dh = (struct dnshdr*)txbuf;
+	int qlen = prep_name(rx + 12, len - 12, name, size);
+	byte* p = txbuf + 12 + qlen;
+	uint flags = DNSF_QR | DNSF_RD | DNSF_RA;
+	byte soa[22] = { 0, 0 };
+	byte ip[4] = { 10, 0, 0, 1 };
+	int edns = ((struct dnshdr*)rx)->arcount != 0;
+	int i;
+
+	if(12 + qlen > len)
+		return 0;
+
+	memcpy(txbuf, rx, 12 + qlen);
+
+	dh->ancount = 0;
+	dh->nscount = 0;
+	dh->arcount = 0;
+
+	if(startswith(name, "drop")) {
+		return 0;
+	} else if(startswith(name, "fail")) {
+		flags |= DNSF_RC_SERVER;
+	} else if(startswith(name, "nx")) {
+		flags |= DNSF_RC_NAME;
+		p += put_rr(p, DNS_TYPE_SOA, 300, sizeof(soa));
+		put_long(soa + 2 + 16, 60);
+		memcpy(p, soa, sizeof(soa));
+		p += sizeof(soa);
+		dh->nscount = htons(1);
+	} else if(startswith(name, "big")) {
+		for(i = 0; i < 40; i++) {
+			p += put_rr(p, DNS_TYPE_A, 300, 4);
+			ip[3] = i + 1;
+			memcpy(p, ip, 4);
+			p += 4;
+		}
+		dh->ancount = htons(40);
+
+		if(!edns && p - txbuf > 512) {
+			p = txbuf + 12 + qlen;
+			dh->ancount = 0;
+			flags |= DNSF_TC;
+		}
+	} else {
+		uint ttl = startswith(name, "short") ? 2 : 300;
+		p += put_rr(p, DNS_TYPE_A, ttl, 4);
+		memcpy(p, ip, 4);
+		p += 4;
+		dh->ancount = htons(1);
+	}
+
+	if(edns) {
+		*p++ = 0; /* root name */
+		p += put_short(p, DNS_TYPE_OPT);
+		p += put_short(p, 1232);
+		p += put_long(p, 0);
+		p += put_short(p, 0);
+		dh->arcount = htons(1);
+	}
+
+	dh->flags = htons(flags);
+
+	return p - txbuf;
+}
+
+static void delay(void)
+{
+	struct timespec ts = { 0, 500*1000*1000 };
+
+	sys_nanosleep(&ts, NULL);
+}
+
+static void serve(int fd)
+{
+	struct sockaddr_in from;
+	int fromlen, rd, len;
+	char name[256];
+
+	while(1) {
+		fromlen = sizeof(from);
+
+		if((rd = sys_recvfrom(fd, rxbuf, sizeof(rxbuf), 0, &from, &fromlen)) < 0)
+			fail("recv", NULL, rd);
+		if(rd < 12 + 5)
+			continue;
+
+		if(!(len = answer(rxbuf, rd, name, sizeof(name))))
+			continue;
+
+		FMTBUF(p, e, buf, 300);
+		p = fmtstr(p, e, "query ");
+		p = fmtstr(p, e, name);
+		FMTENL(p, e);
+
+		writeall(STDOUT, buf, p - buf);
+
+		if(startswith(name, "slow"))
+			delay();
+
+		sys_sendto(fd, txbuf, len, 0, &from, fromlen);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	struct sockaddr_in addr = { .family = AF_INET };
+	int fd, ret, port = 53;
+	char* p;
+
+	if(argc != 2)
+		fail("bad call", NULL, 0);
+
+	if(!(p = parseip(argv[1], addr.addr)))
+		fail("invalid address", argv[1], 0);
+	if(*p == ':' && (!(p = parseint(p + 1, &port)) || *p))
+		fail("invalid port", argv[1], 0);
+
+	addr.port = htons(port);
+
+	if((fd = sys_socket(AF_INET, SOCK_DGRAM, 0)) < 0)
+		fail("socket", NULL, fd);
+	if((ret = sys_bind(fd, &addr, sizeof(addr))) < 0)
+		fail("bind", NULL, ret);
+
+	serve(fd);
+
+	return 0;
+}
@@ -0,0 +1,133 @@
+#include <bits/socket/inet.h>
+#include <sys/file.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include <main.h>
+#include <format.h>
+#include <endian.h>
+#include <string.h>
+#include <util.h>
+
+/* Minimal stand-in NTP server, answering client requests with
+   the local CLOCK_REALTIME shifted by a given offset (in ms).
+
+       ntserv [ip][:port] [offset-ms]
+
+   This is a testing tool for timed, allowing to check how it
+   handles offsets without messing with the actual system clock
+   of the host the server runs on. It claims stratum 1 and does
+   no checks whatsoever on the incoming requests beyond size. */
+
+ERRTAG("ntserv");
+
+struct ntpreq {
+	uint32_t code;
+	uint32_t rdelay;
+	uint32_t rdispersion;
+	byte refid[4];
+	uint64_t reference;
+	uint64_t originate;
+	uint64_t receive;
+	uint64_t transmit;
+} __attribute__((packed));
+
+static int64_t offset;
+
+static uint64_t get_ntp_time(void)
+{
+	struct timespec ts;
+	int ret;
+
+	if((ret = sys_clock_gettime(CLOCK_REALTIME, &ts)) < 0)
+		fail("clock_gettime", NULL, ret);
+
+	uint64_t ns = ts.nsec;
+	uint64_t fs = ns*(1ULL<<32)/(1000000000ULL);
+	uint64_t ss = ts.sec + 2208988800UL;
+
+	return ((ss << 32) | fs) + offset;
+}
+
+static void parse_offset(char* arg)
+{
+	int neg = (*arg == '-');
+	int ms;
+	char* p;
+
+	if(!(p = parseint(arg + neg, &ms)) || *p)
+		fail("bad offset:", arg, 0);
+
+	int64_t dt = ((int64_t)ms << 32) / 1000;
+
+	offset = neg ? -dt : dt;
+}
+
+static int prep_socket(char* address)
+{
+	struct sockaddr_in addr = {
+		.family = AF_INET,
+		.port = htons(123),
+		.addr = { 0, 0, 0, 0 }
+	};
+	int port = 123;
+	int fd, ret;
+	char* p = address;
+
+	if(*p && *p != ':' && !(p = parseip(p, addr.addr)))
+		fail("bad ip:", address, 0);
+	if(*p == ':' && !(p = parseint(p + 1, &port)))
+		fail("bad port:", address, 0);
+	if(*p)
+		fail("bad address:", address, 0);
+
+	addr.port = htons(port);
+
+	if((fd = sys_socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP)) < 0)
+		fail("socket", "udp", fd);
+	if((ret = sys_bind(fd, &addr, sizeof(addr))) < 0)
+		fail("bind", address, ret);
+
+	return fd;
+}
+
+static void serve(int fd)
+{
+	struct ntpreq req, *rq = &req;
+	byte from[32];
+	int fromlen = sizeof(from);
+	int ret;
+
+	if((ret = sys_recvfrom(fd, rq, sizeof(*rq), 0, from, &fromlen)) < 0)
+		fail("recv", NULL, ret);
+	if(ret < (int)sizeof(*rq))
+		return;
+
+	uint64_t recv = get_ntp_time();
+
+	rq->code = htonl((0 << 30) | (4 << 27) | (4 << 24) | (1 << 16) | (0xEC << 0));
+	rq->rdelay = 0;
+	rq->rdispersion = 0;
+	memcpy(rq->refid, "LOCL", 4);
+	rq->originate = rq->transmit;
+	rq->reference = htonx(recv);
+	rq->receive = htonx(recv);
+	rq->transmit = htonx(get_ntp_time());
+
+	if((ret = sys_sendto(fd, rq, sizeof(*rq), 0, from, fromlen)) < 0)
+		warn("send", NULL, ret);
+}
+
+int main(int argc, char** argv)
+{
+	int fd;
+
+	if(argc < 2 || argc > 3)
+		fail("bad call", NULL, 0);
+	if(argc > 2)
+		parse_offset(argv[2]);
+
+	fd = prep_socket(argv[1]);
+
+	while(1) serve(fd);
+}
@@ -0,0 +1,316 @@
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+
+#include <format.h>
+#include <string.h>
+#include <util.h>
+#include <main.h>
+
+#include "bench.h"
+
+/* Benchmark runner for the core lib routines.
+
+       bench [-l] [-s save] [-c base] [-t percent] [prefix ...]
+
+   With -s, the results get written to a file, one "name ps/op" line
+   per benchmark. With -c, a file saved earlier is used as a baseline,
+   the difference is reported for each benchmark, and the exit status
+   is non-zero if anything got slower by more than -t percent (10 by
+   default). Prefixes limit the run to benchmarks with matching names,
+   "crypto/" or "format/parse" for instance.
+
+   The figures are only comparable between runs on the same machine,
+   and even then they are noisy at the level of several percent. */
+
+ERRTAG("bench");
+
+#define MINTIME 20000000  /* ns, for a single timed run */
+#define ROUNDS 5
+
+static const struct bench* const groups[] = {
+	bench_util,
+	bench_format,
+	bench_lzma,
+	bench_crypto,
+	bench_netlink,
+	NULL
+};
+
+volatile ulong sink;
+
+static struct top {
+	int list;
+	char* save;
+	char* base;
+	int threshold;
+
+	char** prefixes;
+	int nprefixes;
+
+	char* basebuf;
+	int baselen;
+
+	int fd;
+	int regressed;
+} top;
+
+uint64_t random(void)
+{
+	static uint64_t x = 88172645463325252ULL;
+
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+
+	return x;
+}
+
+static uint64_t now(void)
+{
+	struct timespec ts;
+
+	sys_clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.sec*1000000000ULL + ts.nsec;
+}
+
+static uint64_t timed_run(const struct bench* b, long n)
+{
+	uint64_t t0 = now();
+
+	b->run(n);
+
+	return now() - t0;
+}
+
+/* Returns picoseconds per iteration */
+
+static uint64_t measure(const struct bench* b)
+{
+	uint64_t t, best;
+	long n = 1;
+
+	if(b->init)
+		b->init();
+
+	while((t = timed_run(b, n)) < MINTIME)
+		n *= (t < MINTIME/16) ? 8 : 2;
+
+	best = t;
+
+	for(int i = 1; i < ROUNDS; i++)
+		if((t = timed_run(b, n)) < best)
+			best = t;
+
+	return best*1000/n;
+}
+
+static char* fmtfrac(char* p, char* e, uint64_t val, int div, int digits)
+{
+	p = fmtu64(p, e, val / div);
+	p = fmtchar(p, e, '.');
+	p = fmtpad0(p, e, digits, fmtu64(p, e, val % div));
+
+	return p;
+}
+
+static int load_base(char* name, uint64_t* ps)
+{
+	char* buf = top.basebuf;
+	char* end = buf + top.baselen;
+	int nlen = strlen(name);
+	char *ls, *le, *p;
+
+	for(ls = buf; ls < end; ls = le + 1) {
+		le = strecbrk(ls, end, '\n');
+
+		if(le - ls <= nlen || ls[nlen] != ' ')
+			continue;
+		if(memcmp(ls, name, nlen))
+			continue;
+		if(!(p = parseu64(ls + nlen + 1, ps)) || p != le)
+			continue;
+
+		return *ps ? 0 : -1;
+	}
+
+	return -1;
+}
+
+static char* fmt_delta(char* p, char* e, uint64_t ps, uint64_t base)
+{
+	int64_t d = (int64_t)(ps - base)*1000/(int64_t)base;
+
+	p = fmtstr(p, e, "  ");
+	p = fmtchar(p, e, d < 0 ? '-' : '+');
+	p = fmtfrac(p, e, d < 0 ? -d : d, 10, 1);
+	p = fmtchar(p, e, '%');
+
+	if(d > 10*top.threshold) {
+		p = fmtstr(p, e, " SLOWER");
+		top.regressed = 1;
+	}
+
+	return p;
+}
+
+static void report(const struct bench* b, uint64_t ps)
+{
+	uint64_t base;
+
+	FMTBUF(p, e, buf, 200);
+	p = fmtpadr(p, e, 24, fmtstr(p, e, b->name));
+	p = fmtpad(p, e, 14, fmtfrac(p, e, ps/10, 100, 2));
+	p = fmtstr(p, e, " ns/op");
+
+	if(b->bytes) {
+		uint64_t rate = b->bytes*10000000ULL/(ps ? ps : 1);
+		p = fmtpad(p, e, 10, fmtfrac(p, e, rate, 10, 1));
+		p = fmtstr(p, e, " MB/s");
+	} else {
+		p = fmtpad(p, e, 15, p);
+	}
+
+	if(top.basebuf && !load_base(b->name, &base))
+		p = fmt_delta(p, e, ps, base);
+
+	FMTENL(p, e);
+
+	writeall(STDOUT, buf, p - buf);
+}
+
+static void save(const struct bench* b, uint64_t ps)
+{
+	FMTBUF(p, e, buf, 100);
+	p = fmtstr(p, e, b->name);
+	p = fmtchar(p, e, ' ');
+	p = fmtu64(p, e, ps);
+	FMTENL(p, e);
+
+	writeall(top.fd, buf, p - buf);
+}
+
+static int selected(char* name)
+{
+	int i, n = top.nprefixes;
+
+	if(!n) return 1;
+
+	for(i = 0; i < n; i++)
+		if(!strncmp(name, top.prefixes[i], strlen(top.prefixes[i])))
+			return 1;
+
+	return 0;
+}
+
+static void run_bench(const struct bench* b)
+{
+	uint64_t ps;
+
+	if(!selected(b->name))
+		return;
+
+	if(top.list) {
+		writeall(STDOUT, b->name, strlen(b->name));
+		writeall(STDOUT, "\n", 1);
+		return;
+	}
+
+	ps = measure(b);
+
+	report(b, ps);
+
+	if(top.save)
+		save(b, ps);
+}
+
+static void open_base(char* name)
+{
+	int fd, rd;
+	struct stat st;
+	char* buf;
+
+	if((fd = sys_open(name, O_RDONLY)) < 0)
+		fail(NULL, name, fd);
+	if((rd = sys_fstat(fd, &st)) < 0)
+		fail("stat", name, rd);
+	if(st.size > 1024*1024)
+		fail(NULL, name, -E2BIG);
+
+	buf = sys_brk(0);
+
+	if(brk_error(buf, sys_brk(buf + st.size + 1)))
+		fail("brk", NULL, 0);
+	if((rd = sys_read(fd, buf, st.size)) < 0)
+		fail("read", name, rd);
+
+	top.basebuf = buf;
+	top.baselen = rd;
+
+	sys_close(fd);
+}
+
+static void open_save(char* name)
+{
+	int flags = O_WRONLY | O_CREAT | O_TRUNC;
+	int fd;
+
+	if((fd = sys_open3(name, flags, 0644)) < 0)
+		fail(NULL, name, fd);
+
+	top.fd = fd;
+}
+
+static char* shift(int argc, char** argv, int* i)
+{
+	if(*i >= argc)
+		fail("argument required for", argv[*i - 1], 0);
+
+	return argv[(*i)++];
+}
+
+static void parse_args(int argc, char** argv)
+{
+	int i = 1;
+	char *arg, *p;
+
+	top.threshold = 10;
+
+	while(i < argc && (arg = argv[i])[0] == '-') {
+		i++;
+
+		if(!strcmp(arg, "-l"))
+			top.list = 1;
+		else if(!strcmp(arg, "-s"))
+			top.save = shift(argc, argv, &i);
+		else if(!strcmp(arg, "-c"))
+			top.base = shift(argc, argv, &i);
+		else if(strcmp(arg, "-t"))
+			fail("unknown option", arg, 0);
+		else if(!(p = parseint(arg = shift(argc, argv, &i), &top.threshold)) || *p)
+			fail("bad threshold", arg, 0);
+	}
+
+	top.prefixes = argv + i;
+	top.nprefixes = argc - i;
+}
+
+int main(int argc, char** argv)
+{
+	const struct bench* const* g;
+	const struct bench* b;
+
+	parse_args(argc, argv);
+
+	if(top.base)
+		open_base(top.base);
+	if(top.save)
+		open_save(top.save);
+
+	for(g = groups; *g; g++)
+		for(b = *g; b->name; b++)
+			run_bench(b);
+
+	return top.regressed ? 1 : 0;
+}
@@ -0,0 +1,29 @@
+#include <cdefs.h>
+
+/* Each benchmark is a function doing n iterations of some operation.
+   The runner picks n so that a single run takes long enough to time
+   reliably, and reports the best of several runs.
+
+   Setup that should not be timed goes into init, which gets called
+   once before the first run. Benchmarks that process some amount
+   of data per iteration set bytes to get MB/s figures. */
+
+struct bench {
+	char* name;
+	void (*run)(long n);
+	void (*init)(void);
+	long bytes;
+};
+
+extern const struct bench bench_util[];
+extern const struct bench bench_format[];
+extern const struct bench bench_lzma[];
+extern const struct bench bench_crypto[];
+extern const struct bench bench_netlink[];
+
+/* Results get accumulated here so the compiler would not be able
+   to drop the code being timed as having no effect. */
+
+extern volatile ulong sink;
+
+uint64_t random(void);
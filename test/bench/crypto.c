@@ -0,0 +1,162 @@
+#include <sys/mman.h>
+
+#include <crypto/sha1.h>
+#include <crypto/sha256.h>
+#include <crypto/aes128.h>
+#include <crypto/scrypt.h>
+#include <util.h>
+
+#include "bench.h"
+
+/* Hashes get timed on page-sized inputs, AES on single blocks, XTS
+   on a page worth of sectors (as in deitool), and key wrapping on
+   a 256-bit key, which is what wsupp does with it. scrypt uses
+   the parameters of dcrypt key derivation scaled down to keep
+   the iteration time reasonable. */
+
+#define DATA 4096
+
+static char data[DATA] __attribute__((aligned(8)));
+static byte key[16];
+static byte block[16];
+static byte wrapped[40];
+
+static void init_data(void)
+{
+	for(int i = 0; i < DATA; i++)
+		data[i] = random();
+	for(int i = 0; i < 16; i++)
+		key[i] = random();
+}
+
+static void run_sha1(long n)
+{
+	uint8_t out[20];
+
+	while(n-- > 0) {
+		sha1(out, data, DATA);
+		sink += out[0];
+	}
+}
+
+static void run_sha256(long n)
+{
+	uint8_t out[32];
+
+	while(n-- > 0) {
+		sha256(out, data, DATA);
+		sink += out[0];
+	}
+}
+
+static void run_hmac_sha256(long n)
+{
+	uint8_t out[32];
+
+	while(n-- > 0) {
+		hmac_sha256(out, key, sizeof(key), data, 64);
+		sink += out[0];
+	}
+}
+
+static void run_aes_encrypt(long n)
+{
+	struct aes128 ae;
+
+	aes128_init(&ae, key);
+
+	while(n-- > 0)
+		aes128_encrypt(&ae, block);
+
+	sink += block[0];
+
+	aes128_fini(&ae);
+}
+
+static void run_aes_decrypt(long n)
+{
+	struct aes128 ae;
+
+	aes128_init(&ae, key);
+
+	while(n-- > 0)
+		aes128_decrypt(&ae, block);
+
+	sink += block[0];
+
+	aes128_fini(&ae);
+}
+
+static void run_aes_xts(long n)
+{
+	struct aes128 ae;
+
+	aes128_init(&ae, key);
+
+	while(n-- > 0)
+		aes128_xts_encrypt(&ae, &ae, data, data, DATA, n);
+
+	sink += data[0];
+
+	aes128_fini(&ae);
+}
+
+static void run_aes_wrap(long n)
+{
+	while(n-- > 0)
+		aes128_wrap(key, wrapped, sizeof(wrapped));
+
+	sink += wrapped[0];
+}
+
+#define SCRYPT_N 1024
+#define SCRYPT_R 8
+#define SCRYPT_P 1
+
+static void* sctemp;
+static ulong sclen;
+
+static void init_scrypt(void)
+{
+	struct scrypt sc;
+	int prot = PROT_READ | PROT_WRITE;
+	int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+	void* buf;
+	int ret;
+
+	if(sctemp) return;
+
+	sclen = scrypt_init(&sc, SCRYPT_N, SCRYPT_R, SCRYPT_P);
+	buf = sys_mmap(NULL, sclen, prot, flags, -1, 0);
+
+	if((ret = mmap_error(buf)))
+		fail("mmap", NULL, ret);
+
+	sctemp = buf;
+}
+
+static void run_scrypt(long n)
+{
+	struct scrypt sc;
+	byte dk[32];
+
+	while(n-- > 0) {
+		scrypt_init(&sc, SCRYPT_N, SCRYPT_R, SCRYPT_P);
+		scrypt_temp(&sc, sctemp, sclen);
+		scrypt_data(&sc, "password", 8, "NaCl", 4);
+		scrypt_hash(&sc, dk, sizeof(dk));
+		sink += dk[0];
+	}
+}
+
+const struct bench bench_crypto[] = {
+	{ "crypto/sha1", run_sha1, init_data, DATA },
+	{ "crypto/sha256", run_sha256, init_data, DATA },
+	{ "crypto/hmac-sha256", run_hmac_sha256, init_data, 64 },
+	{ "crypto/aes128-encrypt", run_aes_encrypt, init_data, 16 },
+	{ "crypto/aes128-decrypt", run_aes_decrypt, init_data, 16 },
+	{ "crypto/aes128-xts", run_aes_xts, init_data, DATA },
+	{ "crypto/aes128-wrap", run_aes_wrap, init_data, 32 },
+	{ "crypto/scrypt", run_scrypt, init_scrypt, 0 },
+	{ NULL, NULL, NULL, 0 }
+};
@@ -0,0 +1,90 @@
+#include <format.h>
+
+#include "bench.h"
+
+/* Numbers with uniformly distributed decimal lengths, so that short
+   ones (which dominate real output) are not drowned out by the long
+   ones. Each iteration formats or parses one number. */
+
+#define NUMS 4096
+#define MASK (NUMS - 1)
+
+static uint64_t nums[NUMS];
+static char strs[NUMS][24];
+static char ints[NUMS][12];
+static char out[32];
+
+static void init_nums(void)
+{
+	static int done;
+
+	if(done++) return;
+
+	for(int i = 0; i < NUMS; i++) {
+		int len = 1 + random() % 19;
+		uint64_t m = 1;
+
+		while(--len > 0)
+			m *= 10;
+
+		nums[i] = random() % (10*m);
+
+		char* p = fmtu64(strs[i], strs[i] + 23, nums[i]);
+		*p = '\0';
+
+		p = fmtu64(ints[i], ints[i] + 11, nums[i] % 1000000000);
+		*p = '\0';
+	}
+}
+
+static void run_fmtu64(long n)
+{
+	for(long i = 0; i < n; i++)
+		sink += fmtu64(out, out + sizeof(out), nums[i & MASK]) - out;
+}
+
+static void run_fmti32(long n)
+{
+	for(long i = 0; i < n; i++)
+		sink += fmti32(out, out + sizeof(out), (int32_t)nums[i & MASK]) - out;
+}
+
+static void run_fmtx64(long n)
+{
+	for(long i = 0; i < n; i++)
+		sink += fmtx64(out, out + sizeof(out), nums[i & MASK]) - out;
+}
+
+static void run_fmtsize(long n)
+{
+	for(long i = 0; i < n; i++)
+		sink += fmtsize(out, out + sizeof(out), nums[i & MASK]) - out;
+}
+
+static void run_parseu64(long n)
+{
+	uint64_t v;
+
+	for(long i = 0; i < n; i++)
+		if(parseu64(strs[i & MASK], &v))
+			sink += v;
+}
+
+static void run_parseint(long n)
+{
+	int v;
+
+	for(long i = 0; i < n; i++)
+		if(parseint(ints[i & MASK], &v))
+			sink += v;
+}
+
+const struct bench bench_format[] = {
+	{ "format/fmtu64", run_fmtu64, init_nums, 0 },
+	{ "format/fmti32", run_fmti32, init_nums, 0 },
+	{ "format/fmtx64", run_fmtx64, init_nums, 0 },
+	{ "format/fmtsize", run_fmtsize, init_nums, 0 },
+	{ "format/parseu64", run_parseu64, init_nums, 0 },
+	{ "format/parseint", run_parseint, init_nums, 0 },
+	{ NULL, NULL, NULL, 0 }
+};
@@ -0,0 +1,237 @@
+/* lib/lzma.c at the time this benchmark was written, compressed as
+   a raw LZMA stream (lc=3 lp=0 pb=2, 64KB dictionary, end marker),
+   the way it would appear in .lz files past the header. */
+
+#define LZSIZE 10286
+
+static const byte lzdata[] = {
+	0x00, 0x11, 0x9A, 0x49, 0xC6, 0x47, 0x0F, 0x13, 0xA2, 0x00, 0x77, 0x3B,
+	0x18, 0x1F, 0x6C, 0x16, 0x27, 0x77, 0xBA, 0x30, 0xDE, 0x81, 0x11, 0x08,
+	0xC3, 0x53, 0x99, 0x8E, 0xEB, 0x88, 0x88, 0xE8, 0xE6, 0xC4, 0x0F, 0x95,
+	0xEA, 0x0D, 0xA8, 0xBF, 0x21, 0xED, 0xF5, 0xA3, 0x7E, 0xE9, 0x41, 0x04,
+	0x18, 0x17, 0x41, 0xAA, 0x7F, 0x42, 0x30, 0x7B, 0x99, 0xDA, 0x07, 0xB3,
+	0x44, 0x28, 0x93, 0x15, 0xD0, 0xDA, 0x31, 0x4C, 0xE9, 0x1C, 0x37, 0x6C,
+	0x80, 0xCF, 0x19, 0x0B, 0x84, 0xAD, 0x00, 0x63, 0xC2, 0xB9, 0x43, 0x90,
+	0xD5, 0x59, 0x21, 0x1E, 0x68, 0x57, 0xFF, 0xD6, 0xCA, 0x8F, 0x6E, 0x81,
+	0x57, 0xEE, 0xE0, 0xD1, 0x4B, 0x8B, 0x4D, 0x9C, 0xE2, 0x79, 0x6B, 0xF2,
+	0xE3, 0xDF, 0x2F, 0x56, 0x61, 0x38, 0x9C, 0xCD, 0xF7, 0x53, 0xD1, 0xDB,
+	0x9F, 0x80, 0x5B, 0x24, 0xE7, 0x71, 0xF7, 0x79, 0xF4, 0xD6, 0xA1, 0x1D,
+	0xBD, 0x8D, 0xA9, 0x81, 0x95, 0xA0, 0xB1, 0x25, 0xAE, 0x6A, 0x6C, 0x25,
+	0x25, 0x8A, 0x89, 0x63, 0x23, 0x7A, 0x35, 0x54, 0xE1, 0x48, 0x02, 0x5B,
+	0xFB, 0x09, 0x83, 0x46, 0xC6, 0x44, 0xA4, 0xD6, 0x06, 0x2E, 0x22, 0x67,
+	0x99, 0x51, 0x9C, 0x76, 0xC3, 0x2D, 0x03, 0x5D, 0x54, 0x30, 0xEB, 0x0D,
+	0x74, 0x80, 0xFE, 0xCC, 0x64, 0xFB, 0x9F, 0xAE, 0x27, 0x76, 0x8D, 0xA4,
+	0xC8, 0xC6, 0xA0, 0x01, 0x97, 0x99, 0x36, 0x92, 0xFA, 0xCB, 0x44, 0x5B,
+	0x94, 0xC8, 0x28, 0xD4, 0xD5, 0xE2, 0x06, 0x35, 0xE1, 0x03, 0x8E, 0x00,
+	0xF6, 0x84, 0xDC, 0x28, 0x41, 0x71, 0xE3, 0xD1, 0x33, 0x2A, 0xB9, 0x7E,
+	0x49, 0x55, 0xCC, 0xDE, 0x3D, 0x15, 0xBD, 0x8B, 0x71, 0xE0, 0x34, 0x75,
+	0x0A, 0xE0, 0xEA, 0xAD, 0xEF, 0xD3, 0xD8, 0x94, 0x2F, 0x98, 0x29, 0x79,
+	0x2D, 0x88, 0x4C, 0xF4, 0x72, 0x67, 0x2B, 0x52, 0x3E, 0xA6, 0x6D, 0xF2,
+	0xC5, 0x04, 0x00, 0x26, 0x27, 0x8D, 0x86, 0xB7, 0x66, 0x28, 0x6D, 0xEA,
+	0x51, 0xA3, 0x92, 0x6C, 0x7C, 0x5F, 0xAC, 0x33, 0x90, 0xA3, 0x05, 0x7E,
+	0x6C, 0x96, 0x3F, 0x81, 0x24, 0x2C, 0x12, 0x04, 0x33, 0xB7, 0xD5, 0x68,
+	0x37, 0x43, 0xDE, 0x5E, 0x35, 0x71, 0x15, 0xAF, 0xAB, 0x55, 0x49, 0x06,
+	0x6D, 0x0D, 0xBF, 0xF4, 0xDF, 0x10, 0x21, 0xE4, 0x84, 0xD3, 0x12, 0x85,
+	0x95, 0xC0, 0xD1, 0x3B, 0x30, 0x56, 0xCC, 0xFD, 0x7D, 0xFA, 0x92, 0xC4,
+	0xCD, 0x8A, 0x3C, 0x0F, 0xB5, 0xA6, 0x02, 0x1B, 0x1A, 0x86, 0x97, 0xCF,
+	0x32, 0x1F, 0x35, 0x6B, 0xA1, 0x32, 0x18, 0x14, 0x76, 0xA4, 0xCC, 0x51,
+	0x74, 0xB8, 0xF6, 0x90, 0xAB, 0x50, 0x1E, 0xDB, 0xBD, 0x2F, 0x75, 0x33,
+	0x15, 0x64, 0x70, 0x10, 0x57, 0x5B, 0x6F, 0xF5, 0xDC, 0xCA, 0xB0, 0x7A,
+	0x14, 0x9C, 0x38, 0x18, 0x79, 0xC9, 0xE7, 0x23, 0xC7, 0x27, 0x09, 0xDB,
+	0x57, 0xFA, 0xA2, 0xC0, 0x88, 0xEE, 0x9E, 0x61, 0x15, 0xAF, 0xB2, 0xC6,
+	0x9B, 0x0C, 0x88, 0xDF, 0x77, 0x35, 0x9F, 0x87, 0xC7, 0x4D, 0xC1, 0xF8,
+	0x19, 0x0C, 0x8F, 0x5D, 0xB7, 0xDC, 0x34, 0x72, 0x01, 0x06, 0xFD, 0x6A,
+	0xD1, 0x64, 0x6F, 0x0B, 0x71, 0x4D, 0x09, 0x93, 0x19, 0xD1, 0xFD, 0x34,
+	0x7C, 0x12, 0x93, 0xB7, 0x0A, 0xE4, 0x5F, 0xB8, 0xFF, 0x71, 0xD4, 0x85,
+	0xB3, 0x1D, 0x02, 0x08, 0xA7, 0xF1, 0xCF, 0x83, 0x5F, 0x4B, 0x11, 0xEE,
+	0x8A, 0x21, 0xBF, 0x93, 0x81, 0x02, 0x82, 0xC2, 0xF9, 0xBB, 0x28, 0x27,
+	0x4B, 0xE7, 0x25, 0x4C, 0xE2, 0xFB, 0xDF, 0x01, 0x0A, 0x50, 0x03, 0x18,
+	0x36, 0xF0, 0xA4, 0xB9, 0x46, 0xA0, 0x14, 0xC5, 0x4B, 0x1A, 0x2F, 0x33,
+	0xE2, 0x0D, 0x84, 0x1C, 0xA6, 0x06, 0xCF, 0xE8, 0x74, 0xA2, 0x67, 0xDE,
+	0x49, 0x95, 0xA0, 0x29, 0x5B, 0x13, 0xE3, 0x7C, 0x40, 0xAF, 0xF0, 0xBC,
+	0x67, 0x02, 0xF3, 0xE0, 0x56, 0xD8, 0x1F, 0x11, 0x00, 0xA2, 0xB2, 0x1B,
+	0x5D, 0xA7, 0x4A, 0x27, 0xB4, 0x45, 0x74, 0xAC, 0x51, 0x2C, 0x61, 0x26,
+	0x1C, 0x6B, 0x89, 0x6A, 0xEA, 0x0C, 0x3E, 0xB6, 0x3C, 0x0F, 0xDF, 0x3F,
+	0xD4, 0x6A, 0x59, 0xED, 0xD5, 0x3D, 0x55, 0xAC, 0x45, 0xD7, 0x8E, 0x43,
+	0x0D, 0x2E, 0xC2, 0xCF, 0x1F, 0xA5, 0xF9, 0x68, 0xEE, 0x9E, 0x99, 0xD5,
+	0x3E, 0xF7, 0x5F, 0x55, 0xB5, 0x6B, 0x6E, 0x77, 0x9F, 0xCC, 0x81, 0xFF,
+	0xBE, 0x55, 0xEC, 0x58, 0xA2, 0x68, 0xFC, 0x45, 0xF8, 0xE3, 0xF4, 0x36,
+	0xD7, 0x9B, 0x79, 0xDB, 0x96, 0x01, 0x12, 0x9B, 0xF7, 0x59, 0x2F, 0x5D,
+	0xE7, 0x81, 0x83, 0x59, 0x8E, 0x7E, 0x6B, 0x58, 0xB0, 0x2C, 0xE8, 0xB9,
+	0x46, 0x76, 0x0F, 0xAA, 0x68, 0xC4, 0x4C, 0x78, 0x51, 0x17, 0x63, 0x0A,
+	0x7C, 0xA1, 0x6E, 0x64, 0xA2, 0xC9, 0xA6, 0xBC, 0x3D, 0xA6, 0x44, 0x6F,
+	0xD0, 0x50, 0x2C, 0xC2, 0x1E, 0x08, 0xD8, 0x1D, 0x9C, 0x89, 0xB1, 0x27,
+	0x28, 0x46, 0xBD, 0x2B, 0x07, 0x27, 0x94, 0x95, 0x97, 0x4D, 0x40, 0xCC,
+	0xE5, 0xCB, 0x48, 0x53, 0x7D, 0xA7, 0x02, 0xE0, 0x54, 0x13, 0x27, 0x6D,
+	0xA9, 0xC8, 0xA7, 0x4A, 0x15, 0xE4, 0x97, 0x92, 0x37, 0xCE, 0x62, 0x12,
+	0xCF, 0x82, 0x11, 0x8A, 0x70, 0x24, 0x73, 0x25, 0xD2, 0x7F, 0x4D, 0xC6,
+	0x3B, 0x4C, 0xDB, 0x73, 0x55, 0x26, 0x03, 0xAF, 0x16, 0x6E, 0x7B, 0x54,
+	0x7B, 0x99, 0xB5, 0x77, 0x4C, 0x0E, 0x37, 0x58, 0xF3, 0x25, 0xB5, 0xE2,
+	0xE0, 0xF5, 0x4C, 0xAC, 0xE0, 0x30, 0xDF, 0x50, 0x09, 0xE9, 0x9D, 0xB7,
+	0x6F, 0x5E, 0x9E, 0x54, 0xAB, 0xF7, 0xB2, 0xB4, 0x55, 0xE3, 0xBB, 0x12,
+	0xFA, 0xC5, 0x2E, 0x80, 0x0B, 0xF7, 0x9B, 0x89, 0x4C, 0x14, 0xEB, 0x8C,
+	0xF8, 0x0C, 0x6B, 0x64, 0x30, 0xA6, 0x55, 0xAE, 0x1A, 0xCD, 0x55, 0x6E,
+	0x99, 0xC8, 0xCD, 0xBF, 0x3C, 0x7B, 0xD7, 0x60, 0x12, 0x50, 0x86, 0xE7,
+	0xD2, 0xB7, 0x80, 0xD8, 0x64, 0xBC, 0x01, 0x8B, 0x66, 0xE4, 0xE7, 0x1D,
+	0x24, 0x39, 0x1F, 0x55, 0x4F, 0x49, 0x4D, 0x6B, 0x72, 0x87, 0x60, 0xFA,
+	0xFA, 0x14, 0x80, 0x30, 0x2D, 0x27, 0x09, 0x36, 0x79, 0xE0, 0x4C, 0x67,
+	0x16, 0x2A, 0xE6, 0x33, 0x8B, 0x2A, 0x7F, 0xA4, 0x69, 0xC4, 0x87, 0xC3,
+	0x7C, 0x11, 0x4E, 0x0C, 0x52, 0x05, 0xA1, 0x45, 0xEF, 0x1B, 0x84, 0x89,
+	0x81, 0xF5, 0x6D, 0x64, 0x9E, 0x72, 0xF7, 0xB3, 0x72, 0xAC, 0xE9, 0x67,
+	0x95, 0x29, 0x40, 0xBE, 0xAF, 0x54, 0xD2, 0xC7, 0x9F, 0xE0, 0x40, 0x0A,
+	0x85, 0x4D, 0x0D, 0x76, 0x33, 0x84, 0x76, 0x7C, 0x2C, 0xDD, 0x6C, 0x2C,
+	0xE5, 0x1E, 0x07, 0x4B, 0x1B, 0x93, 0xFF, 0xE5, 0x34, 0x59, 0xFC, 0x0D,
+	0x9E, 0x7C, 0x75, 0xE5, 0x27, 0x96, 0xC2, 0x0C, 0x56, 0x0F, 0x0F, 0xED,
+	0xED, 0x93, 0x12, 0x62, 0x11, 0x77, 0xF5, 0x58, 0xAC, 0x34, 0x95, 0xBE,
+	0x7D, 0xCB, 0xE4, 0xAC, 0x40, 0xBE, 0x3F, 0x2C, 0xBC, 0x53, 0xFF, 0xD8,
+	0xF8, 0xAA, 0xAD, 0x31, 0xC2, 0xE1, 0xAC, 0x95, 0x01, 0x64, 0x22, 0x7B,
+	0x3F, 0xAD, 0xAC, 0x4A, 0x1D, 0x0D, 0x52, 0x45, 0xA8, 0xD7, 0x2A, 0xDC,
+	0x89, 0xEC, 0xEB, 0x87, 0xDE, 0xA1, 0xED, 0xC2, 0xF1, 0x2F, 0x55, 0x95,
+	0xFC, 0x83, 0xE0, 0xD0, 0x9F, 0x4A, 0xA5, 0x20, 0x8D, 0x75, 0x47, 0x9C,
+	0x09, 0xF7, 0xAB, 0x48, 0x51, 0x6F, 0x90, 0x92, 0x93, 0xE8, 0xE7, 0xF7,
+	0xFB, 0x5B, 0xC7, 0x39, 0xB1, 0xE9, 0xBE, 0x33, 0xE5, 0x2B, 0x5B, 0xCF,
+	0x48, 0xC9, 0x37, 0xEB, 0x73, 0x61, 0x13, 0x18, 0xDA, 0xAD, 0xF3, 0xCB,
+	0xF2, 0x67, 0x2F, 0x88, 0x85, 0x2F, 0x7E, 0xBD, 0xF4, 0x50, 0xA9, 0xE9,
+	0xFF, 0x39, 0x75, 0xC5, 0x93, 0xAE, 0xA0, 0x2D, 0xCE, 0xA7, 0xB6, 0xCA,
+	0x52, 0x4F, 0x91, 0x42, 0xC0, 0x6E, 0xC2, 0xBB, 0xF2, 0x3C, 0x79, 0xB9,
+	0xEC, 0x68, 0x44, 0x9E, 0x12, 0x86, 0x50, 0x90, 0x29, 0x27, 0xA7, 0x0E,
+	0x1F, 0xC3, 0x0A, 0xDA, 0x70, 0x58, 0xDE, 0xD0, 0x6A, 0x18, 0x2E, 0xB0,
+	0x97, 0x70, 0x7B, 0x8F, 0xF4, 0xA1, 0x28, 0xF7, 0x8B, 0xA9, 0x03, 0x28,
+	0xA8, 0xFE, 0x94, 0xAB, 0xE9, 0x52, 0x65, 0x13, 0x12, 0x21, 0xD5, 0xFC,
+	0x9A, 0x6F, 0x5C, 0x07, 0x5C, 0x76, 0x2F, 0x4D, 0x7F, 0x77, 0x7B, 0x13,
+	0x4B, 0xE6, 0xC5, 0x7E, 0x38, 0x29, 0xA3, 0x9F, 0x98, 0xF7, 0xB1, 0x7B,
+	0x6E, 0x93, 0xFE, 0x19, 0xDF, 0x82, 0x23, 0x1C, 0x3B, 0xB7, 0x1A, 0x7F,
+	0x06, 0x56, 0x1A, 0xFA, 0x33, 0xCA, 0x8E, 0x65, 0x5C, 0x2E, 0x2D, 0xA2,
+	0xDB, 0x06, 0x42, 0x44, 0xBB, 0x94, 0xDE, 0x92, 0xAE, 0x99, 0x35, 0xF3,
+	0x8C, 0x84, 0x08, 0x6D, 0x36, 0x8B, 0xEE, 0xE4, 0x0D, 0xCF, 0x61, 0xC0,
+	0x75, 0x90, 0xBF, 0x86, 0x83, 0x74, 0xD1, 0x34, 0x5A, 0xB1, 0xA5, 0xA9,
+	0x2C, 0x16, 0xC8, 0xAC, 0x91, 0xA9, 0x47, 0x81, 0xF3, 0x1C, 0x05, 0x85,
+	0x04, 0x1E, 0x5C, 0x6D, 0x0E, 0x81, 0x9B, 0xEA, 0x20, 0x80, 0xA2, 0xEA,
+	0x43, 0xE3, 0x17, 0xEA, 0x8E, 0xF3, 0x37, 0xB9, 0x07, 0x5F, 0x94, 0x91,
+	0x26, 0x63, 0xC5, 0x13, 0x21, 0x77, 0xAB, 0xC4, 0x3D, 0xCA, 0x9F, 0x7B,
+	0x95, 0x94, 0xCB, 0xC9, 0xF2, 0x86, 0xE6, 0x67, 0x24, 0x4F, 0x79, 0x98,
+	0xAB, 0xE2, 0x2C, 0x36, 0xE1, 0xAB, 0x50, 0x99, 0xCB, 0xE4, 0xE1, 0xCB,
+	0xA5, 0xBC, 0xFD, 0xAA, 0x61, 0x69, 0x38, 0xD9, 0xF9, 0x3A, 0xB0, 0x27,
+	0x4A, 0xBE, 0x37, 0xFA, 0x09, 0x8C, 0x5C, 0x15, 0x95, 0xDD, 0x8E, 0xE7,
+	0x65, 0x76, 0xF1, 0xA5, 0x07, 0x95, 0x87, 0x41, 0x18, 0xD0, 0x85, 0xA3,
+	0x40, 0x78, 0xE9, 0x91, 0x09, 0x07, 0x4C, 0x9B, 0x96, 0x65, 0x0B, 0x23,
+	0x0D, 0xA7, 0x44, 0x61, 0xF0, 0x1F, 0x7D, 0x7A, 0x55, 0xD0, 0x63, 0xD9,
+	0x18, 0x1F, 0x12, 0xEE, 0x3E, 0x21, 0xD4, 0xF6, 0x11, 0x19, 0x5F, 0x39,
+	0x90, 0xAC, 0x12, 0xA0, 0xEF, 0x76, 0x43, 0x2A, 0xBD, 0x76, 0xC1, 0xA2,
+	0x29, 0x85, 0x31, 0x50, 0x70, 0xFB, 0x4E, 0x94, 0xD9, 0xFC, 0xD7, 0xAA,
+	0xDC, 0x24, 0xA4, 0xFB, 0x98, 0xA1, 0x65, 0xD5, 0x4E, 0x9B, 0xD3, 0x16,
+	0xA1, 0x4B, 0x20, 0xAA, 0x5B, 0x38, 0x5B, 0x4A, 0xBD, 0x0C, 0xF7, 0xFD,
+	0xB4, 0x5F, 0x00, 0x36, 0x34, 0x8B, 0x10, 0x12, 0x77, 0xDD, 0xAA, 0x1A,
+	0x37, 0x25, 0x9F, 0x30, 0x3D, 0x37, 0xC2, 0x4D, 0xD5, 0x33, 0x79, 0x42,
+	0x6F, 0x26, 0xD2, 0x0E, 0xB1, 0xAB, 0x11, 0x31, 0xF7, 0x30, 0xB7, 0x47,
+	0xA7, 0x19, 0xB2, 0x59, 0x35, 0xE4, 0x86, 0x1A, 0x76, 0x16, 0xBE, 0x4E,
+	0x39, 0xE5, 0xE0, 0x1C, 0xCE, 0x42, 0x11, 0xBE, 0xAF, 0x38, 0xE9, 0x1C,
+	0x4B, 0x5C, 0xB9, 0xB0, 0x5D, 0x1E, 0x82, 0xF1, 0x65, 0xD8, 0xF5, 0x26,
+	0x89, 0x44, 0xC5, 0x36, 0x76, 0x1E, 0x2D, 0xA7, 0x01, 0x56, 0x83, 0x3D,
+	0x77, 0x6C, 0xBD, 0x0C, 0x4C, 0xF2, 0xDB, 0x1F, 0xEA, 0x51, 0x1E, 0xA1,
+	0x01, 0x85, 0x33, 0xB7, 0x59, 0x98, 0xC9, 0xDF, 0x93, 0xC5, 0xB4, 0xCE,
+	0xD1, 0x2A, 0x4A, 0x79, 0xB8, 0x22, 0x57, 0x7B, 0x2E, 0xA5, 0x58, 0x7A,
+	0xE9, 0x1D, 0x69, 0x3E, 0xD0, 0x5D, 0x03, 0xF4, 0x14, 0x40, 0xF8, 0xFF,
+	0x8C, 0xB1, 0xB0, 0x97, 0x4E, 0xA5, 0x39, 0xA8, 0xB7, 0x72, 0x85, 0x34,
+	0xB2, 0x48, 0x7D, 0xC2, 0xA9, 0x2A, 0xDD, 0xE9, 0x3F, 0xAD, 0x57, 0x53,
+	0xC3, 0xE0, 0xC5, 0x28, 0xF4, 0xA7, 0xE0, 0xCC, 0xF2, 0xD3, 0x23, 0x90,
+	0xE2, 0x37, 0x44, 0xFF, 0xED, 0x48, 0x3D, 0x65, 0x6A, 0x77, 0xFA, 0x38,
+	0x6B, 0x3F, 0x32, 0xE9, 0xB9, 0xC6, 0x43, 0x0A, 0xAF, 0xB9, 0x3B, 0xB8,
+	0xFC, 0xC6, 0x42, 0xC4, 0x6B, 0x24, 0x77, 0x95, 0x82, 0x35, 0xB1, 0x25,
+	0x72, 0x27, 0xD3, 0x6F, 0x2E, 0x50, 0x05, 0x6B, 0xFD, 0x98, 0xB3, 0x7C,
+	0x47, 0x32, 0xBE, 0xDE, 0x35, 0x57, 0xB8, 0xA9, 0xDA, 0x51, 0xC5, 0x47,
+	0x89, 0xA3, 0xF1, 0x14, 0x57, 0x96, 0x72, 0xA4, 0x96, 0x6B, 0xFC, 0x97,
+	0xCF, 0xCB, 0x9E, 0x8E, 0xCC, 0x77, 0xA6, 0x60, 0x0A, 0xDD, 0x7E, 0x89,
+	0x6B, 0x37, 0x7A, 0xB3, 0x93, 0x33, 0x91, 0x50, 0x35, 0xF3, 0x2E, 0xB5,
+	0x09, 0x4F, 0x7C, 0x0F, 0x02, 0x46, 0x11, 0xC0, 0x19, 0x98, 0xC5, 0xCE,
+	0xE4, 0xFC, 0xE6, 0x76, 0x1C, 0x3A, 0x0A, 0x9E, 0x0B, 0x0F, 0x99, 0xDE,
+	0xE6, 0xBD, 0x7B, 0x20, 0x7A, 0xD9, 0xAC, 0x8C, 0x3D, 0x08, 0x18, 0x8C,
+	0x5F, 0xB4, 0xD1, 0x4C, 0x1C, 0x3A, 0xC1, 0x76, 0xDA, 0x21, 0xBF, 0xDF,
+	0x08, 0x36, 0x33, 0x38, 0x20, 0x92, 0xF6, 0x2F, 0x6A, 0x54, 0xA9, 0x5B,
+	0xA3, 0xA6, 0x42, 0x00, 0xBF, 0x16, 0xAE, 0x59, 0x07, 0x6A, 0xAF, 0xAF,
+	0xE2, 0x87, 0x07, 0xEB, 0x4F, 0x25, 0xEE, 0x8E, 0xAB, 0x1E, 0x68, 0x75,
+	0x8C, 0xD4, 0x16, 0x94, 0xDE, 0xE2, 0xB9, 0x9D, 0xBB, 0xEF, 0xA1, 0x9B,
+	0x6F, 0x68, 0xA1, 0xEE, 0xF6, 0xD7, 0xC5, 0x7F, 0x14, 0x04, 0x7A, 0x73,
+	0x4A, 0x7A, 0xCC, 0xC8, 0x3B, 0x5F, 0xC1, 0x5B, 0xEE, 0x86, 0x30, 0xE5,
+	0x2A, 0xD9, 0xCE, 0x24, 0x47, 0xF2, 0xDE, 0x06, 0x07, 0x24, 0x59, 0xAA,
+	0xE0, 0x61, 0xAF, 0x6D, 0xA7, 0x4C, 0xFA, 0x6F, 0x1B, 0x30, 0xF3, 0x3A,
+	0x02, 0x8A, 0x2A, 0x07, 0x93, 0x59, 0xC6, 0xE0, 0x38, 0xFB, 0x0A, 0x26,
+	0x1F, 0x6A, 0x1A, 0x3E, 0x3F, 0x67, 0x03, 0xEA, 0x04, 0x3E, 0x9C, 0x31,
+	0x7A, 0xBB, 0x18, 0xBF, 0x09, 0x5A, 0xED, 0x44, 0x10, 0x75, 0x0F, 0xF6,
+	0x76, 0x9A, 0x2F, 0xC9, 0x0E, 0x4C, 0x16, 0x2A, 0x09, 0x90, 0xB4, 0xDD,
+	0xE6, 0xCC, 0x5C, 0xF6, 0xC7, 0x09, 0xCC, 0x5A, 0xF9, 0x29, 0x22, 0x1C,
+	0x00, 0xD7, 0x70, 0x68, 0x5D, 0x29, 0x5B, 0xB9, 0xA4, 0x63, 0x1E, 0xF3,
+	0xA7, 0x7E, 0x67, 0x1E, 0xDE, 0x8C, 0xD6, 0xDB, 0xF8, 0x38, 0xDD, 0x67,
+	0xF0, 0x7E, 0xBE, 0x14, 0xB7, 0xE6, 0x9E, 0x7A, 0xC5, 0x48, 0x1E, 0x0C,
+	0x98, 0x7B, 0x25, 0x2D, 0x40, 0xDA, 0x35, 0x70, 0x0F, 0x3E, 0x5B, 0xB7,
+	0x23, 0xD9, 0xC2, 0x99, 0xEF, 0xBB, 0x46, 0x2D, 0xF6, 0xF5, 0xFB, 0x2D,
+	0xD9, 0x2E, 0x81, 0x2A, 0xBA, 0x26, 0xF5, 0x25, 0xA7, 0x19, 0xC2, 0xC0,
+	0xE9, 0x21, 0x08, 0x9A, 0x33, 0x61, 0x7D, 0x01, 0x87, 0x2D, 0x0E, 0xDC,
+	0xF4, 0x7F, 0xE4, 0x6B, 0x2B, 0x6C, 0x36, 0x33, 0x0D, 0x36, 0x2B, 0x4D,
+	0x32, 0x0D, 0x56, 0xF8, 0x68, 0x9E, 0xE2, 0x2B, 0xBA, 0x42, 0xA2, 0xF5,
+	0x26, 0xBF, 0xA9, 0xBA, 0x22, 0xC0, 0x19, 0xBB, 0xE1, 0xB4, 0x1E, 0x3D,
+	0xE2, 0x7D, 0xB4, 0x9B, 0xB2, 0x66, 0x21, 0xA1, 0x7F, 0x87, 0x9B, 0x2D,
+	0x56, 0x57, 0xB5, 0xA8, 0xF6, 0x00, 0x70, 0xFF, 0xB4, 0x4F, 0xB4, 0xA9,
+	0x46, 0x79, 0xDE, 0xF2, 0x3F, 0xDB, 0xC0, 0xC1, 0x26, 0x52, 0x71, 0x19,
+	0x2C, 0xAC, 0x34, 0xAF, 0xB7, 0x2A, 0x9E, 0x2F, 0x65, 0xCC, 0xF1, 0x84,
+	0x72, 0xC0, 0x2D, 0xC4, 0x6F, 0x12, 0x02, 0xE1, 0xB6, 0x65, 0xA3, 0x1A,
+	0x11, 0x54, 0x4B, 0x28, 0x53, 0x8A, 0xA9, 0x18, 0x02, 0x48, 0xE1, 0x91,
+	0xED, 0xA0, 0x15, 0xF4, 0x03, 0xE8, 0xAC, 0xE3, 0x05, 0x02, 0xB9, 0x59,
+	0xB5, 0xE3, 0x93, 0xA1, 0x3A, 0x0D, 0x44, 0xAC, 0x6A, 0x80, 0x51, 0xA1,
+	0x80, 0x72, 0x86, 0x5B, 0xCB, 0x9E, 0x8F, 0x23, 0x71, 0x53, 0x3E, 0x55,
+	0x4E, 0x1B, 0x49, 0x4B, 0x92, 0x6D, 0x48, 0xDC, 0x24, 0x26, 0xD7, 0xC3,
+	0xDE, 0x50, 0xCD, 0x58, 0xD1, 0xA6, 0x14, 0xC6, 0xC2, 0x3B, 0x13, 0x5F,
+	0xAB, 0x23, 0x5C, 0x70, 0x52, 0x12, 0x29, 0xB4, 0x16, 0xD8, 0x73, 0xF5,
+	0x97, 0x62, 0xAA, 0xE1, 0xF9, 0x68, 0xF0, 0x4D, 0xA1, 0xAD, 0x98, 0x82,
+	0x3E, 0x62, 0x87, 0x87, 0x11, 0x5A, 0xC1, 0x14, 0xD3, 0xC8, 0x15, 0x78,
+	0x66, 0x04, 0x1F, 0x4B, 0x1A, 0x4C, 0xDD, 0xAB, 0x7E, 0x36, 0x63, 0xEF,
+	0x70, 0xCE, 0x05, 0xA6, 0xC0, 0xA7, 0x3C, 0xD8, 0x11, 0x64, 0xE9, 0xF9,
+	0xBB, 0x1C, 0x3E, 0x9C, 0x66, 0xE7, 0x82, 0x0A, 0x35, 0x75, 0x26, 0x88,
+	0x2E, 0x7A, 0xB7, 0x4F, 0x82, 0xFE, 0xA5, 0x80, 0x75, 0xB3, 0xA5, 0x56,
+	0x6F, 0x6D, 0x90, 0x5F, 0xA6, 0xB5, 0x5D, 0x96, 0xA1, 0xE3, 0xF1, 0xB2,
+	0xAD, 0xE8, 0x05, 0xE5, 0xEE, 0xC5, 0x25, 0xE1, 0x3D, 0xA3, 0xC9, 0xEF,
+	0x7A, 0x77, 0x1D, 0x77, 0xFC, 0x7A, 0xC8, 0x71, 0xB6, 0xA1, 0x82, 0x28,
+	0x20, 0xA1, 0x48, 0xE1, 0xB0, 0xC3, 0x71, 0xB3, 0x94, 0x11, 0xF7, 0x1D,
+	0xA4, 0x96, 0x55, 0x51, 0x74, 0x7E, 0x30, 0x7E, 0xF7, 0x10, 0x84, 0x66,
+	0x15, 0x5E, 0xDC, 0xDB, 0x27, 0x79, 0x54, 0xF3, 0x80, 0xFD, 0xFB, 0xC3,
+	0xD6, 0xE9, 0x44, 0xAB, 0x34, 0x73, 0xC5, 0x8D, 0xF4, 0x8A, 0x88, 0x7B,
+	0x59, 0xA9, 0x8B, 0x89, 0x2E, 0x17, 0x39, 0x6D, 0xF8, 0xEE, 0x16, 0x77,
+	0x6D, 0xE2, 0x4A, 0xA1, 0xA7, 0xB6, 0xF2, 0x64, 0x2A, 0x8E, 0x9C, 0xD4,
+	0xAE, 0x56, 0x3A, 0xE2, 0x82, 0xF6, 0xCD, 0x5D, 0x5C, 0x7A, 0x1F, 0x68,
+	0xB4, 0x2D, 0x0A, 0x8A, 0xCE, 0x52, 0x31, 0xE3, 0x5D, 0x1C, 0x75, 0xBA,
+	0x76, 0x8D, 0x26, 0x28, 0x69, 0xD2, 0xCB, 0xF1, 0xA4, 0xFD, 0x55, 0x8F,
+	0x59, 0xAE, 0x45, 0x05, 0x5C, 0xAA, 0x91, 0xA0, 0x3E, 0x40, 0x35, 0x52,
+	0xAF, 0x95, 0x89, 0xA4, 0x81, 0x8E, 0xDB, 0x80, 0xD9, 0xC0, 0xB1, 0x30,
+	0x39, 0xC5, 0x47, 0x93, 0x67, 0xA6, 0xFF, 0x5A, 0x12, 0x53, 0x92, 0x59,
+	0x37, 0x61, 0x60, 0x91, 0xCD, 0x35, 0xFC, 0xCD, 0xC0, 0x58, 0xEF, 0xA8,
+	0xA5, 0xD8, 0xA4, 0x55, 0xD0, 0x9E, 0xED, 0xEA, 0x9F, 0x0C, 0x7D, 0xF5,
+	0xA9, 0xB2, 0x59, 0x4A, 0xAD, 0x22, 0xE1, 0x00, 0x67, 0x29, 0x8B, 0xCC,
+	0xA3, 0x30, 0xCB, 0xF4, 0xD5, 0x83, 0xD2, 0xB6, 0x65, 0x60, 0x23, 0x73,
+	0x05, 0x60, 0xFF, 0x1B, 0xF9, 0x56, 0x80, 0x2F, 0xA6, 0xA3, 0xA5, 0x6F,
+	0xF7, 0x73, 0xEB, 0x63, 0xA6, 0x46, 0x3A, 0x2C, 0x9B, 0x2B, 0x51, 0x32,
+	0x21, 0xE9, 0x5C, 0x64, 0xD6, 0x20, 0x5B, 0x89, 0x69, 0xDD, 0xB7, 0xC5,
+	0x9E, 0xE6, 0xB7, 0x14, 0x90, 0x61, 0xE5, 0xAC, 0x36, 0x42, 0x10, 0xC4,
+	0xB9, 0xA1, 0x71, 0xD5, 0x6B, 0xA4, 0xD0, 0x4D, 0xEE, 0x29, 0x08, 0xA9,
+	0x4D, 0xAE, 0x26, 0x8D, 0xFF, 0x36, 0xCB, 0x6F, 0x8C, 0x07, 0xC9, 0x42,
+	0x48, 0x02, 0xC2, 0xCD, 0xEB, 0xBC, 0x97, 0xC7, 0xD2, 0x3B, 0xFD, 0xBD,
+	0xB5, 0xEE, 0x63, 0xD8, 0x77, 0x25, 0x65, 0xCE, 0xD0, 0xC1, 0x7A, 0x4D,
+	0xE2, 0x87, 0xA8, 0xB6, 0xC4, 0xF4, 0x01, 0x0B, 0x50, 0xBD, 0x6C, 0x70,
+	0xDA, 0xFE, 0x8B, 0x1A, 0xE7, 0x1F, 0x2A, 0xDA, 0x1C, 0x4A, 0xF4, 0x04,
+	0xF1, 0xC9, 0xDC, 0x56, 0x38, 0x08, 0x4B, 0xBA, 0xE7, 0x3D, 0xD6, 0xD3,
+	0x02, 0xA9, 0x77, 0x3F, 0x41, 0x37, 0xDF, 0xC9, 0x2C, 0x87, 0xB9, 0x5A,
+	0xCD, 0x01, 0xE3, 0xB1, 0xD1, 0xBD, 0xE7, 0x9B, 0x22, 0x06, 0xE7, 0xA2,
+	0xEA, 0x7C, 0x31, 0x78, 0x0A, 0x72, 0x69, 0xD8, 0x08, 0x21, 0x51, 0x02,
+	0xC7, 0x79, 0x62, 0xF7, 0x3A, 0x41, 0x60, 0xF9, 0x25, 0xF9, 0x22, 0x45,
+	0x67, 0xAD, 0x78, 0x2A, 0x74, 0x20, 0x39, 0x17, 0x34, 0xDA, 0x18, 0x47,
+	0x0E, 0xE2, 0x76, 0x0F, 0x72, 0x79, 0x72, 0x80, 0x8A, 0x86, 0x7F, 0xE3,
+	0x5E, 0x41, 0xD4, 0x8D, 0xB9, 0x8B, 0xD6, 0xEA, 0xC3, 0x57, 0x96, 0x5C,
+	0x81, 0x6C, 0x5C, 0xE7, 0x98, 0x9E, 0x63, 0xE1, 0x85, 0x76, 0x1D, 0x6E,
+	0xE3, 0x92, 0x92, 0xAA, 0x62, 0x72, 0xDE, 0x45, 0x34, 0x07, 0x0C, 0x70,
+	0x7C, 0x0F, 0x13, 0x44, 0xE6, 0x1C, 0x13, 0xB7, 0x6C, 0x09, 0xF6, 0x78,
+	0x04, 0xC4, 0xA8, 0x3A, 0xAE, 0x89, 0xE0, 0x36, 0xF3, 0x3B, 0x8B, 0xF1,
+	0x29, 0x55, 0x6C, 0x9E, 0x39, 0xEC, 0xC4, 0x25, 0x34, 0xF2, 0xCB, 0x3E,
+	0x26, 0x70, 0x87, 0x69, 0xDF, 0x68, 0x8C, 0x1A, 0xDD, 0x12, 0xD9, 0x2C,
+	0x90, 0xDA, 0x5D, 0x9A, 0x60, 0xD8, 0xF8, 0x04, 0xB3, 0xD1, 0x88, 0xF3,
+	0x90, 0xED, 0x50, 0x73, 0x4D, 0x1C, 0x58, 0xD0, 0x04, 0xB5, 0x85, 0x74,
+	0x49, 0x97, 0x0A, 0x26, 0xF5, 0x37, 0x4E, 0xFF, 0xDA, 0x72, 0xE8, 0xC8,
+};
@@ -0,0 +1,58 @@
+#include <bits/types.h>
+#include <lzma.h>
+#include <util.h>
+
+#include "bench.h"
+#include "lzdata.h"
+
+/* Each iteration decompresses the whole sample. MB/s figures are
+   for the output. */
+
+static byte lzbuf[LZMA_SIZE];
+static byte output[LZSIZE + 1024];
+
+static int inflate(void)
+{
+	struct lzma* lz;
+	void* src = (void*)lzdata;
+	void* end = src + sizeof(lzdata);
+
+	if(!(lz = lzma_create(lzbuf, sizeof(lzbuf))))
+		fail("LZMA buffer error", NULL, 0);
+
+	lz->srcbuf = src;
+	lz->srcptr = src + 1; /* always-zero first byte of the range coder */
+	lz->srchwm = end;
+	lz->srcend = end;
+
+	lz->dstbuf = output;
+	lz->dstptr = output;
+	lz->dsthwm = output + sizeof(output);
+	lz->dstend = output + sizeof(output);
+
+	int ret = lzma_inflate(lz);
+
+	if(ret != LZMA_STREAM_END)
+		return -ret;
+
+	return (void*)lz->dstptr - (void*)output;
+}
+
+static void check_inflate(void)
+{
+	int ret;
+
+	if((ret = inflate()) != LZSIZE)
+		fail("LZMA sample does not decompress", NULL, 0);
+}
+
+static void run_inflate(long n)
+{
+	while(n-- > 0)
+		sink += inflate();
+}
+
+const struct bench bench_lzma[] = {
+	{ "lzma/inflate", run_inflate, check_inflate, LZSIZE },
+	{ NULL, NULL, NULL, 0 }
+};
@@ -0,0 +1,98 @@
+#include <netlink.h>
+#include <netlink/pack.h>
+#include <netlink/rtnl/addr.h>
+#include <netlink/genl/nl80211.h>
+
+#include <util.h>
+
+#include "bench.h"
+
+/* Packing typical outbound requests, an RTNL address assignment
+   (as in ip4cfg) and a GENL nl80211 connect command (as in wsupp).
+   MB/s figures are for the resulting message size. */
+
+#define RTNL_SIZE 52
+#define GENL_SIZE 84
+
+static char txbuf[512];
+static struct ncbuf nc;
+
+static void pack_rtnl(int seq)
+{
+	struct ifaddrmsg* req;
+	byte ip[4] = { 192, 168, 1, 2 };
+
+	nc_header(&nc, RTM_NEWADDR, NLM_F_CREATE | NLM_F_REPLACE, seq);
+
+	if(!(req = nc_fixed(&nc, sizeof(*req))))
+		return;
+
+	req->family = 2;
+	req->prefixlen = 24;
+	req->index = 3;
+
+	nc_put(&nc, IFA_LOCAL, ip, sizeof(ip));
+	nc_put(&nc, IFA_ADDRESS, ip, sizeof(ip));
+	nc_put_str(&nc, IFA_LABEL, "eth0");
+}
+
+static void pack_genl(int seq)
+{
+	byte bssid[6] = { 0x00, 0x11, 0x22, 0x33, 0x44, 0x55 };
+	char ssid[] = "some-network";
+	struct nlattr* at;
+
+	nc_header(&nc, 28, 0, seq);
+	nc_gencmd(&nc, NL80211_CMD_CONNECT, 0);
+
+	nc_put_int(&nc, NL80211_ATTR_IFINDEX, 3);
+	nc_put(&nc, NL80211_ATTR_MAC, bssid, sizeof(bssid));
+	nc_put(&nc, NL80211_ATTR_SSID, ssid, sizeof(ssid) - 1);
+	nc_put_int(&nc, NL80211_ATTR_WIPHY_FREQ, 2412);
+
+	at = nc_put_nest(&nc, NL80211_ATTR_SCAN_SSIDS);
+	nc_put(&nc, 1, ssid, sizeof(ssid) - 1);
+	nc_end_nest(&nc, at);
+}
+
+static void init_rtnl(void)
+{
+	nc_buf_set(&nc, txbuf, sizeof(txbuf));
+
+	pack_rtnl(0);
+
+	if(nc_msg(&nc)->len != RTNL_SIZE)
+		fail("unexpected RTNL message size", NULL, 0);
+}
+
+static void init_genl(void)
+{
+	nc_buf_set(&nc, txbuf, sizeof(txbuf));
+
+	pack_genl(0);
+
+	if(nc_msg(&nc)->len != GENL_SIZE)
+		fail("unexpected GENL message size", NULL, 0);
+}
+
+static void run_rtnl(long n)
+{
+	while(n-- > 0) {
+		pack_rtnl(n);
+		sink += nc_msg(&nc)->len;
+	}
+}
+
+static void run_genl(long n)
+{
+	while(n-- > 0) {
+		pack_genl(n);
+		sink += nc_msg(&nc)->len;
+	}
+}
+
+const struct bench bench_netlink[] = {
+	{ "netlink/pack-rtnl", run_rtnl, init_rtnl, RTNL_SIZE },
+	{ "netlink/pack-genl", run_genl, init_genl, GENL_SIZE },
+	{ NULL, NULL, NULL, 0 }
+};
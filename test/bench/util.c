@@ -0,0 +1,109 @@
+#include <sys/file.h>
+
+#include <output.h>
+#include <string.h>
+#include <util.h>
+
+#include "bench.h"
+
+/* qsort gets timed on a full sort of a pointer array, which has to be
+   restored to the original order before each run. Copying it over takes
+   a small fraction of the total time. */
+
+#define NSORT 4096
+
+static int values[NSORT];
+static int* orig[NSORT];
+static int* work[NSORT];
+
+static int cmpint(void* a, void* b)
+{
+	int x = *((int*)a);
+	int y = *((int*)b);
+
+	return x < y ? -1 : x > y ? 1 : 0;
+}
+
+static void init_random(void)
+{
+	for(int i = 0; i < NSORT; i++) {
+		values[i] = random() % (10*NSORT);
+		orig[i] = &values[i];
+	}
+}
+
+static void init_sorted(void)
+{
+	for(int i = 0; i < NSORT; i++) {
+		values[i] = i;
+		orig[i] = &values[i];
+	}
+}
+
+static void run_qsort(long n)
+{
+	while(n-- > 0) {
+		for(int i = 0; i < NSORT; i++)
+			work[i] = orig[i];
+
+		qsortp(work, NSORT, cmpint);
+
+		sink += *work[0];
+	}
+}
+
+/* Small writes, of the kind most tools do, into a page-sized buffer
+   flushed to /dev/null. */
+
+#define CHUNK 24
+
+static struct bufout bo;
+static char outbuf[4096];
+static char chunk[CHUNK] = "some line of output ...\n";
+
+static void init_bufout(void)
+{
+	int fd;
+
+	if(bo.buf)
+		return;
+	if((fd = sys_open("/dev/null", O_WRONLY)) < 0)
+		fail(NULL, "/dev/null", fd);
+
+	bufoutset(&bo, fd, outbuf, sizeof(outbuf));
+}
+
+static void run_bufout(long n)
+{
+	while(n-- > 0)
+		bufout(&bo, chunk, CHUNK);
+
+	bufoutflush(&bo);
+}
+
+/* Newline counting over a buffer of text-like data with lines
+   of random length, as tail and wc would see it. */
+
+#define TEXT 65536
+
+static char text[TEXT];
+
+static void init_text(void)
+{
+	for(int i = 0; i < TEXT; i++)
+		text[i] = (random() % 40) ? 'a' + i % 26 : '\n';
+}
+
+static void run_memcount(long n)
+{
+	while(n-- > 0)
+		sink += memcount(text, TEXT, '\n');
+}
+
+const struct bench bench_util[] = {
+	{ "util/qsort-random", run_qsort, init_random, 0 },
+	{ "util/qsort-sorted", run_qsort, init_sorted, 0 },
+	{ "util/bufout", run_bufout, init_bufout, CHUNK },
+	{ "util/memcount", run_memcount, init_text, TEXT },
+	{ NULL, NULL, NULL, 0 }
+};
@@ -0,0 +1,64 @@
+#include <crypto/aes128.h>
+
+#include <printf.h>
+#include <string.h>
+#include <util.h>
+
+#include "aes_xts.h"
+
+/* The vectors use the same key for data and tweaks. */
+
+static uint8_t tmp[2*512] __attribute__((aligned(8)));
+static uint8_t ref[512] __attribute__((aligned(8)));
+
+static void check(const struct vec* v, int op, void* got, const void* exp)
+{
+	if(!memcmp(got, exp, 512))
+		return;
+
+	tracef("FAIL %s %s\n", v->tag, op ? "decrypt" : "encrypt");
+
+	_exit(0xFF);
+}
+
+static void test(const struct vec* v)
+{
+	struct aes128 A;
+	uint64_t lba = v->lba;
+
+	aes128_init(&A, v->key);
+
+	memcpy(tmp, v->ptx, 512);
+	aes128_xts_encrypt(&A, &A, tmp, tmp, 512, lba);
+	check(v, 0, tmp, v->ctx);
+
+	memcpy(tmp, v->ctx, 512);
+	aes128_xts_decrypt(&A, &A, tmp, tmp, 512, lba);
+	check(v, 1, tmp, v->ptx);
+
+	/* Consecutive sectors in a single call */
+
+	memcpy(tmp + 0, v->ptx, 512);
+	memcpy(tmp + 512, v->ptx, 512);
+	memcpy(ref, v->ptx, 512);
+
+	aes128_xts_encrypt(&A, &A, tmp, tmp, 1024, lba);
+	aes128_xts_encrypt(&A, &A, ref, ref, 512, lba + 1);
+	check(v, 0, tmp + 0, v->ctx);
+	check(v, 0, tmp + 512, ref);
+
+	aes128_xts_decrypt(&A, &A, tmp, tmp, 1024, lba);
+	check(v, 1, tmp + 0, v->ptx);
+	check(v, 1, tmp + 512, v->ptx);
+
+	aes128_fini(&A);
+}
+
+int main(void)
+{
+	test(&vec20);
+	test(&vec21);
+	test(&vec25);
+
+	return 0;
+}
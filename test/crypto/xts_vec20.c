@@ -1,4 +1,4 @@
-#include "aesxts.h"
+#include "aes_xts.h"
 
 const struct vec vec20 = {
 	.tag = "vec20",
@@ -1,4 +1,5 @@
 #include <sys/file.h>
+#include <bits/time.h>
 #include <format.h>
 #include <string.h>
 #include <util.h>
@@ -72,9 +73,27 @@ int test_basic_types(void)
 	TEST(fmtint, "123", 123);
 	TEST(fmtint, "1234567890", 1234567890);
 	TEST(fmtint, "-10", -10);
+	TEST(fmtint, "0", 0);
+	TEST(fmtint, "9", 9);
+	TEST(fmtint, "10", 10);
+	TEST(fmtint, "99", 99);
+	TEST(fmtint, "100", 100);
+	TEST(fmtint, "-2147483648", -2147483647-1);
+	TEST(fmtuint, "4294967295", 4294967295U);
+
+	TEST(fmti64, "-9223372036854775808", -9223372036854775807LL-1);
+	TEST(fmtu64, "18446744073709551615", 18446744073709551615ULL);
+	TEST(fmtu64, "10000000000000000000", 10000000000000000000ULL);
+	TEST(fmtu64, "9999999999999999999", 9999999999999999999ULL);
+	TEST(fmtu64, "1000000000", 1000000000ULL);
 
 	TEST(fmtxlong, "ABCD", 0xABCD);
 	TEST(fmtxlong, "FFFFFFFF", 0xFFFFFFFF);
+	TEST(fmtxlong, "0", 0);
+	TEST(fmtx64, "123456789ABCDEF0", 0x123456789ABCDEF0ULL);
+	TEST(fmtx64, "100000000", 0x100000000ULL);
+	TEST(fmtx32, "9A", 0x9A);
+	TEST(fmthex, "DEADBEEF", 0xDEADBEEF);
 
 	TEST(fmtchar, "Q", 'Q');
 
@@ -85,6 +104,16 @@ int test_basic_types(void)
 
 	TEST(fmtraw, "abc", "abcdef", 3);
 
+	struct tm tm = {
+		.year = 2017 - 1900, .mon = 8 - 1, .mday = 26,
+		.hour = 1, .min = 38, .sec = 5
+	};
+
+	TEST(fmttm, "2017-08-26 01:38:05", &tm);
+
+	tm.year = 10000 - 1900;
+	TEST(fmttm, "10000-08-26 01:38:05", &tm);
+
 	return ret;
 }
 
@@ -100,6 +129,13 @@ int test_buf_cliping(void)
 	TEST(fmtint, "123", 1234);
 	TEST(fmtstr, "abc", "abcdef");
 	TEST(fmtxlong, "ABC", 0xABCDEF);
+	TEST(fmtint, "-12", -1234);
+	TEST(fmtu64, "184", 18446744073709551615ULL);
+	TEST(fmtx64, "123", 0x123456789ABCDEF0ULL);
+
+	struct tm tm = { .year = 2017 - 1900, .mon = 0, .mday = 1 };
+
+	TEST(fmttm, "201", &tm);
 
 	return ret;
 }
@@ -1,4 +1,5 @@
 #include <sys/file.h>
+#include <sys/mman.h>
 #include <printf.h>
 #include <format.h>
 #include <string.h>
@@ -33,9 +34,52 @@ static void failf(const char* fmt, ...)
 	if(var != exp) \
 		failf("%s:%i: FAIL %s -> " fmt "\n", FL, str, var);
 
+/* printf here has no %llu, uint64_t values get formatted separately */
+
+static void fail64(const char* file, int line, char* str, uint64_t val)
+{
+	char buf[30];
+	char* p = fmtu64(buf, buf + sizeof(buf) - 1, val);
+
+	*p = '\0';
+
+	failf("%s:%i: FAIL %s -> %s\n", file, line, str, buf);
+}
+
+#define TOK64(parse, str, var, exp) \
+	if(!(p = parse(str, &var)) || *p) \
+		failf("%s:%i: FAIL %s not parsed\n", FL, str); \
+	if(var != exp) \
+		fail64(FL, str, var);
+
+/* Block parsing may read past the terminating 0, but must never
+   cross into the next page. Put the number at the very end of a page
+   with nothing mapped after it. */
+
+static void test_page_end(void)
+{
+	int prot = PROT_READ | PROT_WRITE;
+	int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+	char* buf = sys_mmap(NULL, 2*PAGE, prot, flags, -1, 0);
+	char* str = buf + PAGE - 8;
+	uint64_t xv;
+	char* p;
+
+	if(mmap_error(buf))
+		failf("%s:%i: FAIL mmap\n", FL);
+
+	sys_munmap(buf + PAGE, PAGE);
+
+	memcpy(str, "1234567", 8);
+
+	TOK64(parseu64, str, xv, 1234567);
+}
+
 int main(void)
 {
 	int iv;
+	ulong lv;
+	uint64_t xv;
 	char* p;
 
 	TNULL(parseint, "",    iv);
@@ -45,6 +89,18 @@ int main(void)
 
 	TOK(parseint, "123", iv, 123, "%i");
 	TOK(parseint, "1",   iv, 1,   "%i");
+	TOK(parseint, "0012345678", iv, 12345678, "%i");
+
+	TLEFT(parseint, "123456789x", iv, "x");
+	TLEFT(parseint, "12345678:9", iv, ":9");
+	TLEFT(parseint, "1234567/", iv, "/");
+
+	TOK(parseulong, "4294967295", lv, 4294967295UL, "%lu");
+	TOK64(parseu64, "18446744073709551615", xv, 18446744073709551615ULL);
+	TOK64(parseu64, "1234567890123456", xv, 1234567890123456ULL);
+	TLEFT(parseu64, "12345678901234567890abc", xv, "abc");
+
+	test_page_end();
 
 	return 0;
 }
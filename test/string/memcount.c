@@ -0,0 +1,72 @@
+#include <format.h>
+#include <string.h>
+#include <util.h>
+
+static char buf[1500];
+
+static int test(char* file, int line, int off, int len, int exp)
+{
+	int res = memcount(buf + off, len, '\n');
+
+	if(res == exp)
+		return 0;
+
+	FMTBUF(p, e, out, 200);
+
+	p = fmtstr(p, e, file);
+	p = fmtstr(p, e, ":");
+	p = fmtint(p, e, line);
+	p = fmtstr(p, e, ": ");
+	p = fmtstr(p, e, "FAIL exp ");
+	p = fmtint(p, e, exp);
+	p = fmtstr(p, e, " got ");
+	p = fmtint(p, e, res);
+
+	FMTENL(p, e);
+
+	writeall(STDERR, out, p - out);
+
+	return -1;
+}
+
+/* Reference count, byte by byte. */
+
+static int slow(int off, int len)
+{
+	int i, cnt = 0;
+
+	for(i = off; i < off + len; i++)
+		if(buf[i] == '\n')
+			cnt++;
+
+	return cnt;
+}
+
+#define TEST(off, len, exp) \
+	ret |= test(__FILE__, __LINE__, off, len, exp)
+
+int main(void)
+{
+	int i, ret = 0;
+
+	TEST(0, 0, 0);
+
+	memset(buf, '\n', sizeof(buf));
+
+	TEST(0, 1, 1);
+	TEST(3, 37, 37);
+	TEST(0, 1500, 1500); /* lane counters must not overflow */
+
+	/* bytes differing from \n in the high bit only */
+	memset(buf, '\n' | 0x80, sizeof(buf));
+
+	TEST(0, 1500, 0);
+
+	for(i = 0; i < (int)sizeof(buf); i++)
+		buf[i] = (i % 7 == 0) ? '\n' : (i % 5 ? 'a' : 0x8A);
+
+	for(i = 0; i < 20; i++)
+		TEST(i, 1400 - 3*i, slow(i, 1400 - 3*i));
+
+	return ret;
+}